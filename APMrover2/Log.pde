@@ -197,6 +197,9 @@ static void Log_Write_Performance()
         ins_error_count  : ins.error_count()
     };
     DataFlash.WriteBlock(&pkt, sizeof(pkt));
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    DataFlash.Log_Write_Scheduler(scheduler);
+#endif
 }
 
 // Write a mission command. Total length : 36 bytes
@@ -571,6 +571,8 @@ static void load_parameters(void)
 	    unsigned long before = micros();
 	    // Load all auto-loaded EEPROM variables
 	    AP_Param::load_all();
+	    // reclaim the space of removed parameters if storage is nearly full
+	    AP_Param::compact_if_full();
 
 	    cliSerial->printf_P(PSTR("load_all took %luus\n"), micros() - before);
 	}
@@ -296,6 +296,8 @@ static void load_parameters(void)
         uint32_t before = hal.scheduler->micros();
         // Load all auto-loaded EEPROM variables
         AP_Param::load_all();
+        // reclaim the space of removed parameters if storage is nearly full
+        AP_Param::compact_if_full();
         cliSerial->printf_P(PSTR("load_all took %luus\n"), hal.scheduler->micros() - before);
     }
 }
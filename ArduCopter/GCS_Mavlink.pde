@@ -654,6 +654,18 @@ bool GCS_MAVLINK::try_send_message(enum ap_message id)
 #endif
         break;
 
+    case MSG_SCHED_STATS:
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+        CHECK_PAYLOAD_SIZE(DATA32);
+        scheduler.send_task_stats(chan);
+#endif
+        break;
+
+    case MSG_STREAM_STATS:
+        CHECK_PAYLOAD_SIZE(DATA32);
+        send_stream_stats();
+        break;
+
     case MSG_FENCE_STATUS:
     case MSG_WIND:
         // unused
@@ -752,39 +764,6 @@ const AP_Param::GroupInfo GCS_MAVLINK::var_info[] PROGMEM = {
 };
 
 
-// see if we should send a stream now. Called at 50Hz
-bool GCS_MAVLINK::stream_trigger(enum streams stream_num)
-{
-    if (stream_num >= NUM_STREAMS) {
-        return false;
-    }
-    float rate = (uint8_t)streamRates[stream_num].get();
-
-    // send at a much lower rate while handling waypoints and
-    // parameter sends
-    if ((stream_num != STREAM_PARAMS) &&
-        (waypoint_receiving || _queued_parameter != NULL)) {
-        rate *= 0.25f;
-    }
-
-    if (rate <= 0) {
-        return false;
-    }
-
-    if (stream_ticks[stream_num] == 0) {
-        // we're triggering now, setup the next trigger point
-        if (rate > 50) {
-            rate = 50;
-        }
-        stream_ticks[stream_num] = (50 / rate) - 1 + stream_slowdown;
-        return true;
-    }
-
-    // count down at 50Hz
-    stream_ticks[stream_num]--;
-    return false;
-}
-
 void
 GCS_MAVLINK::data_stream_send(void)
 {
@@ -882,6 +861,10 @@ GCS_MAVLINK::data_stream_send(void)
         send_message(MSG_OPTICAL_FLOW);
         send_message(MSG_GIMBAL_REPORT);
         send_message(MSG_EKF_STATUS_REPORT);
+        if (scheduler.debug() != 0) {
+            send_message(MSG_SCHED_STATS);
+            send_message(MSG_STREAM_STATS);
+        }
     }
 }
 
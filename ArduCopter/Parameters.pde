@@ -1083,6 +1083,8 @@ static void load_parameters(void)
         // Load all auto-loaded EEPROM variables
         AP_Param::load_all();
         AP_Param::convert_old_parameters(&conversion_table[0], sizeof(conversion_table)/sizeof(conversion_table[0]));
+        // reclaim the space of removed parameters if storage is nearly full
+        AP_Param::compact_if_full();
         cliSerial->printf_P(PSTR("load_all took %luus\n"), micros() - before);
     }
 }
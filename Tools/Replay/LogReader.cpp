@@ -15,6 +15,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 
 #include "MsgHandler.h"
 
@@ -24,7 +25,10 @@ extern const AP_HAL::HAL& hal;
 
 LogReader::LogReader(AP_AHRS &_ahrs, AP_InertialSensor &_ins, AP_Baro &_baro, Compass &_compass, AP_GPS &_gps, AP_Airspeed &_airspeed, DataFlash_Class &_dataflash) :
     vehicle(VehicleType::VEHICLE_UNKNOWN),
-    fd(-1),
+    log_data(NULL),
+    log_size(0),
+    log_ofs(0),
+    log_end(0),
     ahrs(_ahrs),
     ins(_ins),
     baro(_baro),
@@ -34,16 +38,136 @@ LogReader::LogReader(AP_AHRS &_ahrs, AP_InertialSensor &_ins, AP_Baro &_baro, Co
     dataflash(_dataflash),
     accel_mask(7),
     gyro_mask(7),
+    time_index(NULL),
+    time_index_len(0),
     last_timestamp_usec(0),
     installed_vehicle_specific_parsers(false)
-{}
+{
+    memset(type_index, 0, sizeof(type_index));
+}
 
 bool LogReader::open_log(const char *logfile)
 {
-    fd = ::open(logfile, O_RDONLY);
+    int fd = ::open(logfile, O_RDONLY);
     if (fd == -1) {
         return false;
     }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if ((uint64_t)st.st_size > 0xFFFFFFFFUL) {
+        ::printf("Log too large to index (%llu bytes)\n", (unsigned long long)st.st_size);
+        ::close(fd);
+        return false;
+    }
+    log_size = st.st_size;
+    if (log_size != 0) {
+        // a private writable mapping, as the parsers take a non-const
+        // message pointer; nothing is ever written back to the file
+        void *p = mmap(NULL, log_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        log_data = (uint8_t *)p;
+        madvise(log_data, log_size, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+
+    return build_index();
+}
+
+/*
+  scan the mapped log once, recording the offset of each message by
+  type and a time index from messages that start with a TimeMS
+  field. The scan is done twice over the mapping, once to count and
+  once to fill the tables; that is cheap compared to the replay
+ */
+bool LogReader::build_index(void)
+{
+    uint8_t length[LOGREADER_MAX_FORMATS];
+    bool timestamped[LOGREADER_MAX_FORMATS];
+    uint32_t ntime = 0;
+    uint32_t last_time_ms = 0;
+
+    for (uint8_t pass=0; pass<2; pass++) {
+        memset(length, 0, sizeof(length));
+        memset(timestamped, 0, sizeof(timestamped));
+        length[LOG_FORMAT_MSG] = sizeof(struct log_Format);
+        ntime = 0;
+
+        uint32_t ofs = 0;
+        while (ofs + 3 <= log_size) {
+            const uint8_t *msg = &log_data[ofs];
+            if (msg[0] != HEAD_BYTE1 || msg[1] != HEAD_BYTE2 ||
+                msg[2] >= LOGREADER_MAX_FORMATS || length[msg[2]] < 3 ||
+                ofs + length[msg[2]] > log_size) {
+                break;
+            }
+            uint8_t type = msg[2];
+            if (type == LOG_FORMAT_MSG) {
+                const struct log_Format *f = (const struct log_Format *)msg;
+                if (f->type < LOGREADER_MAX_FORMATS) {
+                    length[f->type] = f->length;
+                    timestamped[f->type] = (f->format[0] == 'I' &&
+                                            strncmp(f->labels, "TimeMS", 6) == 0 &&
+                                            (f->labels[6] == ',' || f->labels[6] == 0));
+                }
+            } else if (timestamped[type]) {
+                uint32_t time_ms;
+                memcpy(&time_ms, &msg[3], sizeof(time_ms));
+                if (ntime == 0 || time_ms >= last_time_ms + LOGREADER_TIME_INDEX_MS) {
+                    if (pass == 1) {
+                        time_index[ntime].time_ms = time_ms;
+                        time_index[ntime].ofs = ofs;
+                    }
+                    last_time_ms = time_ms;
+                    ntime++;
+                }
+            }
+            if (pass == 0) {
+                type_index[type].count++;
+            } else {
+                type_index[type].offsets[type_index[type].count++] = ofs;
+            }
+            ofs += length[type];
+        }
+        log_end = ofs;
+
+        if (pass == 0) {
+            uint32_t total = 0;
+            for (uint16_t i=0; i<LOGREADER_MAX_FORMATS; i++) {
+                total += type_index[i].count;
+                if (type_index[i].count != 0) {
+                    type_index[i].offsets = (uint32_t *)calloc(type_index[i].count, sizeof(uint32_t));
+                    if (type_index[i].offsets == NULL) {
+                        return false;
+                    }
+                }
+                type_index[i].count = 0;
+            }
+            if (ntime != 0) {
+                time_index = (struct time_index_entry *)calloc(ntime, sizeof(time_index[0]));
+                if (time_index == NULL) {
+                    return false;
+                }
+            }
+            ::printf("Indexed %u messages\n", (unsigned)total);
+        }
+    }
+    time_index_len = ntime;
+
+    if (log_end != log_size) {
+        ::printf("Log index stops at offset %u of %u\n",
+                 (unsigned)log_end, (unsigned)log_size);
+    }
+    if (time_index_len != 0) {
+        ::printf("Log covers %.1f to %.1f seconds\n",
+                 time_index[0].time_ms*0.001f,
+                 time_index[time_index_len-1].time_ms*0.001f);
+    }
     return true;
 }
 
@@ -102,10 +226,10 @@ bool LogReader::in_list(const char *type, const char *list[])
 
 bool LogReader::update(char type[5])
 {
-    uint8_t hdr[3];
-    if (::read(fd, hdr, 3) != 3) {
+    if (log_ofs + 3 > log_end) {
         return false;
     }
+    uint8_t *hdr = &log_data[log_ofs];
     if (hdr[0] != HEAD_BYTE1 || hdr[1] != HEAD_BYTE2) {
         printf("bad log header\n");
         return false;
@@ -113,10 +237,11 @@ bool LogReader::update(char type[5])
 
     if (hdr[2] == LOG_FORMAT_MSG) {
         struct log_Format f;
-        memcpy(&f, hdr, 3);
-        if (::read(fd, &f.type, sizeof(f)-3) != sizeof(f)-3) {
+        if (log_ofs + sizeof(f) > log_end) {
             return false;
         }
+        memcpy(&f, hdr, sizeof(f));
+        log_ofs += sizeof(f);
         memcpy(&formats[f.type], &f, sizeof(formats[f.type]));
         strncpy(type, f.name, 4);
         type[4] = 0;
@@ -215,12 +340,12 @@ bool LogReader::update(char type[5])
         exit(1);
     }
 
-    uint8_t msg[f.length];
-
-    memcpy(msg, hdr, 3);
-    if (::read(fd, &msg[3], f.length-3) != f.length-3) {
+    // parse in place from the mapping
+    uint8_t *msg = hdr;
+    if (log_ofs + f.length > log_end) {
         return false;
     }
+    log_ofs += f.length;
 
     strncpy(type, f.name, 4);
     type[4] = 0;
@@ -254,6 +379,72 @@ bool LogReader::wait_type(const char *wtype)
     return true;
 }
 
+/*
+  message types which are still processed when seeking past them, as
+  they carry state the rest of the replay depends on
+ */
+static const char *seek_context_types[] = { "PARM", "MSG", NULL };
+
+/*
+  process all messages of one type between the current position and
+  end_ofs, in file order
+ */
+void LogReader::process_index_before(uint8_t type, uint32_t end_ofs)
+{
+    const uint32_t resume_ofs = log_ofs;
+    const struct type_index &idx = type_index[type];
+    char name[5];
+    for (uint32_t i=0; i<idx.count && idx.offsets[i] < end_ofs; i++) {
+        if (idx.offsets[i] < resume_ofs) {
+            continue;
+        }
+        log_ofs = idx.offsets[i];
+        update(name);
+    }
+    log_ofs = resume_ofs;
+}
+
+/*
+  skip forward to the last indexed message at or before time_ms. Format
+  messages before that point are still processed so every parser is
+  set up, as are parameters and vehicle type messages
+ */
+bool LogReader::seek_to_time(uint32_t time_ms)
+{
+    if (time_index_len == 0 || time_index[0].time_ms > time_ms) {
+        return false;
+    }
+
+    // binary search for the last entry at or before time_ms
+    uint32_t lo = 0, hi = time_index_len;
+    while (hi - lo > 1) {
+        uint32_t mid = (lo + hi) / 2;
+        if (time_index[mid].time_ms <= time_ms) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    const uint32_t target_ofs = time_index[lo].ofs;
+    if (target_ofs <= log_ofs) {
+        // already there, and we can't go backwards
+        return false;
+    }
+
+    process_index_before(LOG_FORMAT_MSG, target_ofs);
+    for (uint16_t t=0; t<LOGREADER_MAX_FORMATS; t++) {
+        char name[5];
+        memset(name, '\0', 5);
+        memcpy(name, formats[t].name, 4);
+        if (formats[t].length != 0 && in_list(name, seek_context_types)) {
+            process_index_before(t, target_ofs);
+        }
+    }
+
+    log_ofs = target_ofs;
+    ::printf("Seeked to %.1f seconds\n", time_index[lo].time_ms*0.001f);
+    return true;
+}
 
 bool LogReader::set_parameter(const char *name, float value)
 {
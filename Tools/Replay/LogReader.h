@@ -7,6 +7,7 @@ public:
     bool open_log(const char *logfile);
     bool update(char type[5]);
     bool wait_type(const char *type);
+    bool seek_to_time(uint32_t time_ms);
 
     const Vector3f &get_attitude(void) const { return attitude; }
     const Vector3f &get_ahr2_attitude(void) const { return ahr2_attitude; }
@@ -24,7 +25,12 @@ public:
     uint64_t last_timestamp_us(void) const { return last_timestamp_usec; }
 
 private:
-    int fd;
+    // the log is mapped into memory by open_log() and messages are
+    // handed to the parsers straight from the mapped pages
+    uint8_t *log_data;
+    uint32_t log_size;
+    uint32_t log_ofs;  // offset of the next message to process
+    uint32_t log_end;  // end of the last complete message seen by the index scan
     AP_AHRS &ahrs;
     AP_InertialSensor &ins;
     AP_Baro &baro;
@@ -45,6 +51,23 @@ private:
     struct log_Format formats[LOGREADER_MAX_FORMATS];
     class MsgHandler *msgparser[LOGREADER_MAX_FORMATS];
 
+    // index built by a single scan of the log in open_log(): the
+    // offset of every message of each type, in file order, plus a
+    // table of offsets of timestamped messages for seek_to_time()
+#define LOGREADER_TIME_INDEX_MS 100 // spacing of time index entries
+    struct type_index {
+        uint32_t count;
+        uint32_t *offsets;
+    } type_index[LOGREADER_MAX_FORMATS];
+    struct time_index_entry {
+        uint32_t time_ms;
+        uint32_t ofs;
+    } *time_index;
+    uint32_t time_index_len;
+
+    bool build_index(void);
+    void process_index_before(uint8_t type, uint32_t end_ofs);
+
     template <typename R>
     void require_field(class MsgHandler *p, uint8_t *msg, const char *label, R &ret);
     void require_field(class MsgHandler *p, uint8_t *data, const char *label, char *buffer, uint8_t bufferlen);
@@ -101,6 +101,7 @@ static bool done_baro_init;
 static bool done_home_init;
 static uint16_t update_rate = 50;
 static uint32_t arm_time_ms;
+static uint32_t start_time_ms;
 static bool ahrs_healthy;
 static bool have_imu2;
 
@@ -125,6 +126,7 @@ static void usage(void)
     ::printf(" -aMASK     set accel mask (1=accel1 only, 2=accel2 only, 3=both)\n");
     ::printf(" -gMASK     set gyro mask (1=gyro1 only, 2=gyro2 only, 3=both)\n");
     ::printf(" -A time    arm at time milliseconds)\n");
+    ::printf(" -s time    start replay at log time milliseconds\n");
 }
 
 void setup()
@@ -138,7 +140,7 @@ void setup()
 
     hal.util->commandline_arguments(argc, argv);
 
-	while ((opt = getopt(argc, argv, "r:p:ha:g:A:")) != -1) {
+	while ((opt = getopt(argc, argv, "r:p:ha:g:A:s:")) != -1) {
 		switch (opt) {
         case 'h':
             usage();
@@ -160,6 +162,10 @@ void setup()
             arm_time_ms = strtoul(optarg, NULL, 0);
             break;
 
+        case 's':
+            start_time_ms = strtoul(optarg, NULL, 0);
+            break;
+
         case 'p':
             char *eq = strchr(optarg, '=');
             if (eq == NULL) {
@@ -200,6 +206,11 @@ void setup()
     dataflash.Init(log_structure, sizeof(log_structure)/sizeof(log_structure[0]));
     dataflash.StartNewLog();
 
+    if (start_time_ms != 0 && !LogReader.seek_to_time(start_time_ms)) {
+        ::printf("Unable to seek to %u ms\n", (unsigned)start_time_ms);
+        exit(1);
+    }
+
     LogReader.wait_type("GPS");
     LogReader.wait_type("IMU");
     LogReader.wait_type("GPS");
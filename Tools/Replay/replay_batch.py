@@ -0,0 +1,175 @@
+#!/usr/bin/env python
+'''
+replay a batch of DataFlash logs in parallel and produce a single
+JSON report of EKF innovation and timing summaries per log
+
+Replay keeps all of its state in the HAL globals, so each log is run
+as a separate Replay process in its own scratch directory. A pool of
+one worker per core pulls logs from a shared queue as it becomes free,
+largest logs first so a long log doesn't end up running on its own at
+the end of the batch.
+
+usage: replay_batch.py [options] LOG...
+'''
+
+import os, sys, re, json, time, shutil, tempfile, subprocess, optparse, multiprocessing
+
+# columns of EKF3.dat written by Replay, after timestamp and TimeMS
+innovation_columns = ['IVN', 'IVE', 'IVD', 'IPN', 'IPE', 'IPD', 'IMX', 'IMY', 'IMZ', 'IVT']
+
+def load_params(filename):
+    '''load a NAME VALUE parameter file in the same format as the autotest .parm files'''
+    params = []
+    for line in open(filename):
+        line = line.split('#')[0].strip()
+        if not line:
+            continue
+        a = line.replace(',', ' ').split()
+        if len(a) != 2:
+            raise ValueError("bad parameter line '%s' in %s" % (line, filename))
+        params.append((a[0], float(a[1])))
+    return params
+
+def innovation_summary(filename):
+    '''summarise the innovations in an EKF3.dat file'''
+    n = 0
+    sumsq = [0.0] * len(innovation_columns)
+    maxabs = [0.0] * len(innovation_columns)
+    if not os.path.exists(filename):
+        return None
+    f = open(filename)
+    f.readline()
+    for line in f:
+        a = line.split()
+        if len(a) != len(innovation_columns) + 2:
+            continue
+        n += 1
+        for i in range(len(innovation_columns)):
+            v = float(a[i+2])
+            sumsq[i] += v*v
+            maxabs[i] = max(maxabs[i], abs(v))
+    f.close()
+    ret = { 'samples' : n }
+    for i in range(len(innovation_columns)):
+        rms = 0.0
+        if n > 0:
+            rms = (sumsq[i] / n) ** 0.5
+        ret[innovation_columns[i]] = { 'rms' : rms, 'max' : maxabs[i] }
+    return ret
+
+def replay_one(args):
+    '''run Replay on one log, returning its summary'''
+    (logfile, opts, params) = args
+    logfile = os.path.abspath(logfile)
+    workdir = tempfile.mkdtemp(prefix='replay_')
+    cmd = [opts.replay]
+    for (name, value) in params:
+        cmd.append('-p%s=%f' % (name, value))
+    if opts.rate is not None:
+        cmd.append('-r%u' % opts.rate)
+    cmd.append(logfile)
+
+    result = { 'log' : logfile,
+               'size' : os.path.getsize(logfile) }
+    t0 = time.time()
+    try:
+        p = subprocess.Popen(cmd, cwd=workdir,
+                             stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        output = p.communicate()[0].decode('utf-8', 'replace')
+        result['returncode'] = p.returncode
+    except OSError as e:
+        output = ''
+        result['returncode'] = -1
+        result['error'] = str(e)
+    result['wall_time'] = time.time() - t0
+
+    m = re.search(r'End of log at ([\d.]+) seconds', output)
+    if m is not None:
+        result['log_time'] = float(m.group(1))
+        if result['wall_time'] > 0:
+            result['speedup'] = result['log_time'] / result['wall_time']
+    result['ok'] = (result['returncode'] == 0 and m is not None)
+    result['innovations'] = innovation_summary(os.path.join(workdir, 'EKF3.dat'))
+
+    if opts.keep is not None:
+        dest = os.path.join(opts.keep, os.path.splitext(os.path.basename(logfile))[0])
+        if os.path.exists(dest):
+            shutil.rmtree(dest)
+        shutil.copytree(workdir, dest)
+        open(os.path.join(dest, 'replay.out'), 'w').write(output)
+        result['output_dir'] = dest
+    shutil.rmtree(workdir, ignore_errors=True)
+    return result
+
+def main():
+    parser = optparse.OptionParser("replay_batch.py [options] LOG...")
+    parser.add_option("--replay", default="/tmp/Replay.build/Replay.elf", help="path to the Replay executable")
+    parser.add_option("--params", default=None, help="parameter file to apply to every log")
+    parser.add_option("--param", action='append', default=[], help="extra NAME=VALUE parameter, may be repeated")
+    parser.add_option("--rate", type='int', default=None, help="IMU rate in Hz passed to Replay")
+    parser.add_option("--jobs", "-j", type='int', default=multiprocessing.cpu_count(), help="number of parallel replays")
+    parser.add_option("--report", default="replay_report.json", help="JSON report file")
+    parser.add_option("--keep", default=None, help="directory to keep per-log Replay outputs in")
+    parser.add_option("--list", default=None, help="file containing a list of logs, one per line")
+
+    opts, args = parser.parse_args()
+
+    logs = list(args)
+    if opts.list is not None:
+        for line in open(opts.list):
+            line = line.strip()
+            if line and not line.startswith('#'):
+                logs.append(line)
+    if len(logs) == 0:
+        parser.print_help()
+        sys.exit(1)
+
+    params = []
+    if opts.params is not None:
+        params.extend(load_params(opts.params))
+    for p in opts.param:
+        (name, value) = p.split('=', 1)
+        params.append((name, float(value)))
+
+    # each replay runs in its own scratch directory
+    opts.replay = os.path.abspath(opts.replay)
+    if opts.keep is not None:
+        opts.keep = os.path.abspath(opts.keep)
+    if opts.keep is not None and not os.path.isdir(opts.keep):
+        os.makedirs(opts.keep)
+
+    # biggest first, so the tail of the batch is made of short jobs
+    logs.sort(key=lambda f: os.path.getsize(f), reverse=True)
+
+    t0 = time.time()
+    pool = multiprocessing.Pool(max(1, opts.jobs))
+    results = []
+    for r in pool.imap_unordered(replay_one, [(f, opts, params) for f in logs], chunksize=1):
+        status = 'OK'
+        if not r['ok']:
+            status = 'FAILED'
+        print("%-6s %s %.1fs" % (status, r['log'], r['wall_time']))
+        sys.stdout.flush()
+        results.append(r)
+    pool.close()
+    pool.join()
+    elapsed = time.time() - t0
+
+    results.sort(key=lambda r: r['log'])
+    nfailed = len([r for r in results if not r['ok']])
+    report = { 'replay' : opts.replay,
+               'params' : dict(params),
+               'jobs' : opts.jobs,
+               'elapsed' : elapsed,
+               'replay_time' : sum([r['wall_time'] for r in results]),
+               'failed' : nfailed,
+               'logs' : results }
+    f = open(opts.report, 'w')
+    json.dump(report, f, indent=2, sort_keys=True)
+    f.close()
+    print("Replayed %u logs (%u failed) in %.1fs, report in %s" % (len(results), nfailed, elapsed, opts.report))
+    if nfailed != 0:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -105,8 +105,9 @@ def pexpect_drain(p):
     except pexpect.TIMEOUT:
         pass
 
-def start_SIL(atype, valgrind=False, wipe=False, synthetic_clock=True, home=None, model=None, speedup=1):
-    '''launch a SIL instance'''
+def start_SIL(atype, valgrind=False, wipe=False, synthetic_clock=True, home=None, model=None, speedup=1, lockstep=None):
+    '''launch a SIL instance. With lockstep a built-in model runs as fast
+    as the CPU allows. It defaults to on if AUTOTEST_LOCKSTEP is set'''
     import pexpect
     cmd=""
     if valgrind and os.path.exists('/usr/bin/valgrind'):
@@ -123,7 +124,11 @@ def start_SIL(atype, valgrind=False, wipe=False, synthetic_clock=True, home=None
         cmd += ' --home=%s' % home
     if model is not None:
         cmd += ' --model=%s' % model
-    if speedup != 1:
+    if lockstep is None:
+        lockstep = os.getenv('AUTOTEST_LOCKSTEP') is not None
+    if lockstep and model is not None and model not in ['jsbsim', 'crrcsim']:
+        cmd += ' --lockstep'
+    elif speedup != 1:
         cmd += ' --speedup=%f' % speedup
     print("Running: %s" % cmd)
     ret = pexpect.spawn(cmd, logfile=sys.stdout, timeout=5)
@@ -0,0 +1,111 @@
+#!/bin/bash
+
+# run a swarm of SITL vehicles, with the physics of all of them in
+# one process. Run from the vehicle directory after "make sitl"
+
+LOCATION="CMAC"
+FRAME=""
+NUM_VEHICLES=2
+SPEEDUP="1"
+LOCKSTEP=0
+SWARM_FILE="/tmp/sitl_swarm.bin"
+
+usage()
+{
+cat <<EOF
+Usage: sim_swarm.sh [options]
+Options:
+    -n NUM           number of vehicles (default 2)
+    -L               select start location from Tools/autotest/locations.txt
+    -f FRAME         set copter frame type (default +)
+    -s SPEEDUP       set simulation speedup (default 1)
+    -l               run as fast as the slowest vehicle allows
+    -F FILE          shared swarm file (default $SWARM_FILE)
+
+Vehicle N listens for MAVLink on TCP port 5760+10*N
+EOF
+}
+
+while getopts ":n:L:f:s:lF:h" opt; do
+  case $opt in
+    n)
+      NUM_VEHICLES=$OPTARG
+      ;;
+    L)
+      LOCATION="$OPTARG"
+      ;;
+    f)
+      FRAME="$OPTARG"
+      ;;
+    s)
+      SPEEDUP="$OPTARG"
+      ;;
+    l)
+      LOCKSTEP=1
+      ;;
+    F)
+      SWARM_FILE="$OPTARG"
+      ;;
+    h)
+      usage
+      exit 0
+      ;;
+    \?)
+      echo "Invalid option: -$OPTARG"
+      usage
+      exit 1
+      ;;
+  esac
+done
+
+VEHICLE=$(basename $PWD)
+autotest=$(dirname $(readlink -e $0))
+
+if [ ! -x $VEHICLE.elf ]; then
+    echo "No $VEHICLE.elf, run make sitl first"
+    exit 1
+fi
+
+case $VEHICLE in
+    ArduCopter)
+        [ -z "$FRAME" ] && FRAME="+"
+        ;;
+    APMrover2)
+        FRAME="rover"
+        ;;
+    *)
+        echo "Swarms are only supported for ArduCopter and APMrover2"
+        exit 1
+        ;;
+esac
+
+SIMHOME=$(cat $autotest/locations.txt | grep -i "^$LOCATION=" | cut -d= -f2)
+[ -z "$SIMHOME" ] && {
+    echo "Unknown location $LOCATION"
+    usage
+    exit 1
+}
+
+SIM_ARGS="--swarm $SWARM_FILE"
+if [ $LOCKSTEP == 1 ]; then
+    SIM_ARGS="$SIM_ARGS --lockstep"
+fi
+
+PIDS=""
+kill_swarm()
+{
+    kill $PIDS 2> /dev/null
+}
+trap kill_swarm SIGINT SIGTERM EXIT
+
+./$VEHICLE.elf $SIM_ARGS --swarm-physics $NUM_VEHICLES --model $FRAME --home $SIMHOME --speedup $SPEEDUP &
+PIDS="$PIDS $!"
+
+for i in $(seq 0 $((NUM_VEHICLES-1))); do
+    mkdir -p swarm$i
+    (cd swarm$i && exec ../$VEHICLE.elf --swarm $SWARM_FILE -I$i -w > vehicle.log 2>&1) &
+    PIDS="$PIDS $!"
+done
+
+echo "Started $NUM_VEHICLES vehicles at $LOCATION"
+wait
@@ -82,6 +82,18 @@ void AP_SerialBus_SPI::write(uint8_t reg)
     _spi->transaction(tx, NULL, 1);
 }
 
+uint32_t AP_SerialBus_SPI::read_24bits_write(uint8_t reg, uint8_t next)
+{
+    uint8_t tx[4] = { reg, 0, 0, 0 };
+    uint8_t rx[4];
+    AP_HAL::SPIDeviceDriver::segment segments[2] = {
+        { tx, rx, 4, false },
+        { &next, NULL, 1, false }
+    };
+    _spi->transaction_batch(segments, 2);
+    return (((uint32_t)rx[1])<<16) | (((uint32_t)rx[2])<<8) | ((uint32_t)rx[3]);
+}
+
 bool AP_SerialBus_SPI::sem_take_blocking() 
 {
     return _spi_sem->take(10);
@@ -136,6 +148,20 @@ void AP_SerialBus_I2C::write(uint8_t reg)
     hal.i2c->write(_addr, 1, &reg);
 }
 
+uint32_t AP_SerialBus_I2C::read_24bits_write(uint8_t reg, uint8_t next)
+{
+    uint8_t buf[3];
+    AP_HAL::I2CDriver::segment segments[3] = {
+        { _addr, false, 1, &reg },
+        { _addr, true, sizeof(buf), buf },
+        { _addr, false, 1, &next }
+    };
+    if (hal.i2c->transfer_batch(segments, 3) == 0) {
+        return (((uint32_t)buf[0]) << 16) | (((uint32_t)buf[1]) << 8) | buf[2];
+    }
+    return 0;
+}
+
 bool AP_SerialBus_I2C::sem_take_blocking() 
 {
     return _i2c_sem->take(10);
@@ -266,8 +292,8 @@ void AP_Baro_MS5611::_timer(void)
     }
 
     if (_state == 0) {
-        // On state 0 we read temp
-        uint32_t d2 = _serial->read_24bits(0);
+        // On state 0 we read temp, and start reading pressure
+        uint32_t d2 = _serial->read_24bits_write(0, CMD_CONVERT_D1_OSR4096);
         if (d2 != 0) {
             _s_D2 += d2;
             _d2_count++;
@@ -280,9 +306,11 @@ void AP_Baro_MS5611::_timer(void)
             }
         }
         _state++;
-        _serial->write(CMD_CONVERT_D1_OSR4096);      // Command to read pressure
     } else {
-        uint32_t d1 = _serial->read_24bits(0);;
+        // read pressure, and start reading temperature after 4
+        // pressure readings
+        uint8_t next = (_state == 4) ? CMD_CONVERT_D2_OSR4096 : CMD_CONVERT_D1_OSR4096;
+        uint32_t d1 = _serial->read_24bits_write(0, next);
         if (d1 != 0) {
             // occasional zero values have been seen on the PXF
             // board. These may be SPI errors, but safest to ignore
@@ -300,10 +328,7 @@ void AP_Baro_MS5611::_timer(void)
         }
         _state++;
         if (_state == 5) {
-            _serial->write(CMD_CONVERT_D2_OSR4096); // Command to read temperature
             _state = 0;
-        } else {
-            _serial->write(CMD_CONVERT_D1_OSR4096); // Command to read pressure
         }
     }
 
@@ -24,6 +24,14 @@ public:
     /** Write to a register with no data. */
     virtual void write(uint8_t reg) = 0;
 
+    /** Read a 24-bit value from register "reg", then write to register
+     * "next" with no data. Buses that can queue transfers do both at once */
+    virtual uint32_t read_24bits_write(uint8_t reg, uint8_t next) {
+        uint32_t v = read_24bits(reg);
+        write(next);
+        return v;
+    }
+
     /** Acquire the internal semaphore for this device.
      * take_nonblocking should be used from the timer process,
      * take_blocking from synchronous code (i.e. init) */
@@ -44,6 +52,7 @@ public:
     uint32_t read_24bits(uint8_t reg);
     uint32_t read_adc(uint8_t reg);
     void write(uint8_t reg);
+    uint32_t read_24bits_write(uint8_t reg, uint8_t next);
     bool sem_take_nonblocking();
     bool sem_take_blocking();
     void sem_give();
@@ -64,6 +73,7 @@ public:
     uint16_t read_16bits(uint8_t reg);
     uint32_t read_24bits(uint8_t reg);
     void write(uint8_t reg);
+    uint32_t read_24bits_write(uint8_t reg, uint8_t next);
     bool sem_take_nonblocking();
     bool sem_take_blocking();
     void sem_give();
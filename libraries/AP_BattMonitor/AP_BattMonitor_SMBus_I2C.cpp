@@ -39,15 +39,38 @@ void AP_BattMonitor_SMBus_I2C::read()
     uint8_t buff[4];
     uint32_t tnow = hal.scheduler->micros();
 
-    // read voltage
-    if (read_word(BATTMONITOR_SMBUS_VOLTAGE, data)) {
+    // read voltage (word and PEC) and current (length, 4 bytes and
+    // PEC) in one batch
+    uint8_t voltage_reg = BATTMONITOR_SMBUS_VOLTAGE;
+    uint8_t current_reg = BATTMONITOR_SMBUS_CURRENT;
+    uint8_t voltage_buff[3];
+    uint8_t current_buff[sizeof(buff)+2];
+    AP_HAL::I2CDriver::segment segments[4] = {
+        { BATTMONITOR_SMBUS_I2C_ADDR, false, 1, &voltage_reg },
+        { BATTMONITOR_SMBUS_I2C_ADDR, true, sizeof(voltage_buff), voltage_buff },
+        { BATTMONITOR_SMBUS_I2C_ADDR, false, 1, &current_reg },
+        { BATTMONITOR_SMBUS_I2C_ADDR, true, sizeof(current_buff), current_buff }
+    };
+
+    // get pointer to i2c bus semaphore
+    AP_HAL::Semaphore* i2c_sem = hal.i2c->get_semaphore();
+
+    // take i2c bus semaphore
+    bool ok = false;
+    if (i2c_sem->take_nonblocking()) {
+        ok = hal.i2c->transfer_batch(segments, 4) == 0;
+        i2c_sem->give();
+    }
+
+    // check voltage
+    if (ok && check_word(voltage_reg, voltage_buff, data)) {
         _state.voltage = (float)data / 1000.0f;
         _state.last_time_micros = tnow;
         _state.healthy = true;
     }
 
-    // read current
-    if (read_block(BATTMONITOR_SMBUS_CURRENT, buff, 4, false) == 4) {
+    // check current
+    if (ok && check_block(current_reg, current_buff, buff, 4, false) == 4) {
         _state.current_amps = (float)((int32_t)((uint32_t)buff[3]<<24 | (uint32_t)buff[2]<<16 | (uint32_t)buff[1]<<8 | (uint32_t)buff[0])) / 1000.0f;
         _state.last_time_micros = tnow;
     }
@@ -58,67 +81,26 @@ void AP_BattMonitor_SMBus_I2C::read()
     }
 }
 
-// read word from register
-// returns true if read was succesful, false if failed
-bool AP_BattMonitor_SMBus_I2C::read_word(uint8_t reg, uint16_t& data) const
+// check word read from register
+// returns true if PEC is correct, false if not
+bool AP_BattMonitor_SMBus_I2C::check_word(uint8_t reg, const uint8_t buff[3], uint16_t& data) const
 {
-    // get pointer to i2c bus semaphore
-    AP_HAL::Semaphore* i2c_sem = hal.i2c->get_semaphore();
-
-    // take i2c bus semaphore
-    if (!i2c_sem->take_nonblocking()) {
-        i2c_sem->give();
-        return false;
-    }
-
-    uint8_t buff[3];    // buffer to hold results
-
-    // read three bytes and place in last three bytes of buffer
-    if (hal.i2c->readRegisters(BATTMONITOR_SMBUS_I2C_ADDR, reg, 3, buff) != 0) {
-        i2c_sem->give();
-        return false;
-    }
-
     // check PEC
     uint8_t pec = get_PEC(BATTMONITOR_SMBUS_I2C_ADDR, reg, true, buff, 2);
     if (pec != buff[2]) {
-        i2c_sem->give();
         return false;
     }
 
     // convert buffer to word
     data = (uint16_t)buff[1]<<8 | (uint16_t)buff[0];
 
-    // give back i2c semaphore
-    i2c_sem->give();
-
     // return success
     return true;
 }
 
-// read_block - returns number of characters read if successful, zero if unsuccessful
-uint8_t AP_BattMonitor_SMBus_I2C::read_block(uint8_t reg, uint8_t* data, uint8_t max_len, bool append_zero) const
+// check_block - returns number of characters copied if block is valid, zero if not
+uint8_t AP_BattMonitor_SMBus_I2C::check_block(uint8_t reg, const uint8_t buff[], uint8_t* data, uint8_t max_len, bool append_zero) const
 {
-    uint8_t buff[max_len+2];    // buffer to hold results (2 extra byte returned holding length and PEC)
-
-    // get pointer to i2c bus semaphore
-    AP_HAL::Semaphore* i2c_sem = hal.i2c->get_semaphore();
-
-    // take i2c bus semaphore
-    if (!i2c_sem->take_nonblocking()) {
-        i2c_sem->give();
-        return 0;
-    }
-
-    // read bytes
-    if (hal.i2c->readRegisters(BATTMONITOR_SMBUS_I2C_ADDR, reg, max_len+2, buff) != 0) {
-        i2c_sem->give();
-        return 0;
-    }
-
-    // give back i2c semaphore
-    i2c_sem->give();
-
     // get length
     uint8_t bufflen = buff[0];
 
@@ -130,7 +112,6 @@ uint8_t AP_BattMonitor_SMBus_I2C::read_block(uint8_t reg, uint8_t* data, uint8_t
     // check PEC
     uint8_t pec = get_PEC(BATTMONITOR_SMBUS_I2C_ADDR, reg, true, buff, bufflen+1);
     if (pec != buff[bufflen+1]) {
-        i2c_sem->give();
         return 0;
     }
 
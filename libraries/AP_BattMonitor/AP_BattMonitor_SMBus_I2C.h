@@ -19,12 +19,13 @@ public:
 
 private:
 
-    // read word from register
-    // returns true if read was successful, false if failed
-    bool read_word(uint8_t reg, uint16_t& data) const;
+    // check_word - check the PEC of a word read from a register, buff holding the word then the PEC
+    // returns true if the word is valid, false if not
+    bool check_word(uint8_t reg, const uint8_t buff[3], uint16_t& data) const;
 
-    // read_block - returns number of characters read if successful, zero if unsuccessful
-    uint8_t read_block(uint8_t reg, uint8_t* data, uint8_t max_len, bool append_zero) const;
+    // check_block - check a block read from a register, buff holding the length, up to max_len bytes then the PEC
+    // returns number of characters copied to data if valid, zero if not
+    uint8_t check_block(uint8_t reg, const uint8_t buff[], uint8_t* data, uint8_t max_len, bool append_zero) const;
 
     // get_PEC - calculate PEC for a read or write from the battery
     //  buff is the data that was read or will be written
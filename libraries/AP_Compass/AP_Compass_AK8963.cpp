@@ -157,14 +157,15 @@ bool AK8963_MPU9250_SPI_Backend::init()
 void AK8963_MPU9250_SPI_Backend::read(uint8_t address, uint8_t *buf, uint32_t count)
 {
     ASSERT(count < 10);
-    uint8_t tx[11];
-    uint8_t rx[11];
-
-    tx[0] = address | READ_FLAG;
-    tx[1] = 0;
-    _spi->transaction(tx, rx, count + 1);
-
-    memcpy(buf, rx + 1, count);
+    uint8_t addr = address | READ_FLAG;
+
+    // the register address, then the read into buf with the chip
+    // still selected
+    AP_HAL::SPIDeviceDriver::segment segments[2] = {
+        { &addr, NULL, 1, true },
+        { NULL, buf, (uint16_t)count, false }
+    };
+    _spi->transaction_batch(segments, 2);
 }
 
 void AK8963_MPU9250_SPI_Backend::write(uint8_t address, const uint8_t *buf, uint32_t count)
@@ -219,7 +220,9 @@ void AP_Compass_AK8963_MPU9250::_backend_reset()
 
 bool AP_Compass_AK8963_MPU9250::_backend_init()
 {
-    _backend->write(MPUREG_USER_CTRL, BIT_USER_CTRL_I2C_MST_EN);    /* I2C Master mode */
+    /* I2C Master mode, keeping the FIFO settings of the MPU9250 driver */
+    uint8_t user_ctrl = _backend->read(MPUREG_USER_CTRL);
+    _backend->write(MPUREG_USER_CTRL, user_ctrl | BIT_USER_CTRL_I2C_MST_EN);
     _backend->write(MPUREG_I2C_MST_CTRL, I2C_MST_CLOCK_400KHZ);    /*  I2C configuration multi-master  IIC 400KHz */
 
     return true;
@@ -527,7 +530,6 @@ void AP_Compass_AK8963::_start_conversion()
     static const uint8_t count = 0x09;
 
     _backend_init();
-    _backend->write(MPUREG_USER_CTRL, BIT_USER_CTRL_I2C_MST_EN);    /* I2C Master mode */
     _backend->write(MPUREG_I2C_SLV0_ADDR, AK8963_I2C_ADDR | READ_FLAG);  /* Set the I2C slave addres of AK8963 and set for read. */
     _backend->write(MPUREG_I2C_SLV0_REG, address); /* I2C slave 0 register address from where to begin data transfer */
     _backend->write(MPUREG_I2C_SLV0_CTRL, I2C_SLV0_EN | count); /* Enable I2C and set @count byte */
@@ -0,0 +1,48 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AP_HAL.h>
+#include "I2CDriver.h"
+
+/*
+  default batched transfer, for ports without a bus driver that can
+  queue transfers. A one byte write followed by a read of the same
+  device is done as a register read, anything else as a plain write
+  or read. Stops at the first failure
+ */
+uint8_t AP_HAL::I2CDriver::transfer_batch(const struct segment *segments, uint8_t count)
+{
+    uint8_t i = 0;
+    while (i < count) {
+        const struct segment &seg = segments[i];
+        uint8_t ret;
+        if (!seg.read && seg.len == 1 && i+1 < count &&
+            segments[i+1].read && segments[i+1].addr == seg.addr) {
+            ret = readRegisters(seg.addr, seg.data[0], segments[i+1].len, segments[i+1].data);
+            i += 2;
+        } else if (seg.read) {
+            ret = read(seg.addr, seg.len, seg.data);
+            i++;
+        } else {
+            ret = write(seg.addr, seg.len, seg.data);
+            i++;
+        }
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    return 0;
+}
@@ -40,6 +40,27 @@ public:
                                           uint8_t* data) = 0;
 #endif
 
+    /*
+      transfer_batch: optional batched transfers. Each segment writes
+      len bytes from data to the device at addr, or reads len bytes
+      into data if read is set. Segments for several devices can share
+      a batch, and a read that follows a write to the same device is
+      joined to it with a repeated start, so a register read is a
+      write of the register number then a read. Returns 0 on success.
+
+      Ports that can hand several transfers to the bus driver in one
+      call override this. The default does each register read or plain
+      transfer in turn
+     */
+    struct segment {
+        uint8_t addr;
+        bool read;
+        uint8_t len;
+        uint8_t *data;
+    };
+
+    virtual uint8_t transfer_batch(const struct segment *segments, uint8_t count);
+
     virtual uint8_t lockup_count() = 0;
     void ignore_errors(bool b) { _ignore_errors = b; }
     virtual AP_HAL::Semaphore* get_semaphore() = 0;
@@ -0,0 +1,49 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AP_HAL.h>
+#include "SPIDriver.h"
+
+/*
+  default batched transaction, for ports without a bus driver that
+  can queue transactions. Transactions of one segment go through
+  transaction(), longer ones are clocked a byte at a time with the
+  chip held selected
+ */
+void AP_HAL::SPIDeviceDriver::transaction_batch(const struct segment *segments, uint8_t count)
+{
+    uint8_t i = 0;
+    while (i < count) {
+        if (!segments[i].cs_hold && segments[i].tx != NULL) {
+            transaction(segments[i].tx, segments[i].rx, segments[i].len);
+            i++;
+            continue;
+        }
+        cs_assert();
+        bool hold;
+        do {
+            const struct segment &seg = segments[i++];
+            for (uint16_t j=0; j<seg.len; j++) {
+                uint8_t v = transfer(seg.tx != NULL ? seg.tx[j] : 0);
+                if (seg.rx != NULL) {
+                    seg.rx[j] = v;
+                }
+            }
+            hold = seg.cs_hold;
+        } while (hold && i < count);
+        cs_release();
+    }
+}
@@ -39,7 +39,27 @@ public:
     };
 
     virtual void set_bus_speed(enum bus_speed speed) {}
-    
+
+    /**
+       optional batched transaction interface. A batch is a list of
+       segments, each a transfer of len bytes. tx may be NULL to send
+       zeros, and rx may be NULL to discard what is received. The chip
+       is selected for each segment unless the segment before it had
+       cs_hold set, so a register address and the read that follows it
+       can be separate segments of one transaction.
+
+       Ports that can hand several transactions to the bus driver in
+       one call override this. The default does each transaction in
+       turn
+     */
+    struct segment {
+        const uint8_t *tx;
+        uint8_t *rx;
+        uint16_t len;
+        bool cs_hold;
+    };
+
+    virtual void transaction_batch(const struct segment *segments, uint8_t count);
 };
 
 #endif // __AP_HAL_SPI_DRIVER_H__
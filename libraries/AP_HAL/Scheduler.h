@@ -66,6 +66,13 @@ public:
        optional function to stop clock at a given time, used by log replay
      */
     virtual void     stop_clock(uint64_t time_usec) {}
+
+    /**
+       optional function to start a worker thread on a CPU core other
+       than the one running the main loop. The thread calls proc
+       repeatedly. Returns false if the board can't do this
+     */
+    virtual bool     start_worker_thread(AP_HAL::MemberProc proc) { return false; }
 };
 
 #endif // __AP_HAL_SCHEDULER_H__
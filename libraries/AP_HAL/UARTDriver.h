@@ -45,6 +45,16 @@ public:
     virtual void set_flow_control(enum flow_control flow_control_setting) {};
     virtual enum flow_control get_flow_control(void) { return FLOW_CONTROL_DISABLE; };
 
+    /*
+      bulk receive from the driver's receive buffer. read_span()
+      returns how many received bytes are contiguous in the buffer,
+      setting data to point at the first of them, without consuming
+      them. read_advance() then consumes n of those bytes. Drivers
+      without a receive buffer return 0, and callers use read()
+     */
+    virtual uint16_t read_span(const uint8_t *&data) { return 0; }
+    virtual void read_advance(uint16_t n) {}
+
     /* Implementations of BetterStream virtual methods. These are
      * provided by AP_HAL to ensure consistency between ports to
      * different boards
@@ -0,0 +1,143 @@
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  lock-free single producer, single consumer byte ring buffer
+ */
+
+#include <AP_HAL.h>
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_150
+
+#include <stdlib.h>
+#include <string.h>
+#include "RingBuffer.h"
+
+ByteBuffer::ByteBuffer(uint32_t _size) :
+    buf(NULL),
+    size(0),
+    head(0),
+    tail(0)
+{
+    set_size(_size);
+}
+
+ByteBuffer::~ByteBuffer(void)
+{
+    free(buf);
+}
+
+bool ByteBuffer::set_size(uint32_t _size)
+{
+    // round down to a power of 2
+    while (_size & (_size-1)) {
+        _size &= _size-1;
+    }
+    uint8_t *newbuf = (uint8_t *)malloc(_size);
+    if (newbuf == NULL && _size != 0) {
+        return false;
+    }
+    free(buf);
+    buf = newbuf;
+    size = _size;
+    head = tail = 0;
+    return true;
+}
+
+uint32_t ByteBuffer::available(void) const
+{
+    return __atomic_load_n(&tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+}
+
+uint32_t ByteBuffer::space(void) const
+{
+    return size - available();
+}
+
+bool ByteBuffer::empty(void) const
+{
+    return available() == 0;
+}
+
+uint32_t ByteBuffer::write(const uint8_t *data, uint32_t len)
+{
+    uint32_t n = space();
+    if (len > n) {
+        len = n;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    uint32_t ofs = tail & (size-1);
+    uint32_t part = size - ofs;
+    if (part > len) {
+        part = len;
+    }
+    memcpy(&buf[ofs], data, part);
+    memcpy(&buf[0], data + part, len - part);
+    __atomic_store_n(&tail, tail + len, __ATOMIC_RELEASE);
+    return len;
+}
+
+uint32_t ByteBuffer::read(uint8_t *data, uint32_t len)
+{
+    IoVec vec[2];
+    uint8_t n = peekiovec(vec, len);
+    uint32_t ret = 0;
+    for (uint8_t i=0; i<n; i++) {
+        memcpy(data + ret, vec[i].data, vec[i].len);
+        ret += vec[i].len;
+    }
+    advance(ret);
+    return ret;
+}
+
+uint8_t ByteBuffer::peekiovec(IoVec vec[2], uint32_t len)
+{
+    uint32_t n = available();
+    if (len > n) {
+        len = n;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    uint32_t ofs = head & (size-1);
+    uint32_t part = size - ofs;
+    if (part >= len) {
+        vec[0].data = &buf[ofs];
+        vec[0].len = len;
+        return 1;
+    }
+    vec[0].data = &buf[ofs];
+    vec[0].len = part;
+    vec[1].data = &buf[0];
+    vec[1].len = len - part;
+    return 2;
+}
+
+bool ByteBuffer::advance(uint32_t n)
+{
+    if (n > available()) {
+        return false;
+    }
+    __atomic_store_n(&head, head + n, __ATOMIC_RELEASE);
+    return true;
+}
+
+void ByteBuffer::clear(void)
+{
+    __atomic_store_n(&head, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&tail, 0, __ATOMIC_RELEASE);
+}
+
+#endif // HAL_CPU_CLASS
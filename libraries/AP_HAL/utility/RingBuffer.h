@@ -19,4 +19,68 @@
 #define BUF_ADVANCETAIL(buf, n) buf##_tail = (buf##_tail + n) % buf##_size
 #define BUF_ADVANCEHEAD(buf, n) buf##_head = (buf##_head + n) % buf##_size
 
+#include <stdint.h>
+
+/*
+  single producer, single consumer byte ring buffer
+
+  One thread may write while another thread reads without any
+  locking. The write position is only updated by the producer and the
+  read position only by the consumer, each with release semantics
+  after the data has been copied, and the other side's position is
+  loaded with acquire semantics. The size is a power of 2 so the
+  positions can run freely and be masked on access, which lets the
+  whole buffer be used.
+ */
+class ByteBuffer {
+public:
+    ByteBuffer(uint32_t size);
+    ~ByteBuffer(void);
+
+    // number of bytes available to be read
+    uint32_t available(void) const;
+
+    // number of bytes that can be written
+    uint32_t space(void) const;
+
+    // true if available() is zero
+    bool empty(void) const;
+
+    // size of the buffer in bytes
+    uint32_t get_size(void) const { return size; }
+
+    // change the size of the buffer, discarding its contents. The
+    // size is rounded down to a power of 2. Returns false if the
+    // memory could not be allocated
+    bool set_size(uint32_t size);
+
+    // write up to len bytes, returning the number written. Producer only
+    uint32_t write(const uint8_t *data, uint32_t len);
+
+    // read up to len bytes, returning the number read. Consumer only
+    uint32_t read(uint8_t *data, uint32_t len);
+
+    struct IoVec {
+        uint8_t *data;
+        uint32_t len;
+    };
+
+    // fill vec with up to two contiguous regions covering the first
+    // len readable bytes, without consuming them. Returns the number
+    // of regions filled. Consumer only
+    uint8_t peekiovec(IoVec vec[2], uint32_t len);
+
+    // consume n bytes previously returned by peekiovec. Consumer only
+    bool advance(uint32_t n);
+
+    // discard all data. Only safe when neither side is active
+    void clear(void);
+
+private:
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t head;  // read position, updated by the consumer
+    uint32_t tail;  // write position, updated by the producer
+};
+
 #endif // __AP_HAL_UTILITY_RINGBUFFER_H__
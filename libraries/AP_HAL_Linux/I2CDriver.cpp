@@ -15,6 +15,8 @@
 #include <linux/i2c.h>
 #endif
 
+extern const AP_HAL::HAL& hal;
+
 using namespace Linux;
 
 /*
@@ -25,6 +27,10 @@ LinuxI2CDriver::LinuxI2CDriver(AP_HAL::Semaphore* semaphore, const char *device)
     _fd(-1),
     _device(device)
 {
+    // the scheduler clock starts with the sketch, so the statistics
+    // start from zero
+    memset(&_bus_stats, 0, sizeof(_bus_stats));
+    memset(_device_stats, 0, sizeof(_device_stats));
 }
 
 /*
@@ -76,10 +82,10 @@ uint8_t LinuxI2CDriver::write(uint8_t addr, uint8_t len, uint8_t* data)
     if (!set_address(addr)) {
         return 1;
     }
-    if (::write(_fd, data, len) != len) {
-        return 1;
-    }
-    return 0; // success
+    uint64_t t0 = hal.scheduler->micros64();
+    uint8_t ret = ::write(_fd, data, len) != len ? 1 : 0;
+    _record(addr, t0, ret);
+    return ret;
 }
 
 
@@ -116,11 +122,11 @@ uint8_t LinuxI2CDriver::writeRegister(uint8_t addr, uint8_t reg, uint8_t val)
     }
     union i2c_smbus_data data;
     data.byte = val;
-    if (_i2c_smbus_access(_fd,I2C_SMBUS_WRITE, reg,
-                         I2C_SMBUS_BYTE_DATA, &data) == -1) {
-        return 1;
-    }
-    return 0;
+    uint64_t t0 = hal.scheduler->micros64();
+    uint8_t ret = _i2c_smbus_access(_fd,I2C_SMBUS_WRITE, reg,
+                                    I2C_SMBUS_BYTE_DATA, &data) == -1 ? 1 : 0;
+    _record(addr, t0, ret);
+    return ret;
 }
 
 uint8_t LinuxI2CDriver::read(uint8_t addr, uint8_t len, uint8_t* data)
@@ -128,10 +134,10 @@ uint8_t LinuxI2CDriver::read(uint8_t addr, uint8_t len, uint8_t* data)
     if (!set_address(addr)) {
         return 1;
     }
-    if (::read(_fd, data, len) != len) {
-        return 1;
-    }
-    return 0;
+    uint64_t t0 = hal.scheduler->micros64();
+    uint8_t ret = ::read(_fd, data, len) != len ? 1 : 0;
+    _record(addr, t0, ret);
+    return ret;
 }
 
 uint8_t LinuxI2CDriver::readRegisters(uint8_t addr, uint8_t reg,
@@ -162,11 +168,10 @@ uint8_t LinuxI2CDriver::readRegisters(uint8_t addr, uint8_t reg,
     // prevent valgrind error
     memset(data, 0, len);
 
-    if (ioctl(_fd, I2C_RDWR, &i2c_data) == -1) {
-        return 1;
-    }
-
-    return 0;
+    uint64_t t0 = hal.scheduler->micros64();
+    uint8_t ret = ioctl(_fd, I2C_RDWR, &i2c_data) == -1 ? 1 : 0;
+    _record(addr, t0, ret);
+    return ret;
 }
 
 
@@ -201,8 +206,11 @@ uint8_t LinuxI2CDriver::readRegistersMultiple(uint8_t addr, uint8_t reg,
             msgs[i*2+1].buf = (typeof(msgs->buf))data;
             data += len;
         };
-        if (ioctl(_fd, I2C_RDWR, &i2c_data) == -1) {
-            return 1;
+        uint64_t t0 = hal.scheduler->micros64();
+        uint8_t ret = ioctl(_fd, I2C_RDWR, &i2c_data) == -1 ? 1 : 0;
+        _record(addr, t0, ret);
+        if (ret != 0) {
+            return ret;
         }
         count -= n;
     }
@@ -217,14 +225,119 @@ uint8_t LinuxI2CDriver::readRegister(uint8_t addr, uint8_t reg, uint8_t* data)
     }
     union i2c_smbus_data v;
     memset(&v, 0, sizeof(v));
-    if (_i2c_smbus_access(_fd,I2C_SMBUS_READ, reg,
-                          I2C_SMBUS_BYTE_DATA, &v)) {
-        return 1;
+    uint64_t t0 = hal.scheduler->micros64();
+    uint8_t ret = _i2c_smbus_access(_fd,I2C_SMBUS_READ, reg,
+                                    I2C_SMBUS_BYTE_DATA, &v) ? 1 : 0;
+    _record(addr, t0, ret);
+    if (ret != 0) {
+        return ret;
     }
     *data = v.byte;
     return 0;
 }
 
+/*
+  batched transfers, as one I2C_RDWR ioctl where the kernel allows
+  that many messages. Each message after the first starts with a
+  repeated start, so a register write and the read after it are never
+  split between ioctls
+ */
+uint8_t LinuxI2CDriver::transfer_batch(const struct segment *segments, uint8_t count)
+{
+#ifdef I2C_RDRW_IOCTL_MAX_MSGS
+    const uint8_t max_msgs = I2C_RDRW_IOCTL_MAX_MSGS;
+#else
+    const uint8_t max_msgs = 16;
+#endif
+
+    if (_fd == -1) {
+        return 1;
+    }
+    uint64_t t0 = hal.scheduler->micros64();
+    uint8_t ret = 0;
+    uint8_t done = 0;
+    while (done < count) {
+        uint8_t n = count - done > max_msgs ? max_msgs : count - done;
+        const struct segment *seg = &segments[done];
+        if (done + n < count && n > 1 && !seg[n-1].read &&
+            seg[n].read && seg[n].addr == seg[n-1].addr) {
+            n--;
+        }
+        struct i2c_msg msgs[n];
+        struct i2c_rdwr_ioctl_data i2c_data = {
+        msgs : msgs,
+        nmsgs : n
+        };
+        for (uint8_t i=0; i<n; i++) {
+            msgs[i].addr = seg[i].addr;
+            msgs[i].flags = seg[i].read ? I2C_M_RD : 0;
+            msgs[i].len = seg[i].len;
+            msgs[i].buf = (typeof(msgs->buf))seg[i].data;
+            if (seg[i].read) {
+                // prevent valgrind error
+                memset(seg[i].data, 0, seg[i].len);
+            }
+        }
+        if (ioctl(_fd, I2C_RDWR, &i2c_data) == -1) {
+            ret = 1;
+            break;
+        }
+        done += n;
+    }
+
+    uint32_t usec = _record_bus(t0);
+    for (uint8_t i=0; i<count; i++) {
+        // each device once, however many segments it has
+        bool seen = false;
+        for (uint8_t j=0; j<i && !seen; j++) {
+            seen = segments[j].addr == segments[i].addr;
+        }
+        if (!seen) {
+            _record_device(segments[i].addr, usec, ret);
+        }
+    }
+    return ret;
+}
+
+/*
+  add a transfer that started at start_usec to the bus statistics,
+  returning its duration
+ */
+uint32_t LinuxI2CDriver::_record_bus(uint64_t start_usec)
+{
+    uint32_t usec = hal.scheduler->micros64() - start_usec;
+    _bus_stats.transfers++;
+    _bus_stats.busy_usec += usec;
+    return usec;
+}
+
+void LinuxI2CDriver::_record_device(uint8_t addr, uint32_t usec, uint8_t ret)
+{
+    for (uint8_t i=0; i<LINUX_I2C_STATS_DEVICES; i++) {
+        DeviceStats &ds = _device_stats[i];
+        if (ds.transfers != 0 && ds.addr != addr) {
+            continue;
+        }
+        ds.addr = addr;
+        ds.transfers++;
+        if (ret != 0) {
+            ds.errors++;
+        }
+        ds.total_usec += usec;
+        if (usec > ds.max_usec) {
+            ds.max_usec = usec;
+        }
+        return;
+    }
+}
+
+void LinuxI2CDriver::reset_stats(void)
+{
+    memset(&_bus_stats, 0, sizeof(_bus_stats));
+    memset(_device_stats, 0, sizeof(_device_stats));
+    _bus_stats.start_usec = hal.scheduler->micros64();
+}
+
 uint8_t LinuxI2CDriver::lockup_count() 
 {
     return 0;
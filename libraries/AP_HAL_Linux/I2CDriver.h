@@ -4,6 +4,9 @@
 
 #include <AP_HAL_Linux.h>
 
+// devices with their own latency statistics, on each bus
+#define LINUX_I2C_STATS_DEVICES 8
+
 class Linux::LinuxI2CDriver : public AP_HAL::I2CDriver {
 public:
     LinuxI2CDriver(AP_HAL::Semaphore* semaphore, const char *device);
@@ -36,13 +39,47 @@ public:
                                   uint8_t len, uint8_t count, 
                                   uint8_t* data);
 
+    uint8_t transfer_batch(const struct segment *segments, uint8_t count);
+
     uint8_t lockup_count();
 
     AP_HAL::Semaphore* get_semaphore() { return _semaphore; }
 
+    /*
+      bus statistics. busy_usec is the time spent in transfers since
+      start_usec, so gives the bus occupancy. A batch counts as one
+      transfer for the bus and one for each device in it, with the
+      time of the whole batch as the device latency
+     */
+    struct BusStats {
+        uint32_t transfers;
+        uint64_t busy_usec;
+        uint64_t start_usec;
+    };
+
+    struct DeviceStats {
+        uint8_t  addr;
+        uint32_t transfers;      // zero for an unused entry
+        uint32_t errors;
+        uint64_t total_usec;
+        uint32_t max_usec;
+    };
+
+    const BusStats &bus_stats(void) const { return _bus_stats; }
+    const DeviceStats &device_stats(uint8_t i) const { return _device_stats[i]; }
+    void reset_stats(void);
+
 private:
     AP_HAL::Semaphore* _semaphore;
     bool set_address(uint8_t addr);
+    uint32_t _record_bus(uint64_t start_usec);
+    void _record_device(uint8_t addr, uint32_t usec, uint8_t ret);
+    void _record(uint8_t addr, uint64_t start_usec, uint8_t ret) {
+        _record_device(addr, _record_bus(start_usec), ret);
+    }
+
+    BusStats _bus_stats;
+    DeviceStats _device_stats[LINUX_I2C_STATS_DEVICES];
     int _fd;
     uint8_t _addr;
     const char *_device;
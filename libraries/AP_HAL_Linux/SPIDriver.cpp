@@ -15,6 +15,10 @@
 
 #define SPI_DEBUGGING 0
 
+// clear receive buffers before each transfer, as valgrind doesn't
+// know the kernel fills them
+#define SPI_VALGRIND 0
+
 using namespace Linux;
 
 extern const AP_HAL::HAL& hal;
@@ -53,6 +57,8 @@ LinuxSPIDeviceDriver LinuxSPIDeviceManager::_device[0];
 // have a separate semaphore per bus
 LinuxSemaphore LinuxSPIDeviceManager::_semaphore[LINUX_SPI_MAX_BUSES];
 
+int16_t LinuxSPIDeviceManager::_bus_mode[LINUX_SPI_MAX_BUSES];
+
 LinuxSPIDeviceDriver::LinuxSPIDeviceDriver(uint16_t bus, uint16_t subdev, enum AP_HAL::SPIDevice type, uint8_t mode, uint8_t bitsPerWord, int16_t cs_pin, uint32_t lowspeed, uint32_t highspeed):
     _bus(bus),
     _subdev(subdev),
@@ -63,7 +69,9 @@ LinuxSPIDeviceDriver::LinuxSPIDeviceDriver(uint16_t bus, uint16_t subdev, enum A
     _highspeed(highspeed),
     _speed(highspeed),
     _cs_pin(cs_pin),
-    _cs(NULL)
+    _cs(NULL),
+    _node(0),
+    _node_mode(-1)
 {
 }
 
@@ -92,6 +100,11 @@ void LinuxSPIDeviceDriver::transaction(const uint8_t *tx, uint8_t *rx, uint16_t
     LinuxSPIDeviceManager::transaction(*this, tx, rx, len);
 }
 
+void LinuxSPIDeviceDriver::transaction_batch(const struct segment *segments, uint8_t count)
+{
+    LinuxSPIDeviceManager::transaction_batch(*this, segments, count);
+}
+
 void LinuxSPIDeviceDriver::set_bus_speed(enum bus_speed speed)
 {
     if (speed == SPI_SPEED_LOW) {
@@ -125,6 +138,9 @@ void LinuxSPIDeviceDriver::transfer(const uint8_t *data, uint16_t len)
 
 void LinuxSPIDeviceManager::init(void *)
 {
+    for (uint8_t i=0; i<LINUX_SPI_MAX_BUSES; i++) {
+        _bus_mode[i] = -1;
+    }
     for (uint8_t i=0; i<LINUX_SPI_DEVICE_NUM_DEVICES; i++) {
         if (_device[i]._bus >= LINUX_SPI_MAX_BUSES) {
             hal.scheduler->panic("SPIDriver: invalid bus number");
@@ -142,6 +158,14 @@ void LinuxSPIDeviceManager::init(void *)
         fflush(stdout);
 #endif
         _device[i].init();
+
+        for (uint8_t j=0; j<=i; j++) {
+            if (_device[j]._bus == _device[i]._bus &&
+                _device[j]._subdev == _device[i]._subdev) {
+                _device[i]._node = j;
+                break;
+            }
+        }
     }
 }
 
@@ -207,11 +231,27 @@ void LinuxSPIDeviceManager::cs_release(enum AP_HAL::SPIDevice type)
     }
 }
 
-void LinuxSPIDeviceManager::transaction(LinuxSPIDeviceDriver &driver, const uint8_t *tx, uint8_t *rx, uint16_t len)
+/*
+  we set the mode before we assert the CS line so that the bus is in
+  the correct idle state before the chip is selected. The mode belongs
+  to the spidev node, which may be shared by several devices with GPIO
+  chip selects, and the idle state to the bus, so we only need to set
+  it when either was last used with another mode
+ */
+void LinuxSPIDeviceManager::_set_mode(LinuxSPIDeviceDriver &driver)
 {
-    // we set the mode before we assert the CS line so that the bus is
-    // in the correct idle state before the chip is selected
+    LinuxSPIDeviceDriver &node = _device[driver._node];
+    if (node._node_mode == driver._mode && _bus_mode[driver._bus] == driver._mode) {
+        return;
+    }
     ioctl(driver._fd, SPI_IOC_WR_MODE, &driver._mode);
+    node._node_mode = driver._mode;
+    _bus_mode[driver._bus] = driver._mode;
+}
+
+void LinuxSPIDeviceManager::transaction(LinuxSPIDeviceDriver &driver, const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+    _set_mode(driver);
 
     cs_assert(driver._type);
     struct spi_ioc_transfer spi[1];
@@ -224,15 +264,80 @@ void LinuxSPIDeviceManager::transaction(LinuxSPIDeviceDriver &driver, const uint
     spi[0].bits_per_word = driver._bitsPerWord;
     spi[0].cs_change     = 0;
 
+#if SPI_VALGRIND
     if (rx != NULL) {
-        // keep valgrind happy
         memset(rx, 0, len);
     }
+#endif
 
     ioctl(driver._fd, SPI_IOC_MESSAGE(1), &spi);
     cs_release(driver._type);
 }
 
+/*
+  run a batch of transactions. With a kernel chip select, as many
+  transactions as fit go in one SPI_IOC_MESSAGE, with cs_change
+  deselecting the chip between them. A GPIO chip select has to be
+  toggled between messages, so there each transaction is a message of
+  its own
+ */
+void LinuxSPIDeviceManager::transaction_batch(LinuxSPIDeviceDriver &driver,
+                                              const AP_HAL::SPIDeviceDriver::segment *segments,
+                                              uint8_t count)
+{
+    struct spi_ioc_transfer spi[LINUX_SPI_MAX_SEGMENTS];
+    bool kernel_cs = (driver._cs_pin == SPI_CS_KERNEL);
+
+    _set_mode(driver);
+
+    uint8_t i = 0;
+    while (i < count) {
+        memset(spi, 0, sizeof(spi));
+
+        // n is the segments filled in, and whole the segments up to
+        // the end of the last complete transaction
+        uint8_t n = 0, whole = 0;
+        while (i + n < count && n < LINUX_SPI_MAX_SEGMENTS) {
+            const AP_HAL::SPIDeviceDriver::segment &seg = segments[i + n];
+            spi[n].tx_buf        = (uint64_t)seg.tx;
+            spi[n].rx_buf        = (uint64_t)seg.rx;
+            spi[n].len           = seg.len;
+            spi[n].speed_hz      = driver._speed;
+            spi[n].bits_per_word = driver._bitsPerWord;
+            spi[n].cs_change     = !seg.cs_hold;
+#if SPI_VALGRIND
+            if (seg.rx != NULL) {
+                memset(seg.rx, 0, seg.len);
+            }
+#endif
+            n++;
+            if (!seg.cs_hold) {
+                whole = n;
+                if (!kernel_cs) {
+                    break;
+                }
+            }
+        }
+        if (i + n == count) {
+            // a hold on the last segment of the batch has nothing to
+            // hold the chip for
+            whole = n;
+        }
+        if (whole == 0) {
+            hal.scheduler->panic("SPIDriver: too many segments in a transaction");
+        }
+
+        // the chip is deselected at the end of a message unless
+        // cs_change is set on its last transfer
+        spi[whole-1].cs_change = 0;
+
+        cs_assert(driver._type);
+        ioctl(driver._fd, _IOC(_IOC_WRITE, SPI_IOC_MAGIC, 0, SPI_MSGSIZE(whole)), spi);
+        cs_release(driver._type);
+        i += whole;
+    }
+}
+
 /*
   return a SPIDeviceDriver for a particular device
  */
@@ -22,6 +22,9 @@
 
 #define LINUX_SPI_MAX_BUSES 3
 
+// most segments handed to the kernel in one SPI_IOC_MESSAGE
+#define LINUX_SPI_MAX_SEGMENTS 16
+
 // Fake CS pin to indicate in-kernel handling
 #define SPI_CS_KERNEL -1
 
@@ -32,6 +35,7 @@ public:
     void init();
     AP_HAL::Semaphore *get_semaphore();
     void transaction(const uint8_t *tx, uint8_t *rx, uint16_t len);
+    void transaction_batch(const struct segment *segments, uint8_t count);
 
     void cs_assert();
     void cs_release();
@@ -51,6 +55,11 @@ private:
     uint32_t _speed;
     enum AP_HAL::SPIDevice _type;
     int _fd;	// Per-device FD.
+
+    // index of the first device in the table on the same spidev
+    // node, which holds the mode last set on the node
+    uint8_t _node;
+    int16_t _node_mode;
 };
 
 class Linux::LinuxSPIDeviceManager : public AP_HAL::SPIDeviceManager {
@@ -63,10 +72,17 @@ public:
     static void cs_assert(enum AP_HAL::SPIDevice type);
     static void cs_release(enum AP_HAL::SPIDevice type);
     static void transaction(LinuxSPIDeviceDriver &driver, const uint8_t *tx, uint8_t *rx, uint16_t len);
+    static void transaction_batch(LinuxSPIDeviceDriver &driver,
+                                  const AP_HAL::SPIDeviceDriver::segment *segments, uint8_t count);
 
 private:
+    static void _set_mode(LinuxSPIDeviceDriver &driver);
+
     static LinuxSPIDeviceDriver _device[LINUX_SPI_DEVICE_NUM_DEVICES];
     static LinuxSemaphore _semaphore[LINUX_SPI_MAX_BUSES];
+
+    // mode of the last transfer on each bus, or -1 if not known
+    static int16_t _bus_mode[LINUX_SPI_MAX_BUSES];
 };
 
 #endif // __AP_HAL_LINUX_SPIDRIVER_H__
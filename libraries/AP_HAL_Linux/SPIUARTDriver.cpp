@@ -223,6 +223,23 @@ int LinuxSPIUARTDriver::_read_fd(uint8_t *buf, uint16_t n)
     return n;
 }
 
+int LinuxSPIUARTDriver::_read_fd_wrap(uint16_t n1, uint16_t n2)
+{
+    if (_external) {
+        return LinuxUARTDriver::_read_fd_wrap(n1, n2);
+    }
+
+    // each part is its own SPI transaction
+    int ret = _read_fd(&_readbuf[_readbuf_tail], n1);
+    if (ret == n1 && n2 > 0) {
+        int ret2 = _read_fd(&_readbuf[_readbuf_tail], n2);
+        if (ret2 > 0) {
+            ret += ret2;
+        }
+    }
+    return ret;
+}
+
 void LinuxSPIUARTDriver::_timer_tick(void)
 {
     if (_external) {
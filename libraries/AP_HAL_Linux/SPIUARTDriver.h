@@ -15,6 +15,7 @@ public:
 protected:
     int _write_fd(const uint8_t *buf, uint16_t n);
     int _read_fd(uint8_t *buf, uint16_t n);
+    int _read_fd_wrap(uint16_t n1, uint16_t n2);
 
 private:
     bool sem_take_nonblocking();
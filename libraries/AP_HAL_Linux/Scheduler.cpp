@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <sys/mman.h>
+#include <sys/timerfd.h>
 
 using namespace Linux;
 
@@ -26,6 +27,48 @@ extern const AP_HAL::HAL& hal;
 #define APM_LINUX_MAIN_PRIORITY         12
 #define APM_LINUX_TONEALARM_PRIORITY    11
 #define APM_LINUX_IO_PRIORITY           10
+#define APM_LINUX_WORKER_PRIORITY       11
+
+#define APM_LINUX_TIMER_PERIOD          1000
+#define APM_LINUX_UART_PERIOD           10000
+#define APM_LINUX_RCIN_PERIOD           10000
+#define APM_LINUX_TONEALARM_PERIOD      10000
+#define APM_LINUX_IO_PERIOD             20000
+
+/*
+  minimum time between data driven wakeups of one UART. This bounds
+  the cost of a descriptor that stays readable (such as stdin at EOF)
+  while still cutting receive latency well below the 10ms flush period
+ */
+#define APM_LINUX_UART_EVENT_HOLDOFF    1000
+
+const uint32_t LinuxScheduler::jitter_bin_limit_usec[LINUX_SCHEDULER_JITTER_BINS-1] = {
+    10, 50, 100, 500, 1000
+};
+
+static void timespec_add_usec(struct timespec &ts, uint64_t usec)
+{
+    ts.tv_sec  += usec / 1000000UL;
+    ts.tv_nsec += (usec % 1000000UL) * 1000UL;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+}
+
+// a - b in microseconds
+static int64_t timespec_diff_usec(const struct timespec &a, const struct timespec &b)
+{
+    return (int64_t)(a.tv_sec - b.tv_sec) * 1000000LL +
+        (a.tv_nsec - b.tv_nsec) / 1000;
+}
+
+static uint64_t monotonic_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
 
 LinuxScheduler::LinuxScheduler()
 {}
@@ -122,6 +165,49 @@ void LinuxScheduler::_microsleep(uint32_t usec)
     while (nanosleep(&ts, &ts) == -1 && errno == EINTR) ;
 }
 
+/*
+  sleep until the next absolute deadline of a periodic thread. Sleeping
+  to an absolute time means the time spent running the thread's work
+  doesn't accumulate as drift, and no wakeups happen between deadlines
+ */
+void LinuxScheduler::_wait_period(struct timespec &deadline, uint32_t period_usec,
+                                  enum jitter_thread t)
+{
+    timespec_add_usec(deadline, period_usec);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) ;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t late = timespec_diff_usec(now, deadline);
+    if (late > (int64_t)period_usec) {
+        // we've lost sync - restart from now rather than running a
+        // burst of back to back catch-up ticks
+        deadline = now;
+        _jitter[t].resyncs++;
+    }
+    _record_jitter(t, late > 0 ? late : 0);
+}
+
+void LinuxScheduler::_record_jitter(enum jitter_thread t, uint32_t late_usec)
+{
+    JitterStats &js = _jitter[t];
+    uint8_t bin = 0;
+    while (bin < LINUX_SCHEDULER_JITTER_BINS-1 && late_usec >= jitter_bin_limit_usec[bin]) {
+        bin++;
+    }
+    js.hist[bin]++;
+    js.wakeups++;
+    js.total_usec += late_usec;
+    if (late_usec > js.max_usec) {
+        js.max_usec = late_usec;
+    }
+}
+
+void LinuxScheduler::reset_jitter_stats(void)
+{
+    memset(_jitter, 0, sizeof(_jitter));
+}
+
 void LinuxScheduler::delay(uint16_t ms)
 {
     if (stopped_clock_usec) {
@@ -275,16 +361,11 @@ void *LinuxScheduler::_timer_thread(void* arg)
       this aims to run at an average of 1kHz, so that it can be used
       to drive 1kHz processes without drift
      */
-    uint64_t next_run_usec = sched->micros64() + 1000;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
     while (true) {
-        uint64_t dt = next_run_usec - sched->micros64();
-        if (dt > 2000) {
-            // we've lost sync - restart
-            next_run_usec = sched->micros64();
-        } else {
-            sched->_microsleep(dt);
-        }
-        next_run_usec += 1000;
+        sched->_wait_period(deadline, APM_LINUX_TIMER_PERIOD, JITTER_TIMER);
+
         // run registered timers
         sched->_run_timers(true);
     }
@@ -314,29 +395,126 @@ void *LinuxScheduler::_rcin_thread(void *arg)
     while (sched->system_initializing()) {
         poll(NULL, 0, 1);
     }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
     while (true) {
-        sched->_microsleep(10000);
+        sched->_wait_period(deadline, APM_LINUX_RCIN_PERIOD, JITTER_RCIN);
 
         ((LinuxRCInput *)hal.rcin)->_timer_tick();
     }
     return NULL;
 }
 
+/*
+  the UART thread sleeps in poll() on the read side of each UART plus a
+  timerfd for the periodic write flush, so incoming bytes are picked up
+  as they arrive instead of on the next 10ms tick, and an idle link
+  causes no extra wakeups. The set of descriptors changes as TCP
+  clients connect, so it is rebuilt on each pass; with at most four
+  UARTs that is cheaper than keeping an epoll set in step
+ */
 void *LinuxScheduler::_uart_thread(void* arg)
 {
     LinuxScheduler* sched = (LinuxScheduler *)arg;
+    LinuxUARTDriver *uarts[] = {
+        (LinuxUARTDriver *)hal.uartA,
+        (LinuxUARTDriver *)hal.uartB,
+        (LinuxUARTDriver *)hal.uartC,
+        (LinuxUARTDriver *)hal.uartE,
+    };
+    const uint8_t num_uarts = sizeof(uarts)/sizeof(uarts[0]);
+    uint64_t holdoff_until[num_uarts];
+    memset(holdoff_until, 0, sizeof(holdoff_until));
 
     while (sched->system_initializing()) {
         poll(NULL, 0, 1);
     }
+
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (tfd == -1) {
+        sched->panic(PSTR("Failed to create UART timerfd"));
+    }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    timespec_add_usec(deadline, APM_LINUX_UART_PERIOD);
+    struct itimerspec its;
+    its.it_value = deadline;
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = APM_LINUX_UART_PERIOD * 1000UL;
+    if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) == -1) {
+        sched->panic(PSTR("Failed to start UART timerfd"));
+    }
+
     while (true) {
-        sched->_microsleep(10000);
+        struct pollfd fds[1+num_uarts];
+        uint8_t fd_uart[1+num_uarts];
+        uint8_t nfds = 1;
+        uint64_t now = monotonic_usec();
+        uint64_t next_holdoff = 0;
+
+        fds[0].fd = tfd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        for (uint8_t i=0; i<num_uarts; i++) {
+            int fd = uarts[i]->_poll_fd();
+            if (fd == -1) {
+                continue;
+            }
+            if (now < holdoff_until[i]) {
+                if (next_holdoff == 0 || holdoff_until[i] < next_holdoff) {
+                    next_holdoff = holdoff_until[i];
+                }
+                continue;
+            }
+            fds[nfds].fd = fd;
+            fds[nfds].events = POLLIN;
+            fds[nfds].revents = 0;
+            fd_uart[nfds] = i;
+            nfds++;
+        }
+
+        struct timespec timeout;
+        if (next_holdoff != 0) {
+            uint64_t dt = next_holdoff - now;
+            timeout.tv_sec = dt / 1000000UL;
+            timeout.tv_nsec = (dt % 1000000UL) * 1000UL;
+        }
+        if (ppoll(fds, nfds, next_holdoff != 0 ? &timeout : NULL, NULL) <= 0) {
+            continue;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t expirations = 0;
+            if (read(tfd, &expirations, sizeof(expirations)) == sizeof(expirations) &&
+                expirations > 0) {
+                // lateness is measured against the most recent expiry
+                timespec_add_usec(deadline, (expirations-1) * APM_LINUX_UART_PERIOD);
+                struct timespec ts;
+                clock_gettime(CLOCK_MONOTONIC, &ts);
+                int64_t late = timespec_diff_usec(ts, deadline);
+                if (expirations > 1) {
+                    sched->_jitter[JITTER_UART].resyncs++;
+                }
+                sched->_record_jitter(JITTER_UART, late > 0 ? late : 0);
+                timespec_add_usec(deadline, APM_LINUX_UART_PERIOD);
+            }
+            // process any pending serial bytes
+            for (uint8_t i=0; i<num_uarts; i++) {
+                uarts[i]->_timer_tick();
+            }
+            continue;
+        }
 
-        // process any pending serial bytes
-        ((LinuxUARTDriver *)hal.uartA)->_timer_tick();
-        ((LinuxUARTDriver *)hal.uartB)->_timer_tick();
-        ((LinuxUARTDriver *)hal.uartC)->_timer_tick();
-        ((LinuxUARTDriver *)hal.uartE)->_timer_tick();
+        now = monotonic_usec();
+        for (uint8_t n=1; n<nfds; n++) {
+            if (fds[n].revents == 0) {
+                continue;
+            }
+            uint8_t i = fd_uart[n];
+            uarts[i]->_timer_tick();
+            holdoff_until[i] = now + APM_LINUX_UART_EVENT_HOLDOFF;
+            sched->_jitter[JITTER_UART].event_wakeups++;
+        }
     }
     return NULL;
 }
@@ -348,8 +526,10 @@ void *LinuxScheduler::_tonealarm_thread(void* arg)
     while (sched->system_initializing()) {
         poll(NULL, 0, 1);
     }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
     while (true) {
-        sched->_microsleep(10000);
+        sched->_wait_period(deadline, APM_LINUX_TONEALARM_PERIOD, JITTER_TONEALARM);
 
         // process tone command
         ((LinuxUtil *)hal.util)->_toneAlarm_timer_tick();
@@ -357,6 +537,43 @@ void *LinuxScheduler::_tonealarm_thread(void* arg)
     return NULL;
 }
 
+/*
+  start a thread for work offloaded from the main loop, pinned to the
+  last CPU. The main thread is left where the kernel puts it
+ */
+bool LinuxScheduler::start_worker_thread(AP_HAL::MemberProc proc)
+{
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (ncpus < 2 || _worker_proc != NULL) {
+        return false;
+    }
+    _worker_proc = proc;
+    _create_realtime_thread(&_worker_thread_ctx, APM_LINUX_WORKER_PRIORITY,
+                            "sched-worker", &Linux::LinuxScheduler::_worker_thread);
+
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(ncpus-1, &cpuset);
+    int r = pthread_setaffinity_np(_worker_thread_ctx, sizeof(cpuset), &cpuset);
+    if (r != 0) {
+        hal.console->printf("Failed to pin worker thread: %s\n", strerror(r));
+    }
+    return true;
+}
+
+void *LinuxScheduler::_worker_thread(void* arg)
+{
+    LinuxScheduler* sched = (LinuxScheduler *)arg;
+
+    while (sched->system_initializing()) {
+        poll(NULL, 0, 1);
+    }
+    while (true) {
+        sched->_worker_proc();
+    }
+    return NULL;
+}
+
 void *LinuxScheduler::_io_thread(void* arg)
 {
     LinuxScheduler* sched = (LinuxScheduler *)arg;
@@ -364,8 +581,10 @@ void *LinuxScheduler::_io_thread(void* arg)
     while (sched->system_initializing()) {
         poll(NULL, 0, 1);
     }
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
     while (true) {
-        sched->_microsleep(20000);
+        sched->_wait_period(deadline, APM_LINUX_IO_PERIOD, JITTER_IO);
 
         // process any pending storage writes
         ((LinuxStorage *)hal.storage)->_timer_tick();
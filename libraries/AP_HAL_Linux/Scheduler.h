@@ -7,11 +7,15 @@
 
 #if CONFIG_HAL_BOARD == HAL_BOARD_LINUX
 #include <sys/time.h>
+#include <time.h>
 #include <pthread.h>
 
 #define LINUX_SCHEDULER_MAX_TIMER_PROCS 10
 #define LINUX_SCHEDULER_MAX_IO_PROCS 10
 
+// wakeup lateness histogram bins: <10, <50, <100, <500, <1000, >=1000 usec
+#define LINUX_SCHEDULER_JITTER_BINS 6
+
 class Linux::LinuxScheduler : public AP_HAL::Scheduler {
 
 typedef void *(*pthread_startroutine_t)(void *);
@@ -48,10 +52,43 @@ public:
 
     void     stop_clock(uint64_t time_usec);
 
+    bool     start_worker_thread(AP_HAL::MemberProc proc);
+
+    enum jitter_thread {
+        JITTER_TIMER = 0,
+        JITTER_UART,
+        JITTER_RCIN,
+        JITTER_TONEALARM,
+        JITTER_IO,
+        JITTER_NUM_THREADS
+    };
+
+    /*
+      wakeup statistics for one of the scheduler threads. Lateness is
+      measured against the absolute deadline the thread asked to be
+      woken at. Updated only by the owning thread, so values read from
+      elsewhere are a snapshot
+     */
+    struct JitterStats {
+        uint32_t wakeups;        // deadline wakeups
+        uint32_t event_wakeups;  // wakeups due to file descriptor activity
+        uint32_t resyncs;        // times the thread fell a period behind
+        uint64_t total_usec;
+        uint32_t max_usec;
+        uint32_t hist[LINUX_SCHEDULER_JITTER_BINS];
+    };
+
+    const JitterStats &jitter_stats(enum jitter_thread t) const { return _jitter[t]; }
+    void     reset_jitter_stats(void);
+    static const uint32_t jitter_bin_limit_usec[LINUX_SCHEDULER_JITTER_BINS-1];
+
 private:
     struct timespec _sketch_start_time;    
     void _timer_handler(int signum);
     void _microsleep(uint32_t usec);
+    void _wait_period(struct timespec &deadline, uint32_t period_usec,
+                      enum jitter_thread t);
+    void _record_jitter(enum jitter_thread t, uint32_t late_usec);
 
     AP_HAL::Proc _delay_cb;
     uint16_t _min_delay_cb_ms;
@@ -76,12 +113,16 @@ private:
     pthread_t _rcin_thread_ctx;
     pthread_t _uart_thread_ctx;
     pthread_t _tonealarm_thread_ctx;
+    pthread_t _worker_thread_ctx;
 
     static void *_timer_thread(void* arg);
     static void *_io_thread(void* arg);
     static void *_rcin_thread(void* arg);
     static void *_uart_thread(void* arg);
     static void *_tonealarm_thread(void* arg);
+    static void *_worker_thread(void* arg);
+
+    AP_HAL::MemberProc _worker_proc;
 
     void _run_timers(bool called_from_timer_thread);
     void _run_io(void);
@@ -92,6 +133,8 @@ private:
 
     LinuxSemaphore _timer_semaphore;
     LinuxSemaphore _io_semaphore;
+
+    JitterStats _jitter[JITTER_NUM_THREADS];
 };
 
 #endif // CONFIG_HAL_BOARD
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <stdio.h>
+#include <sys/uio.h>
 #include "Storage.h"
 
 using namespace Linux;
@@ -16,12 +17,29 @@ using namespace Linux;
 /*
   This stores 'eeprom' data on the SD card, with a 4k size, and a
   in-memory buffer. This keeps the latency down.
+
+  Dirty lines are written back by the IO thread. Each pass first
+  appends all of the dirty lines to a journal as one checksummed
+  record, then writes them to the storage file. If power is lost
+  part way through the storage file write the journal is replayed
+  the next time the storage is opened.
  */
 
 // name the storage file after the sketch so you can use the same board
 // card for ArduCopter and ArduPlane
 #define STORAGE_DIR "/var/APM"
 #define STORAGE_FILE STORAGE_DIR "/" SKETCHNAME ".stg"
+#define JOURNAL_FILE STORAGE_DIR "/" SKETCHNAME ".jnl"
+
+#define JOURNAL_MAGIC 0x4A53544CUL // "LTSJ"
+
+// each journal record is this header followed by the lines in line_mask
+struct journal_header {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t line_mask;
+    uint32_t crc; // crc32 of seq, line_mask and the line data
+};
 
 extern const AP_HAL::HAL& hal;
 
@@ -29,6 +47,8 @@ void LinuxStorage::_storage_create(void)
 {
     mkdir(STORAGE_DIR, 0777);
     unlink(STORAGE_FILE);
+    // a journal only makes sense against the file it was written for
+    unlink(JOURNAL_FILE);
     int fd = open(STORAGE_FILE, O_RDWR|O_CREAT, 0666);
     if (fd == -1) {
         hal.scheduler->panic("Failed to create " STORAGE_FILE);
@@ -70,23 +90,125 @@ void LinuxStorage::_storage_open(void)
         }
     }
     close(fd);
+    _journal_replay();
+    memcpy(_flush_buffer, _buffer, sizeof(_buffer));
     _initialised = true;
 }
 
+// standard (IEEE 802.3) crc32, done a nibble at a time
+uint32_t LinuxStorage::_crc32(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        crc = (crc >> 4) ^ table[crc & 0xF];
+        crc = (crc >> 4) ^ table[crc & 0xF];
+    }
+    return ~crc;
+}
+
+/*
+  apply any complete journal records on top of the storage file. A
+  record that is short or fails its checksum was being written when
+  power was lost, and nothing after it can be trusted. Records that
+  had already reached the storage file are harmlessly applied again
+ */
+void LinuxStorage::_journal_replay(void)
+{
+    int fd = open(JOURNAL_FILE, O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    uint32_t replayed = 0;
+    struct journal_header hdr;
+    while (read(fd, &hdr, sizeof(hdr)) == sizeof(hdr)) {
+        if (hdr.magic != JOURNAL_MAGIC ||
+            hdr.line_mask == 0 ||
+            (hdr.line_mask >> LINUX_STORAGE_NUM_LINES) != 0) {
+            break;
+        }
+        // read the lines into the flush buffer, which is free until
+        // the storage is initialised
+        uint16_t len = __builtin_popcount(hdr.line_mask) << LINUX_STORAGE_LINE_SHIFT;
+        if (read(fd, _flush_buffer, len) != len) {
+            break;
+        }
+        uint32_t crc = _crc32(0, (const uint8_t *)&hdr.seq, sizeof(hdr.seq));
+        crc = _crc32(crc, (const uint8_t *)&hdr.line_mask, sizeof(hdr.line_mask));
+        crc = _crc32(crc, _flush_buffer, len);
+        if (crc != hdr.crc) {
+            break;
+        }
+        const uint8_t *p = _flush_buffer;
+        for (uint8_t i=0; i<LINUX_STORAGE_NUM_LINES; i++) {
+            if (hdr.line_mask & (1U<<i)) {
+                memcpy(&_buffer[i<<LINUX_STORAGE_LINE_SHIFT], p, LINUX_STORAGE_LINE_SIZE);
+                p += LINUX_STORAGE_LINE_SIZE;
+            }
+        }
+        _journal_seq = hdr.seq;
+        replayed++;
+    }
+    close(fd);
+
+    if (replayed != 0) {
+        // make the storage file whole again before dropping the journal
+        fd = open(STORAGE_FILE, O_WRONLY);
+        if (fd == -1 ||
+            pwrite(fd, _buffer, sizeof(_buffer), 0) != sizeof(_buffer) ||
+            fsync(fd) != 0) {
+            // keep the journal for the next attempt
+            if (fd != -1) {
+                close(fd);
+            }
+            _stats.errors++;
+            return;
+        }
+        close(fd);
+    }
+    _stats.recovered_records = replayed;
+    if (truncate(JOURNAL_FILE, 0) != 0 && unlink(JOURNAL_FILE) != 0) {
+        // new records would be appended after any torn record, where
+        // replay stops
+        _stats.errors++;
+    }
+}
+
+bool LinuxStorage::_journal_open(void)
+{
+    if (_journal_fd != -1) {
+        return true;
+    }
+    _journal_fd = open(JOURNAL_FILE, O_WRONLY|O_CREAT|O_APPEND, 0666);
+    if (_journal_fd == -1) {
+        return false;
+    }
+    _journal_size = lseek(_journal_fd, 0, SEEK_END);
+    return true;
+}
+
 /*
-  mark some lines as dirty. Note that there is no attempt to avoid
-  the race condition between this code and the _timer_tick() code
-  below, which both update _dirty_mask. If we lose the race then the
-  result is that a line is written more than once, but it won't result
-  in a line not being written.
+  mark some lines as dirty. The IO thread clears the bits it is about
+  to write before copying the lines, so a line changed while it is
+  being written is marked again and written on the next pass
  */
 void LinuxStorage::_mark_dirty(uint16_t loc, uint16_t length)
 {
     uint16_t end = loc + length;
+    uint32_t mask = 0;
     for (uint8_t line=loc>>LINUX_STORAGE_LINE_SHIFT;
-         line <= end>>LINUX_STORAGE_LINE_SHIFT;
+         line <= end>>LINUX_STORAGE_LINE_SHIFT && line < LINUX_STORAGE_NUM_LINES;
          line++) {
-        _dirty_mask |= 1U << line;
+        mask |= 1U << line;
+    }
+    if (__sync_fetch_and_or(&_dirty_mask, mask) == 0) {
+        _dirty_since_usec = hal.scheduler->micros64();
     }
 }
 
@@ -123,50 +245,105 @@ void LinuxStorage::_timer_tick(void)
             return;    
         }
     }
+    if (!_journal_open()) {
+        return;
+    }
 
-    // write out the first dirty set of lines. We don't write more
-    // than one to keep the latency of this call to a minimum
-    uint8_t i, n;
-    for (i=0; i<LINUX_STORAGE_NUM_LINES; i++) {
-        if (_dirty_mask & (1<<i)) {
-            break;
-        }
+    uint64_t start_usec = hal.scheduler->micros64();
+    uint8_t num_dirty = __builtin_popcount(_dirty_mask);
+    if (num_dirty > _stats.max_dirty_lines) {
+        _stats.max_dirty_lines = num_dirty;
     }
-    if (i == LINUX_STORAGE_NUM_LINES) {
-        // this shouldn't be possible
+    uint32_t age = start_usec - _dirty_since_usec;
+
+    /*
+      take all of the dirty lines in this pass, then snapshot them
+      into the flush buffer so the journal checksum covers exactly
+      what is written even if the main thread changes them meanwhile
+     */
+    uint32_t write_mask = __sync_fetch_and_and(&_dirty_mask, 0);
+    if (write_mask == 0) {
         return;
     }
-    uint32_t write_mask = (1U<<i);
-    // see how many lines to write
-    for (n=1; (i+n) < LINUX_STORAGE_NUM_LINES && 
-             n < (LINUX_STORAGE_MAX_WRITE>>LINUX_STORAGE_LINE_SHIFT); n++) {
-        if (!(_dirty_mask & (1<<(n+i)))) {
-            break;
-        }        
-        // mark that line clean
-        write_mask |= (1<<(n+i));
+    struct journal_header hdr;
+    struct iovec iov[1+LINUX_STORAGE_NUM_LINES];
+    uint8_t n = 0, first = 0xFF, last = 0;
+    hdr.magic = JOURNAL_MAGIC;
+    hdr.seq = ++_journal_seq;
+    hdr.line_mask = write_mask;
+    hdr.crc = _crc32(0, (const uint8_t *)&hdr.seq, sizeof(hdr.seq));
+    hdr.crc = _crc32(hdr.crc, (const uint8_t *)&hdr.line_mask, sizeof(hdr.line_mask));
+    iov[n].iov_base = &hdr;
+    iov[n].iov_len = sizeof(hdr);
+    n++;
+    for (uint8_t i=0; i<LINUX_STORAGE_NUM_LINES; i++) {
+        if (!(write_mask & (1U<<i))) {
+            continue;
+        }
+        uint8_t *line = &_flush_buffer[i<<LINUX_STORAGE_LINE_SHIFT];
+        memcpy(line, &_buffer[i<<LINUX_STORAGE_LINE_SHIFT], LINUX_STORAGE_LINE_SIZE);
+        hdr.crc = _crc32(hdr.crc, line, LINUX_STORAGE_LINE_SIZE);
+        iov[n].iov_base = line;
+        iov[n].iov_len = LINUX_STORAGE_LINE_SIZE;
+        n++;
+        if (first == 0xFF) {
+            first = i;
+        }
+        last = i;
     }
+    ssize_t record_len = sizeof(hdr) + ((n-1)<<LINUX_STORAGE_LINE_SHIFT);
 
     /*
-      write the lines. This also updates _dirty_mask. Note that
-      because this is a SCHED_FIFO thread it will not be preempted
-      by the main task except during blocking calls. This means we
-      don't need a semaphore around the _dirty_mask updates.
+      journal the lines, then write everything from the first to the
+      last dirty line to the storage file in one go. Clean lines in
+      between come from the flush buffer, which matches the file
      */
-    if (lseek(_fd, i<<LINUX_STORAGE_LINE_SHIFT, SEEK_SET) == (i<<LINUX_STORAGE_LINE_SHIFT)) {
-        _dirty_mask &= ~write_mask;
-        if (write(_fd, &_buffer[i<<LINUX_STORAGE_LINE_SHIFT], n<<LINUX_STORAGE_LINE_SHIFT) != n<<LINUX_STORAGE_LINE_SHIFT) {
-            // write error - likely EINTR
-            _dirty_mask |= write_mask;
-            close(_fd);
-            _fd = -1;
-        }
-        if (_dirty_mask == 0) {
-            if (fsync(_fd) != 0) {
-                close(_fd);
-                _fd = -1;
-            }
+    uint16_t ofs = first<<LINUX_STORAGE_LINE_SHIFT;
+    ssize_t len = (last+1-first)<<LINUX_STORAGE_LINE_SHIFT;
+    if (writev(_journal_fd, iov, n) != record_len ||
+        fdatasync(_journal_fd) != 0) {
+        // likely EINTR. Retry the lines on the next pass, cutting
+        // off any partial record so later records can be replayed
+        __sync_fetch_and_or(&_dirty_mask, write_mask);
+        if (ftruncate(_journal_fd, _journal_size) != 0) {
+            // the storage file is synced up to the last good
+            // record, so the journal is not needed to recover it
+            unlink(JOURNAL_FILE);
         }
+        close(_journal_fd);
+        _journal_fd = -1;
+        _stats.errors++;
+        return;
+    }
+    _journal_size += record_len;
+
+    if (pwrite(_fd, &_flush_buffer[ofs], len, ofs) != len ||
+        fdatasync(_fd) != 0) {
+        // the lines may be partly written, but the journal holds
+        // them until a later pass writes them again
+        __sync_fetch_and_or(&_dirty_mask, write_mask);
+        close(_fd);
+        _fd = -1;
+        _stats.errors++;
+        return;
+    }
+
+    // the storage file is synced, so the journal can start again
+    if (_journal_size >= LINUX_STORAGE_JOURNAL_MAX &&
+        ftruncate(_journal_fd, 0) == 0) {
+        _journal_size = 0;
+    }
+
+    uint32_t dt = hal.scheduler->micros64() - start_usec;
+    _stats.flushes++;
+    _stats.lines_written += n-1;
+    _stats.last_flush_usec = dt;
+    _stats.total_flush_usec += dt;
+    if (dt > _stats.max_flush_usec) {
+        _stats.max_flush_usec = dt;
+    }
+    if (age + dt > _stats.max_dirty_age_usec) {
+        _stats.max_dirty_age_usec = age + dt;
     }
 }
 
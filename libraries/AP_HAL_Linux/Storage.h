@@ -16,13 +16,22 @@
 #define LINUX_STORAGE_LINE_SIZE (1<<LINUX_STORAGE_LINE_SHIFT)
 #define LINUX_STORAGE_NUM_LINES (LINUX_STORAGE_SIZE/LINUX_STORAGE_LINE_SIZE)
 
+// the write-back journal is truncated once it grows past this size
+#define LINUX_STORAGE_JOURNAL_MAX (64*1024)
+
 class Linux::LinuxStorage : public AP_HAL::Storage 
 {
 public:
     LinuxStorage() :
 	_fd(-1),
-	_dirty_mask(0)
-	{}
+	_dirty_mask(0),
+	_journal_fd(-1),
+	_journal_size(0),
+	_journal_seq(0),
+	_dirty_since_usec(0)
+	{
+	    memset(&_stats, 0, sizeof(_stats));
+	}
     void init(void* machtnichts) {}
     uint8_t  read_byte(uint16_t loc);
     uint16_t read_word(uint16_t loc);
@@ -35,6 +44,27 @@ public:
     void write_block(uint16_t dst, const void* src, size_t n);
 
     virtual void _timer_tick(void);
+
+    /*
+      write-back statistics. Updated by the IO thread, so values read
+      from elsewhere are a snapshot
+     */
+    struct StorageStats {
+        uint32_t flushes;           // passes that wrote to the file
+        uint32_t lines_written;
+        uint32_t errors;            // failed passes, retried later
+        uint32_t recovered_records; // journal records replayed at open
+        uint32_t last_flush_usec;
+        uint32_t max_flush_usec;
+        uint64_t total_flush_usec;
+        uint32_t max_dirty_age_usec; // longest a line waited to be written
+        uint8_t  max_dirty_lines;
+    };
+    const StorageStats &stats(void) const { return _stats; }
+
+    // number of lines waiting to be written
+    uint8_t dirty_lines(void) const { return __builtin_popcount(_dirty_mask); }
+
 protected:
     void _mark_dirty(uint16_t loc, uint16_t length);
     virtual void _storage_create(void);
@@ -43,6 +73,21 @@ protected:
     volatile bool _initialised;
     uint8_t _buffer[LINUX_STORAGE_SIZE];
     volatile uint32_t _dirty_mask;
+
+private:
+    bool _journal_open(void);
+    void _journal_replay(void);
+    static uint32_t _crc32(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+    int _journal_fd;
+    uint32_t _journal_size;
+    uint32_t _journal_seq;
+
+    // copy of the storage as last written to the file
+    uint8_t _flush_buffer[LINUX_STORAGE_SIZE];
+
+    volatile uint64_t _dirty_since_usec;
+    StorageStats _stats;
 };
 
 #include "Storage_FRAM.h"
@@ -17,6 +17,7 @@
 #include <poll.h>
 #include <assert.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -485,6 +486,32 @@ int16_t LinuxUARTDriver::read()
     return c;
 }
 
+/*
+  return the received bytes that are contiguous in the read buffer,
+  without consuming them
+ */
+uint16_t LinuxUARTDriver::read_span(const uint8_t *&data)
+{
+    if (!_initialised || _readbuf == NULL) {
+        return 0;
+    }
+    uint16_t head = _readbuf_head;
+    uint16_t tail = _readbuf_tail;
+    data = &_readbuf[head];
+    if (tail >= head) {
+        return tail - head;
+    }
+    return _readbuf_size - head;
+}
+
+/*
+  consume bytes returned by read_span()
+ */
+void LinuxUARTDriver::read_advance(uint16_t n)
+{
+    BUF_ADVANCEHEAD(_readbuf, n);
+}
+
 /* Linux implementations of Print virtual methods */
 size_t LinuxUARTDriver::write(uint8_t c) 
 { 
@@ -606,6 +633,27 @@ int LinuxUARTDriver::_read_fd(uint8_t *buf, uint16_t n)
     return ret;
 }
 
+/*
+  fill both parts of a wrapped read buffer with a single readv(), so
+  a busy link costs one system call per timer tick
+ */
+int LinuxUARTDriver::_read_fd_wrap(uint16_t n1, uint16_t n2)
+{
+    struct iovec iov[2];
+    iov[0].iov_base = &_readbuf[_readbuf_tail];
+    iov[0].iov_len  = n1;
+    iov[1].iov_base = &_readbuf[0];
+    iov[1].iov_len  = n2;
+
+    int ret = ::readv(_rd_fd, iov, 2);
+    if (ret > 0) {
+        BUF_ADVANCETAIL(_readbuf, ret);
+    } else if (ret < 0 && errno != EAGAIN && errno != EPIPE) {
+        ::fprintf(stdout, "read failed - %s\n", strerror(errno));
+    }
+    return ret;
+}
+
 
 /*
   push any pending bytes to/from the serial port. This is called at
@@ -680,11 +728,7 @@ void LinuxUARTDriver::_timer_tick(void)
             _read_fd(&_readbuf[_readbuf_tail], n);
         } else {
             assert(_readbuf_tail+n1 <= _readbuf_size);
-            int ret = _read_fd(&_readbuf[_readbuf_tail], n1);
-            if (ret == n1 && n > n1) {
-                assert(_readbuf_tail+(n-n1) <= _readbuf_size);
-                _read_fd(&_readbuf[_readbuf_tail], n - n1);                
-            }
+            _read_fd_wrap(n1, n - n1);
         }
     }
 
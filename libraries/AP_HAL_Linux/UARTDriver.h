@@ -20,6 +20,8 @@ public:
     int16_t available();
     int16_t txspace();
     int16_t read();
+    uint16_t read_span(const uint8_t *&data);
+    void read_advance(uint16_t n);
 
     /* Linux implementations of Print virtual methods */
     size_t write(uint8_t c);
@@ -29,6 +31,9 @@ public:
 
     virtual void _timer_tick(void);
 
+    // file descriptor the scheduler can poll for incoming data, or -1
+    int _poll_fd(void) const { return _initialised ? _rd_fd : -1; }
+
     enum flow_control get_flow_control(void) { return _flow_control; }
 
 private:
@@ -77,6 +82,9 @@ protected:
 
     virtual int _write_fd(const uint8_t *buf, uint16_t n);
     virtual int _read_fd(uint8_t *buf, uint16_t n);
+    // read into the free space of the read buffer when it wraps, n1
+    // bytes at the tail and n2 at the start
+    virtual int _read_fd_wrap(uint16_t n1, uint16_t n2);
 
 };
 
@@ -0,0 +1,160 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// report I2C bus occupancy and latency for each device, reading a
+// register of each device found one transfer at a time, then from
+// all of them in batches
+//
+
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include "../../I2CDriver.h"
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+// register reads timed for each device and method
+#define NUM_READS 200
+
+static struct {
+    const char *name;
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t len;
+    bool found;
+} device_list[] = {
+    { "HMC5843",  0x1E, 0x0A, 3, false },
+    { "MS5611",   0x77, 0xA2, 2, false },
+    { "MS4525",   0x28, 0x00, 4, false },
+    { "SMBus",    0x0B, 0x09, 3, false },
+};
+
+#define NUM_DEVICES (sizeof(device_list)/sizeof(device_list[0]))
+
+static uint8_t buf[NUM_DEVICES][4];
+
+void setup(void)
+{
+    hal.console->println("I2CBench startup...");
+}
+
+static const char *device_name(uint8_t addr)
+{
+    for (uint8_t i=0; i<NUM_DEVICES; i++) {
+        if (device_list[i].addr == addr) {
+            return device_list[i].name;
+        }
+    }
+    return "unknown";
+}
+
+/*
+  one register read per transfer, as drivers do now
+ */
+static uint32_t bench_single(void)
+{
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t n=0; n<NUM_READS; n++) {
+        for (uint8_t i=0; i<NUM_DEVICES; i++) {
+            if (device_list[i].found) {
+                hal.i2c->readRegisters(device_list[i].addr, device_list[i].reg,
+                                       device_list[i].len, buf[i]);
+            }
+        }
+    }
+    return hal.scheduler->micros() - t0;
+}
+
+/*
+  a register read from each device in one batch
+ */
+static uint32_t bench_batch(void)
+{
+    AP_HAL::I2CDriver::segment segments[NUM_DEVICES*2];
+    uint8_t count = 0;
+    for (uint8_t i=0; i<NUM_DEVICES; i++) {
+        if (!device_list[i].found) {
+            continue;
+        }
+        segments[count].addr = device_list[i].addr;
+        segments[count].read = false;
+        segments[count].len = 1;
+        segments[count].data = &device_list[i].reg;
+        count++;
+        segments[count].addr = device_list[i].addr;
+        segments[count].read = true;
+        segments[count].len = device_list[i].len;
+        segments[count].data = buf[i];
+        count++;
+    }
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t n=0; n<NUM_READS; n++) {
+        hal.i2c->transfer_batch(segments, count);
+    }
+    return hal.scheduler->micros() - t0;
+}
+
+static void report(void)
+{
+    Linux::LinuxI2CDriver *i2c = (Linux::LinuxI2CDriver *)hal.i2c;
+    const Linux::LinuxI2CDriver::BusStats &bs = i2c->bus_stats();
+    uint64_t elapsed = hal.scheduler->micros64() - bs.start_usec;
+    hal.console->printf("bus: %lu transfers %.1f%% busy\n",
+                        (unsigned long)bs.transfers,
+                        elapsed ? bs.busy_usec * 100.0f / elapsed : 0);
+    hal.console->printf("%-8s %4s %9s %6s %8s %8s\n",
+                        "device", "addr", "transfers", "errors", "avg", "max");
+    for (uint8_t i=0; i<LINUX_I2C_STATS_DEVICES; i++) {
+        const Linux::LinuxI2CDriver::DeviceStats &ds = i2c->device_stats(i);
+        if (ds.transfers == 0) {
+            continue;
+        }
+        hal.console->printf("%-8s 0x%02x %9lu %6lu %8.1f %8lu\n",
+                            device_name(ds.addr), (unsigned)ds.addr,
+                            (unsigned long)ds.transfers, (unsigned long)ds.errors,
+                            ds.total_usec / (float)ds.transfers,
+                            (unsigned long)ds.max_usec);
+    }
+}
+
+void loop(void)
+{
+    AP_HAL::Semaphore *i2c_sem = hal.i2c->get_semaphore();
+    if (!i2c_sem->take(1000)) {
+        hal.console->println("Failed to get I2C semaphore");
+        hal.scheduler->delay(5000);
+        return;
+    }
+    uint8_t found = 0;
+    for (uint8_t i=0; i<NUM_DEVICES; i++) {
+        device_list[i].found = hal.i2c->readRegisters(device_list[i].addr, device_list[i].reg,
+                                                      device_list[i].len, buf[i]) == 0;
+        if (device_list[i].found) {
+            found++;
+        }
+    }
+    Linux::LinuxI2CDriver *i2c = (Linux::LinuxI2CDriver *)hal.i2c;
+    i2c->reset_stats();
+    uint32_t single_usec = bench_single();
+    uint32_t batch_usec = bench_batch();
+    i2c_sem->give();
+
+    if (found == 0) {
+        hal.console->println("No devices found");
+    } else {
+        hal.console->printf("%u devices: single %.1f usec/round, batched %.1f usec/round\n",
+                            (unsigned)found,
+                            single_usec / (float)NUM_READS,
+                            batch_usec / (float)NUM_READS);
+        report();
+    }
+    hal.console->println();
+    hal.scheduler->delay(5000);
+}
+
+AP_HAL_MAIN();
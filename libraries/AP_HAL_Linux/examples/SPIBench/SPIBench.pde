@@ -0,0 +1,116 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// report SPI transaction rate and latency for each sensor, reading
+// its ID register one transaction at a time and in batches. Devices
+// without an ID register are given a read with no side effects
+//
+
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+// transactions timed for each device and method
+#define NUM_TRANSACTIONS 1000
+
+// transactions in each batch
+#define BATCH_SIZE 8
+
+void setup(void)
+{
+    hal.console->println("SPIBench startup...");
+}
+
+static struct {
+    const char *name;
+    enum AP_HAL::SPIDevice dev;
+    uint8_t whoami_reg;
+} whoami_list[] = {
+    // PROM read of the first calibration coefficient
+    { "MS5611",     AP_HAL::SPIDevice_MS5611,     0xA2 },
+    { "MPU9250",    AP_HAL::SPIDevice_MPU9250,    0x75 | 0x80 },
+    { "MPU6000",    AP_HAL::SPIDevice_MPU6000,    0x75 | 0x80 },
+    // RDSR, read status register
+    { "FRAM",       AP_HAL::SPIDevice_Dataflash,  0x05 },
+    { "LSM9DS0_AM", AP_HAL::SPIDevice_LSM9DS0_AM, 0x0F | 0x80 },
+    { "LSM9DS0_G",  AP_HAL::SPIDevice_LSM9DS0_G,  0x0F | 0x80 },
+};
+
+static void report(const char *name, const char *method, uint32_t usec)
+{
+    hal.console->printf("%-10s %-8s %8lu transactions/sec %7.2f usec/transaction\n",
+                        name, method,
+                        (unsigned long)(usec ? NUM_TRANSACTIONS * 1.0e6f / usec : 0),
+                        usec / (float)NUM_TRANSACTIONS);
+}
+
+/*
+  one two byte register read per transaction, as drivers do now
+ */
+static uint32_t bench_single(AP_HAL::SPIDeviceDriver *spi, uint8_t reg)
+{
+    uint8_t tx[2] = { reg, 0 };
+    uint8_t rx[2];
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_TRANSACTIONS; i++) {
+        spi->transaction(tx, rx, 2);
+    }
+    return hal.scheduler->micros() - t0;
+}
+
+/*
+  register reads in batches, each the register address then the read
+  as two segments
+ */
+static uint32_t bench_batch(AP_HAL::SPIDeviceDriver *spi, uint8_t reg)
+{
+    uint8_t rx[BATCH_SIZE];
+    AP_HAL::SPIDeviceDriver::segment segments[BATCH_SIZE*2];
+    for (uint8_t i=0; i<BATCH_SIZE; i++) {
+        segments[2*i].tx = &reg;
+        segments[2*i].rx = NULL;
+        segments[2*i].len = 1;
+        segments[2*i].cs_hold = true;
+        segments[2*i+1].tx = NULL;
+        segments[2*i+1].rx = &rx[i];
+        segments[2*i+1].len = 1;
+        segments[2*i+1].cs_hold = false;
+    }
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_TRANSACTIONS; i+=BATCH_SIZE) {
+        spi->transaction_batch(segments, BATCH_SIZE*2);
+    }
+    return hal.scheduler->micros() - t0;
+}
+
+void loop(void)
+{
+    for (uint8_t i=0; i<sizeof(whoami_list)/sizeof(whoami_list[0]); i++) {
+        AP_HAL::SPIDeviceDriver *spi = hal.spi->device(whoami_list[i].dev);
+        if (spi == NULL) {
+            continue;
+        }
+        AP_HAL::Semaphore *spi_sem = spi->get_semaphore();
+        if (!spi_sem->take(1000)) {
+            hal.console->printf("Failed to get SPI semaphore for %s\n", whoami_list[i].name);
+            continue;
+        }
+        uint32_t single_usec = bench_single(spi, whoami_list[i].whoami_reg);
+        uint32_t batch_usec = bench_batch(spi, whoami_list[i].whoami_reg);
+        spi_sem->give();
+
+        report(whoami_list[i].name, "single", single_usec);
+        report(whoami_list[i].name, "batched", batch_usec);
+    }
+    hal.console->println();
+    hal.scheduler->delay(5000);
+}
+
+AP_HAL_MAIN();
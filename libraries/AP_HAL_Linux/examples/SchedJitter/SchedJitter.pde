@@ -0,0 +1,54 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// report wakeup jitter of the Linux scheduler threads
+//
+
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include "../../Scheduler.h"
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+static const char *thread_names[Linux::LinuxScheduler::JITTER_NUM_THREADS] = {
+    "timer", "uart", "rcin", "tonealarm", "io"
+};
+
+void setup(void)
+{
+    hal.console->println("SchedJitter startup...");
+}
+
+void loop(void)
+{
+    Linux::LinuxScheduler *sched = (Linux::LinuxScheduler *)hal.scheduler;
+
+    hal.scheduler->delay(5000);
+
+    hal.console->printf("%-10s %7s %7s %6s %6s %6s  <10 <50 <100 <500 <1000 >=1000 usec\n",
+                        "thread", "wakeups", "events", "resync", "avg", "max");
+    for (uint8_t t=0; t<Linux::LinuxScheduler::JITTER_NUM_THREADS; t++) {
+        const Linux::LinuxScheduler::JitterStats &js =
+            sched->jitter_stats((enum Linux::LinuxScheduler::jitter_thread)t);
+        hal.console->printf("%-10s %7u %7u %6u %6u %6u ",
+                            thread_names[t],
+                            (unsigned)js.wakeups,
+                            (unsigned)js.event_wakeups,
+                            (unsigned)js.resyncs,
+                            (unsigned)(js.wakeups ? js.total_usec / js.wakeups : 0),
+                            (unsigned)js.max_usec);
+        for (uint8_t b=0; b<LINUX_SCHEDULER_JITTER_BINS; b++) {
+            hal.console->printf(" %u", (unsigned)js.hist[b]);
+        }
+        hal.console->println();
+    }
+    sched->reset_jitter_stats();
+}
+
+AP_HAL_MAIN();
@@ -287,6 +287,32 @@ int16_t PX4UARTDriver::read()
 	return c;
 }
 
+/*
+  return the received bytes that are contiguous in the read buffer,
+  without consuming them
+ */
+uint16_t PX4UARTDriver::read_span(const uint8_t *&data)
+{
+    if (_uart_owner_pid != getpid() || !_initialised || _readbuf == NULL) {
+        return 0;
+    }
+    uint16_t head = _readbuf_head;
+    uint16_t tail = _readbuf_tail;
+    data = &_readbuf[head];
+    if (tail >= head) {
+        return tail - head;
+    }
+    return _readbuf_size - head;
+}
+
+/*
+  consume bytes returned by read_span()
+ */
+void PX4UARTDriver::read_advance(uint16_t n)
+{
+    BUF_ADVANCEHEAD(_readbuf, n);
+}
+
 /* 
    write one byte to the buffer
  */
@@ -69,7 +69,20 @@ void SITL_State::_sitl_setup(void)
     inet_pton(AF_INET, _fdm_address, &_rcout_addr.sin_addr);
 
 #ifndef HIL_MODE
+    // the UDP input is kept in lockstep for RC input, as given by
+    // MAVProxy with --sitl
     _setup_fdm();
+    if (_lockstep) {
+        // the model is stepped directly
+        if (_swarm_path != NULL) {
+            _swarm = new SwarmLink();
+            if (!_swarm->attach(_swarm_path, _instance)) {
+                fprintf(stderr, "Unable to join swarm %s as vehicle %u\n",
+                        _swarm_path, (unsigned)_instance);
+                exit(1);
+            }
+        }
+    }
 #endif
     fprintf(stdout, "Starting SITL input\n");
 
@@ -147,6 +160,8 @@ void SITL_State::_fdm_input_step(void)
 
     if (sitl_model != NULL) {
         _fdm_input_local();
+    } else if (_swarm != NULL) {
+        _fdm_input_swarm();
     } else {
         tv.tv_sec = 1;
         tv.tv_usec = 0;
@@ -163,8 +178,10 @@ void SITL_State::_fdm_input_step(void)
         _fdm_input();
     }
 
-    /* make sure we die if our parent dies */
-    if (kill(_parent_pid, 0) != 0) {
+    /* make sure we die if our parent dies. In lockstep there is no
+       need to check on every step */
+    if ((!_lockstep || (_update_count % 1000) == 0) &&
+        kill(_parent_pid, 0) != 0) {
         exit(1);
     }
 
@@ -217,9 +234,9 @@ void SITL_State::wait_clock(uint64_t wait_time_usec)
 
 #ifndef HIL_MODE
 /*
-  check for a SITL FDM packet
+  check for a SITL FDM packet, returning true if a packet was read
  */
-void SITL_State::_fdm_input(void)
+bool SITL_State::_fdm_input(void)
 {
     ssize_t size;
     struct pwm_packet {
@@ -239,7 +256,7 @@ void SITL_State::_fdm_input(void)
 
         if (d.fg_pkt.magic != 0x4c56414f) {
             fprintf(stdout, "Bad FDM packet - magic=0x%08x\n", d.fg_pkt.magic);
-            return;
+            return true;
         }
 
         hal.scheduler->stop_clock(d.fg_pkt.timestamp_us);
@@ -250,7 +267,7 @@ void SITL_State::_fdm_input(void)
                 d.fg_pkt.longitude == 0 ||
                 d.fg_pkt.altitude <= 0) {
             // garbage input
-            return;
+            return true;
         }
 
         if (_sitl != NULL) {
@@ -290,6 +307,7 @@ void SITL_State::_fdm_input(void)
         // send RC output to flight sim
         _simulator_output(_synthetic_clock_mode);
     }
+    return size > 0;
 }
 
 
@@ -300,8 +318,9 @@ void SITL_State::_fdm_input_local(void)
 {
     Aircraft::sitl_input input;
 
-    // check for direct RC input
-    _fdm_input();
+    // check for direct RC input, taking everything that has arrived
+    // as nothing waits on the socket
+    while (_fdm_input()) {}
 
     // construct servos structure for FDM
     _simulator_servos(input);
@@ -318,6 +337,29 @@ void SITL_State::_fdm_input_local(void)
     _synthetic_clock_mode = true;
     _update_count++;
 }
+
+/*
+  get FDM input from the swarm physics process
+ */
+void SITL_State::_fdm_input_swarm(void)
+{
+    Aircraft::sitl_input input;
+
+    // check for direct RC input
+    while (_fdm_input()) {}
+
+    _simulator_servos(input);
+
+    if (!_swarm->exchange(input, _sitl->state)) {
+        fprintf(stderr, "Lost contact with swarm physics\n");
+        exit(1);
+    }
+
+    hal.scheduler->stop_clock(_sitl->state.timestamp_us);
+
+    _synthetic_clock_mode = true;
+    _update_count++;
+}
 #endif
 
 /*
@@ -476,9 +518,27 @@ void SITL_State::_simulator_output(bool synthetic_clock_mode)
         control.speed = 0;
     }
 
+    if (_sitl_fd == -1) {
+        return;
+    }
     sendto(_sitl_fd, (void*)&control, sizeof(control), MSG_DONTWAIT, (const sockaddr *)&_rcout_addr, sizeof(_rcout_addr));
 }
 
+/*
+  return the time of day seen by simulated sensors. In lockstep mode
+  this follows the simulation clock from a fixed starting point
+ */
+void SITL_State::_gps_timeval(struct timeval &tv) const
+{
+    if (!_lockstep) {
+        gettimeofday(&tv, NULL);
+        return;
+    }
+    uint64_t now = hal.scheduler->micros64();
+    tv.tv_sec = SITL_LOCKSTEP_EPOCH + now / 1000000ULL;
+    tv.tv_usec = now % 1000000ULL;
+}
+
 // generate a random float between -1 and 1
 float SITL_State::_rand_float(void)
 {
@@ -15,6 +15,7 @@
 #include <netinet/in.h>
 #include <netinet/udp.h>
 #include <arpa/inet.h>
+#include <sys/time.h>
 
 #include "../AP_Baro/AP_Baro.h"
 #include "../AP_InertialSensor/AP_InertialSensor.h"
@@ -23,9 +24,17 @@
 #include "../AP_Terrain/AP_Terrain.h"
 #include "../SITL/SITL.h"
 #include "../SITL/SIM_Multicopter.h"
+#include "../SITL/SIM_Swarm.h"
 
 class HAL_SITL;
 
+// distance between vehicles on the starting grid of a swarm, meters
+#define SITL_SWARM_SPACING 10
+
+// in lockstep mode simulated sensors see the time of day start at
+// this fixed point (2015-01-01 00:00:00 UTC), so runs are repeatable
+#define SITL_LOCKSTEP_EPOCH 1420070400
+
 class HALSITL::SITL_State {
     friend class HALSITL::SITLScheduler;
 public:
@@ -106,8 +115,11 @@ private:
                      double rollRate, 	double pitchRate,double yawRate,	// Local to plane
                      double xAccel, 	double yAccel, 	double zAccel,		// Local to plane
                      float airspeed,	float altitude);
-    void _fdm_input(void);
+    bool _fdm_input(void);
     void _fdm_input_local(void);
+    void _fdm_input_swarm(void);
+    void _swarm_physics(const char *home_str, const char *model_str,
+                        uint16_t num_vehicles, float speedup);
     void _simulator_servos(Aircraft::sitl_input &input);
     void _simulator_output(bool synthetic_clock_mode);
     void _apply_servo_filter(float deltat);
@@ -117,6 +129,7 @@ private:
     float _rand_float(void);
     Vector3f _rand_vec3f(void);
     void _fdm_input_step(void);
+    void _gps_timeval(struct timeval &tv) const;
 
     void wait_clock(uint64_t wait_time_usec);
 
@@ -148,6 +161,9 @@ private:
 
     bool _synthetic_clock_mode;
 
+    // lockstep with a built-in model: no waiting for FDM packets and no sleeping
+    bool _lockstep;
+
     const char *_fdm_address;
 
     // delay buffer variables
@@ -191,6 +207,10 @@ private:
     // internal SITL model
     Aircraft *sitl_model;
 
+    // link to a swarm physics process, if this vehicle is in a swarm
+    SwarmLink *_swarm;
+    const char *_swarm_path;
+
     // TCP address to connect uartC to
     const char *_client_address;
 };
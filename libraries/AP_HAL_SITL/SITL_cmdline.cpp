@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <signal.h>
 #include <unistd.h>
+#include <math.h>
+#include <sys/time.h>
 #include <utility/getopt_cpp.h>
 
 #include <SIM_Multicopter.h>
@@ -18,6 +20,7 @@
 #include <SIM_Rover.h>
 #include <SIM_CRRCSim.h>
 #include <SIM_JSBSim.h>
+#include <SIM_Swarm.h>
 
 extern const AP_HAL::HAL& hal;
 
@@ -40,23 +43,28 @@ void SITL_State::_usage(void)
            "\t--console          use console instead of TCP ports\n"
            "\t--instance N       set instance of SITL (adds 10*instance to all port numbers)\n"
            "\t--speedup SPEEDUP  set simulation speedup\n"
+           "\t--lockstep         run a built-in model in lockstep, as fast as possible\n"
+           "\t--seed SEED        seed the simulated sensor noise\n"
+           "\t--swarm FILE       join the swarm in FILE as vehicle --instance\n"
+           "\t--swarm-physics N  run the physics of a swarm of N vehicles in FILE\n"
         );
 }
 
 static const struct {
     const char *name;
     Aircraft *(*constructor)(const char *home_str, const char *frame_str);
+    bool external; // the FDM runs in another process
 } model_constructors[] = {
-    { "+",         MultiCopter::create },
-    { "quad",      MultiCopter::create },
-    { "copter",    MultiCopter::create },
-    { "x",         MultiCopter::create },
-    { "hexa",      MultiCopter::create },
-    { "octa",      MultiCopter::create },
-    { "heli",      Helicopter::create },
-    { "rover",     Rover::create },
-    { "crrcsim",   CRRCSim::create },
-    { "jsbsim",    JSBSim::create }
+    { "+",         MultiCopter::create, false },
+    { "quad",      MultiCopter::create, false },
+    { "copter",    MultiCopter::create, false },
+    { "x",         MultiCopter::create, false },
+    { "hexa",      MultiCopter::create, false },
+    { "octa",      MultiCopter::create, false },
+    { "heli",      Helicopter::create,  false },
+    { "rover",     Rover::create,       false },
+    { "crrcsim",   CRRCSim::create,     true },
+    { "jsbsim",    JSBSim::create,      true }
 };
 
 void SITL_State::_parse_command_line(int argc, char * const argv[])
@@ -65,6 +73,7 @@ void SITL_State::_parse_command_line(int argc, char * const argv[])
     const char *home_str = NULL;
     const char *model_str = NULL;
     float speedup = 1.0f;
+    uint16_t swarm_vehicles = 0;
 
     signal(SIGFPE, _sig_fpe);
     // No-op SIGPIPE handler
@@ -74,15 +83,22 @@ void SITL_State::_parse_command_line(int argc, char * const argv[])
     setvbuf(stderr, (char *)0, _IONBF, 0);
 
     _synthetic_clock_mode = false;
+    _lockstep = false;
     _base_port = 5760;
     _rcout_port = 5502;
     _simin_port = 5501;
     _fdm_address = "127.0.0.1";
     _client_address = NULL;
     _instance = 0;
+    _swarm = NULL;
+    _swarm_path = NULL;
 
     enum long_options {
-        CMDLINE_CLIENT=0
+        CMDLINE_CLIENT=0,
+        CMDLINE_LOCKSTEP,
+        CMDLINE_SEED,
+        CMDLINE_SWARM,
+        CMDLINE_SWARM_PHYSICS
     };
 
     const struct GetOptLong::option options[] = {
@@ -97,6 +113,10 @@ void SITL_State::_parse_command_line(int argc, char * const argv[])
         {"home",            true,   0, 'O'},
         {"model",           true,   0, 'M'},
         {"client",          true,   0, CMDLINE_CLIENT},
+        {"lockstep",        false,  0, CMDLINE_LOCKSTEP},
+        {"seed",            true,   0, CMDLINE_SEED},
+        {"swarm",           true,   0, CMDLINE_SWARM},
+        {"swarm-physics",   true,   0, CMDLINE_SWARM_PHYSICS},
         {0, false, 0, 0}
     };
 
@@ -143,25 +163,68 @@ void SITL_State::_parse_command_line(int argc, char * const argv[])
         case CMDLINE_CLIENT:
             _client_address = gopt.optarg;
             break;
+        case CMDLINE_LOCKSTEP:
+            _lockstep = true;
+            break;
+        case CMDLINE_SEED:
+            // both the sensor noise and the model noise
+            srandom(strtoul(gopt.optarg, NULL, 0));
+            srand(strtoul(gopt.optarg, NULL, 0));
+            break;
+        case CMDLINE_SWARM:
+            _swarm_path = gopt.optarg;
+            break;
+        case CMDLINE_SWARM_PHYSICS:
+            swarm_vehicles = atoi(gopt.optarg);
+            break;
         default:
             _usage();
             exit(1);
         }
     }
 
-    if (model_str && home_str) {
+    if (swarm_vehicles != 0) {
+        if (_swarm_path == NULL || model_str == NULL || home_str == NULL) {
+            fprintf(stderr, "--swarm-physics needs --swarm, --model and --home\n");
+            exit(1);
+        }
+        _swarm_physics(home_str, model_str, swarm_vehicles, _lockstep ? 0 : speedup);
+        exit(0);
+    }
+
+    if (_swarm_path != NULL) {
+        // the physics process owns the model, the vehicle just
+        // steps with it
+        _lockstep = true;
+        _synthetic_clock_mode = true;
+        printf("Joining swarm %s as vehicle %u\n", _swarm_path, (unsigned)_instance);
+    } else if (model_str && home_str) {
         for (uint8_t i=0; i<sizeof(model_constructors)/sizeof(model_constructors[0]); i++) {
             if (strncmp(model_constructors[i].name, model_str, strlen(model_constructors[i].name)) == 0) {
+                if (_lockstep && model_constructors[i].external) {
+                    fprintf(stderr, "Model %s can't run in lockstep\n", model_str);
+                    exit(1);
+                }
                 sitl_model = model_constructors[i].constructor(home_str, model_str);
                 sitl_model->set_speedup(speedup);
                 sitl_model->set_instance(_instance);
+                sitl_model->set_lockstep(_lockstep);
                 _synthetic_clock_mode = true;
-                printf("Started model %s at %s at speed %.1f\n", model_str, home_str, speedup);
+                if (_lockstep) {
+                    printf("Started model %s at %s in lockstep\n", model_str, home_str);
+                } else {
+                    printf("Started model %s at %s at speed %.1f\n", model_str, home_str, speedup);
+                }
                 break;
             }
         }
     }
 
+    if (_lockstep && sitl_model == NULL && _swarm_path == NULL) {
+        fprintf(stderr, "--lockstep needs a built-in --model and --home\n");
+        exit(1);
+    }
+
     fprintf(stdout, "Starting sketch '%s'\n", SKETCH);
 
     if (strcmp(SKETCH, "ArduCopter") == 0) {
@@ -186,4 +249,100 @@ void SITL_State::_parse_command_line(int argc, char * const argv[])
     _sitl_setup();
 }
 
+static uint64_t wall_time_us(void)
+{
+    struct timeval tp;
+    gettimeofday(&tp, NULL);
+    return tp.tv_sec*1000000ULL + tp.tv_usec;
+}
+
+/*
+  run the physics of a swarm of vehicles, started on a grid around
+  home. The models are stepped in lockstep with the autopilots, and
+  paced to speedup times real time, or as fast as the slowest
+  autopilot allows if speedup is zero. Never returns
+ */
+void SITL_State::_swarm_physics(const char *home_str, const char *model_str,
+                                uint16_t num_vehicles, float speedup)
+{
+    uint8_t m;
+    for (m=0; m<sizeof(model_constructors)/sizeof(model_constructors[0]); m++) {
+        if (strncmp(model_constructors[m].name, model_str, strlen(model_constructors[m].name)) == 0) {
+            break;
+        }
+    }
+    if (m == sizeof(model_constructors)/sizeof(model_constructors[0]) ||
+        model_constructors[m].external) {
+        fprintf(stderr, "Model %s can't run in a swarm\n", model_str);
+        exit(1);
+    }
+
+    double lat, lng;
+    float alt, yaw;
+    if (sscanf(home_str, "%lf,%lf,%f,%f", &lat, &lng, &alt, &yaw) != 4) {
+        fprintf(stderr, "Bad home %s\n", home_str);
+        exit(1);
+    }
+
+    // rover throttle is centred, to allow for reverse
+    uint16_t idle_pwm = strcmp(model_str, "rover") == 0 ? 1500 : 1000;
+
+    SwarmLink swarm;
+    if (!swarm.create(_swarm_path, num_vehicles, idle_pwm)) {
+        fprintf(stderr, "Unable to create swarm of %u in %s\n",
+                (unsigned)num_vehicles, _swarm_path);
+        exit(1);
+    }
+
+    Aircraft **models = new Aircraft*[num_vehicles];
+    uint16_t cols = ceilf(sqrtf(num_vehicles));
+    for (uint16_t i=0; i<num_vehicles; i++) {
+        Location loc;
+        memset(&loc, 0, sizeof(loc));
+        loc.lat = lat * 1.0e7;
+        loc.lng = lng * 1.0e7;
+        location_offset(loc, (i / cols) * SITL_SWARM_SPACING, (i % cols) * SITL_SWARM_SPACING);
+        char home[80];
+        snprintf(home, sizeof(home), "%.7f,%.7f,%.2f,%.1f",
+                 loc.lat*1.0e-7, loc.lng*1.0e-7, alt, yaw);
+        models[i] = model_constructors[m].constructor(home, model_str);
+        models[i]->set_instance(i);
+        models[i]->set_lockstep(true);
+    }
+    printf("Started swarm of %u %s in %s\n", (unsigned)num_vehicles, model_str, _swarm_path);
+
+    struct sitl_fdm fdm;
+    uint64_t start_us = 0;
+    uint64_t start_wall_us = wall_time_us();
+    uint64_t last_report_us = 0;
+    uint32_t steps = 0;
+    while (true) {
+        uint16_t attached = swarm.step(models);
+        steps++;
+
+        models[0]->fill_fdm(fdm);
+        if (start_us == 0) {
+            start_us = fdm.timestamp_us;
+            last_report_us = start_us;
+        }
+        uint64_t sim_us = fdm.timestamp_us - start_us;
+
+        if (speedup > 0) {
+            uint64_t target_wall_us = start_wall_us + sim_us / speedup;
+            uint64_t now = wall_time_us();
+            if (target_wall_us > now) {
+                usleep(target_wall_us - now);
+            }
+        }
+
+        if (fdm.timestamp_us - last_report_us >= 10000000UL) {
+            float wall_s = (wall_time_us() - start_wall_us) * 1.0e-6f;
+            printf("Swarm t=%.0fs attached=%u min_separation=%.1fm rate=%.0f steps/s\n",
+                   sim_us * 1.0e-6f, (unsigned)attached, swarm.min_separation(),
+                   wall_s > 0 ? steps / wall_s : 0);
+            last_report_us = fdm.timestamp_us;
+        }
+    }
+}
+
 #endif
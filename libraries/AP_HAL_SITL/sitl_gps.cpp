@@ -148,10 +148,8 @@ void SITL_State::_gps_send_ubx(uint8_t msgid, uint8_t *buf, uint16_t size)
 /*
   return GPS time of week in milliseconds
  */
-static void gps_time(uint16_t *time_week, uint32_t *time_week_ms)
+static void gps_time(const struct timeval &tv, uint16_t *time_week, uint32_t *time_week_ms)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
     const uint32_t epoch = 86400*(10*365 + (1980-1969)/4 + 1 + 6 - 2) - 15;
     uint32_t epoch_seconds = tv.tv_sec - epoch;
     *time_week = epoch_seconds / (86400*7UL);
@@ -218,7 +216,9 @@ void SITL_State::_update_gps_ubx(const struct gps_data *d)
     uint16_t time_week;
     uint32_t time_week_ms;
 
-    gps_time(&time_week, &time_week_ms);
+    struct timeval tv;
+    _gps_timeval(tv);
+    gps_time(tv, &time_week, &time_week_ms);
 
     pos.time = time_week_ms;
     pos.longitude = d->longitude * 1.0e7;
@@ -327,7 +327,7 @@ void SITL_State::_update_gps_mtk(const struct gps_data *d)
     struct tm tm;
     struct timeval tv;
 
-    gettimeofday(&tv, NULL);
+    _gps_timeval(tv);
     tm = *gmtime(&tv.tv_sec);
     uint32_t hsec = (tv.tv_usec / (10000*20)) * 20; // always multiple of 20
 
@@ -384,7 +384,7 @@ void SITL_State::_update_gps_mtk16(const struct gps_data *d)
     struct tm tm;
     struct timeval tv;
 
-    gettimeofday(&tv, NULL);
+    _gps_timeval(tv);
     tm = *gmtime(&tv.tv_sec);
     uint32_t millisec = (tv.tv_usec / (1000*200)) * 200; // always multiple of 200
 
@@ -442,7 +442,7 @@ void SITL_State::_update_gps_mtk19(const struct gps_data *d)
     struct tm tm;
     struct timeval tv;
 
-    gettimeofday(&tv, NULL);
+    _gps_timeval(tv);
     tm = *gmtime(&tv.tv_sec);
     uint32_t millisec = (tv.tv_usec / (1000*200)) * 200; // always multiple of 200
 
@@ -503,7 +503,7 @@ void SITL_State::_update_gps_nmea(const struct gps_data *d)
     char lat_string[20];
     char lng_string[20];
 
-    gettimeofday(&tv, NULL);
+    _gps_timeval(tv);
 
     tm = gmtime(&tv.tv_sec);
 
@@ -620,7 +620,9 @@ void SITL_State::_update_gps_sbp(const struct gps_data *d)
     uint16_t time_week;
     uint32_t time_week_ms;
 
-    gps_time(&time_week, &time_week_ms);
+    struct timeval tv;
+    _gps_timeval(tv);
+    gps_time(tv, &time_week, &time_week_ms);
 
     t.wn = time_week;
     t.tow = time_week_ms;
@@ -282,6 +282,32 @@ int16_t VRBRAINUARTDriver::read()
 	return c;
 }
 
+/*
+  return the received bytes that are contiguous in the read buffer,
+  without consuming them
+ */
+uint16_t VRBRAINUARTDriver::read_span(const uint8_t *&data)
+{
+    if (!_initialised || _readbuf == NULL) {
+        return 0;
+    }
+    uint16_t head = _readbuf_head;
+    uint16_t tail = _readbuf_tail;
+    data = &_readbuf[head];
+    if (tail >= head) {
+        return tail - head;
+    }
+    return _readbuf_size - head;
+}
+
+/*
+  consume bytes returned by read_span()
+ */
+void VRBRAINUARTDriver::read_advance(uint16_t n)
+{
+    BUF_ADVANCEHEAD(_readbuf, n);
+}
+
 /* 
    write one byte to the buffer
  */
@@ -21,6 +21,8 @@ public:
     int16_t available();
     int16_t txspace();
     int16_t read();
+    uint16_t read_span(const uint8_t *&data);
+    void read_advance(uint16_t n);
 
     /* VRBRAIN implementations of Print virtual methods */
     size_t write(uint8_t c);
@@ -326,6 +326,7 @@ private:
     DataFlash_Class *_dataflash;
 };
 
+#include "AP_InertialSensor_SampleChannel.h"
 #include "AP_InertialSensor_Backend.h"
 #include "AP_InertialSensor_MPU6000.h"
 #include "AP_InertialSensor_PX4.h"
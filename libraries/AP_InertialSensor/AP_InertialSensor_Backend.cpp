@@ -78,6 +78,31 @@ void AP_InertialSensor_Backend::_publish_accel(uint8_t instance, const Vector3f
     }
 }
 
+/*
+  publish the latest sample from a sample channel snapshot. The sums
+  are corrected as an average rate then integrated over the time they
+  cover, so the delta angle and velocity include every sample taken by
+  the timer process, not just the latest one
+ */
+void AP_InertialSensor_Backend::_publish_samples(uint8_t gyro_instance, uint8_t accel_instance,
+                                                 const AP_InertialSensor_SampleChannel::Sample &s)
+{
+    _publish_gyro(gyro_instance, s.gyro);
+    _publish_accel(accel_instance, s.accel);
+
+    if (s.count == 0 || s.dt <= 0) {
+        return;
+    }
+
+    Vector3f gyro = s.gyro_sum / s.count;
+    _rotate_and_correct_gyro(gyro_instance, gyro);
+    _publish_delta_angle(gyro_instance, gyro * s.dt);
+
+    Vector3f accel = s.accel_sum / s.count;
+    _rotate_and_correct_accel(accel_instance, accel);
+    _publish_delta_velocity(accel_instance, accel * s.dt, s.dt);
+}
+
 // set accelerometer error_count
 void AP_InertialSensor_Backend::_set_accel_error_count(uint8_t instance, uint32_t error_count)
 {
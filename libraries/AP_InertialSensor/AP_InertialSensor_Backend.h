@@ -73,6 +73,12 @@ protected:
     // rotate accel vector, scale, offset and publish
     void _publish_accel(uint8_t instance, const Vector3f &accel, bool rotate_and_correct = true);
 
+    // publish gyro and accel from a sample channel snapshot, plus the
+    // delta angle and delta velocity over the samples it covers. The
+    // snapshot must already be scaled and rotated to board frame
+    void _publish_samples(uint8_t gyro_instance, uint8_t accel_instance,
+                          const AP_InertialSensor_SampleChannel::Sample &s);
+
     // publish a temperature value
     void _publish_temperature(uint8_t instance, float temperature);
 
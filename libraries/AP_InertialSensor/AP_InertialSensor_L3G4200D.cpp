@@ -114,19 +114,11 @@ const extern AP_HAL::HAL& hal;
 // constructor
 AP_InertialSensor_L3G4200D::AP_InertialSensor_L3G4200D(AP_InertialSensor &imu) :
     AP_InertialSensor_Backend(imu),
-    _data_idx(0),
     _have_gyro_sample(false),
     _have_accel_sample(false),
-    _have_sample(false),
     _accel_filter(800, 10),
     _gyro_filter(800, 10)
 {
-    pthread_spin_init(&_data_lock, PTHREAD_PROCESS_PRIVATE);
-}
-
-AP_InertialSensor_L3G4200D::~AP_InertialSensor_L3G4200D()
-{
-    pthread_spin_destroy(&_data_lock);
 }
 
 bool AP_InertialSensor_L3G4200D::_init_sensor(void) 
@@ -245,22 +237,12 @@ void AP_InertialSensor_L3G4200D::_set_filter_frequency(uint8_t filter_hz)
  */
 bool AP_InertialSensor_L3G4200D::update(void) 
 {
-    Vector3f accel, gyro;
-
-    pthread_spin_lock(&_data_lock);
-    unsigned int idx = !_data_idx;
-    accel = _data[idx].accel_filtered;
-    gyro = _data[idx].gyro_filtered;
-    _have_sample = false;
-    pthread_spin_unlock(&_data_lock);
-
-    // Adjust for chip scaling to get m/s/s
-    accel *= ADXL345_ACCELEROMETER_SCALE_M_S;
-    _publish_accel(_accel_instance, accel);
+    AP_InertialSensor_SampleChannel::Sample s;
+    _samples.take(s);
 
-    // Adjust for chip scaling to get radians/sec
-    gyro *= L3G4200D_GYRO_SCALE_R_S;
-    _publish_gyro(_gyro_instance, gyro);
+    // Adjust for chip scaling to get radians/sec and m/s/s
+    s.scale(L3G4200D_GYRO_SCALE_R_S, ADXL345_ACCELEROMETER_SCALE_M_S);
+    _publish_samples(_gyro_instance, _accel_instance, s);
 
     if (_last_filter_hz != _accel_filter_cutoff()) {
         _set_filter_frequency(_accel_filter_cutoff());
@@ -305,7 +287,7 @@ void AP_InertialSensor_L3G4200D::_accumulate(void)
         if (hal.i2c->readRegisters(L3G4200D_I2C_ADDRESS, L3G4200D_REG_XL | L3G4200D_REG_AUTO_INCREMENT, 
                                    sizeof(buffer), (uint8_t *)&buffer[0][0]) == 0) {
             for (uint8_t i=0; i<num_samples_available; i++) {
-                _data[_data_idx].gyro_filtered = _gyro_filter.apply(Vector3f(buffer[i][0], -buffer[i][1], -buffer[i][2]));
+                _gyro_filtered = _gyro_filter.apply(Vector3f(buffer[i][0], -buffer[i][1], -buffer[i][2]));
                 _have_gyro_sample = true;
             }
         }
@@ -325,7 +307,7 @@ void AP_InertialSensor_L3G4200D::_accumulate(void)
                                            sizeof(buffer[0]), num_samples_available,
                                            (uint8_t *)&buffer[0][0]) == 0) {
             for (uint8_t i=0; i<num_samples_available; i++) {
-                _data[_data_idx].accel_filtered = _accel_filter.apply(Vector3f(buffer[i][0], -buffer[i][1], -buffer[i][2]));
+                _accel_filtered = _accel_filter.apply(Vector3f(buffer[i][0], -buffer[i][1], -buffer[i][2]));
                 _have_accel_sample = true;
             }
         }
@@ -338,10 +320,7 @@ void AP_InertialSensor_L3G4200D::_accumulate(void)
         _have_gyro_sample = false;
         _have_accel_sample = false;
 
-        pthread_spin_lock(&_data_lock);
-        _data_idx = !_data_idx;
-        _have_sample = true;
-        pthread_spin_unlock(&_data_lock);
+        _samples.push(_gyro_filtered, _accel_filtered, hal.scheduler->micros());
     }
 }
 
@@ -6,8 +6,6 @@
 #include <AP_HAL.h>
 #if CONFIG_HAL_BOARD == HAL_BOARD_LINUX
 
-#include <pthread.h>
-
 #include "AP_InertialSensor.h"
 #include <Filter.h>
 #include <LowPassFilter2p.h>
@@ -17,13 +15,12 @@ class AP_InertialSensor_L3G4200D : public AP_InertialSensor_Backend
 public:
 
     AP_InertialSensor_L3G4200D(AP_InertialSensor &imu);
-    ~AP_InertialSensor_L3G4200D();
 
     /* update accel and gyro state */
     bool update();
 
-    bool gyro_sample_available(void) { return _have_sample; }
-    bool accel_sample_available(void) { return _have_sample; }
+    bool gyro_sample_available(void) { return _samples.available(); }
+    bool accel_sample_available(void) { return _samples.available(); }
 
     // detect the sensor
     static AP_InertialSensor_Backend *detect(AP_InertialSensor &imu);
@@ -35,16 +32,14 @@ private:
     bool            _init_sensor(void);
     void            _accumulate(void);
 
-    struct {
-        Vector3f accel_filtered;
-        Vector3f gyro_filtered;
-    } _data[2];
-    int _data_idx;
-    pthread_spinlock_t _data_lock;
-
+    // latest filtered values, pushed once both have been updated
+    Vector3f _accel_filtered;
+    Vector3f _gyro_filtered;
     bool _have_gyro_sample;
     bool _have_accel_sample;
-    volatile bool _have_sample;
+
+    // filtered samples from the timer thread to update()
+    AP_InertialSensor_SampleChannel _samples;
 
     // support for updating filter at runtime
     uint8_t         _last_filter_hz;
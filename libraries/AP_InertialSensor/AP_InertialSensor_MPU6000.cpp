@@ -39,6 +39,7 @@ extern const AP_HAL::HAL& hal;
 #define MPUREG_ZG_OFFS_USRL                     0x18    // Z axis gyro offset (low byte)
 #define MPUREG_SMPLRT_DIV                               0x19    // sample rate.  Fsample= 1Khz/(<this value>+1) = 200Hz
 #       define MPUREG_SMPLRT_1000HZ                             0x00
+#       define MPUREG_SMPLRT_8000HZ                             0x00    // with the DLPF disabled
 #       define MPUREG_SMPLRT_500HZ                              0x01
 #       define MPUREG_SMPLRT_250HZ                              0x03
 #       define MPUREG_SMPLRT_200HZ                              0x04
@@ -61,6 +62,12 @@ extern const AP_HAL::HAL& hal;
 #define MPUREG_ZRMOT_THR                                0x21    // detection threshold for Zero Motion interrupt generation.
 #define MPUREG_ZRMOT_DUR                                0x22    // duration counter threshold for Zero Motion interrupt generation. The duration counter ticks at 16 Hz, therefore ZRMOT_DUR has a unit of 1 LSB = 64 ms.
 #define MPUREG_FIFO_EN                                  0x23
+// bit definitions for MPUREG_FIFO_EN
+#       define BIT_FIFO_EN_ACCEL                                0x08
+#       define BIT_FIFO_EN_ZG                                   0x10
+#       define BIT_FIFO_EN_YG                                   0x20
+#       define BIT_FIFO_EN_XG                                   0x40
+#       define BIT_FIFO_EN_TEMP                                 0x80
 #define MPUREG_INT_PIN_CFG                              0x37
 #       define BIT_INT_RD_CLEAR                                 0x10    // clear the interrupt when any read occurs
 #       define BIT_LATCH_INT_EN                                 0x20    // latch data ready pin 
@@ -158,6 +165,29 @@ extern const AP_HAL::HAL& hal;
 #define MPU6000_REV_D8                          0x58    // 0101			1000
 #define MPU6000_REV_D9                          0x59    // 0101			1001
 
+// big endian 16 bit value at index idx of a buffer of sample registers
+#define int16_val(v, idx) ((int16_t)(((uint16_t)v[2*idx] << 8) | v[2*idx+1]))
+
+#if MPU6000_FIFO_SAMPLING
+// the gyro is sampled at its full rate of 8kHz. The accel only
+// samples at 1kHz, so each accel sample is repeated in the FIFO
+#define MPU6000_SAMPLE_HZ           8000
+#define MPU6000_SAMPLE_US           125
+
+// FIFO packets hold accel, temperature and gyro in register order
+#define MPU6000_FIFO_SIZE           1024
+#define MPU6000_FIFO_PACKET         14
+
+// most packets read in one SPI transaction
+#define MPU6000_FIFO_BURST          16
+
+// a change in temperature between samples bigger than this (2 degrees
+// C) means we have lost the packet boundaries
+#define MPU6000_FIFO_TEMP_JUMP      680
+#else
+#define MPU6000_SAMPLE_HZ           1000
+#endif
+
 
 /*
  *  RM-MPU-6000A-00.pdf, page 33, section 4.25 lists LSB sensitivity of
@@ -181,15 +211,21 @@ AP_InertialSensor_MPU6000::AP_InertialSensor_MPU6000(AP_InertialSensor &imu) :
     _last_accel_filter_hz(-1),
     _last_gyro_filter_hz(-1),
     _error_count(0),
+#if MPU6000_FIFO_SAMPLING
+    _fifo_last_us(0),
+    _fifo_temp(0),
+    _fifo_temp_valid(false),
+    _fifo_resets(0),
+#endif
 #if MPU6000_FAST_SAMPLING
-    _accel_filter(1000, 15),
-    _gyro_filter(1000, 15),
+    _accel_filter(MPU6000_SAMPLE_HZ, 15),
+    _gyro_filter(MPU6000_SAMPLE_HZ, 15)
 #else
     _sample_count(0),
     _accel_sum(),
     _gyro_sum(),
-#endif
     _sum_count(0)
+#endif
 {
 }
 
@@ -269,51 +305,52 @@ bool AP_InertialSensor_MPU6000::_init_sensor(void)
  */
 bool AP_InertialSensor_MPU6000::update( void )
 {    
-#if !MPU6000_FAST_SAMPLING
+#if MPU6000_FAST_SAMPLING
+    // pull the data from the timer thread
+    AP_InertialSensor_SampleChannel::Sample s;
+    _samples.take(s);
+
+    s.scale(_gyro_scale, MPU6000_ACCEL_SCALE_1G);
+
+#if CONFIG_HAL_BOARD_SUBTYPE == HAL_BOARD_SUBTYPE_LINUX_PXF
+    s.rotate(ROTATION_PITCH_180_YAW_90);
+#endif
+
+    _publish_samples(_gyro_instance, _accel_instance, s);
+#else
     if (_sum_count < _sample_count) {
         // we don't have enough samples yet
         return false;
     }
-#endif
 
     // we have a full set of samples
     uint16_t num_samples;
     Vector3f accel, gyro;
 
     hal.scheduler->suspend_timer_procs();
-#if MPU6000_FAST_SAMPLING
-    gyro = _gyro_filtered;
-    accel = _accel_filtered;
-    num_samples = 1;
-#else
     gyro(_gyro_sum.x, _gyro_sum.y, _gyro_sum.z);
     accel(_accel_sum.x, _accel_sum.y, _accel_sum.z);
     num_samples = _sum_count;
     _accel_sum.zero();
     _gyro_sum.zero();
-#endif
     _sum_count = 0;
     hal.scheduler->resume_timer_procs();
 
     gyro *= _gyro_scale / num_samples;
     accel *= MPU6000_ACCEL_SCALE_1G / num_samples;
 
-#if CONFIG_HAL_BOARD_SUBTYPE == HAL_BOARD_SUBTYPE_LINUX_PXF
-    accel.rotate(ROTATION_PITCH_180_YAW_90);
-    gyro.rotate(ROTATION_PITCH_180_YAW_90);
-#endif
-
     _publish_accel(_accel_instance, accel);
     _publish_gyro(_gyro_instance, gyro);
+#endif
 
 #if MPU6000_FAST_SAMPLING
     if (_last_accel_filter_hz != _accel_filter_cutoff()) {
-        _accel_filter.set_cutoff_frequency(1000, _accel_filter_cutoff());
+        _accel_filter.set_cutoff_frequency(MPU6000_SAMPLE_HZ, _accel_filter_cutoff());
         _last_accel_filter_hz = _accel_filter_cutoff();
     }
 
     if (_last_gyro_filter_hz != _gyro_filter_cutoff()) {
-        _gyro_filter.set_cutoff_frequency(1000, _gyro_filter_cutoff());
+        _gyro_filter.set_cutoff_frequency(MPU6000_SAMPLE_HZ, _gyro_filter_cutoff());
         _last_gyro_filter_hz = _gyro_filter_cutoff();
     }
 #else
@@ -356,12 +393,134 @@ void AP_InertialSensor_MPU6000::_poll_data(void)
     if (!_spi_sem->take_nonblocking()) {
         return;
     }   
+#if MPU6000_FIFO_SAMPLING
+    _read_fifo();
+#else
     if (_data_ready()) {
         _read_data_transaction(); 
     }
+#endif
     _spi_sem->give();
 }
 
+#if MPU6000_FIFO_SAMPLING
+/*
+  empty the FIFO and start filling it with accel, temperature and gyro
+  samples. Assumes caller has taken semaphore
+ */
+void AP_InertialSensor_MPU6000::_fifo_reset(void)
+{
+    // registers can only be written at low speed
+    _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_LOW);
+    _register_write(MPUREG_FIFO_EN, 0);
+    _register_write(MPUREG_USER_CTRL, BIT_USER_CTRL_I2C_IF_DIS | BIT_USER_CTRL_FIFO_RESET);
+    _register_write(MPUREG_USER_CTRL, BIT_USER_CTRL_I2C_IF_DIS | BIT_USER_CTRL_FIFO_EN);
+    _register_write(MPUREG_FIFO_EN, BIT_FIFO_EN_ACCEL | BIT_FIFO_EN_TEMP |
+                    BIT_FIFO_EN_XG | BIT_FIFO_EN_YG | BIT_FIFO_EN_ZG);
+    if (_error_count <= 4) {
+        _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_HIGH);
+    }
+
+    _fifo_last_us = hal.scheduler->micros();
+    _fifo_temp_valid = false;
+}
+
+/*
+  read all the samples buffered in the FIFO, in as few bus
+  transactions as we can. The samples are timestamped from the sample
+  rate rather than the time we read them, so the frontend integrates
+  each one over the period it covers
+ */
+void AP_InertialSensor_MPU6000::_read_fifo(void)
+{
+    uint8_t tx[3] = { MPUREG_FIFO_COUNTH | 0x80, 0, 0 };
+    uint8_t rx[3];
+    _spi->transaction(tx, rx, 3);
+    uint16_t count = ((uint16_t)rx[1] << 8) | rx[2];
+    uint32_t now = hal.scheduler->micros();
+
+    if (count > MPU6000_FIFO_SIZE) {
+        // likely a bad bus transaction
+        if (++_error_count > 4) {
+            _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_LOW);
+        }
+        return;
+    }
+    if (count > MPU6000_FIFO_SIZE - MPU6000_FIFO_PACKET) {
+        // the FIFO overflowed and the oldest samples have been
+        // overwritten, possibly part way through a packet
+        _fifo_resets++;
+        _fifo_reset();
+        return;
+    }
+
+    uint16_t n = count / MPU6000_FIFO_PACKET;
+    if (n == 0) {
+        return;
+    }
+
+    /*
+      the newest sample can't be later than now, and should be less
+      than a timer tick before it. Pull our sample clock back if the
+      sensor runs slower than its nominal rate, nudge it forward if it
+      runs faster, and start again after a long gap
+     */
+    int32_t lag = now - (_fifo_last_us + n * MPU6000_SAMPLE_US);
+    if (lag < 0 || lag > 10000) {
+        _fifo_last_us = now - n * MPU6000_SAMPLE_US;
+    } else {
+        _fifo_last_us += lag / 16;
+    }
+
+    struct PACKED {
+        uint8_t cmd;
+        uint8_t v[MPU6000_FIFO_BURST][MPU6000_FIFO_PACKET];
+    } brx, btx;
+    memset(&btx, 0, sizeof(btx));
+    btx.cmd = MPUREG_FIFO_R_W | 0x80;
+
+    while (n > 0) {
+        uint8_t burst = n < MPU6000_FIFO_BURST ? n : MPU6000_FIFO_BURST;
+        _spi->transaction((const uint8_t *)&btx, (uint8_t *)&brx,
+                          1 + burst * MPU6000_FIFO_PACKET);
+        for (uint8_t i=0; i<burst; i++) {
+            _fifo_last_us += MPU6000_SAMPLE_US;
+            if (!_accumulate_fifo_sample(brx.v[i], _fifo_last_us)) {
+                // the rest of the FIFO is misaligned too
+                _fifo_resets++;
+                _fifo_reset();
+                return;
+            }
+        }
+        n -= burst;
+    }
+}
+
+/*
+  filter one sample from the FIFO and hand it to update(). Returns
+  false if the sample is not aligned to a packet
+ */
+bool AP_InertialSensor_MPU6000::_accumulate_fifo_sample(const uint8_t *v, uint32_t timestamp_us)
+{
+    int16_t temp = int16_val(v, 3);
+    if (_fifo_temp_valid && abs(temp - _fifo_temp) > MPU6000_FIFO_TEMP_JUMP) {
+        return false;
+    }
+    _fifo_temp = temp;
+    _fifo_temp_valid = true;
+
+    Vector3f accel_filtered = _accel_filter.apply(Vector3f(int16_val(v, 1),
+                                                           int16_val(v, 0),
+                                                           -int16_val(v, 2)));
+
+    Vector3f gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(v, 5),
+                                                         int16_val(v, 4),
+                                                         -int16_val(v, 6)));
+    _samples.push(gyro_filtered, accel_filtered, timestamp_us);
+    return true;
+}
+#endif // MPU6000_FIFO_SAMPLING
+
 
 void AP_InertialSensor_MPU6000::_read_data_transaction() {
     /* one resister address followed by seven 2-byte registers */
@@ -389,15 +548,15 @@ void AP_InertialSensor_MPU6000::_read_data_transaction() {
         }
     }
 
-#define int16_val(v, idx) ((int16_t)(((uint16_t)v[2*idx] << 8) | v[2*idx+1]))
 #if MPU6000_FAST_SAMPLING
-    _accel_filtered = _accel_filter.apply(Vector3f(int16_val(rx.v, 1),
-                                                   int16_val(rx.v, 0),
-                                                   -int16_val(rx.v, 2)));
-
-    _gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(rx.v, 5),
-                                                 int16_val(rx.v, 4),
-                                                 -int16_val(rx.v, 6)));
+    Vector3f accel_filtered = _accel_filter.apply(Vector3f(int16_val(rx.v, 1),
+                                                           int16_val(rx.v, 0),
+                                                           -int16_val(rx.v, 2)));
+
+    Vector3f gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(rx.v, 5),
+                                                         int16_val(rx.v, 4),
+                                                         -int16_val(rx.v, 6)));
+    _samples.push(gyro_filtered, accel_filtered, hal.scheduler->micros());
 #else
     _accel_sum.x += int16_val(rx.v, 1);
     _accel_sum.y += int16_val(rx.v, 0);
@@ -405,10 +564,8 @@ void AP_InertialSensor_MPU6000::_read_data_transaction() {
     _gyro_sum.x  += int16_val(rx.v, 5);
     _gyro_sum.y  += int16_val(rx.v, 4);
     _gyro_sum.z  -= int16_val(rx.v, 6);
-#endif
     _sum_count++;
 
-#if !MPU6000_FAST_SAMPLING
     if (_sum_count == 0) {
         // rollover - v unlikely
         _accel_sum.zero();
@@ -553,8 +710,13 @@ bool AP_InertialSensor_MPU6000::_hardware_init(void)
     // disable sensor filtering 
     _set_filter_register(256);
 
+#if MPU6000_FIFO_SAMPLING
+    // sample at the full gyro rate, and apply a software filter
+    _register_write(MPUREG_SMPLRT_DIV, MPUREG_SMPLRT_8000HZ);
+#else
     // set sample rate to 1000Hz and apply a software filter
     _register_write(MPUREG_SMPLRT_DIV, MPUREG_SMPLRT_1000HZ);
+#endif
 #else
     _set_filter_register(_accel_filter_cutoff());
 
@@ -592,6 +754,10 @@ bool AP_InertialSensor_MPU6000::_hardware_init(void)
     // until we clear the interrupt
     _register_write(MPUREG_INT_PIN_CFG, BIT_INT_RD_CLEAR | BIT_LATCH_INT_EN);
 
+#if MPU6000_FIFO_SAMPLING
+    _fifo_reset();
+#endif
+
     // now that we have initialised, we set the SPI bus speed to high
     // (8MHz on APM2)
     _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_HIGH);
@@ -19,6 +19,14 @@
 #define MPU6000_FAST_SAMPLING 0
 #endif
 
+/*
+  on fast CPUs the gyro is also read at its full 8kHz rate through the
+  FIFO, draining all the buffered samples in one burst per timer tick
+ */
+#ifndef MPU6000_FIFO_SAMPLING
+#define MPU6000_FIFO_SAMPLING MPU6000_FAST_SAMPLING
+#endif
+
 #if MPU6000_FAST_SAMPLING
 #include <Filter.h>
 #include <LowPassFilter2p.h>
@@ -32,8 +40,13 @@ public:
     /* update accel and gyro state */
     bool update();
 
+#if MPU6000_FAST_SAMPLING
+    bool gyro_sample_available(void) { return _samples.available(); }
+    bool accel_sample_available(void) { return _samples.available(); }
+#else
     bool gyro_sample_available(void) { return _sum_count >= _sample_count; }
     bool accel_sample_available(void) { return _sum_count >= _sample_count; }
+#endif
 
     // detect the sensor
     static AP_InertialSensor_Backend *detect(AP_InertialSensor &imu);
@@ -53,6 +66,11 @@ private:
     bool                 _sample_available();
     void                 _read_data_transaction();
     bool                 _data_ready();
+#if MPU6000_FIFO_SAMPLING
+    void                 _fifo_reset(void);
+    void                 _read_fifo(void);
+    bool                 _accumulate_fifo_sample(const uint8_t *v, uint32_t timestamp_us);
+#endif
     void                 _poll_data(void);
     uint8_t              _register_read( uint8_t reg );
     void                 _register_write( uint8_t reg, uint8_t val );
@@ -76,9 +94,23 @@ private:
     // how many hardware samples before we report a sample to the caller
     uint8_t _sample_count;
 
+#if MPU6000_FIFO_SAMPLING
+    // time of the newest sample read from the FIFO, advanced by the
+    // sample period for each sample
+    uint32_t _fifo_last_us;
+
+    // temperature of the last FIFO sample, used to check the samples
+    // are still aligned to the start of a packet
+    int16_t _fifo_temp;
+    bool _fifo_temp_valid;
+
+    // count of FIFO resets after an overflow or lost alignment
+    uint16_t _fifo_resets;
+#endif
+
 #if MPU6000_FAST_SAMPLING
-    Vector3f _accel_filtered;
-    Vector3f _gyro_filtered;
+    // filtered samples from the timer thread to update()
+    AP_InertialSensor_SampleChannel _samples;
 
     // Low Pass filters for gyro and accel 
     LowPassFilter2pVector3f _accel_filter;
@@ -88,8 +120,8 @@ private:
     // the sum of the values since last read
     Vector3l _accel_sum;
     Vector3l _gyro_sum;
-#endif
     volatile uint16_t _sum_count;
+#endif
 };
 
 #endif // __AP_INERTIAL_SENSOR_MPU6000_H__
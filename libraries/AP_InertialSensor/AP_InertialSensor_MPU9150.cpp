@@ -326,7 +326,6 @@ static struct gyro_state_s st = {
  */
 AP_InertialSensor_MPU9150::AP_InertialSensor_MPU9150(AP_InertialSensor &imu) :
     AP_InertialSensor_Backend(imu),
-    _have_sample_available(false),
     _accel_filter(800, 10),
     _gyro_filter(800, 10)
 {
@@ -1086,11 +1085,11 @@ void AP_InertialSensor_MPU9150::_accumulate(void)
 
         // TODO Revisit why AP_InertialSensor_L3G4200D uses a minus sign in the y and z component. Maybe this
         //  is because the sensor is placed in the bottom side of the board?
-        _accel_filtered = _accel_filter.apply(Vector3f(accel_x, accel_y, accel_z));
+        Vector3f accel_filtered = _accel_filter.apply(Vector3f(accel_x, accel_y, accel_z));
 
-        _gyro_filtered = _gyro_filter.apply(Vector3f(gyro_x, gyro_y, gyro_z));
+        Vector3f gyro_filtered = _gyro_filter.apply(Vector3f(gyro_x, gyro_y, gyro_z));
 
-        _have_sample_available = true;
+        _samples.push(gyro_filtered, accel_filtered, hal.scheduler->micros());
     }
 
     // give back i2c semaphore
@@ -1099,19 +1098,11 @@ void AP_InertialSensor_MPU9150::_accumulate(void)
 
 bool AP_InertialSensor_MPU9150::update(void) 
 {
-    Vector3f accel, gyro;
+    AP_InertialSensor_SampleChannel::Sample s;
+    _samples.take(s);
 
-    hal.scheduler->suspend_timer_procs();
-    accel = _accel_filtered;
-    gyro = _gyro_filtered;
-    _have_sample_available = false;
-    hal.scheduler->resume_timer_procs();
-
-    accel *= MPU9150_ACCEL_SCALE_2G;
-    _publish_accel(_accel_instance, accel);
-
-    gyro *= MPU9150_GYRO_SCALE_2000;
-    _publish_gyro(_gyro_instance, gyro);
+    s.scale(MPU9150_GYRO_SCALE_2000, MPU9150_ACCEL_SCALE_2G);
+    _publish_samples(_gyro_instance, _accel_instance, s);
 
     if (_last_accel_filter_hz != _accel_filter_cutoff()) {
         _set_accel_filter_frequency(_accel_filter_cutoff());
@@ -20,8 +20,8 @@ public:
     /* update accel and gyro state */
     bool update();
 
-    bool gyro_sample_available(void) { return _have_sample_available; }
-    bool accel_sample_available(void) { return _have_sample_available; }
+    bool gyro_sample_available(void) { return _samples.available(); }
+    bool accel_sample_available(void) { return _samples.available(); }
 
     // detect the sensor
     static AP_InertialSensor_Backend *detect(AP_InertialSensor &imu);
@@ -29,9 +29,9 @@ public:
 private:
     bool            _init_sensor();
     void             _accumulate(void);
-    Vector3f        _accel_filtered;
-    Vector3f        _gyro_filtered;
-    bool            _have_sample_available;
+
+    // filtered samples from the timer thread to update()
+    AP_InertialSensor_SampleChannel _samples;
 
     // // support for updating filter at runtime
     uint8_t         _last_accel_filter_hz;
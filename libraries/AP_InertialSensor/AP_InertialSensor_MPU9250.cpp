@@ -53,6 +53,7 @@ extern const AP_HAL::HAL& hal;
 #define MPUREG_ZG_OFFS_USRL                     0x18    // Z axis gyro offset (low byte)
 #define MPUREG_SMPLRT_DIV                               0x19    // sample rate.  Fsample= 1Khz/(<this value>+1) = 200Hz
 #       define MPUREG_SMPLRT_1000HZ                             0x00
+#       define MPUREG_SMPLRT_8000HZ                             0x00    // with the DLPF disabled
 #       define MPUREG_SMPLRT_500HZ                              0x01
 #       define MPUREG_SMPLRT_250HZ                              0x03
 #       define MPUREG_SMPLRT_200HZ                              0x04
@@ -75,6 +76,12 @@ extern const AP_HAL::HAL& hal;
 #define MPUREG_ZRMOT_THR                                0x21    // detection threshold for Zero Motion interrupt generation.
 #define MPUREG_ZRMOT_DUR                                0x22    // duration counter threshold for Zero Motion interrupt generation. The duration counter ticks at 16 Hz, therefore ZRMOT_DUR has a unit of 1 LSB = 64 ms.
 #define MPUREG_FIFO_EN                                  0x23
+// bit definitions for MPUREG_FIFO_EN
+#       define BIT_FIFO_EN_ACCEL                                0x08
+#       define BIT_FIFO_EN_ZG                                   0x10
+#       define BIT_FIFO_EN_YG                                   0x20
+#       define BIT_FIFO_EN_XG                                   0x40
+#       define BIT_FIFO_EN_TEMP                                 0x80
 #define MPUREG_INT_PIN_CFG                              0x37
 #       define BIT_INT_RD_CLEAR                                 0x10    // clear the interrupt when any read occurs
 #       define BIT_LATCH_INT_EN                                 0x20    // latch data ready pin
@@ -159,6 +166,33 @@ extern const AP_HAL::HAL& hal;
 #define BITS_DLPF_CFG_2100HZ_NOLPF              0x07
 #define BITS_DLPF_CFG_MASK                              0x07
 
+// big endian 16 bit value at index idx of a buffer of sample registers
+#define int16_val(v, idx) ((int16_t)(((uint16_t)v[2*idx] << 8) | v[2*idx+1]))
+
+#if MPU9250_FIFO_SAMPLING
+// the gyro is sampled at its full rate of 8kHz. The accel only
+// samples at 1kHz, so each accel sample is repeated in the FIFO
+#define MPU9250_SAMPLE_HZ           8000
+#define MPU9250_SAMPLE_US           125
+
+// FIFO packets hold accel, temperature and gyro in register order
+#define MPU9250_FIFO_SIZE           512
+#define MPU9250_FIFO_PACKET         14
+
+// most packets read in one SPI transaction
+#define MPU9250_FIFO_BURST          16
+
+// a change in temperature between samples bigger than this (2 degrees
+// C) means we have lost the packet boundaries
+#define MPU9250_FIFO_TEMP_JUMP      668
+
+// timer ticks with an empty FIFO before we assume it has been
+// disabled and reset it
+#define MPU9250_FIFO_EMPTY_TICKS    50
+#else
+#define MPU9250_SAMPLE_HZ           1000
+#endif
+
 /*
  *  PS-MPU-9250A-00.pdf, page 8, lists LSB sensitivity of
  *  gyro as 16.4 LSB/DPS at scale factor of +/- 2000dps (FS_SEL==3)
@@ -177,10 +211,15 @@ AP_InertialSensor_MPU9250::AP_InertialSensor_MPU9250(AP_InertialSensor &imu) :
 	AP_InertialSensor_Backend(imu),
     _last_accel_filter_hz(-1),
     _last_gyro_filter_hz(-1),
-    _shared_data_idx(0),
-    _accel_filter(1000, 15),
-    _gyro_filter(1000, 15),
-    _have_sample_available(false)
+#if MPU9250_FIFO_SAMPLING
+    _fifo_last_us(0),
+    _fifo_temp(0),
+    _fifo_temp_valid(false),
+    _fifo_empty_count(0),
+    _fifo_resets(0),
+#endif
+    _accel_filter(MPU9250_SAMPLE_HZ, 15),
+    _gyro_filter(MPU9250_SAMPLE_HZ, 15)
 {
 }
 
@@ -262,36 +301,27 @@ bool AP_InertialSensor_MPU9250::_init_sensor(void)
  */
 bool AP_InertialSensor_MPU9250::update( void )
 {
-    // pull the data from the timer shared data buffer
-    uint8_t idx = _shared_data_idx;
-    Vector3f gyro = _shared_data[idx]._gyro_filtered;
-    Vector3f accel = _shared_data[idx]._accel_filtered;
+    // pull the data from the timer thread
+    AP_InertialSensor_SampleChannel::Sample s;
+    _samples.take(s);
 
-    _have_sample_available = false;
-
-    accel *= MPU9250_ACCEL_SCALE_1G;
-    gyro *= GYRO_SCALE;
+    s.scale(GYRO_SCALE, MPU9250_ACCEL_SCALE_1G);
 
     // rotate for bbone default
-    accel.rotate(ROTATION_ROLL_180_YAW_90);
-    gyro.rotate(ROTATION_ROLL_180_YAW_90);
+    s.rotate(ROTATION_ROLL_180_YAW_90);
 
 #if CONFIG_HAL_BOARD_SUBTYPE == HAL_BOARD_SUBTYPE_LINUX_PXF
     // PXF has an additional YAW 180
-    accel.rotate(ROTATION_YAW_180);
-    gyro.rotate(ROTATION_YAW_180);
+    s.rotate(ROTATION_YAW_180);
 #elif CONFIG_HAL_BOARD_SUBTYPE == HAL_BOARD_SUBTYPE_LINUX_NAVIO
     // NavIO has different orientation, assuming RaspberryPi is right
     // way up, and PWM pins on NavIO are at the back of the aircraft
-    accel.rotate(ROTATION_ROLL_180_YAW_90);
-    gyro.rotate(ROTATION_ROLL_180_YAW_90);
+    s.rotate(ROTATION_ROLL_180_YAW_90);
 #elif CONFIG_HAL_BOARD_SUBTYPE == HAL_BOARD_SUBTYPE_LINUX_BBBMINI
-    accel.rotate(ROTATION_ROLL_180);
-    gyro.rotate(ROTATION_ROLL_180);
+    s.rotate(ROTATION_ROLL_180);
 #endif
 
-    _publish_gyro(_gyro_instance, gyro);
-    _publish_accel(_accel_instance, accel);
+    _publish_samples(_gyro_instance, _accel_instance, s);
 
     if (_last_accel_filter_hz != _accel_filter_cutoff()) {
         _set_accel_filter(_accel_filter_cutoff());
@@ -322,10 +352,132 @@ void AP_InertialSensor_MPU9250::_poll_data(void)
         */
         return;
     }
+#if MPU9250_FIFO_SAMPLING
+    _read_fifo();
+#else
     _read_data_transaction();
+#endif
     _spi_sem->give();
 }
 
+#if MPU9250_FIFO_SAMPLING
+/*
+  empty the FIFO and start filling it with accel, temperature and gyro
+  samples. The I2C master used by the AK8963 compass shares the
+  control register, so its bits are kept
+ */
+void AP_InertialSensor_MPU9250::_fifo_reset(void)
+{
+    // registers can only be written at low speed
+    _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_LOW);
+    uint8_t user_ctrl = _register_read(MPUREG_USER_CTRL) & ~BIT_USER_CTRL_FIFO_EN;
+    _register_write(MPUREG_FIFO_EN, 0);
+    _register_write(MPUREG_USER_CTRL, user_ctrl | BIT_USER_CTRL_FIFO_RESET);
+    _register_write(MPUREG_USER_CTRL, user_ctrl | BIT_USER_CTRL_FIFO_EN);
+    _register_write(MPUREG_FIFO_EN, BIT_FIFO_EN_ACCEL | BIT_FIFO_EN_TEMP |
+                    BIT_FIFO_EN_XG | BIT_FIFO_EN_YG | BIT_FIFO_EN_ZG);
+    _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_HIGH);
+
+    _fifo_last_us = hal.scheduler->micros();
+    _fifo_temp_valid = false;
+    _fifo_empty_count = 0;
+}
+
+/*
+  read all the samples buffered in the FIFO, in as few bus
+  transactions as we can. The samples are timestamped from the sample
+  rate rather than the time we read them, so the frontend integrates
+  each one over the period it covers
+ */
+void AP_InertialSensor_MPU9250::_read_fifo(void)
+{
+    uint8_t tx[3] = { MPUREG_FIFO_COUNTH | 0x80, 0, 0 };
+    uint8_t rx[3];
+    _spi->transaction(tx, rx, 3);
+    uint16_t count = ((uint16_t)rx[1] << 8) | rx[2];
+    uint32_t now = hal.scheduler->micros();
+
+    if (count > MPU9250_FIFO_SIZE - MPU9250_FIFO_PACKET) {
+        // the FIFO overflowed and the oldest samples have been
+        // overwritten, possibly part way through a packet
+        _fifo_resets++;
+        _fifo_reset();
+        return;
+    }
+
+    uint16_t n = count / MPU9250_FIFO_PACKET;
+    if (n == 0) {
+        if (++_fifo_empty_count >= MPU9250_FIFO_EMPTY_TICKS) {
+            // something else has turned the FIFO off
+            _fifo_resets++;
+            _fifo_reset();
+        }
+        return;
+    }
+    _fifo_empty_count = 0;
+
+    /*
+      the newest sample can't be later than now, and should be less
+      than a timer tick before it. Pull our sample clock back if the
+      sensor runs slower than its nominal rate, nudge it forward if it
+      runs faster, and start again after a long gap
+     */
+    int32_t lag = now - (_fifo_last_us + n * MPU9250_SAMPLE_US);
+    if (lag < 0 || lag > 10000) {
+        _fifo_last_us = now - n * MPU9250_SAMPLE_US;
+    } else {
+        _fifo_last_us += lag / 16;
+    }
+
+    struct PACKED {
+        uint8_t cmd;
+        uint8_t v[MPU9250_FIFO_BURST][MPU9250_FIFO_PACKET];
+    } brx, btx;
+    memset(&btx, 0, sizeof(btx));
+    btx.cmd = MPUREG_FIFO_R_W | 0x80;
+
+    while (n > 0) {
+        uint8_t burst = n < MPU9250_FIFO_BURST ? n : MPU9250_FIFO_BURST;
+        _spi->transaction((const uint8_t *)&btx, (uint8_t *)&brx,
+                          1 + burst * MPU9250_FIFO_PACKET);
+        for (uint8_t i=0; i<burst; i++) {
+            _fifo_last_us += MPU9250_SAMPLE_US;
+            if (!_accumulate_fifo_sample(brx.v[i], _fifo_last_us)) {
+                // the rest of the FIFO is misaligned too
+                _fifo_resets++;
+                _fifo_reset();
+                return;
+            }
+        }
+        n -= burst;
+    }
+}
+
+/*
+  filter one sample from the FIFO and hand it to update(). Returns
+  false if the sample is not aligned to a packet
+ */
+bool AP_InertialSensor_MPU9250::_accumulate_fifo_sample(const uint8_t *v, uint32_t timestamp_us)
+{
+    int16_t temp = int16_val(v, 3);
+    if (_fifo_temp_valid && abs(temp - _fifo_temp) > MPU9250_FIFO_TEMP_JUMP) {
+        return false;
+    }
+    _fifo_temp = temp;
+    _fifo_temp_valid = true;
+
+    Vector3f accel_filtered = _accel_filter.apply(Vector3f(int16_val(v, 1),
+                                                           int16_val(v, 0),
+                                                           -int16_val(v, 2)));
+
+    Vector3f gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(v, 5),
+                                                         int16_val(v, 4),
+                                                         -int16_val(v, 6)));
+    _samples.push(gyro_filtered, accel_filtered, timestamp_us);
+    return true;
+}
+#endif // MPU9250_FIFO_SAMPLING
+
 
 /*
   read from the data registers and update filtered data
@@ -341,8 +493,6 @@ void AP_InertialSensor_MPU9250::_read_data_transaction()
 
     _spi->transaction((const uint8_t *)&tx, (uint8_t *)&rx, sizeof(rx));
 
-#define int16_val(v, idx) ((int16_t)(((uint16_t)v[2*idx] << 8) | v[2*idx+1]))
-
     Vector3f _accel_filtered = _accel_filter.apply(Vector3f(int16_val(rx.v, 1),
                                                    int16_val(rx.v, 0),
                                                    -int16_val(rx.v, 2)));
@@ -350,13 +500,7 @@ void AP_InertialSensor_MPU9250::_read_data_transaction()
     Vector3f _gyro_filtered = _gyro_filter.apply(Vector3f(int16_val(rx.v, 5),
                                                  int16_val(rx.v, 4),
                                                  -int16_val(rx.v, 6)));
-    // update the shared buffer
-    uint8_t idx = _shared_data_idx ^ 1;
-    _shared_data[idx]._accel_filtered = _accel_filtered;
-    _shared_data[idx]._gyro_filtered = _gyro_filtered;
-    _shared_data_idx = idx;
-
-    _have_sample_available = true;
+    _samples.push(_gyro_filtered, _accel_filtered, hal.scheduler->micros());
 }
 
 /*
@@ -393,7 +537,7 @@ void AP_InertialSensor_MPU9250::_register_write(uint8_t reg, uint8_t val)
  */
 void AP_InertialSensor_MPU9250::_set_accel_filter(uint8_t filter_hz)
 {
-    _accel_filter.set_cutoff_frequency(1000, filter_hz);
+    _accel_filter.set_cutoff_frequency(MPU9250_SAMPLE_HZ, filter_hz);
 }
 
 /*
@@ -401,7 +545,7 @@ void AP_InertialSensor_MPU9250::_set_accel_filter(uint8_t filter_hz)
  */
 void AP_InertialSensor_MPU9250::_set_gyro_filter(uint8_t filter_hz)
 {
-    _gyro_filter.set_cutoff_frequency(1000, filter_hz);
+    _gyro_filter.set_cutoff_frequency(MPU9250_SAMPLE_HZ, filter_hz);
 }
 
 
@@ -449,9 +593,15 @@ bool AP_InertialSensor_MPU9250::_hardware_init(void)
     // the 2-pole software filter
     _register_write(MPUREG_CONFIG, BITS_DLPF_CFG_256HZ_NOLPF2);
 
+#if MPU9250_FIFO_SAMPLING
+    // sample at the full gyro rate, and use the 2 pole filter to give
+    // the desired rate
+    _register_write(MPUREG_SMPLRT_DIV, MPUREG_SMPLRT_8000HZ);
+#else
     // set sample rate to 1kHz, and use the 2 pole filter to give the
     // desired rate
     _register_write(MPUREG_SMPLRT_DIV, MPUREG_SMPLRT_1000HZ);
+#endif
     _register_write(MPUREG_GYRO_CONFIG, BITS_GYRO_FS_2000DPS);  // Gyro scale 2000º/s
 
     // RM-MPU-9250A-00.pdf, pg. 15, select accel full scale 16g
@@ -464,6 +614,10 @@ bool AP_InertialSensor_MPU9250::_hardware_init(void)
     // until we clear the interrupt
     _register_write(MPUREG_INT_PIN_CFG, BIT_INT_RD_CLEAR | BIT_LATCH_INT_EN);
 
+#if MPU9250_FIFO_SAMPLING
+    _fifo_reset();
+#endif
+
     // now that we have initialised, we set the SPI bus speed to high
     // (8MHz on APM2)
     _spi->set_bus_speed(AP_HAL::SPIDeviceDriver::SPI_SPEED_HIGH);
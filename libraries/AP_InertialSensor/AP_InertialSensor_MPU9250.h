@@ -14,6 +14,14 @@
 // enable debug to see a register dump on startup
 #define MPU9250_DEBUG 0
 
+/*
+  read the gyro at its full 8kHz rate through the FIFO, draining all
+  the buffered samples in one burst per timer tick
+ */
+#ifndef MPU9250_FIFO_SAMPLING
+#define MPU9250_FIFO_SAMPLING 1
+#endif
+
 class AP_InertialSensor_MPU9250 : public AP_InertialSensor_Backend
 {
 public:
@@ -23,8 +31,8 @@ public:
     /* update accel and gyro state */
     bool update();
 
-    bool gyro_sample_available(void) { return _have_sample_available; }
-    bool accel_sample_available(void) { return _have_sample_available; }
+    bool gyro_sample_available(void) { return _samples.available(); }
+    bool accel_sample_available(void) { return _samples.available(); }
 
     // detect the sensor
     static AP_InertialSensor_Backend *detect(AP_InertialSensor &imu);
@@ -34,6 +42,11 @@ private:
 
     void                 _read_data_transaction();
     bool                 _data_ready();
+#if MPU9250_FIFO_SAMPLING
+    void                 _fifo_reset(void);
+    void                 _read_fifo(void);
+    bool                 _accumulate_fifo_sample(const uint8_t *v, uint32_t timestamp_us);
+#endif
     void                 _poll_data(void);
     uint8_t              _register_read( uint8_t reg );
     void                 _register_write( uint8_t reg, uint8_t val );
@@ -51,23 +64,30 @@ private:
     void _set_accel_filter(uint8_t filter_hz);
     void _set_gyro_filter(uint8_t filter_hz);
 
-    // This structure is used to pass data from the timer which reads
-    // the sensor to the main thread. The _shared_data_idx is used to
-    // prevent race conditions by ensuring the data is fully updated
-    // before being used by the consumer
-    struct {
-        Vector3f _accel_filtered;
-        Vector3f _gyro_filtered;
-    } _shared_data[2];
-    volatile uint8_t _shared_data_idx;
+#if MPU9250_FIFO_SAMPLING
+    // time of the newest sample read from the FIFO, advanced by the
+    // sample period for each sample
+    uint32_t _fifo_last_us;
+
+    // temperature of the last FIFO sample, used to check the samples
+    // are still aligned to the start of a packet
+    int16_t _fifo_temp;
+    bool _fifo_temp_valid;
+
+    // timer ticks since the FIFO last had a sample in it
+    uint8_t _fifo_empty_count;
+
+    // count of FIFO resets after an overflow or lost alignment
+    uint16_t _fifo_resets;
+#endif
+
+    // filtered samples from the timer thread to update()
+    AP_InertialSensor_SampleChannel _samples;
 
     // Low Pass filters for gyro and accel 
     LowPassFilter2pVector3f _accel_filter;
     LowPassFilter2pVector3f _gyro_filter;
 
-    // do we currently have a sample pending?
-    bool _have_sample_available;
-
     // gyro and accel instances
     uint8_t _gyro_instance;
     uint8_t _accel_instance;
@@ -0,0 +1,108 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+#include <AP_HAL.h>
+#include "AP_InertialSensor_SampleChannel.h"
+
+/*
+  the producer and consumer run on different threads on Linux, so
+  ordering of the data and sequence stores needs a real memory
+  barrier. Elsewhere the producer is a timer interrupt on the same
+  CPU and stopping the compiler reordering is enough
+ */
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_150
+#define SAMPLE_CHANNEL_BARRIER() __sync_synchronize()
+#else
+#define SAMPLE_CHANNEL_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
+AP_InertialSensor_SampleChannel::AP_InertialSensor_SampleChannel() :
+    _seq(0),
+    _taken_seq(0),
+    _have_prev(false)
+{
+}
+
+void AP_InertialSensor_SampleChannel::push(const Vector3f &gyro, const Vector3f &accel, uint32_t timestamp_us)
+{
+    if (_taken_seq == _seq) {
+        // the consumer has everything we have published. Start new
+        // sums so they stay small
+        _acc.gyro_sum.zero();
+        _acc.accel_sum.zero();
+        _acc.count = 0;
+        _acc.epoch++;
+    }
+    _acc.gyro = gyro;
+    _acc.accel = accel;
+    _acc.gyro_sum += gyro;
+    _acc.accel_sum += accel;
+    _acc.count++;
+    _acc.timestamp_us = timestamp_us;
+
+    // an odd sequence number marks a write in progress
+    _seq = _seq + 1;
+    SAMPLE_CHANNEL_BARRIER();
+    _shared = _acc;
+    SAMPLE_CHANNEL_BARRIER();
+    _seq = _seq + 1;
+}
+
+bool AP_InertialSensor_SampleChannel::take(Sample &s)
+{
+    Totals snap;
+    seq_t seq;
+    do {
+        seq = _seq;
+        SAMPLE_CHANNEL_BARRIER();
+        snap = _shared;
+        SAMPLE_CHANNEL_BARRIER();
+    } while ((seq & 1) || seq != _seq);
+
+    s.gyro = snap.gyro;
+    s.accel = snap.accel;
+    s.timestamp_us = snap.timestamp_us;
+
+    if (seq == _taken_seq) {
+        s.gyro_sum.zero();
+        s.accel_sum.zero();
+        s.count = 0;
+        s.dt = 0;
+        return false;
+    }
+
+    if (snap.epoch == _prev.epoch) {
+        // the producer is still adding to the sums we last saw
+        s.gyro_sum = snap.gyro_sum - _prev.gyro_sum;
+        s.accel_sum = snap.accel_sum - _prev.accel_sum;
+        s.count = snap.count - _prev.count;
+    } else {
+        // the producer restarted its sums after our last take()
+        s.gyro_sum = snap.gyro_sum;
+        s.accel_sum = snap.accel_sum;
+        s.count = snap.count;
+    }
+    // the first snapshot has nothing to measure time against
+    s.dt = _have_prev ? (snap.timestamp_us - _prev.timestamp_us) * 1.0e-6f : 0;
+
+    _prev = snap;
+    _have_prev = true;
+    SAMPLE_CHANNEL_BARRIER();
+    _taken_seq = seq;
+    return true;
+}
+
+void AP_InertialSensor_SampleChannel::Sample::scale(float gyro_scale, float accel_scale)
+{
+    gyro *= gyro_scale;
+    gyro_sum *= gyro_scale;
+    accel *= accel_scale;
+    accel_sum *= accel_scale;
+}
+
+void AP_InertialSensor_SampleChannel::Sample::rotate(enum Rotation r)
+{
+    gyro.rotate(r);
+    gyro_sum.rotate(r);
+    accel.rotate(r);
+    accel_sum.rotate(r);
+}
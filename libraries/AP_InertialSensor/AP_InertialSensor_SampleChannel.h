@@ -0,0 +1,106 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+  Single producer, single consumer handoff of IMU samples from a
+  driver's timer process to its update() call on the main thread.
+
+  The producer keeps running sums of the gyro and accel samples since
+  the consumer last caught up, and publishes them under a sequence
+  counter (a seqlock). The consumer copies a consistent snapshot,
+  retrying if the producer was part way through a write, and
+  subtracts the previous snapshot it took. Neither side ever waits
+  for the other, so the timer process never loses a sample to a busy
+  consumer and update() never sees a torn vector.
+
+  The sums restart from zero once the producer sees that the consumer
+  has taken its latest publication, which keeps the float sums small
+  enough not to lose precision.
+ */
+#ifndef __AP_INERTIALSENSOR_SAMPLECHANNEL_H__
+#define __AP_INERTIALSENSOR_SAMPLECHANNEL_H__
+
+#include <stdint.h>
+#include <AP_HAL.h>
+#include <AP_Math.h>
+
+class AP_InertialSensor_SampleChannel
+{
+public:
+    AP_InertialSensor_SampleChannel();
+
+    /*
+      samples handed to the consumer. gyro and accel are the most
+      recent sample, the sums cover count samples over dt seconds
+     */
+    struct Sample {
+        Vector3f gyro;
+        Vector3f accel;
+        Vector3f gyro_sum;
+        Vector3f accel_sum;
+        uint32_t count;
+        uint32_t timestamp_us;
+        float dt;
+
+        // apply a driver scaling or board rotation to all vectors
+        void scale(float gyro_scale, float accel_scale);
+        void rotate(enum Rotation r);
+    };
+
+    // producer side: add a sample, called from the timer process
+    void push(const Vector3f &gyro, const Vector3f &accel, uint32_t timestamp_us);
+
+    /*
+      consumer side: fill in the samples published since the last
+      call. Returns false with count zero if there are no new samples,
+      in which case gyro and accel hold the last known values
+     */
+    bool take(Sample &s);
+
+    // true if samples have been published since the last take()
+    bool available(void) const { return _seq != _taken_seq; }
+
+private:
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+    typedef uint32_t seq_t;
+#else
+    // loads wider than a byte are not atomic on 8 bit CPUs
+    typedef uint8_t seq_t;
+#endif
+
+    struct Totals {
+        Totals() : count(0), timestamp_us(0), epoch(0) {}
+        Vector3f gyro;
+        Vector3f accel;
+        Vector3f gyro_sum;
+        Vector3f accel_sum;
+        uint32_t count;
+        uint32_t timestamp_us;
+        uint8_t epoch;
+    };
+
+    // written by the producer only
+    Totals _acc;
+    Totals _shared;
+    volatile seq_t _seq;
+
+    // written by the consumer only
+    Totals _prev;
+    volatile seq_t _taken_seq;
+    bool _have_prev;
+};
+
+#endif // __AP_INERTIALSENSOR_SAMPLECHANNEL_H__
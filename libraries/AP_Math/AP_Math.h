@@ -54,6 +54,12 @@
 // radius of earth in meters
 #define RADIUS_OF_EARTH 6378100
 
+// scaling factor from 1e-7 degrees to meters at equater
+// == 1.0e-7 * DEG_TO_RAD * RADIUS_OF_EARTH
+#define LOCATION_SCALING_FACTOR 0.011131884502145034f
+// inverse of LOCATION_SCALING_FACTOR
+#define LOCATION_SCALING_FACTOR_INV 89.83204953368922f
+
 #define ROTATION_COMBINATION_SUPPORT 0
 
 // convert a longitude or latitude point to meters or centimeteres.
@@ -24,15 +24,6 @@
 #include <stdlib.h>
 #include "AP_Math.h"
 
-// radius of earth in meters
-#define RADIUS_OF_EARTH 6378100
-
-// scaling factor from 1e-7 degrees to meters at equater
-// == 1.0e-7 * DEG_TO_RAD * RADIUS_OF_EARTH
-#define LOCATION_SCALING_FACTOR 0.011131884502145034f
-// inverse of LOCATION_SCALING_FACTOR
-#define LOCATION_SCALING_FACTOR_INV 89.83204953368922f
-
 float longitude_scale(const struct Location &loc)
 {
     static int32_t last_lat;
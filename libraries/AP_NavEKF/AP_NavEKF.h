@@ -255,6 +255,13 @@ public:
     // returns a zero rotation quaternion if the INS calculation was not performed on that time step.
     Quaternion getDeltaQuaternion(void) const;
 
+    // calculate the upper triangle of rows 0-9 of the predicted covariance matrix, before the
+    // state process noise is added. Used by CovariancePrediction() and by the covariance example.
+    static void PredictCovarianceKernel(const Matrix22 &P, Matrix22 &nextP, const Quaternion &quat,
+                                        const Vector3f &delAng, const Vector3f &delAngBias,
+                                        const Vector3f &delVel, float delVelBiasZ, float dt,
+                                        const Vector3f &delAngVar, const Vector3f &delVelVar);
+
     static const struct AP_Param::GroupInfo var_info[];
 
 private:
@@ -313,6 +320,9 @@ private:
     // fuse sythetic sideslip measurement of zero
     void FuseSideslip();
 
+    // correct the covariance matrix for a scalar observation using the non-zero columns of H
+    void CovarianceUpdate(const Vector22 &H, const uint8_t *Hidx, uint8_t numHidx);
+
     // zero specified range of rows in the state covariance matrix
     void zeroRows(Matrix22 &covMat, uint8_t first, uint8_t last);
 
@@ -546,8 +556,6 @@ private:
 
     float gpsNoiseScaler;           // Used to scale the  GPS measurement noise and consistency gates to compensate for operation with small satellite counts
     Vector31 Kfusion;               // Kalman gain vector
-    Matrix22 KH;                    // intermediate result used for covariance updates
-    Matrix22 KHP;                   // intermediate result used for covariance updates
     Matrix22 P;                     // covariance matrix
     VectorN<state_elements,50> storedStates;       // state vectors stored for the last 50 time steps
     Vector_u32_50 statetimeStamp;    // time stamp for each state vector stored
@@ -631,12 +639,8 @@ private:
     Vector3f lastAngRate;           // angular rate from previous IMU sample used for trapezoidal integrator
     Vector3f lastAccel1;            // acceleration from previous IMU1 sample used for trapezoidal integrator
     Vector3f lastAccel2;            // acceleration from previous IMU2 sample used for trapezoidal integrator
-    Matrix22 nextP;                 // Predicted covariance matrix before addition of process noise to diagonals
+    Matrix22 nextP;                 // Predicted covariance matrix, only the upper triangle of rows 0-9 is used
     Vector22 processNoise;          // process noise added to diagonals of predicted covariance matrix
-    Vector15 SF;                    // intermediate variables used to calculate predicted covariance matrix
-    Vector8 SG;                     // intermediate variables used to calculate predicted covariance matrix
-    Vector11 SQ;                    // intermediate variables used to calculate predicted covariance matrix
-    Vector8 SPP;                    // intermediate variables used to calculate predicted covariance matrix
     float IMU1_weighting;           // Weighting applied to use of IMU1. Varies between 0 and 1.
     bool yawAligned;                // true when the yaw angle has been aligned
     Vector2f gpsPosGlitchOffsetNE;  // offset applied to GPS data in the NE direction to compensate for rapid changes in GPS solution
@@ -0,0 +1,379 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// Check and benchmark of the NavEKF covariance prediction
+//
+// NavEKF::PredictCovarianceKernel() is compared against a dense
+// F*P*transpose(F) + G*Q*transpose(G) evaluated in double precision
+// for random covariance matrices, attitudes, IMU increments and time
+// steps. F and G are found by differencing the state prediction
+// equations, so they don't share any algebra with the kernel. The
+// kernel is then timed against the same dense product in float.
+//
+
+#include <AP_HAL.h>
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <AP_InertialSensor.h>
+#include <AP_ADC.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_Baro.h>
+#include <AP_GPS.h>
+#include <AP_AHRS.h>
+#include <AP_Compass.h>
+#include <AP_Declination.h>
+#include <AP_Airspeed.h>
+#include <GCS_MAVLink.h>
+#include <AP_Mission.h>
+#include <StorageManager.h>
+#include <AP_Terrain.h>
+#include <Filter.h>
+#include <SITL.h>
+#include <AP_Buffer.h>
+#include <AP_Notify.h>
+#include <AP_Vehicle.h>
+#include <DataFlash.h>
+#include <AP_NavEKF.h>
+#include <AP_Rally.h>
+#include <AP_Scheduler.h>
+
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_PX4.h>
+#include <AP_BattMonitor.h>
+#include <AP_SerialManager.h>
+#include <RC_Channel.h>
+#include <AP_RangeFinder.h>
+#include <AP_OpticalFlow.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+// number of random cases checked against the dense product
+#define NUM_CHECKS 2000
+// largest allowed difference relative to sqrt(Pii*Pjj)
+#define CHECK_TOLERANCE 1.0e-5
+// number of predictions timed
+#define NUM_TIMED 1000
+
+#define NUM_STATES 22
+// states with a transition that isn't identity, or that it depends on
+#define NUM_DYN_STATES 14
+#define NUM_INPUTS 6
+
+struct prediction {
+    double q[4];
+    double delAng[3];
+    double delAngBias[3];
+    double delVel[3];
+    double delVelBiasZ;
+    double dt;
+    double delAngVar[3];
+    double delVelVar[3];
+};
+
+static NavEKF::Matrix22 P;
+static NavEKF::Matrix22 nextP;
+static double Pd[NUM_STATES][NUM_STATES];
+static double F[NUM_STATES][NUM_STATES];
+static double G[NUM_STATES][NUM_INPUTS];
+static double ref[NUM_STATES][NUM_STATES];
+static float Ff[NUM_STATES][NUM_STATES];
+static float FPf[NUM_STATES][NUM_STATES];
+float denseP[NUM_STATES][NUM_STATES];
+
+static uint32_t seed = 1;
+
+// xorshift, so every board checks the same cases
+static double rand_double(double lo, double hi)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return lo + (hi - lo) * (seed / 4294967295.0);
+}
+
+/*
+  predict the quaternion, velocity, position and bias states from the
+  delta angle and delta velocity inputs, as the covariance prediction
+  was derived
+ */
+static void predict_states(const double *x, const double *u, double dt, double *xn)
+{
+    double q0 = x[0], q1 = x[1], q2 = x[2], q3 = x[3];
+    double a = 0.5*(u[0] - x[10]);
+    double b = 0.5*(u[1] - x[11]);
+    double c = 0.5*(u[2] - x[12]);
+
+    // rotate the quaternion by the corrected delta angle
+    xn[0] = q0 - q1*a - q2*b - q3*c;
+    xn[1] = q0*a + q1 + q2*c - q3*b;
+    xn[2] = q0*b - q1*c + q2 + q3*a;
+    xn[3] = q0*c + q1*b - q2*a + q3;
+
+    // add the corrected delta velocity rotated into the navigation frame
+    double dvx = u[3], dvy = u[4], dvz = u[5] - x[13];
+    double Tbn[3][3] = {
+        { q0*q0 + q1*q1 - q2*q2 - q3*q3, 2*(q1*q2 - q0*q3), 2*(q1*q3 + q0*q2) },
+        { 2*(q1*q2 + q0*q3), q0*q0 - q1*q1 + q2*q2 - q3*q3, 2*(q2*q3 - q0*q1) },
+        { 2*(q1*q3 - q0*q2), 2*(q2*q3 + q0*q1), q0*q0 - q1*q1 - q2*q2 + q3*q3 }
+    };
+    for (uint8_t i=0; i<3; i++) {
+        xn[4+i] = x[4+i] + Tbn[i][0]*dvx + Tbn[i][1]*dvy + Tbn[i][2]*dvz;
+        xn[7+i] = x[7+i] + dt*x[4+i];
+    }
+
+    for (uint8_t i=10; i<NUM_DYN_STATES; i++) {
+        xn[i] = x[i];
+    }
+}
+
+/*
+  find F and G by central differences. The prediction is at most
+  quadratic in each state and input, so these are exact apart from
+  rounding
+ */
+static void find_jacobians(const struct prediction &p)
+{
+    const double h = 1.0e-5;
+    double x[NUM_DYN_STATES];
+    double u[NUM_INPUTS];
+    double xp[NUM_DYN_STATES], xm[NUM_DYN_STATES];
+
+    memset(x, 0, sizeof(x));
+    for (uint8_t i=0; i<4; i++) {
+        x[i] = p.q[i];
+    }
+    for (uint8_t i=0; i<3; i++) {
+        x[10+i] = p.delAngBias[i];
+        u[i] = p.delAng[i];
+        u[3+i] = p.delVel[i];
+    }
+    x[13] = p.delVelBiasZ;
+
+    memset(F, 0, sizeof(F));
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        F[i][i] = 1;
+    }
+    for (uint8_t j=0; j<NUM_DYN_STATES; j++) {
+        double xj = x[j];
+        x[j] = xj + h;
+        predict_states(x, u, p.dt, xp);
+        x[j] = xj - h;
+        predict_states(x, u, p.dt, xm);
+        x[j] = xj;
+        for (uint8_t i=0; i<NUM_DYN_STATES; i++) {
+            F[i][j] = (xp[i] - xm[i]) / (2*h);
+        }
+    }
+
+    memset(G, 0, sizeof(G));
+    for (uint8_t j=0; j<NUM_INPUTS; j++) {
+        double uj = u[j];
+        u[j] = uj + h;
+        predict_states(x, u, p.dt, xp);
+        u[j] = uj - h;
+        predict_states(x, u, p.dt, xm);
+        u[j] = uj;
+        for (uint8_t i=0; i<NUM_DYN_STATES; i++) {
+            G[i][j] = (xp[i] - xm[i]) / (2*h);
+        }
+    }
+}
+
+/*
+  a random prediction step and positive definite covariance matrix
+ */
+static void make_case(struct prediction &p)
+{
+    static const double sigma[NUM_STATES] = {
+        0.1, 0.1, 0.1, 0.1,     // quaternion
+        2, 2, 2,                // velocity
+        20, 20, 20,             // position
+        2e-4, 2e-4, 2e-4,       // delta angle bias
+        2e-3,                   // delta velocity bias
+        3, 3,                   // wind
+        0.05, 0.05, 0.05,       // earth field
+        0.05, 0.05, 0.05        // body field
+    };
+    static double A[NUM_STATES][NUM_STATES];
+
+    p.dt = rand_double(0.0025, 0.04);
+    double norm = 0;
+    for (uint8_t i=0; i<4; i++) {
+        p.q[i] = rand_double(-1, 1);
+        norm += p.q[i]*p.q[i];
+    }
+    norm = sqrt(norm);
+    for (uint8_t i=0; i<4; i++) {
+        p.q[i] /= norm;
+    }
+    double gyrNoise = rand_double(1e-3, 5e-2);
+    double accNoise = rand_double(5e-2, 1.0);
+    for (uint8_t i=0; i<3; i++) {
+        p.delAng[i] = rand_double(-3, 3) * p.dt;
+        p.delAngBias[i] = rand_double(-0.1, 0.1) * p.dt;
+        p.delVel[i] = rand_double(-20, 20) * p.dt;
+        p.delAngVar[i] = (gyrNoise*p.dt) * (gyrNoise*p.dt);
+        p.delVelVar[i] = (accNoise*p.dt) * (accNoise*p.dt);
+    }
+    p.delVelBiasZ = rand_double(-1, 1) * p.dt;
+
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            A[i][j] = rand_double(-1, 1);
+        }
+    }
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=i; j<NUM_STATES; j++) {
+            double sum = (i == j) ? 0.1 : 0;
+            for (uint8_t k=0; k<NUM_STATES; k++) {
+                sum += A[i][k] * A[j][k] / NUM_STATES;
+            }
+            P[i][j] = P[j][i] = sum * sigma[i] * sigma[j];
+        }
+    }
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            Pd[i][j] = P[i][j];
+        }
+    }
+}
+
+static void run_kernel(const struct prediction &p)
+{
+    NavEKF::PredictCovarianceKernel(P, nextP,
+                                    Quaternion(p.q[0], p.q[1], p.q[2], p.q[3]),
+                                    Vector3f(p.delAng[0], p.delAng[1], p.delAng[2]),
+                                    Vector3f(p.delAngBias[0], p.delAngBias[1], p.delAngBias[2]),
+                                    Vector3f(p.delVel[0], p.delVel[1], p.delVel[2]),
+                                    p.delVelBiasZ, p.dt,
+                                    Vector3f(p.delAngVar[0], p.delAngVar[1], p.delAngVar[2]),
+                                    Vector3f(p.delVelVar[0], p.delVelVar[1], p.delVelVar[2]));
+}
+
+/*
+  the dense product, in double precision
+ */
+static void dense_reference(const struct prediction &p)
+{
+    static double FP[NUM_STATES][NUM_STATES];
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            double sum = 0;
+            for (uint8_t k=0; k<NUM_STATES; k++) {
+                sum += F[i][k] * Pd[k][j];
+            }
+            FP[i][j] = sum;
+        }
+    }
+    const double Q[NUM_INPUTS] = {
+        p.delAngVar[0], p.delAngVar[1], p.delAngVar[2],
+        p.delVelVar[0], p.delVelVar[1], p.delVelVar[2]
+    };
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            double sum = 0;
+            for (uint8_t k=0; k<NUM_STATES; k++) {
+                sum += FP[i][k] * F[j][k];
+            }
+            for (uint8_t k=0; k<NUM_INPUTS; k++) {
+                sum += G[i][k] * Q[k] * G[j][k];
+            }
+            ref[i][j] = sum;
+        }
+    }
+}
+
+/*
+  the dense product in float, as the baseline for timing
+ */
+static void dense_float(void)
+{
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            float sum = 0;
+            for (uint8_t k=0; k<NUM_STATES; k++) {
+                sum += Ff[i][k] * P[k][j];
+            }
+            FPf[i][j] = sum;
+        }
+    }
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            float sum = 0;
+            for (uint8_t k=0; k<NUM_STATES; k++) {
+                sum += FPf[i][k] * Ff[j][k];
+            }
+            denseP[i][j] = sum;
+        }
+    }
+}
+
+static struct prediction last_case;
+
+void setup(void)
+{
+    hal.console->println("NavEKF covariance prediction check");
+
+    double max_err = 0;
+    for (uint16_t n=0; n<NUM_CHECKS; n++) {
+        struct prediction &p = last_case;
+        make_case(p);
+        find_jacobians(p);
+        dense_reference(p);
+        run_kernel(p);
+        // the kernel gives the upper triangle of rows 0-9, the
+        // other rows of the prediction are P
+        for (uint8_t i=0; i<10; i++) {
+            for (uint8_t j=i; j<NUM_STATES; j++) {
+                double err = fabs(nextP[i][j] - ref[i][j]) / sqrt(ref[i][i] * ref[j][j]);
+                if (err > max_err) {
+                    max_err = err;
+                }
+            }
+        }
+        for (uint8_t i=10; i<NUM_STATES; i++) {
+            for (uint8_t j=i; j<NUM_STATES; j++) {
+                double err = fabs(Pd[i][j] - ref[i][j]) / sqrt(ref[i][i] * ref[j][j]);
+                if (err > max_err) {
+                    max_err = err;
+                }
+            }
+        }
+    }
+    hal.console->printf_P(PSTR("%u cases: max relative error %.3g %s\n"),
+                          (unsigned)NUM_CHECKS, max_err,
+                          max_err < CHECK_TOLERANCE ? "PASSED" : "FAILED");
+
+    for (uint8_t i=0; i<NUM_STATES; i++) {
+        for (uint8_t j=0; j<NUM_STATES; j++) {
+            Ff[i][j] = F[i][j];
+        }
+    }
+}
+
+void loop(void)
+{
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t n=0; n<NUM_TIMED; n++) {
+        run_kernel(last_case);
+    }
+    uint32_t t_kernel = hal.scheduler->micros() - t0;
+
+    t0 = hal.scheduler->micros();
+    for (uint16_t n=0; n<NUM_TIMED; n++) {
+        dense_float();
+    }
+    uint32_t t_dense = hal.scheduler->micros() - t0;
+
+    hal.console->printf_P(PSTR("kernel %.3f usec dense %.3f usec per prediction\n"),
+                          t_kernel / (float)NUM_TIMED,
+                          t_dense / (float)NUM_TIMED);
+    hal.scheduler->delay(1000);
+}
+
+AP_HAL_MAIN();
@@ -30,6 +30,8 @@
 
 #include <math.h>
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
 
 extern const AP_HAL::HAL &hal;
 
@@ -80,6 +82,21 @@ uint16_t AP_Param::num_param_overrides = 0;
 // storage object
 StorageAccess AP_Param::_storage(StorageManager::StorageParam);
 
+#if AP_PARAM_NAME_INDEX
+struct AP_Param::name_index_entry *AP_Param::_name_index;
+uint16_t AP_Param::_name_index_size;
+#endif
+
+#if AP_PARAM_STORAGE_INDEX
+struct AP_Param::storage_index_entry *AP_Param::_storage_index;
+uint16_t AP_Param::_storage_index_count;
+uint16_t AP_Param::_storage_end = 0xFFFF;
+uint8_t AP_Param::_storage_index_bits;
+
+// smallest storage index, in bits of slot count
+#define STORAGE_INDEX_MIN_BITS 6
+#endif
+
 
 // write to EEPROM
 void AP_Param::eeprom_write_check(const void *ptr, uint16_t ofs, uint8_t size)
@@ -114,6 +131,10 @@ void AP_Param::erase_all(void)
 
     // add a sentinal directly after the header
     write_sentinal(sizeof(struct EEPROM_header));
+
+#if AP_PARAM_STORAGE_INDEX
+    storage_index_reset(sizeof(struct EEPROM_header));
+#endif
 }
 
 // validate a group info table
@@ -237,6 +258,13 @@ bool AP_Param::setup(void)
         erase_all();
     }
 
+#if AP_PARAM_NAME_INDEX
+    build_name_index();
+#endif
+#if AP_PARAM_STORAGE_INDEX
+    build_storage_index();
+#endif
+
     return true;
 }
 
@@ -466,6 +494,17 @@ uint8_t AP_Param::type_size(enum ap_var_type type)
 // if the sentinal isn't found either, the offset is set to 0xFFFF
 bool AP_Param::scan(const AP_Param::Param_header *target, uint16_t *pofs)
 {
+#if AP_PARAM_STORAGE_INDEX
+    if (_storage_index != NULL) {
+        const struct storage_index_entry &e = _storage_index[storage_index_slot(*target)];
+        if (e.ofs != 0) {
+            *pofs = e.ofs;
+            return true;
+        }
+        *pofs = _storage_end;
+        return false;
+    }
+#endif
     struct Param_header phdr;
     uint16_t ofs = sizeof(AP_Param::EEPROM_header);
     while (ofs < _storage.size()) {
@@ -493,6 +532,164 @@ bool AP_Param::scan(const AP_Param::Param_header *target, uint16_t *pofs)
     return false;
 }
 
+#if AP_PARAM_STORAGE_INDEX
+// find the slot holding a header, or the empty slot where it belongs
+uint16_t AP_Param::storage_index_slot(const struct Param_header &phdr)
+{
+    // fibonacci hash of the header
+    uint32_t v = phdr.key | (phdr.type<<8) | (((uint32_t)phdr.group_element)<<14);
+    uint16_t mask = (1U<<_storage_index_bits) - 1;
+    uint16_t i = ((uint32_t)(v * 2654435761UL)) >> (32 - _storage_index_bits);
+    while (_storage_index[i].ofs != 0) {
+        const struct Param_header &h = _storage_index[i].phdr;
+        if (h.key == phdr.key && h.type == phdr.type && h.group_element == phdr.group_element) {
+            break;
+        }
+        i = (i+1) & mask;
+    }
+    return i;
+}
+
+// move the storage index to a table of 1<<bits slots
+bool AP_Param::storage_index_resize(uint8_t bits)
+{
+    struct storage_index_entry *old = _storage_index;
+    uint16_t old_size = old?(1U<<_storage_index_bits):0;
+
+    _storage_index = new storage_index_entry[1U<<bits];
+    if (_storage_index == NULL) {
+        _storage_index = old;
+        return false;
+    }
+    memset(_storage_index, 0, sizeof(_storage_index[0])<<bits);
+    _storage_index_bits = bits;
+    for (uint16_t i=0; i<old_size; i++) {
+        if (old[i].ofs != 0) {
+            _storage_index[storage_index_slot(old[i].phdr)] = old[i];
+        }
+    }
+    delete[] old;
+    return true;
+}
+
+// add a storage record to the index, keeping the first one for a header
+bool AP_Param::storage_index_add(const struct Param_header &phdr, uint16_t ofs)
+{
+    // keep the table at most 3/4 full
+    if ((_storage_index_count+1U)*4 > (3U<<_storage_index_bits) &&
+        !storage_index_resize(_storage_index_bits+1)) {
+        free_storage_index();
+        return false;
+    }
+    struct storage_index_entry &e = _storage_index[storage_index_slot(phdr)];
+    if (e.ofs == 0) {
+        e.phdr = phdr;
+        e.ofs = ofs;
+        _storage_index_count++;
+    }
+    return true;
+}
+
+// start an empty storage index with the sentinal at end
+void AP_Param::storage_index_reset(uint16_t end)
+{
+    free_storage_index();
+    if (storage_index_resize(STORAGE_INDEX_MIN_BITS)) {
+        _storage_end = end;
+    }
+}
+
+void AP_Param::free_storage_index(void)
+{
+    delete[] _storage_index;
+    _storage_index = NULL;
+    _storage_index_count = 0;
+    _storage_end = 0xFFFF;
+}
+
+// build the storage index with one pass over the storage
+bool AP_Param::build_storage_index(void)
+{
+    storage_index_reset(0xFFFF);
+
+    struct Param_header phdr;
+    uint16_t ofs = sizeof(AP_Param::EEPROM_header);
+    while (_storage_index != NULL && ofs < _storage.size()) {
+        _storage.read_block(&phdr, ofs, sizeof(phdr));
+        if (phdr.type == _sentinal_type ||
+            phdr.key == _sentinal_key ||
+            phdr.group_element == _sentinal_group) {
+            _storage_end = ofs;
+            break;
+        }
+        storage_index_add(phdr, ofs);
+        ofs += type_size((enum ap_var_type)phdr.type) + sizeof(phdr);
+    }
+    Debug("storage index %u records end %u",
+          (unsigned)_storage_index_count, (unsigned)_storage_end);
+    return _storage_index != NULL;
+}
+
+/*
+  compact the parameter storage. Kept records only ever move towards
+  the start of storage, so they can be copied one at a time
+ */
+bool AP_Param::compact(uint16_t *bytes_freed)
+{
+    if (!build_storage_index() || _storage_end == 0xFFFF) {
+        return false;
+    }
+
+    struct Param_header phdr;
+    uint8_t buf[sizeof(phdr) + 3*3*4];
+    uint16_t src = sizeof(AP_Param::EEPROM_header);
+    uint16_t dst = src;
+    while (src < _storage_end) {
+        _storage.read_block(&phdr, src, sizeof(phdr));
+        uint8_t size = sizeof(phdr) + type_size((enum ap_var_type)phdr.type);
+        void *ptr;
+        uint16_t first_ofs;
+        if (scan(&phdr, &first_ofs) && first_ofs == src &&
+            find_by_header(phdr, &ptr) != NULL) {
+            if (dst != src) {
+                _storage.read_block(buf, src, size);
+                eeprom_write_check(buf, dst, size);
+            }
+            dst += size;
+        }
+        src += size;
+    }
+
+    uint16_t freed = _storage_end - dst;
+    if (freed != 0) {
+        write_sentinal(dst);
+    }
+    if (bytes_freed != NULL) {
+        *bytes_freed = freed;
+    }
+    Debug("compact freed %u bytes", (unsigned)freed);
+    return build_storage_index();
+}
+#endif // AP_PARAM_STORAGE_INDEX
+
+/*
+  compact the storage if less than 1/16 of it is free
+ */
+bool AP_Param::compact_if_full(void)
+{
+#if AP_PARAM_STORAGE_INDEX
+    if (!build_storage_index() || _storage_end == 0xFFFF) {
+        return false;
+    }
+    if (_storage.size() - _storage_end >= _storage.size() / 16) {
+        return false;
+    }
+    return compact();
+#else
+    return false;
+#endif
+}
+
 /**
  * add a _X, _Y, _Z suffix to the name of a Vector3f element
  * @param buffer
@@ -588,11 +785,126 @@ AP_Param::find_group(const char *name, uint8_t vindex, const struct GroupInfo *g
 }
 
 
+#if AP_PARAM_NAME_INDEX
+// FNV-1a hash of a parameter name, case insensitive to match find()
+uint32_t AP_Param::name_hash(const char *name)
+{
+    uint32_t h = 2166136261UL;
+    while (*name) {
+        h ^= (uint8_t)toupper(*name++);
+        h *= 16777619UL;
+    }
+    return h & 0xFFFFFF;
+}
+
+// order index entries by hash, then in var_info order so duplicate
+// names resolve to the same variable as a linear search would
+int AP_Param::name_index_compare(const void *a, const void *b)
+{
+    const struct name_index_entry *e1 = (const struct name_index_entry *)a;
+    const struct name_index_entry *e2 = (const struct name_index_entry *)b;
+    if (e1->hash != e2->hash) {
+        return e1->hash < e2->hash ? -1 : 1;
+    }
+    if (e1->token.key != e2->token.key) {
+        return e1->token.key < e2->token.key ? -1 : 1;
+    }
+    if (e1->token.group_element != e2->token.group_element) {
+        return e1->token.group_element < e2->token.group_element ? -1 : 1;
+    }
+    return (int)e1->token.idx - (int)e2->token.idx;
+}
+
+/*
+  build the name index. Every variable returned by next() gets an
+  entry except the elements of top level vectors, which find() has
+  never resolved
+ */
+bool AP_Param::build_name_index(void)
+{
+    if (_name_index != NULL) {
+        return true;
+    }
+    if (!initialised()) {
+        return false;
+    }
+
+    ParamToken token;
+    enum ap_var_type type;
+    AP_Param *ap;
+    uint16_t count = 0;
+    for (ap=first(&token, &type); ap; ap=next(&token, &type)) {
+        if (token.idx == 0 || PGM_UINT8(&_var_info[token.key].type) == AP_PARAM_GROUP) {
+            count++;
+        }
+    }
+    if (count == 0) {
+        return false;
+    }
+
+    _name_index = new name_index_entry[count];
+    if (_name_index == NULL) {
+        return false;
+    }
+
+    char name[AP_MAX_NAME_SIZE+1];
+    uint16_t n = 0;
+    for (ap=first(&token, &type); ap && n < count; ap=next(&token, &type)) {
+        if (token.idx != 0 && PGM_UINT8(&_var_info[token.key].type) != AP_PARAM_GROUP) {
+            continue;
+        }
+        ap->copy_name_token(token, name, sizeof(name), token.idx != 0);
+        name[AP_MAX_NAME_SIZE] = 0;
+        _name_index[n].hash = name_hash(name);
+        _name_index[n].type = type;
+        _name_index[n].token = token;
+        _name_index[n].ap = ap;
+        n++;
+    }
+    qsort(_name_index, n, sizeof(_name_index[0]), name_index_compare);
+    _name_index_size = n;
+
+    Debug("name index %u entries", (unsigned)n);
+    return true;
+}
+
+// find a variable by name using the name index
+AP_Param *AP_Param::find_by_name_index(const char *name, enum ap_var_type *ptype)
+{
+    uint32_t h = name_hash(name);
+    uint16_t lo = 0, hi = _name_index_size;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (_name_index[mid].hash < h) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    char name2[AP_MAX_NAME_SIZE+1];
+    for (; lo < _name_index_size && _name_index[lo].hash == h; lo++) {
+        const struct name_index_entry &e = _name_index[lo];
+        e.ap->copy_name_token(e.token, name2, sizeof(name2), e.token.idx != 0);
+        name2[AP_MAX_NAME_SIZE] = 0;
+        if (strcasecmp(name, name2) == 0) {
+            *ptype = (enum ap_var_type)e.type;
+            return e.ap;
+        }
+    }
+    return NULL;
+}
+#endif // AP_PARAM_NAME_INDEX
+
 // Find a variable by name.
 //
 AP_Param *
 AP_Param::find(const char *name, enum ap_var_type *ptype)
 {
+#if AP_PARAM_NAME_INDEX
+    if (_name_index != NULL) {
+        return find_by_name_index(name, ptype);
+    }
+#endif
     for (uint8_t i=0; i<_num_vars; i++) {
         uint8_t type = PGM_UINT8(&_var_info[i].type);
         if (type == AP_PARAM_GROUP) {
@@ -756,6 +1068,11 @@ bool AP_Param::save(bool force_save)
     write_sentinal(ofs + sizeof(phdr) + type_size((enum ap_var_type)phdr.type));
     eeprom_write_check(ap, ofs+sizeof(phdr), type_size((enum ap_var_type)phdr.type));
     eeprom_write_check(&phdr, ofs, sizeof(phdr));
+#if AP_PARAM_STORAGE_INDEX
+    if (_storage_index != NULL && storage_index_add(phdr, ofs)) {
+        _storage_end = ofs + sizeof(phdr) + type_size((enum ap_var_type)phdr.type);
+    }
+#endif
     return true;
 }
 
@@ -893,6 +1210,14 @@ bool AP_Param::load_all(void)
     struct Param_header phdr;
     uint16_t ofs = sizeof(AP_Param::EEPROM_header);
 
+#if AP_PARAM_NAME_INDEX
+    build_name_index();
+#endif
+#if AP_PARAM_STORAGE_INDEX
+    // the index is rebuilt as part of the walk over storage below
+    storage_index_reset(0xFFFF);
+#endif
+
     /*
       if the HAL specifies a defaults parameter file then override
       defaults using that file
@@ -909,8 +1234,18 @@ bool AP_Param::load_all(void)
             phdr.key == _sentinal_key ||
             phdr.group_element == _sentinal_group) {
             // we've reached the sentinal
+#if AP_PARAM_STORAGE_INDEX
+            if (_storage_index != NULL) {
+                _storage_end = ofs;
+            }
+#endif
             return true;
         }
+#if AP_PARAM_STORAGE_INDEX
+        if (_storage_index != NULL) {
+            storage_index_add(phdr, ofs);
+        }
+#endif
 
         const struct AP_Param::Info *info;
         void *ptr;
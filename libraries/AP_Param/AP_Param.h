@@ -34,6 +34,23 @@
 #define AP_MAX_NAME_SIZE 16
 #define AP_NESTED_GROUPS_ENABLED
 
+// on boards with RAM to spare keep a sorted hash index of parameter
+// names, so find() doesn't need to string compare its way through
+// every var_info and group table
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+#define AP_PARAM_NAME_INDEX 1
+#else
+#define AP_PARAM_NAME_INDEX 0
+#endif
+
+// likewise keep a hash table of where each variable lives in storage,
+// so save() and load() don't walk the storage from the start
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_75
+#define AP_PARAM_STORAGE_INDEX 1
+#else
+#define AP_PARAM_STORAGE_INDEX 0
+#endif
+
 // a variant of offsetof() to work around C++ restrictions.
 // this can only be used when the offset of a variable in a object
 // is constant and known at compile time
@@ -262,6 +279,46 @@ public:
     // check var table for consistency
     static bool             check_var_info(void);
 
+#if AP_PARAM_NAME_INDEX
+    /// build the name index used by find(). This is done by setup()
+    /// and load_all(), and is a no-op once the index exists
+    ///
+    /// @return             True if the index is available
+    ///
+    static bool             build_name_index(void);
+#endif
+
+#if AP_PARAM_STORAGE_INDEX
+    /// build the index of storage offsets used by save() and
+    /// load(). This is done by setup(), load_all() and erase_all(),
+    /// and kept up to date by save()
+    ///
+    /// @return             True if the index is available
+    ///
+    static bool             build_storage_index(void);
+
+    /// drop the storage index, falling back to scanning storage
+    static void             free_storage_index(void);
+
+    /// rewrite the parameter storage keeping only the first record
+    /// of each variable still in var_info. Records of removed
+    /// parameters are dropped, so this must not be called before
+    /// convert_old_parameters(). Not safe against power loss, so
+    /// save() never calls it
+    ///
+    /// @param  bytes_freed Optional, set to the number of bytes reclaimed
+    /// @return             True if the storage was compacted
+    ///
+    static bool             compact(uint16_t *bytes_freed=NULL);
+#endif
+
+    /// compact the storage if it is nearly full. Vehicles call this
+    /// once while booting, after convert_old_parameters()
+    ///
+    /// @return             True if the storage was compacted
+    ///
+    static bool             compact_if_full(void);
+
 private:
     /// EEPROM header
     ///
@@ -337,6 +394,19 @@ private:
                                     uint8_t vindex,
                                     const struct GroupInfo *group_info,
                                     enum ap_var_type *ptype);
+#if AP_PARAM_NAME_INDEX
+    static uint32_t             name_hash(const char *name);
+    static int                  name_index_compare(const void *a, const void *b);
+    static AP_Param *           find_by_name_index(
+                                    const char *name,
+                                    enum ap_var_type *ptype);
+#endif
+#if AP_PARAM_STORAGE_INDEX
+    static uint16_t             storage_index_slot(const struct Param_header &phdr);
+    static bool                 storage_index_resize(uint8_t bits);
+    static bool                 storage_index_add(const struct Param_header &phdr, uint16_t ofs);
+    static void                 storage_index_reset(uint16_t end);
+#endif
     static void                 write_sentinal(uint16_t ofs);
     static bool                 scan(
                                     const struct Param_header *phdr,
@@ -375,6 +445,40 @@ private:
     static uint8_t              _num_vars;
     static const struct Info *  _var_info;
 
+#if AP_PARAM_NAME_INDEX
+    /*
+      one entry per name that find() can resolve, sorted by a 24 bit
+      hash of the upper cased name. The name itself is not stored, a
+      candidate is confirmed by regenerating its name from the token
+     */
+    struct name_index_entry {
+        uint32_t hash : 24;
+        uint32_t type : 8;
+        ParamToken token;
+        AP_Param *ap;
+    };
+    static struct name_index_entry *_name_index;
+    static uint16_t             _name_index_size;
+#endif
+
+#if AP_PARAM_STORAGE_INDEX
+    /*
+      open addressed hash table of 1<<_storage_index_bits slots, giving
+      the offset of the first storage record for each header. A slot
+      with an offset of zero is empty, as the EEPROM header lives there.
+      _storage_end is the offset of the sentinal, or 0xFFFF if there
+      is none
+     */
+    struct storage_index_entry {
+        struct Param_header phdr;
+        uint16_t ofs;
+    };
+    static struct storage_index_entry *_storage_index;
+    static uint16_t             _storage_index_count;
+    static uint16_t             _storage_end;
+    static uint8_t              _storage_index_bits;
+#endif
+
     /*
       list of overridden values from load_defaults_file()
     */
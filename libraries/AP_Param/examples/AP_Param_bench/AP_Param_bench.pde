@@ -0,0 +1,316 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+//
+// Benchmark of AP_Param name lookups and storage access, with and
+// without the name and storage indexes
+//
+
+#include <AP_HAL.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_Param.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_PX4.h>
+#include <AP_HAL_Linux.h>
+#include <AP_Math.h>
+#include <Filter.h>
+#include <AP_ADC.h>
+#include <SITL.h>
+#include <AP_Compass.h>
+#include <AP_Baro.h>
+#include <AP_Notify.h>
+#include <AP_InertialSensor.h>
+#include <AP_GPS.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <AP_Mission.h>
+#include <StorageManager.h>
+#include <AP_Terrain.h>
+#include <AP_Declination.h>
+#include <AP_AHRS.h>
+#include <AP_NavEKF.h>
+#include <AP_Airspeed.h>
+#include <AP_Vehicle.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_Rally.h>
+#include <AP_BattMonitor.h>
+#include <AP_RangeFinder.h>
+#include <AP_OpticalFlow.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+#if AP_PARAM_NAME_INDEX
+
+// a parameter group shaped like a PID controller with a trim vector
+class BenchGroup {
+public:
+    static const struct AP_Param::GroupInfo var_info[];
+
+    AP_Float kp;
+    AP_Float ki;
+    AP_Float kd;
+    AP_Int16 imax;
+    AP_Float filt;
+    AP_Vector3f trim;
+};
+
+const AP_Param::GroupInfo BenchGroup::var_info[] PROGMEM = {
+    AP_GROUPINFO("P",    0, BenchGroup, kp,   1.0f),
+    AP_GROUPINFO("I",    1, BenchGroup, ki,   0.1f),
+    AP_GROUPINFO("D",    2, BenchGroup, kd,   0.0f),
+    AP_GROUPINFO("IMAX", 3, BenchGroup, imax, 100),
+    AP_GROUPINFO("FILT", 4, BenchGroup, filt, 20.0f),
+    AP_GROUPINFO("TRIM", 5, BenchGroup, trim, 0),
+    AP_GROUPEND
+};
+
+#define NUM_GROUPS 90
+#define REPEATS    10
+
+static BenchGroup groups[NUM_GROUPS];
+static AP_Int16 format_version;
+static AP_Vector3f top_vector;
+
+// groups G10_ to G99_, using the group number as the key
+#define BENCH_GROUP(n) { AP_PARAM_GROUP, "G" #n "_", n, &groups[n-10], {group_info : BenchGroup::var_info} }
+#define BENCH_GROUPS(t) \
+    BENCH_GROUP(t##0), BENCH_GROUP(t##1), BENCH_GROUP(t##2), BENCH_GROUP(t##3), BENCH_GROUP(t##4), \
+    BENCH_GROUP(t##5), BENCH_GROUP(t##6), BENCH_GROUP(t##7), BENCH_GROUP(t##8), BENCH_GROUP(t##9)
+
+static const AP_Param::Info var_info[] PROGMEM = {
+    { AP_PARAM_INT16,    "FORMAT_VERSION", 0, &format_version, {def_value : 0} },
+    { AP_PARAM_VECTOR3F, "TOP_VEC",        1, &top_vector,     {def_value : 0} },
+    BENCH_GROUPS(1), BENCH_GROUPS(2), BENCH_GROUPS(3),
+    BENCH_GROUPS(4), BENCH_GROUPS(5), BENCH_GROUPS(6),
+    BENCH_GROUPS(7), BENCH_GROUPS(8), BENCH_GROUPS(9),
+    AP_VAREND
+};
+
+static AP_Param param_loader(var_info);
+
+static uint16_t num_names;
+static char (*names)[AP_MAX_NAME_SIZE+1];
+static AP_Param **linear_result;
+static AP_Param **index_result;
+
+// gather the name of every variable, as sent to a GCS
+static void collect_names(void)
+{
+    AP_Param::ParamToken token;
+    AP_Param *ap;
+    for (ap=AP_Param::first(&token, NULL); ap; ap=AP_Param::next(&token, NULL)) {
+        num_names++;
+    }
+    names = (char (*)[AP_MAX_NAME_SIZE+1])calloc(num_names, AP_MAX_NAME_SIZE+1);
+    linear_result = (AP_Param **)calloc(num_names, sizeof(AP_Param *));
+    index_result = (AP_Param **)calloc(num_names, sizeof(AP_Param *));
+    uint16_t i = 0;
+    for (ap=AP_Param::first(&token, NULL); ap && i<num_names; ap=AP_Param::next(&token, NULL)) {
+        ap->copy_name_token(token, names[i], AP_MAX_NAME_SIZE+1, token.idx != 0);
+        i++;
+    }
+}
+
+/*
+  time finding every name, returning the average usec per lookup of
+  the fastest pass, so SITL timer interrupts don't skew the result
+ */
+static float time_find(AP_Param **result)
+{
+    enum ap_var_type type;
+    uint32_t best = 0;
+    for (uint8_t r=0; r<REPEATS; r++) {
+        uint32_t t0 = hal.scheduler->micros();
+        for (uint16_t i=0; i<num_names; i++) {
+            result[i] = AP_Param::find(names[i], &type);
+        }
+        uint32_t dt = hal.scheduler->micros() - t0;
+        if (r == 0 || dt < best) {
+            best = dt;
+        }
+    }
+    return best / (float)num_names;
+}
+
+// time setting every name, as a GCS parameter upload or defaults file would
+static float time_set(void)
+{
+    uint32_t best = 0;
+    for (uint8_t r=0; r<REPEATS; r++) {
+        uint32_t t0 = hal.scheduler->micros();
+        for (uint16_t i=0; i<num_names; i++) {
+            AP_Param::set_param_by_name(names[i], r, NULL);
+        }
+        uint32_t dt = hal.scheduler->micros() - t0;
+        if (r == 0 || dt < best) {
+            best = dt;
+        }
+    }
+    return best / (float)num_names;
+}
+
+static void name_bench(void)
+{
+    hal.console->println("AP_Param name lookup benchmark");
+
+    collect_names();
+    hal.console->printf_P(PSTR("%u names\n"), (unsigned)num_names);
+
+    float find_linear = time_find(linear_result);
+    float set_linear = time_set();
+
+    uint32_t t0 = hal.scheduler->micros();
+    if (!AP_Param::build_name_index()) {
+        hal.console->println("Failed to build name index");
+        return;
+    }
+    uint32_t build_usec = hal.scheduler->micros() - t0;
+
+    float find_index = time_find(index_result);
+    float set_index = time_set();
+
+    // both searches must agree on every name, and be case insensitive
+    uint16_t mismatches = 0;
+    enum ap_var_type type;
+    for (uint16_t i=0; i<num_names; i++) {
+        char lower[AP_MAX_NAME_SIZE+1];
+        for (uint8_t c=0; c<sizeof(lower); c++) {
+            lower[c] = tolower(names[i][c]);
+        }
+        if (index_result[i] != linear_result[i] ||
+            AP_Param::find(lower, &type) != linear_result[i]) {
+            hal.console->printf_P(PSTR("mismatch for %s\n"), names[i]);
+            mismatches++;
+        }
+    }
+
+    hal.console->printf_P(PSTR("index build: %lu usec\n"), (unsigned long)build_usec);
+    hal.console->printf_P(PSTR("find:   linear %.3f usec  indexed %.3f usec\n"),
+                          find_linear, find_index);
+    hal.console->printf_P(PSTR("set:    linear %.3f usec  indexed %.3f usec\n"),
+                          set_linear, set_index);
+    hal.console->printf_P(PSTR("%u mismatches\n"), (unsigned)mismatches);
+}
+
+#if AP_PARAM_STORAGE_INDEX
+#define NUM_STORED (NUM_GROUPS*4)
+static AP_Float *stored[NUM_STORED];
+
+// give every stored variable a distinct non-default value
+static void set_stored(void)
+{
+    for (uint16_t i=0; i<NUM_STORED; i++) {
+        stored[i]->set((i+1) * 0.5f);
+    }
+}
+
+// time saving every stored variable, returning usec per save
+static float time_save(void)
+{
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_STORED; i++) {
+        stored[i]->save();
+    }
+    return (hal.scheduler->micros() - t0) / (float)NUM_STORED;
+}
+
+// time loading every stored variable, returning usec per load
+static float time_load(uint16_t *bad)
+{
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t i=0; i<NUM_STORED; i++) {
+        stored[i]->set(0);
+        stored[i]->load();
+    }
+    uint32_t dt = hal.scheduler->micros() - t0;
+    for (uint16_t i=0; i<NUM_STORED; i++) {
+        if (!is_equal(stored[i]->get(), (i+1) * 0.5f)) {
+            (*bad)++;
+        }
+    }
+    return dt / (float)NUM_STORED;
+}
+
+static void storage_bench(void)
+{
+    hal.console->println("AP_Param storage benchmark");
+
+    for (uint16_t i=0; i<NUM_GROUPS; i++) {
+        stored[i*4+0] = &groups[i].kp;
+        stored[i*4+1] = &groups[i].ki;
+        stored[i*4+2] = &groups[i].kd;
+        stored[i*4+3] = &groups[i].filt;
+    }
+    uint16_t bad = 0;
+
+    // without the index each save and load scans storage from the start
+    AP_Param::erase_all();
+    AP_Param::free_storage_index();
+    set_stored();
+    float save_linear = time_save();
+    float load_linear = time_load(&bad);
+
+    // a boot, which builds the index as it reads storage
+    set_stored();
+    uint32_t t0 = hal.scheduler->micros();
+    AP_Param::load_all();
+    uint32_t load_all_usec = hal.scheduler->micros() - t0;
+    float load_index = time_load(&bad);
+
+    // saving into fresh storage with the index kept up to date
+    AP_Param::erase_all();
+    set_stored();
+    float save_index = time_save();
+    float reload_index = time_load(&bad);
+
+    // records written through the index must be found by a scan
+    AP_Param::free_storage_index();
+    time_load(&bad);
+
+    uint16_t freed = 0;
+    t0 = hal.scheduler->micros();
+    if (!AP_Param::compact(&freed)) {
+        hal.console->println("compact failed");
+    }
+    uint32_t compact_usec = hal.scheduler->micros() - t0;
+    time_load(&bad);
+
+    hal.console->printf_P(PSTR("%u stored variables\n"), (unsigned)NUM_STORED);
+    hal.console->printf_P(PSTR("load_all: %lu usec\n"), (unsigned long)load_all_usec);
+    hal.console->printf_P(PSTR("save:   linear %.2f usec  indexed %.2f usec\n"),
+                          save_linear, save_index);
+    hal.console->printf_P(PSTR("load:   linear %.2f usec  indexed %.2f/%.2f usec\n"),
+                          load_linear, load_index, reload_index);
+    hal.console->printf_P(PSTR("compact: %lu usec, %u bytes freed\n"),
+                          (unsigned long)compact_usec, (unsigned)freed);
+    hal.console->printf_P(PSTR("%u bad values\n"), (unsigned)bad);
+}
+#endif // AP_PARAM_STORAGE_INDEX
+
+void setup(void)
+{
+    name_bench();
+#if AP_PARAM_STORAGE_INDEX
+    storage_bench();
+#endif
+}
+
+#else // AP_PARAM_NAME_INDEX
+
+void setup(void)
+{
+    hal.console->println("AP_Param name index not available on this board");
+}
+
+#endif // AP_PARAM_NAME_INDEX
+
+void loop(void)
+{
+    hal.scheduler->delay(1000);
+}
+
+AP_HAL_MAIN();
@@ -31,10 +31,29 @@ int8_t AP_Scheduler::current_task = -1;
 const AP_Param::GroupInfo AP_Scheduler::var_info[] PROGMEM = {
     // @Param: DEBUG
     // @DisplayName: Scheduler debug level
-    // @Description: Set to non-zero to enable scheduler debug messages. When set to show "Slips" the scheduler will display a message whenever a scheduled task is delayed due to too much CPU load. When set to ShowOverruns the scheduled will display a message whenever a task takes longer than the limit promised in the task table.
-    // @Values: 0:Disabled,2:ShowSlips,3:ShowOverruns
+    // @Description: Set to non-zero to enable scheduler debug messages and to stream per-task timing statistics to the ground station. When set to show "Slips" the scheduler will display a message whenever a scheduled task is delayed due to too much CPU load. When set to ShowOverruns the scheduled will display a message whenever a task takes longer than the limit promised in the task table.
+    // @Values: 0:Disabled,1:ShowStats,2:ShowSlips,3:ShowOverruns
     // @User: Advanced
     AP_GROUPINFO("DEBUG",    0, AP_Scheduler, _debug, 0),
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    // @Param: DEADLINE
+    // @DisplayName: Scheduler deadline ordering
+    // @Description: When enabled the tasks that are due are run in order of earliest deadline instead of in task table order, and the scheduler stops looking for work as soon as none of the remaining due tasks can fit in the time left
+    // @Values: 0:Disabled,1:Enabled
+    // @User: Advanced
+    AP_GROUPINFO("DEADLINE", 1, AP_Scheduler, _deadline, 0),
+#endif
+
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+    // @Param: OFFLOAD
+    // @DisplayName: Scheduler task offload
+    // @Description: When enabled, tasks marked as offloadable in the vehicle's task table are run on a worker thread on another CPU core, on boards that have more than one core. This frees main loop time for the flight controllers. Takes effect after a reboot
+    // @Values: 0:Disabled,1:Enabled
+    // @User: Advanced
+    AP_GROUPINFO("OFFLOAD",  2, AP_Scheduler, _offload, 0),
+#endif
+
     AP_GROUPEND
 };
 
@@ -46,6 +65,31 @@ void AP_Scheduler::init(const AP_Scheduler::Task *tasks, uint8_t num_tasks)
     _last_run = new uint16_t[_num_tasks];
     memset(_last_run, 0, sizeof(_last_run[0]) * _num_tasks);
     _tick_counter = 0;
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    _task_stats = new TaskStats[_num_tasks];
+    _due = new uint8_t[_num_tasks];
+    _due_slack = new int32_t[_num_tasks];
+    _due_min_budget = new uint16_t[_num_tasks];
+    _stats_send_index = 0;
+    reset_task_stats();
+#endif
+
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+    if (_offload) {
+        // room for a request and a result from every task at once
+        uint32_t ring_size = 1;
+        while (ring_size < _num_tasks * sizeof(struct offload_result)) {
+            ring_size <<= 1;
+        }
+        _offload_requests = new ByteBuffer(ring_size);
+        _offload_results = new ByteBuffer(ring_size);
+        _in_flight = new bool[_num_tasks];
+        memset(_in_flight, 0, sizeof(_in_flight[0]) * _num_tasks);
+        _offload_dt = new uint16_t[_num_tasks];
+        _worker_running = hal.scheduler->start_worker_thread(AP_HAL_MEMBERPROC(&AP_Scheduler::worker_tick));
+    }
+#endif
 }
 
 // one tick has passed
@@ -55,18 +99,57 @@ void AP_Scheduler::tick(void)
 }
 
 /*
-  run one tick
-  this will run as many scheduler tasks as we can in the specified time
+  run task i, which became due dt ticks ago. now is the start time
+  and is updated to the end time. Returns the time the task took
  */
-void AP_Scheduler::run(uint16_t time_available)
+uint32_t AP_Scheduler::run_task(uint8_t i, uint16_t dt, uint32_t &now)
 {
-    uint32_t run_started_usec = hal.scheduler->micros();
-    uint32_t now = run_started_usec;
+    _task_time_started = now;
+    task_fn_t func = (task_fn_t)pgm_read_pointer(&_tasks[i].function);
+    current_task = i;
+    func();
+    current_task = -1;
 
+    // record the tick counter when we ran. This drives
+    // when we next run the event
+    _last_run[i] = _tick_counter;
+
+    // work out how long the event actually took
+    now = hal.scheduler->micros();
+    uint32_t time_taken = now - _task_time_started;
+
+    if (time_taken > _task_time_allowed) {
+        // the event overran!
+        if (_debug > 2) {
+            hal.console->printf_P(PSTR("Scheduler overrun task[%u] (%u/%u)\n"),
+                                  (unsigned)i, 
+                                  (unsigned)time_taken,
+                                  (unsigned)_task_time_allowed);
+        }
+    }
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    update_task_stats(i, dt, time_taken);
+#endif
+
+    return time_taken;
+}
+
+/*
+  run due tasks in the order of the task table. Returns true if we
+  ran out of time
+ */
+bool AP_Scheduler::run_table_order(uint16_t &time_available, uint32_t &now)
+{
     for (uint8_t i=0; i<_num_tasks; i++) {
         uint16_t dt = _tick_counter - _last_run[i];
         uint16_t interval_ticks = pgm_read_word(&_tasks[i].interval_ticks);
         if (dt >= interval_ticks) {
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+            if (offload_task(i, dt)) {
+                continue;
+            }
+#endif
             // this task is due to run. Do we have enough time to run it?
             _task_time_allowed = pgm_read_word(&_tasks[i].max_time_micros);
 
@@ -83,41 +166,282 @@ void AP_Scheduler::run(uint16_t time_available)
             
             if (_task_time_allowed <= time_available) {
                 // run it
-                _task_time_started = now;
-                task_fn_t func = (task_fn_t)pgm_read_pointer(&_tasks[i].function);
-                current_task = i;
-                func();
-                current_task = -1;
-                
-                // record the tick counter when we ran. This drives
-                // when we next run the event
-                _last_run[i] = _tick_counter;
-                
-                // work out how long the event actually took
-                now = hal.scheduler->micros();
-                uint32_t time_taken = now - _task_time_started;
-                
-                if (time_taken > _task_time_allowed) {
-                    // the event overran!
-                    if (_debug > 2) {
-                        hal.console->printf_P(PSTR("Scheduler overrun task[%u] (%u/%u)\n"),
-                                              (unsigned)i, 
-                                              (unsigned)time_taken,
-                                              (unsigned)_task_time_allowed);
-                    }
-                }
+                uint32_t time_taken = run_task(i, dt, now);
                 if (time_taken >= time_available) {
-                    goto update_spare_ticks;
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+                    for (uint8_t j=i+1; j<_num_tasks; j++) {
+                        if ((uint16_t)(_tick_counter - _last_run[j]) >= pgm_read_word(&_tasks[j].interval_ticks)) {
+                            count_skipped(j);
+                        }
+                    }
+#endif
+                    return true;
                 }
                 time_available -= time_taken;
+            } else {
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+                count_skipped(i);
+#endif
+            }
+        }
+    }
+    return false;
+}
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+/*
+  run due tasks in order of earliest deadline. A task that last ran at
+  tick T with interval I becomes due at T+I and we treat T+2I, when it
+  would be due again, as its deadline. Returns true if we ran out of
+  time
+ */
+bool AP_Scheduler::run_deadline_order(uint16_t &time_available, uint32_t &now)
+{
+    // gather the due tasks sorted by the number of ticks left until
+    // their deadline. The insertion is stable, so tasks with the
+    // same deadline keep their table order
+    uint8_t num_due = 0;
+    for (uint8_t i=0; i<_num_tasks; i++) {
+        uint16_t dt = _tick_counter - _last_run[i];
+        uint16_t interval_ticks = pgm_read_word(&_tasks[i].interval_ticks);
+        if (dt < interval_ticks) {
+            continue;
+        }
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+        if (offload_task(i, dt)) {
+            continue;
+        }
+#endif
+        if (dt >= interval_ticks*2 && _debug > 1) {
+            hal.console->printf_P(PSTR("Scheduler slip task[%u] (%u/%u/%u)\n"),
+                                  (unsigned)i, 
+                                  (unsigned)dt,
+                                  (unsigned)interval_ticks,
+                                  (unsigned)task_budget(i));
+        }
+        int32_t slack = 2*(int32_t)interval_ticks - dt;
+        uint8_t j = num_due++;
+        while (j > 0 && _due_slack[j-1] > slack) {
+            _due[j] = _due[j-1];
+            _due_slack[j] = _due_slack[j-1];
+            j--;
+        }
+        _due[j] = i;
+        _due_slack[j] = slack;
+    }
+    if (num_due == 0) {
+        return false;
+    }
+
+    // the smallest budget from each position onwards, so we can stop
+    // as soon as none of the remaining tasks can fit
+    _due_min_budget[num_due-1] = task_budget(_due[num_due-1]);
+    for (int16_t k=num_due-2; k>=0; k--) {
+        _due_min_budget[k] = min(task_budget(_due[k]), _due_min_budget[k+1]);
+    }
+
+    for (uint8_t k=0; k<num_due; k++) {
+        if (_due_min_budget[k] > time_available) {
+            for (; k<num_due; k++) {
+                count_skipped(_due[k]);
             }
+            return false;
+        }
+        uint8_t i = _due[k];
+        _task_time_allowed = task_budget(i);
+        if (_task_time_allowed > time_available) {
+            count_skipped(i);
+            continue;
         }
+        uint32_t time_taken = run_task(i, _tick_counter - _last_run[i], now);
+        if (time_taken >= time_available) {
+            for (k++; k<num_due; k++) {
+                count_skipped(_due[k]);
+            }
+            return true;
+        }
+        time_available -= time_taken;
+    }
+    return false;
+}
+
+/*
+  record a run of task i which became due dt ticks ago
+ */
+void AP_Scheduler::update_task_stats(uint8_t i, uint16_t dt, uint32_t time_taken)
+{
+    TaskStats &stats = _task_stats[i];
+    uint16_t t = time_taken > 0xFFFF ? 0xFFFF : time_taken;
+    if (stats.runs == 0 || t < stats.min_micros) {
+        stats.min_micros = t;
+    }
+    if (t > stats.max_micros) {
+        stats.max_micros = t;
+    }
+    stats.runs++;
+    stats.total_micros += time_taken;
+    if (time_taken > task_budget(i) && stats.overruns != 0xFFFF) {
+        stats.overruns++;
     }
 
-    // update number of spare microseconds
-    _spare_micros += time_available;
+    uint16_t late = dt - pgm_read_word(&_tasks[i].interval_ticks);
+    uint8_t bin;
+    if (late < 2) {
+        bin = late;
+    } else if (late < 4) {
+        bin = 2;
+    } else {
+        bin = 3;
+    }
+    if (stats.slips[bin] != 0xFFFF) {
+        stats.slips[bin]++;
+    }
+}
+
+/*
+  record that task i was due but didn't fit in the time left
+ */
+void AP_Scheduler::count_skipped(uint8_t i)
+{
+    if (_task_stats[i].skipped != 0xFFFF) {
+        _task_stats[i].skipped++;
+    }
+}
+
+void AP_Scheduler::reset_task_stats(void)
+{
+    memset(_task_stats, 0, sizeof(_task_stats[0]) * _num_tasks);
+}
+
+/*
+  send the statistics for one task, cycling through the task table on
+  successive calls
+ */
+void AP_Scheduler::send_task_stats(mavlink_channel_t chan)
+{
+    if (_num_tasks == 0) {
+        return;
+    }
+    if (_stats_send_index >= _num_tasks) {
+        _stats_send_index = 0;
+    }
+    uint8_t i = _stats_send_index++;
+    const TaskStats &stats = _task_stats[i];
+
+    struct sched_stats_packet pkt;
+    pkt.task          = i;
+    pkt.num_tasks     = _num_tasks;
+    pkt.budget_micros = task_budget(i);
+    pkt.min_micros    = stats.min_micros;
+    pkt.avg_micros    = stats.runs ? stats.total_micros / stats.runs : 0;
+    pkt.max_micros    = stats.max_micros;
+    pkt.runs          = stats.runs;
+    pkt.overruns      = stats.overruns;
+    pkt.skipped       = stats.skipped;
+    memcpy(pkt.slips, stats.slips, sizeof(pkt.slips));
+
+    uint8_t data[32];
+    memset(data, 0, sizeof(data));
+    memcpy(data, &pkt, sizeof(pkt));
+    mavlink_msg_data32_send(chan, DATAMSG_TYPE_SCHED_STATS, sizeof(pkt), data);
+}
+#endif // AP_SCHEDULER_EXTENDED_AVAILABLE
+
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+/*
+  hand a due task to the worker thread if it is flagged for
+  offload. Returns true if the worker is looking after the task,
+  either from now or from an earlier tick
+ */
+bool AP_Scheduler::offload_task(uint8_t i, uint16_t dt)
+{
+    if (!_worker_running ||
+        !(pgm_read_byte(&_tasks[i].flags) & AP_SCHEDULER_FLAG_OFFLOAD)) {
+        return false;
+    }
+    if (_in_flight[i]) {
+        // still running from an earlier tick
+        return true;
+    }
+    if (_offload_requests->write(&i, 1) != 1) {
+        return false;
+    }
+    _in_flight[i] = true;
+    _offload_dt[i] = dt;
+    _last_run[i] = _tick_counter;
+    return true;
+}
+
+/*
+  pick up the results of tasks the worker has finished
+ */
+void AP_Scheduler::collect_offload_results(void)
+{
+    struct offload_result r;
+    while (_offload_results->available() >= sizeof(r)) {
+        _offload_results->read((uint8_t *)&r, sizeof(r));
+        _in_flight[r.task] = false;
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+        update_task_stats(r.task, _offload_dt[r.task], r.time_taken);
+#endif
+    }
+}
+
+/*
+  called repeatedly on the worker thread. Runs the next offloaded task,
+  or sleeps briefly if there is none
+ */
+void AP_Scheduler::worker_tick(void)
+{
+    uint8_t i;
+    if (_offload_requests->read(&i, 1) != 1) {
+        hal.scheduler->delay_microseconds(250);
+        return;
+    }
+
+    uint32_t start = hal.scheduler->micros();
+    task_fn_t func = (task_fn_t)pgm_read_pointer(&_tasks[i].function);
+    func();
+
+    struct offload_result r;
+    r.task = i;
+    r.time_taken = hal.scheduler->micros() - start;
+
+    // each task has at most one request outstanding and the ring has
+    // room for a result from every task, so this can't fail
+    _offload_results->write((const uint8_t *)&r, sizeof(r));
+}
+#endif // AP_SCHEDULER_OFFLOAD_AVAILABLE
+
+/*
+  run one tick
+  this will run as many scheduler tasks as we can in the specified time
+ */
+void AP_Scheduler::run(uint16_t time_available)
+{
+    uint32_t now = hal.scheduler->micros();
+    bool out_of_time;
+
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+    if (_worker_running) {
+        collect_offload_results();
+    }
+#endif
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    if (_deadline) {
+        out_of_time = run_deadline_order(time_available, now);
+    } else
+#endif
+    {
+        out_of_time = run_table_order(time_available, now);
+    }
+
+    if (!out_of_time) {
+        // update number of spare microseconds
+        _spare_micros += time_available;
+    }
 
-update_spare_ticks:
     _spare_ticks++;
     if (_spare_ticks == 32) {
         _spare_ticks /= 2;
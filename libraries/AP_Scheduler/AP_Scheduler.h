@@ -24,6 +24,46 @@
 #define AP_SCHEDULER_H
 
 #include <AP_Param.h>
+#include <GCS_MAVLink.h>
+
+// deadline ordering and per-task statistics need more RAM than the
+// AVR boards have to spare
+#ifndef AP_SCHEDULER_EXTENDED_AVAILABLE
+#define AP_SCHEDULER_EXTENDED_AVAILABLE (HAL_CPU_CLASS >= HAL_CPU_CLASS_75)
+#endif
+
+// running tasks on a worker thread needs a HAL with threads
+#ifndef AP_SCHEDULER_OFFLOAD_AVAILABLE
+#define AP_SCHEDULER_OFFLOAD_AVAILABLE (HAL_CPU_CLASS >= HAL_CPU_CLASS_150)
+#endif
+
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+#include "../AP_HAL/utility/RingBuffer.h"
+#endif
+
+// task flags
+#define AP_SCHEDULER_FLAG_OFFLOAD 1 // may run on a worker thread
+
+// number of bins in the per-task slip histogram. A task that runs
+// 0, 1, 2-3 or 4+ ticks after it became due is counted in bin 0 to 3
+#define AP_SCHEDULER_SLIP_BINS 4
+
+// DATA32 packet type used to send per-task statistics, with the
+// payload laid out as below
+#define DATAMSG_TYPE_SCHED_STATS 0xFD
+
+struct PACKED sched_stats_packet {
+    uint8_t task;
+    uint8_t num_tasks;
+    uint16_t budget_micros;
+    uint16_t min_micros;
+    uint16_t avg_micros;
+    uint16_t max_micros;
+    uint32_t runs;
+    uint16_t overruns;
+    uint16_t skipped;
+    uint16_t slips[AP_SCHEDULER_SLIP_BINS];
+};
 
 /*
   A task scheduler for APM main loops
@@ -33,6 +73,15 @@
 
   To run tasks use scheduler.run(), passing the amount of time that
   the scheduler is allowed to use before it must return
+
+  With SCHED_DEADLINE set, due tasks are run in order of earliest
+  deadline rather than in table order, where a task's deadline is the
+  tick at which it would next become due
+
+  With SCHED_OFFLOAD set, tasks flagged AP_SCHEDULER_FLAG_OFFLOAD are
+  handed to a worker thread on another core when the HAL provides
+  one. Such tasks must be safe to run concurrently with the main loop
+  and must not use time_available_usec()
  */
 
 class AP_Scheduler
@@ -44,6 +93,7 @@ public:
 		task_fn_t function;
 		uint16_t interval_ticks;
 		uint16_t max_time_micros;
+		uint8_t flags;
 	};
 
 	// initialise scheduler
@@ -73,9 +123,36 @@ public:
     // current running task, or -1 if none. Used to debug stuck tasks
     static int8_t current_task;
 
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    // timing statistics for one task, accumulated since boot or the
+    // last reset_task_stats()
+    struct TaskStats {
+        uint32_t runs;          // number of times the task has run
+        uint64_t total_micros;  // total run time
+        uint16_t min_micros;
+        uint16_t max_micros;
+        uint16_t overruns;      // runs longer than max_time_micros
+        uint16_t skipped;       // times it was due but didn't fit
+        uint16_t slips[AP_SCHEDULER_SLIP_BINS];
+    };
+
+    uint8_t num_tasks(void) const { return _num_tasks; }
+    uint16_t task_budget(uint8_t i) const { return pgm_read_word(&_tasks[i].max_time_micros); }
+    const TaskStats &task_stats(uint8_t i) const { return _task_stats[i]; }
+    void reset_task_stats(void);
+
+    // send the statistics for the next task in turn as a DATA32 message
+    void send_task_stats(mavlink_channel_t chan);
+#endif
+
 private:
 	// used to enable scheduler debugging
 	AP_Int8 _debug;
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    // run due tasks in earliest deadline order
+    AP_Int8 _deadline;
+#endif
 	
 	// progmem list of tasks to run
 	const struct Task *_tasks;
@@ -101,6 +178,54 @@ private:
 
     // number of ticks that _spare_micros is counted over
     uint8_t _spare_ticks;
+
+    uint32_t run_task(uint8_t i, uint16_t dt, uint32_t &now);
+    bool run_table_order(uint16_t &time_available, uint32_t &now);
+
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    bool run_deadline_order(uint16_t &time_available, uint32_t &now);
+    void update_task_stats(uint8_t i, uint16_t dt, uint32_t time_taken);
+    void count_skipped(uint8_t i);
+
+    TaskStats *_task_stats;
+
+    // workspace for run_deadline_order(): the due tasks sorted by
+    // deadline, the ticks left until each one's deadline and the
+    // smallest budget of the tasks from each position onwards
+    uint8_t *_due;
+    int32_t *_due_slack;
+    uint16_t *_due_min_budget;
+
+    // next task to report in send_task_stats()
+    uint8_t _stats_send_index;
+#endif
+
+#if AP_SCHEDULER_OFFLOAD_AVAILABLE
+    // run flagged tasks on a worker thread
+    AP_Int8 _offload;
+
+    // completion record passed back from the worker thread
+    struct offload_result {
+        uint8_t task;
+        uint32_t time_taken;
+    };
+
+    bool _worker_running;
+
+    // task numbers queued for the worker, and results coming back.
+    // Each is a single producer, single consumer lock-free ring
+    ByteBuffer *_offload_requests;
+    ByteBuffer *_offload_results;
+
+    // per-task flag set while the task is with the worker, and the
+    // number of ticks it was late when it was handed over
+    bool *_in_flight;
+    uint16_t *_offload_dt;
+
+    bool offload_task(uint8_t i, uint16_t dt);
+    void collect_offload_results(void);
+    void worker_tick(void);
+#endif
 };
 
 #endif // AP_SCHEDULER_H
@@ -54,12 +54,14 @@ static uint32_t ins_counter;
 /*
   scheduler table - all regular tasks are listed here, along with how
   often they should be called (in 20ms units) and the maximum time
-  they are expected to take (in microseconds)
+  they are expected to take (in microseconds). The five second call
+  is flagged so that it runs on a worker thread when SCHED_OFFLOAD is
+  set and the board has a spare core
  */
 static const AP_Scheduler::Task scheduler_tasks[] PROGMEM = {
     { ins_update,             1,   1000 },
     { one_hz_print,          50,   1000 },
-    { five_second_call,     250,   1800 },
+    { five_second_call,     250,   1800, AP_SCHEDULER_FLAG_OFFLOAD },
 };
 
 
@@ -108,6 +110,19 @@ static void one_hz_print(void)
 static void five_second_call(void)
 {
     hal.console->printf("five_seconds: t=%lu ins_counter=%u\n", hal.scheduler->millis(), ins_counter);
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    for (uint8_t i=0; i<scheduler.num_tasks(); i++) {
+        const AP_Scheduler::TaskStats &stats = scheduler.task_stats(i);
+        hal.console->printf("task[%u] runs=%lu min=%u avg=%lu max=%u overruns=%u skipped=%u\n",
+                            (unsigned)i,
+                            (unsigned long)stats.runs,
+                            (unsigned)stats.min_micros,
+                            (unsigned long)(stats.runs ? stats.total_micros / stats.runs : 0),
+                            (unsigned)stats.max_micros,
+                            (unsigned)stats.overruns,
+                            (unsigned)stats.skipped);
+    }
+#endif
 }
 
 AP_HAL_MAIN();
@@ -49,6 +49,15 @@ const AP_Param::GroupInfo AP_Terrain::var_info[] PROGMEM = {
     // @Increment: 1
     AP_GROUPINFO("SPACING",   1, AP_Terrain, grid_spacing, 100),
 
+#if TERRAIN_LARGE_CACHE
+    // @Param: CACHE_SZ
+    // @DisplayName: Terrain cache size
+    // @Description: Number of terrain grid blocks kept in memory. Each block takes a little under 2 kilobytes and covers 28 by 32 grid points. Changes take effect after a reboot.
+    // @Range: 12 4096
+    // @User: Advanced
+    AP_GROUPINFO("CACHE_SZ",  2, AP_Terrain, cache_size_param, TERRAIN_LARGE_CACHE_DEFAULT),
+#endif
+
     AP_GROUPEND
 };
 
@@ -67,11 +76,31 @@ AP_Terrain::AP_Terrain(AP_AHRS &_ahrs, const AP_Mission &_mission, const AP_Rall
     directory_created(false),
     home_height(0),
     have_current_loc_height(false),
-    last_current_loc_height(0)
+    last_current_loc_height(0),
+    prefetch_path_len(0),
+    prefetch_sweep(0),
+    prefetch_spacing(0),
+    prefetch_queue_len(0),
+    corridor_samples(0),
+    corridor_horizon(0),
+    corridor_coverage(0),
+    corridor_legs(0),
+    lookahead_distance(0)
 {
     AP_Param::setup_object_defaults(this, var_info);
     memset(&home_loc, 0, sizeof(home_loc));
     memset(&disk_block, 0, sizeof(disk_block));
+#if TERRAIN_LARGE_CACHE
+    cache = NULL;
+    cache_size = 0;
+    cache_hash = NULL;
+    cache_hash_mask = 0;
+    lru_head = lru_tail = cache_none;
+    memset(mapped, 0, sizeof(mapped));
+    for (uint8_t i=0; i<TERRAIN_MAPPED_FILES; i++) {
+        mapped[i].fd = -1;
+    }
+#endif
 }
 
 /*
@@ -147,6 +176,114 @@ bool AP_Terrain::height_amsl(const Location &loc, float &height)
 }
 
 
+/*
+  return terrain heights for up to TERRAIN_BATCH_SIZE points. The
+  block for each point is found from the previous point's block where
+  possible, without the trigonometry and cache search of
+  height_amsl(). The corner heights are gathered first and then
+  interpolated in one straight loop over the arrays, which the
+  compiler can vectorise
+ */
+uint8_t AP_Terrain::height_amsl_batch(const Location *locs, uint8_t count, float *heights,
+                                      bool *available, struct batch_cursor &cursor)
+{
+    float h00[TERRAIN_BATCH_SIZE], h01[TERRAIN_BATCH_SIZE];
+    float h10[TERRAIN_BATCH_SIZE], h11[TERRAIN_BATCH_SIZE];
+    float frac_x[TERRAIN_BATCH_SIZE], frac_y[TERRAIN_BATCH_SIZE];
+    bool valid[TERRAIN_BATCH_SIZE];
+
+    for (uint8_t i=0; i<count; i++) {
+        const Location &loc = locs[i];
+        struct grid_info info;
+        int8_t lat_degrees = (loc.lat<0?(loc.lat-9999999L):loc.lat) / (10*1000*1000L);
+        int16_t lon_degrees = (loc.lng<0?(loc.lng-9999999L):loc.lng) / (10*1000*1000L);
+        bool same_block = false;
+        if (cursor.gcache != NULL &&
+            lat_degrees == cursor.lat_degrees &&
+            lon_degrees == cursor.lon_degrees) {
+            // within a degree square the offset from the reference is
+            // linear in lat/lng, using the scale of the reference
+            Vector2f offset((loc.lat - cursor.ref.lat) * LOCATION_SCALING_FACTOR,
+                            (loc.lng - cursor.ref.lng) * LOCATION_SCALING_FACTOR * cursor.scale);
+            calculate_grid_indices(offset, info);
+            same_block = (info.grid_idx_x == cursor.grid_idx_x &&
+                          info.grid_idx_y == cursor.grid_idx_y);
+        }
+        if (!same_block) {
+            calculate_grid_info(loc, info);
+            cursor.gcache = &find_grid_cache(info);
+            cursor.lat_degrees = info.lat_degrees;
+            cursor.lon_degrees = info.lon_degrees;
+            cursor.ref.lat = info.lat_degrees*10*1000*1000L;
+            cursor.ref.lng = info.lon_degrees*10*1000*1000L;
+            cursor.scale = longitude_scale(cursor.ref);
+            cursor.grid_idx_x = info.grid_idx_x;
+            cursor.grid_idx_y = info.grid_idx_y;
+        }
+
+        const struct grid_block &grid = cursor.gcache->grid;
+        valid[i] = (check_bitmap(grid, info.idx_x,   info.idx_y) &&
+                    check_bitmap(grid, info.idx_x,   info.idx_y+1) &&
+                    check_bitmap(grid, info.idx_x+1, info.idx_y) &&
+                    check_bitmap(grid, info.idx_x+1, info.idx_y+1));
+        if (valid[i]) {
+            h00[i] = grid.height[info.idx_x+0][info.idx_y+0];
+            h01[i] = grid.height[info.idx_x+0][info.idx_y+1];
+            h10[i] = grid.height[info.idx_x+1][info.idx_y+0];
+            h11[i] = grid.height[info.idx_x+1][info.idx_y+1];
+            frac_x[i] = info.frac_x;
+            frac_y[i] = info.frac_y;
+        } else {
+            h00[i] = h01[i] = h10[i] = h11[i] = 0;
+            frac_x[i] = frac_y[i] = 0;
+        }
+    }
+
+    // the same dual linear interpolation as height_amsl()
+    for (uint8_t i=0; i<count; i++) {
+        float avg1 = (1.0f-frac_x[i]) * h00[i] + frac_x[i] * h10[i];
+        float avg2 = (1.0f-frac_x[i]) * h01[i] + frac_x[i] * h11[i];
+        heights[i] = (1.0f-frac_y[i]) * avg1 + frac_y[i] * avg2;
+    }
+
+    uint8_t found = 0;
+    for (uint8_t i=0; i<count; i++) {
+        if (valid[i]) {
+            found++;
+        }
+        if (available != NULL) {
+            available[i] = valid[i];
+        }
+    }
+    return found;
+}
+
+/*
+  return terrain heights in meters above sea level for a set of points
+ */
+uint16_t AP_Terrain::height_amsl_points(const Location *locs, uint16_t count,
+                                        float *heights, bool *available)
+{
+    if (!enable || grid_spacing <= 0) {
+        memset(heights, 0, count*sizeof(heights[0]));
+        if (available != NULL) {
+            memset(available, 0, count*sizeof(available[0]));
+        }
+        return 0;
+    }
+
+    struct batch_cursor cursor;
+    cursor.gcache = NULL;
+    uint16_t found = 0;
+    for (uint16_t i=0; i<count; i += TERRAIN_BATCH_SIZE) {
+        uint8_t n = min(count - i, TERRAIN_BATCH_SIZE);
+        found += height_amsl_batch(&locs[i], n, &heights[i],
+                                   available != NULL ? &available[i] : NULL,
+                                   cursor);
+    }
+    return found;
+}
+
 /* 
    find difference between home terrain height and the terrain height
    at a given location, in meters. A positive result means the terrain
@@ -254,6 +391,11 @@ float AP_Terrain::lookahead(float bearing, float distance, float climb_ratio)
         return 0;
     }
 
+    // make sure the prefetcher looks at least this far ahead
+    if (distance > lookahead_distance) {
+        lookahead_distance = distance;
+    }
+
     Location loc;
     if (!ahrs.get_position(loc)) {
         // we don't know where we are
@@ -268,16 +410,28 @@ float AP_Terrain::lookahead(float bearing, float distance, float climb_ratio)
     float climb = 0;
     float lookahead_estimate = 0;
 
-    // check for terrain at grid spacing intervals
+    // check for terrain at grid spacing intervals, a batch of points
+    // at a time
+    Location points[TERRAIN_BATCH_SIZE];
+    float heights[TERRAIN_BATCH_SIZE];
+    bool available[TERRAIN_BATCH_SIZE];
+    struct batch_cursor cursor;
+    cursor.gcache = NULL;
     while (distance > 0) {
-        location_update(loc, bearing, grid_spacing);
-        climb += climb_ratio * grid_spacing;
-        distance -= grid_spacing;
-        float height;
-        if (height_amsl(loc, height)) {
-            float rise = (height - base_height) - climb;
-            if (rise > lookahead_estimate) {
-                lookahead_estimate = rise;
+        uint8_t n = 0;
+        while (distance > 0 && n < TERRAIN_BATCH_SIZE) {
+            location_update(loc, bearing, grid_spacing);
+            distance -= grid_spacing;
+            points[n++] = loc;
+        }
+        height_amsl_batch(points, n, heights, available, cursor);
+        for (uint8_t i=0; i<n; i++) {
+            climb += climb_ratio * grid_spacing;
+            if (available[i]) {
+                float rise = (heights[i] - base_height) - climb;
+                if (rise > lookahead_estimate) {
+                    lookahead_estimate = rise;
+                }
             }
         }
     }
@@ -312,6 +466,9 @@ void AP_Terrain::update(void)
 
     // check for pending rally data
     update_rally_data();
+
+    // load the corridor ahead of the vehicle
+    update_prefetch();
 }
 
 /*
@@ -58,9 +58,53 @@
 // number of grid_blocks in the LRU memory cache
 #define TERRAIN_GRID_BLOCK_CACHE_SIZE 12
 
+// boards with memory to spare and a real mmap() keep a much larger,
+// hashed LRU cache, sized by TERRAIN_CACHE_SZ, and read grid blocks
+// straight from memory mapped degree files
+#if CONFIG_HAL_BOARD == HAL_BOARD_LINUX || CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#define TERRAIN_LARGE_CACHE 1
+#define TERRAIN_LARGE_CACHE_DEFAULT 256
+#define TERRAIN_LARGE_CACHE_MAX 4096
+// number of degree files kept mapped at once
+#define TERRAIN_MAPPED_FILES 4
+#else
+#define TERRAIN_LARGE_CACHE 0
+#endif
+
 // format of grid on disk
 #define TERRAIN_GRID_FORMAT_VERSION 1
 
+// the prefetcher follows the projected path of the vehicle for
+// TERRAIN_PREFETCH_TIME seconds, limited to the distance range below
+#define TERRAIN_PREFETCH_TIME     120
+#define TERRAIN_PREFETCH_MIN_DIST 2000
+#define TERRAIN_PREFETCH_MAX_DIST 20000
+
+// number of points in the projected path, including the current location
+#define TERRAIN_PREFETCH_PATH 8
+
+// number of grid blocks in the corridor queue, kept in ETA order
+#define TERRAIN_PREFETCH_QUEUE 16
+
+// number of path steps sampled on each call to update()
+#define TERRAIN_PREFETCH_STEPS 10
+
+// number of points handled together by the batch height functions
+#define TERRAIN_BATCH_SIZE 16
+
+// DATA16 packet type used to report the prefetch corridor, with the
+// payload laid out as below
+#define DATAMSG_TYPE_TERRAIN_PREFETCH 0xFC
+
+struct PACKED terrain_prefetch_packet {
+    uint8_t coverage;   // percentage of corridor points with terrain data
+    uint8_t queued;     // grid blocks in the corridor waiting for data
+    uint16_t samples;   // corridor points checked in the last sweep
+    uint16_t horizon;   // length of the corridor in meters
+    uint16_t next_eta;  // seconds until the nearest waiting block
+    uint8_t legs;       // path legs in the corridor
+};
+
 #if TERRAIN_DEBUG
 #define ASSERT_RANGE(v,minv,maxv) assert((v)<=(maxv)&&(v)>=(minv))
 #else
@@ -109,6 +153,19 @@ public:
     // return false if not available
     bool height_amsl(const Location &loc, float &height);
 
+    /*
+      return terrain heights in meters above sea level for a set of
+      points. Consecutive points in the same grid block share the
+      block lookup, so this is much cheaper than calling height_amsl()
+      for each point. If available is not NULL it is set for each
+      point that has terrain data. Points without data get a height of
+      zero.
+
+      return the number of points with terrain data
+     */
+    uint16_t height_amsl_points(const Location *locs, uint16_t count,
+                                float *heights, bool *available);
+
     /* 
        find difference between home terrain height and the terrain
        height at the current location in meters. A positive result
@@ -166,8 +223,10 @@ public:
     void log_terrain_data(DataFlash_Class &dataflash);
 
 private:
+#if TERRAIN_LARGE_CACHE
     // allocate the terrain subsystem data
     void allocate(void);
+#endif
 
     /*
       a grid block is a structure in a local file containing height
@@ -229,8 +288,32 @@ private:
 
         // the last time access was requested to this block, used for LRU
         uint32_t last_access_ms;
+
+#if TERRAIN_LARGE_CACHE
+        // hash chain and LRU list links, as indexes into the cache
+        uint16_t hash_next;
+        uint16_t lru_prev;
+        uint16_t lru_next;
+#endif
     };
 
+#if TERRAIN_LARGE_CACHE
+    // list terminator for hash chains and the LRU list
+    static const uint16_t cache_none = 0xFFFF;
+
+    /*
+      a read-only mapping of a degree file
+     */
+    struct mapped_file {
+        int fd;
+        uint8_t *data;
+        size_t length;
+        int8_t lat_degrees;
+        int16_t lon_degrees;
+        uint32_t last_use_ms;
+    };
+#endif
+
     /*
       grid_info is a broken down representation of a Location, giving
       the index terms for finding the right grid
@@ -263,11 +346,46 @@ private:
     // given a location, fill a grid_info structure
     void calculate_grid_info(const Location &loc, struct grid_info &info) const;
 
+    // given an offset in meters from the degree reference, fill the
+    // grid indices and fractions of a grid_info structure
+    void calculate_grid_indices(const Vector2f &offset, struct grid_info &info) const;
+
+    /*
+      state carried from one point to the next by the batch height
+      functions: the degree reference of the last point and its block
+     */
+    struct batch_cursor {
+        const struct grid_cache *gcache;
+        Location ref;
+        float scale;
+        int8_t lat_degrees;
+        int16_t lon_degrees;
+        uint16_t grid_idx_x;
+        uint16_t grid_idx_y;
+    };
+    uint8_t height_amsl_batch(const Location *locs, uint8_t count, float *heights,
+                              bool *available, struct batch_cursor &cursor);
+
     /*
       find a grid structure given a grid_info
     */
     struct grid_cache &find_grid_cache(const struct grid_info &info);
 
+    /*
+      find the cache index of a grid block, or -1
+     */
+    int16_t find_cache_idx(int32_t lat, int32_t lon, uint16_t spacing);
+
+#if TERRAIN_LARGE_CACHE
+    /*
+      hash index and LRU list maintenance
+     */
+    uint16_t cache_hash_slot(int32_t lat, int32_t lon, uint16_t spacing) const;
+    void cache_hash_insert(uint16_t idx);
+    void cache_hash_remove(uint16_t idx);
+    void lru_touch(uint16_t idx);
+#endif
+
     /*
       calculate bit number in grid_block bitmap. This corresponds to a
       bit representing a 4x4 mavlink transmitted block
@@ -302,6 +420,9 @@ private:
      */
     int16_t find_io_idx(enum GridCacheState state);
     uint16_t get_block_crc(struct grid_block &block);
+    bool block_valid(struct grid_block &block, int32_t lat, int32_t lon);
+    uint32_t block_file_offset(const struct grid_block &block) const;
+    void degree_file_path(char *path, int8_t lat_degrees, int16_t lon_degrees) const;
     void check_disk_read(void);
     void check_disk_write(void);
     void io_timer(void);
@@ -309,6 +430,10 @@ private:
     void seek_offset(void);
     void write_block(void);
     void read_block(void);
+#if TERRAIN_LARGE_CACHE
+    struct mapped_file *map_file(int8_t lat_degrees, int16_t lon_degrees, uint32_t min_length);
+    bool read_mapped_block(struct grid_block &block);
+#endif
 
     /*
       check for missing mission terrain data
@@ -320,10 +445,24 @@ private:
      */
     void update_rally_data(void);
 
+    /*
+      prefetch terrain data along the projected path of the vehicle
+     */
+    void update_prefetch(void);
+    bool start_prefetch_sweep(void);
+    void finish_prefetch_sweep(void);
+    void prefetch_point(const Location &loc, float eta);
+    void prefetch_enqueue(const struct grid_info &info, float eta);
+    bool request_prefetch(mavlink_channel_t chan);
+    void send_prefetch_report(mavlink_channel_t chan);
+
 
     // parameters
     AP_Int8  enable;
     AP_Int16 grid_spacing; // meters between grid points
+#if TERRAIN_LARGE_CACHE
+    AP_Int16 cache_size_param; // number of grid_blocks to cache
+#endif
 
     // reference to AHRS, so we can ask for our position,
     // heading and speed
@@ -337,8 +476,24 @@ private:
     // all rally points
     const AP_Rally &rally;
 
+#if TERRAIN_LARGE_CACHE
+    // cache of grids in memory, allocated on first use. Blocks are
+    // found via a chained hash table on lat, lon and spacing, and
+    // evicted from the tail of a doubly linked LRU list
+    struct grid_cache *cache;
+    uint16_t cache_size;
+    uint16_t *cache_hash;
+    uint16_t cache_hash_mask;
+    uint16_t lru_head;
+    uint16_t lru_tail;
+
+    // degree files mapped for reading by the main thread
+    struct mapped_file mapped[TERRAIN_MAPPED_FILES];
+#else
     // cache of grids in memory, LRU
     struct grid_cache cache[TERRAIN_GRID_BLOCK_CACHE_SIZE];
+    static const uint16_t cache_size = TERRAIN_GRID_BLOCK_CACHE_SIZE;
+#endif
 
     // a grid_cache block waiting for disk IO
     enum DiskIoState {
@@ -385,9 +540,6 @@ private:
     // next mission command to check
     uint16_t next_mission_index;
 
-    // next mission position to check
-    uint8_t next_mission_pos;
-
     // last time the mission changed
     uint32_t last_mission_change_ms;
 
@@ -402,6 +554,41 @@ private:
 
     // grid spacing during rally check
     uint16_t last_rally_spacing;
+
+    /*
+      a grid block in the prefetch corridor that is still missing data
+     */
+    struct prefetch_entry {
+        struct grid_info info;
+        float eta;      // seconds until the vehicle gets there
+        uint8_t sweep;  // sweep that last found the block in the corridor
+    };
+
+    // projected path being swept, and how far along it we are
+    Location prefetch_path[TERRAIN_PREFETCH_PATH];
+    uint8_t prefetch_path_len;
+    uint8_t prefetch_leg;
+    float prefetch_leg_pos;
+    float prefetch_path_pos;
+    float prefetch_horizon;
+    float prefetch_speed;
+    uint8_t prefetch_sweep;
+    uint16_t prefetch_spacing;
+    uint16_t sweep_samples;
+    uint16_t sweep_available;
+
+    // missing grid blocks in the corridor, nearest ETA first
+    struct prefetch_entry prefetch_queue[TERRAIN_PREFETCH_QUEUE];
+    uint8_t prefetch_queue_len;
+
+    // results of the last complete sweep
+    uint16_t corridor_samples;
+    uint16_t corridor_horizon;
+    uint8_t corridor_coverage;
+    uint8_t corridor_legs;
+
+    // longest distance asked for by lookahead()
+    float lookahead_distance;
 };
 #endif // AP_TERRAIN_AVAILABLE
 #endif // __AP_TERRAIN_H__
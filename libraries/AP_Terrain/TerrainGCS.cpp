@@ -100,6 +100,7 @@ void AP_Terrain::send_request(mavlink_channel_t chan)
 
     // always send a terrain report
     send_terrain_report(chan, loc, true);
+    send_prefetch_report(chan);
 
     // did we request recently?
     if (hal.scheduler->millis() - last_request_time_ms < 2000) {
@@ -130,8 +131,13 @@ void AP_Terrain::send_request(mavlink_channel_t chan)
         }
     }
 
+    // then the corridor ahead of the vehicle, nearest first
+    if (request_prefetch(chan)) {
+        return;
+    }
+
     // check cache blocks that may have been setup by a TERRAIN_CHECK
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
+    for (uint16_t i=0; i<cache_size; i++) {
         if (cache[i].state >= GRID_CACHE_VALID) {
             if (request_missing(chan, cache[i])) {
                 return;
@@ -161,7 +167,7 @@ void AP_Terrain::get_statistics(uint16_t &pending, uint16_t &loaded)
 {
     pending = 0;
     loaded = 0;
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
+    for (uint16_t i=0; i<cache_size; i++) {
         if (cache[i].grid.spacing != grid_spacing) {
             continue;
         }
@@ -260,17 +266,10 @@ void AP_Terrain::handle_terrain_data(mavlink_message_t *msg)
     mavlink_terrain_data_t packet;
     mavlink_msg_terrain_data_decode(msg, &packet);
 
-    uint16_t i;
-    for (i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
-        if (cache[i].grid.lat == packet.lat && 
-            cache[i].grid.lon == packet.lon && 
-            cache[i].grid.spacing == packet.grid_spacing &&
-            grid_spacing == packet.grid_spacing &&
-            packet.gridbit < 56) {
-            break;
-        }
-    }
-    if (i == TERRAIN_GRID_BLOCK_CACHE_SIZE) {
+    int16_t i = find_cache_idx(packet.lat, packet.lon, packet.grid_spacing);
+    if (i == -1 ||
+        grid_spacing != packet.grid_spacing ||
+        packet.gridbit >= 56) {
         // we don't have that grid, ignore data
         return;
     }
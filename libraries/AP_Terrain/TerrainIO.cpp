@@ -33,6 +33,9 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <errno.h>
+#if TERRAIN_LARGE_CACHE
+#include <sys/mman.h>
+#endif
 
 extern const AP_HAL::HAL& hal;
 
@@ -41,7 +44,7 @@ extern const AP_HAL::HAL& hal;
  */
 void AP_Terrain::check_disk_read(void)
 {
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
+    for (uint16_t i=0; i<cache_size; i++) {
         if (cache[i].state == GRID_CACHE_DISKWAIT) {
             disk_block.block = cache[i].grid;
             disk_io_state = DiskIoWaitRead;
@@ -55,7 +58,7 @@ void AP_Terrain::check_disk_read(void)
  */
 void AP_Terrain::check_disk_write(void)
 {
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
+    for (uint16_t i=0; i<cache_size; i++) {
         if (cache[i].state == GRID_CACHE_DIRTY) {
             disk_block.block = cache[i].grid;
             disk_io_state = DiskIoWaitWrite;
@@ -124,6 +127,137 @@ void AP_Terrain::schedule_disk_io(void)
 }
 
 
+/*
+  fill in the path of a degree file. path must have room for
+  HAL_BOARD_TERRAIN_DIRECTORY "/NxxExxx.DAT"
+ */
+void AP_Terrain::degree_file_path(char *path, int8_t lat_degrees, int16_t lon_degrees) const
+{
+    strcpy(path, HAL_BOARD_TERRAIN_DIRECTORY "/");
+    char *p = &path[strlen(HAL_BOARD_TERRAIN_DIRECTORY)+1];
+    snprintf(p, 12, "%c%02u%c%03u.DAT",
+             lat_degrees<0?'S':'N',
+             abs(lat_degrees),
+             lon_degrees<0?'W':'E',
+             abs(lon_degrees));
+}
+
+/*
+  file offset of a block within its degree file
+ */
+uint32_t AP_Terrain::block_file_offset(const struct grid_block &block) const
+{
+    // work out how many longitude blocks there are at this latitude
+    Location loc1, loc2;
+    loc1.lat = block.lat_degrees*10*1000*1000L;
+    loc1.lng = block.lon_degrees*10*1000*1000L;
+    loc2.lat = block.lat_degrees*10*1000*1000L;
+    loc2.lng = (block.lon_degrees+1)*10*1000*1000L;
+
+    // shift another two blocks east to ensure room is available
+    location_offset(loc2, 0, 2*grid_spacing*TERRAIN_GRID_BLOCK_SIZE_Y);
+    Vector2f offset = location_diff(loc1, loc2);
+    uint16_t east_blocks = offset.y / (grid_spacing*TERRAIN_GRID_BLOCK_SIZE_Y);
+
+    return (east_blocks * block.grid_idx_x + 
+            block.grid_idx_y) * sizeof(union grid_io_block);
+}
+
+#if TERRAIN_LARGE_CACHE
+/*
+  get a read-only mapping of a degree file covering at least
+  min_length bytes. The most recently used few files stay mapped, and
+  are remapped as the IO thread extends them. Returns NULL if the file
+  or the requested part of it doesn't exist yet.
+
+  This runs in the main thread. Reads through the mapping see blocks
+  written by the IO thread via the page cache, and a block caught part
+  way through a write fails its CRC check
+ */
+AP_Terrain::mapped_file *AP_Terrain::map_file(int8_t lat_degrees, int16_t lon_degrees, uint32_t min_length)
+{
+    struct mapped_file *m = NULL;
+    struct mapped_file *oldest = &mapped[0];
+    for (uint8_t i=0; i<TERRAIN_MAPPED_FILES; i++) {
+        if (mapped[i].fd != -1 &&
+            mapped[i].lat_degrees == lat_degrees &&
+            mapped[i].lon_degrees == lon_degrees) {
+            m = &mapped[i];
+            break;
+        }
+        if (mapped[i].last_use_ms < oldest->last_use_ms) {
+            oldest = &mapped[i];
+        }
+    }
+    uint32_t now = hal.scheduler->millis();
+    if (m != NULL && m->length >= min_length) {
+        m->last_use_ms = now;
+        return m;
+    }
+
+    if (m == NULL) {
+        // reuse the least recently used slot
+        m = oldest;
+        if (m->data != NULL) {
+            munmap(m->data, m->length);
+            m->data = NULL;
+            m->length = 0;
+        }
+        if (m->fd != -1) {
+            ::close(m->fd);
+        }
+        char path[] = HAL_BOARD_TERRAIN_DIRECTORY "/NxxExxx.DAT";
+        degree_file_path(path, lat_degrees, lon_degrees);
+        m->fd = ::open(path, O_RDONLY);
+        if (m->fd == -1) {
+            return NULL;
+        }
+        m->lat_degrees = lat_degrees;
+        m->lon_degrees = lon_degrees;
+    }
+    m->last_use_ms = now;
+
+    // degree files only grow, so map the whole of it as it is now
+    struct stat st;
+    if (fstat(m->fd, &st) != 0 || (uint32_t)st.st_size < min_length) {
+        return NULL;
+    }
+    if (m->data != NULL) {
+        munmap(m->data, m->length);
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, m->fd, 0);
+    if (data == MAP_FAILED) {
+        m->data = NULL;
+        m->length = 0;
+        return NULL;
+    }
+    m->data = (uint8_t *)data;
+    m->length = st.st_size;
+    return m;
+}
+
+/*
+  fill in a block from its mapped degree file. Returns false if the
+  block isn't on disk, leaving the read to the IO thread
+ */
+bool AP_Terrain::read_mapped_block(struct grid_block &block)
+{
+    uint32_t file_offset = block_file_offset(block);
+    struct mapped_file *m = map_file(block.lat_degrees, block.lon_degrees,
+                                     file_offset + sizeof(union grid_io_block));
+    if (m == NULL) {
+        return false;
+    }
+    struct grid_block b;
+    memcpy(&b, &m->data[file_offset], sizeof(b));
+    if (!block_valid(b, block.lat, block.lon)) {
+        return false;
+    }
+    block = b;
+    return true;
+}
+#endif // TERRAIN_LARGE_CACHE
+
 /********************************************************
 All the functions below this point run in the IO timer context, which
 is a separate thread. The code uses the state machine controlled by
@@ -153,12 +287,7 @@ void AP_Terrain::open_file(void)
 
     // build the pathname to the degree file
     char path[] = HAL_BOARD_TERRAIN_DIRECTORY "/NxxExxx.DAT";
-    char *p = &path[strlen(HAL_BOARD_TERRAIN_DIRECTORY)+1];
-    snprintf(p, 12, "%c%02u%c%03u.DAT",
-             block.lat_degrees<0?'S':'N',
-             abs(block.lat_degrees),
-             block.lon_degrees<0?'W':'E',
-             abs(block.lon_degrees));
+    degree_file_path(path, block.lat_degrees, block.lon_degrees);
 
     // create directory if need be
     if (!directory_created) {
@@ -188,21 +317,7 @@ void AP_Terrain::open_file(void)
  */
 void AP_Terrain::seek_offset(void)
 {
-    struct grid_block &block = disk_block.block;
-    // work out how many longitude blocks there are at this latitude
-    Location loc1, loc2;
-    loc1.lat = block.lat_degrees*10*1000*1000L;
-    loc1.lng = block.lon_degrees*10*1000*1000L;
-    loc2.lat = block.lat_degrees*10*1000*1000L;
-    loc2.lng = (block.lon_degrees+1)*10*1000*1000L;
-
-    // shift another two blocks east to ensure room is available
-    location_offset(loc2, 0, 2*grid_spacing*TERRAIN_GRID_BLOCK_SIZE_Y);
-    Vector2f offset = location_diff(loc1, loc2);
-    uint16_t east_blocks = offset.y / (grid_spacing*TERRAIN_GRID_BLOCK_SIZE_Y);
-
-    uint32_t file_offset = (east_blocks * block.grid_idx_x + 
-                            block.grid_idx_y) * sizeof(union grid_io_block);
+    uint32_t file_offset = block_file_offset(disk_block.block);
     if (::lseek(fd, file_offset, SEEK_SET) != (off_t)file_offset) {
 #if TERRAIN_DEBUG
         hal.console->printf("Seek %lu failed - %s\n",
@@ -261,12 +376,7 @@ void AP_Terrain::read_block(void)
 
     ssize_t ret = ::read(fd, &disk_block, sizeof(disk_block));
     if (ret != sizeof(disk_block) || 
-        disk_block.block.lat != lat || 
-        disk_block.block.lon != lon ||
-        disk_block.block.bitmap == 0 ||
-        disk_block.block.spacing != grid_spacing ||
-        disk_block.block.version != TERRAIN_GRID_FORMAT_VERSION ||
-        disk_block.block.crc != get_block_crc(disk_block.block)) {
+        !block_valid(disk_block.block, lat, lon)) {
 #if TERRAIN_DEBUG
         printf("read empty block at %ld %ld ret=%d\n",
                (long)lat,
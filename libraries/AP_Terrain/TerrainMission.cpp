@@ -37,7 +37,6 @@ void AP_Terrain::update_mission_data(void)
         last_mission_spacing != grid_spacing) {
         // the mission has changed - start again
         next_mission_index = 1;
-        next_mission_pos = 0;
         last_mission_change_ms = mission.last_change_time_ms();
         last_mission_spacing = grid_spacing;
     }
@@ -73,7 +72,6 @@ void AP_Terrain::update_mission_data(void)
             if (!mission.read_cmd_from_storage(next_mission_index, cmd)) {
                 // nothing more to do
                 next_mission_index = 0;
-                next_mission_pos = 0;
                 return;
             }
         }
@@ -81,28 +79,28 @@ void AP_Terrain::update_mission_data(void)
         // we will fetch 5 points around the waypoint. Four at 10 grid
         // spacings away at 45, 135, 225 and 315 degrees, and the
         // point itself
-        if (next_mission_pos != 4) {
-            location_update(cmd.content.location, 45+90*next_mission_pos, grid_spacing.get() * 10);
+        Location points[5];
+        for (uint8_t p=0; p<4; p++) {
+            points[p] = cmd.content.location;
+            location_update(points[p], 45+90*p, grid_spacing.get() * 10);
         }
+        points[4] = cmd.content.location;
 
-        // we have a mission command to check
-        float height;
-        if (!height_amsl(cmd.content.location, height)) {
+        // we have a mission command to check. All the points are
+        // looked up, so all their missing grids are requested at once
+        float heights[5];
+        if (height_amsl_points(points, 5, heights, NULL) != 5) {
             // if we can't get data for a mission item then return and
             // check again next time
             return;
         }
 
-        next_mission_pos++;
-        if (next_mission_pos == 5) {
 #if TERRAIN_DEBUG
-            hal.console->printf("checked waypoint %u\n", (unsigned)next_mission_index);
+        hal.console->printf("checked waypoint %u\n", (unsigned)next_mission_index);
 #endif
 
-            // move to next waypoint
-            next_mission_index++;
-            next_mission_pos = 0;
-        }
+        // move to next waypoint
+        next_mission_index++;
     }
 }
 
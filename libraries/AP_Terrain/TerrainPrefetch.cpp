@@ -0,0 +1,309 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  prefetch terrain data along the projected path of the vehicle
+
+  The path is the remaining nav legs of a running mission, or the
+  current velocity vector otherwise, out to a horizon set by the
+  groundspeed and the longest lookahead() distance. The path is swept
+  a few steps per update, checking points on it and either side of
+  it. Grid blocks that are missing data for any of those points are
+  queued in order of expected time of arrival, the nearest ones are
+  loaded from disk, and send_request() asks the GCS for any that are
+  not on disk.
+ */
+
+#include <AP_HAL.h>
+#include <AP_Common.h>
+#include <AP_Math.h>
+#include <GCS_MAVLink.h>
+#include <GCS.h>
+#include "AP_Terrain.h"
+
+#if AP_TERRAIN_AVAILABLE
+
+extern const AP_HAL::HAL& hal;
+
+/*
+  sweep some more of the corridor, and start loading the nearest
+  missing grid blocks
+ */
+void AP_Terrain::update_prefetch(void)
+{
+    if (!enable || grid_spacing <= 0) {
+        return;
+    }
+    if (prefetch_path_len == 0 && !start_prefetch_sweep()) {
+        return;
+    }
+
+    // step along the path one 4x4 mavlink grid at a time, checking
+    // the same distance either side of it
+    float step = grid_spacing * TERRAIN_GRID_MAVLINK_SIZE;
+
+    for (uint8_t n=0; n<TERRAIN_PREFETCH_STEPS; n++) {
+        if (prefetch_leg+1 >= prefetch_path_len ||
+            prefetch_path_pos + prefetch_leg_pos > prefetch_horizon) {
+            finish_prefetch_sweep();
+            break;
+        }
+        const Location &start = prefetch_path[prefetch_leg];
+        const Location &end = prefetch_path[prefetch_leg+1];
+        float leg_length = get_distance(start, end);
+        float bearing = get_bearing_cd(start, end) * 0.01f;
+        float eta;
+        Location loc;
+        if (prefetch_leg_pos >= leg_length) {
+            // finish the leg on its end point
+            loc = end;
+            eta = (prefetch_path_pos + leg_length) / prefetch_speed;
+            prefetch_path_pos += leg_length;
+            prefetch_leg++;
+            prefetch_leg_pos = step;
+        } else {
+            loc = start;
+            location_update(loc, bearing, prefetch_leg_pos);
+            eta = (prefetch_path_pos + prefetch_leg_pos) / prefetch_speed;
+            prefetch_leg_pos += step;
+        }
+
+        prefetch_point(loc, eta);
+        Location side = loc;
+        location_update(side, bearing + 90, step);
+        prefetch_point(side, eta);
+        side = loc;
+        location_update(side, bearing - 90, step);
+        prefetch_point(side, eta);
+    }
+
+    // start disk reads for the nearest missing blocks. This is
+    // limited to a quarter of the cache so the corridor can't push
+    // out the blocks around the vehicle
+    uint16_t loads = cache_size / 4;
+    if (loads == 0) {
+        loads = 1;
+    }
+    for (uint8_t i=0; i<prefetch_queue_len && i<loads; i++) {
+        find_grid_cache(prefetch_queue[i].info);
+    }
+}
+
+/*
+  project the path of the vehicle for a new sweep. Returns false if we
+  don't know where we are
+ */
+bool AP_Terrain::start_prefetch_sweep(void)
+{
+    Location loc;
+    if (!ahrs.get_position(loc)) {
+        return false;
+    }
+
+    if (prefetch_spacing != grid_spacing) {
+        // queued blocks are for the old spacing
+        prefetch_queue_len = 0;
+        prefetch_spacing = grid_spacing;
+    }
+
+    Vector2f velocity = ahrs.groundspeed_vector();
+    float speed = velocity.length();
+    prefetch_speed = max(speed, 1.0f);
+    prefetch_horizon = constrain_float(max(speed * TERRAIN_PREFETCH_TIME, lookahead_distance),
+                                       TERRAIN_PREFETCH_MIN_DIST,
+                                       TERRAIN_PREFETCH_MAX_DIST);
+
+    prefetch_path[0] = loc;
+    prefetch_path_len = 1;
+
+    if (mission.state() == AP_Mission::MISSION_RUNNING) {
+        // follow the mission from the current nav command. Stop at a
+        // DO_JUMP, as we can't tell which way the mission will go
+        uint16_t index = mission.get_current_nav_index();
+        for (uint8_t i=0;
+             index != 0 && i<3*TERRAIN_PREFETCH_PATH && prefetch_path_len < TERRAIN_PREFETCH_PATH;
+             i++, index++) {
+            AP_Mission::Mission_Command cmd;
+            if (!mission.read_cmd_from_storage(index, cmd) ||
+                cmd.id == MAV_CMD_DO_JUMP) {
+                break;
+            }
+            if (!AP_Mission::is_nav_cmd(cmd) ||
+                (cmd.content.location.lat == 0 && cmd.content.location.lng == 0)) {
+                continue;
+            }
+            prefetch_path[prefetch_path_len++] = cmd.content.location;
+        }
+    }
+
+    if (prefetch_path_len == 1) {
+        // no mission legs, so follow the velocity vector, or the
+        // heading if we are not moving
+        float bearing;
+        if (speed > 1.0f) {
+            bearing = degrees(atan2f(velocity.y, velocity.x));
+        } else {
+            bearing = ahrs.yaw_sensor * 0.01f;
+        }
+        prefetch_path[1] = loc;
+        location_update(prefetch_path[1], bearing, prefetch_horizon);
+        prefetch_path_len = 2;
+    }
+
+    prefetch_leg = 0;
+    prefetch_leg_pos = 0;
+    prefetch_path_pos = 0;
+    prefetch_sweep++;
+    sweep_samples = 0;
+    sweep_available = 0;
+    return true;
+}
+
+/*
+  record the results of a sweep, and drop queued blocks that are no
+  longer in the corridor
+ */
+void AP_Terrain::finish_prefetch_sweep(void)
+{
+    uint8_t n = 0;
+    for (uint8_t i=0; i<prefetch_queue_len; i++) {
+        if (prefetch_queue[i].sweep == prefetch_sweep) {
+            prefetch_queue[n++] = prefetch_queue[i];
+        }
+    }
+    prefetch_queue_len = n;
+
+    corridor_samples = sweep_samples;
+    corridor_coverage = sweep_samples ? (100UL * sweep_available) / sweep_samples : 0;
+    corridor_horizon = min(prefetch_path_pos + prefetch_leg_pos, prefetch_horizon);
+    corridor_legs = prefetch_path_len - 1;
+
+    // start a new sweep on the next update
+    prefetch_path_len = 0;
+}
+
+/*
+  check one point in the corridor, queueing its grid block if the
+  point has no terrain data
+ */
+void AP_Terrain::prefetch_point(const Location &loc, float eta)
+{
+    struct grid_info info;
+    calculate_grid_info(loc, info);
+    sweep_samples++;
+
+    int16_t i = find_cache_idx(info.grid_lat, info.grid_lon, grid_spacing);
+    if (i != -1 && cache[i].state >= GRID_CACHE_VALID) {
+        const struct grid_block &grid = cache[i].grid;
+        if (check_bitmap(grid, info.idx_x,   info.idx_y) &&
+            check_bitmap(grid, info.idx_x,   info.idx_y+1) &&
+            check_bitmap(grid, info.idx_x+1, info.idx_y) &&
+            check_bitmap(grid, info.idx_x+1, info.idx_y+1)) {
+            sweep_available++;
+            return;
+        }
+    }
+
+    prefetch_enqueue(info, eta);
+}
+
+/*
+  add a grid block to the ETA ordered queue, or move it to its new
+  place if it is already there
+ */
+void AP_Terrain::prefetch_enqueue(const struct grid_info &info, float eta)
+{
+    for (uint8_t i=0; i<prefetch_queue_len; i++) {
+        struct prefetch_entry &e = prefetch_queue[i];
+        if (e.info.grid_lat != info.grid_lat || e.info.grid_lon != info.grid_lon) {
+            continue;
+        }
+        if (e.sweep == prefetch_sweep && e.eta <= eta) {
+            // already found sooner on this sweep
+            return;
+        }
+        // take it out, to be put back at its new ETA
+        memmove(&prefetch_queue[i], &prefetch_queue[i+1],
+                (prefetch_queue_len-(i+1))*sizeof(prefetch_queue[0]));
+        prefetch_queue_len--;
+        break;
+    }
+
+    uint8_t pos = 0;
+    while (pos < prefetch_queue_len && prefetch_queue[pos].eta <= eta) {
+        pos++;
+    }
+    if (pos == TERRAIN_PREFETCH_QUEUE) {
+        // further away than everything in a full queue
+        return;
+    }
+    if (prefetch_queue_len == TERRAIN_PREFETCH_QUEUE) {
+        // drop the furthest block
+        prefetch_queue_len--;
+    }
+    memmove(&prefetch_queue[pos+1], &prefetch_queue[pos],
+            (prefetch_queue_len-pos)*sizeof(prefetch_queue[0]));
+    prefetch_queue[pos].info = info;
+    prefetch_queue[pos].eta = eta;
+    prefetch_queue[pos].sweep = prefetch_sweep;
+    prefetch_queue_len++;
+}
+
+/*
+  request missing grids for the corridor from the GCS, nearest
+  first. Blocks still waiting for a disk read are skipped
+ */
+bool AP_Terrain::request_prefetch(mavlink_channel_t chan)
+{
+    for (uint8_t i=0; i<prefetch_queue_len; i++) {
+        const struct grid_info &info = prefetch_queue[i].info;
+        int16_t idx = find_cache_idx(info.grid_lat, info.grid_lon, grid_spacing);
+        if (idx != -1 &&
+            cache[idx].state >= GRID_CACHE_VALID &&
+            request_missing(chan, cache[idx])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+  send the results of the last corridor sweep
+ */
+void AP_Terrain::send_prefetch_report(mavlink_channel_t chan)
+{
+    if (corridor_samples == 0) {
+        // no sweep finished yet
+        return;
+    }
+    if (comm_get_txspace(chan) < MAVLINK_NUM_NON_PAYLOAD_BYTES + MAVLINK_MSG_ID_DATA16_LEN) {
+        return;
+    }
+
+    struct terrain_prefetch_packet pkt;
+    pkt.coverage = corridor_coverage;
+    pkt.queued   = prefetch_queue_len;
+    pkt.samples  = corridor_samples;
+    pkt.horizon  = corridor_horizon;
+    pkt.next_eta = prefetch_queue_len ? min(prefetch_queue[0].eta, 65535.0f) : 0;
+    pkt.legs     = corridor_legs;
+
+    uint8_t data[16];
+    memset(data, 0, sizeof(data));
+    memcpy(data, &pkt, sizeof(pkt));
+    mavlink_msg_data16_send(chan, DATAMSG_TYPE_TERRAIN_PREFETCH, sizeof(pkt), data);
+}
+
+#endif // AP_TERRAIN_AVAILABLE
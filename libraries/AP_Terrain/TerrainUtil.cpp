@@ -80,6 +80,23 @@ void AP_Terrain::calculate_grid_info(const Location &loc, struct grid_info &info
     // find offset from reference
     Vector2f offset = location_diff(ref, loc);
 
+    calculate_grid_indices(offset, info);
+
+    // calculate lat/lon of SW corner of 32*28 grid_block
+    location_offset(ref, 
+                    info.grid_idx_x * TERRAIN_GRID_BLOCK_SPACING_X * (float)grid_spacing,
+                    info.grid_idx_y * TERRAIN_GRID_BLOCK_SPACING_Y * (float)grid_spacing);
+    info.grid_lat = ref.lat;
+    info.grid_lon = ref.lng;
+}
+
+/*
+  given an offset in meters from the degree reference, calculate the
+  32x28 grid indices, the indices within that grid and the fraction
+  within the square
+*/
+void AP_Terrain::calculate_grid_indices(const Vector2f &offset, struct grid_info &info) const
+{
     // get indices in terms of grid_spacing elements
     uint32_t idx_x = offset.x / grid_spacing;
     uint32_t idx_y = offset.y / grid_spacing;
@@ -98,13 +115,6 @@ void AP_Terrain::calculate_grid_info(const Location &loc, struct grid_info &info
     info.frac_x = (offset.x - idx_x * grid_spacing) / grid_spacing;
     info.frac_y = (offset.y - idx_y * grid_spacing) / grid_spacing;
 
-    // calculate lat/lon of SW corner of 32*28 grid_block
-    location_offset(ref, 
-                    info.grid_idx_x * TERRAIN_GRID_BLOCK_SPACING_X * (float)grid_spacing,
-                    info.grid_idx_y * TERRAIN_GRID_BLOCK_SPACING_Y * (float)grid_spacing);
-    info.grid_lat = ref.lat;
-    info.grid_lon = ref.lng;
-
     ASSERT_RANGE(info.idx_x,0,TERRAIN_GRID_BLOCK_SPACING_X-1);
     ASSERT_RANGE(info.idx_y,0,TERRAIN_GRID_BLOCK_SPACING_Y-1);
     ASSERT_RANGE(info.frac_x,0,1);
@@ -112,30 +122,175 @@ void AP_Terrain::calculate_grid_info(const Location &loc, struct grid_info &info
 }
 
 
+#if TERRAIN_LARGE_CACHE
+/*
+  allocate the grid cache and its hash table. The size comes from
+  TERRAIN_CACHE_SZ, halved until the allocation succeeds
+ */
+void AP_Terrain::allocate(void)
+{
+    if (cache != NULL) {
+        return;
+    }
+    uint16_t size = constrain_int16(cache_size_param, TERRAIN_GRID_BLOCK_CACHE_SIZE, TERRAIN_LARGE_CACHE_MAX);
+    while (true) {
+        // hash table of at least as many chains as blocks
+        uint16_t hash_size = 1;
+        while (hash_size < size) {
+            hash_size <<= 1;
+        }
+        cache = (struct grid_cache *)calloc(size, sizeof(cache[0]));
+        cache_hash = (uint16_t *)calloc(hash_size, sizeof(cache_hash[0]));
+        if (cache != NULL && cache_hash != NULL) {
+            cache_hash_mask = hash_size - 1;
+            break;
+        }
+        free(cache);
+        free(cache_hash);
+        cache = NULL;
+        cache_hash = NULL;
+        if (size <= TERRAIN_GRID_BLOCK_CACHE_SIZE) {
+            hal.scheduler->panic(PSTR("Unable to allocate terrain cache"));
+        }
+        size /= 2;
+    }
+
+    for (uint16_t i=0; i<=cache_hash_mask; i++) {
+        cache_hash[i] = cache_none;
+    }
+    // all blocks start out in the LRU list, none in the hash table
+    for (uint16_t i=0; i<size; i++) {
+        cache[i].hash_next = cache_none;
+        cache[i].lru_prev = (i == 0) ? cache_none : i-1;
+        cache[i].lru_next = (i == size-1) ? cache_none : i+1;
+    }
+    lru_head = 0;
+    lru_tail = size-1;
+    cache_size = size;
+}
+
+/*
+  hash chain for a grid block
+ */
+uint16_t AP_Terrain::cache_hash_slot(int32_t lat, int32_t lon, uint16_t spacing) const
+{
+    uint32_t h = (uint32_t)lat * 2654435761UL;
+    h ^= (uint32_t)lon * 2246822519UL;
+    h ^= (uint32_t)spacing * 3266489917UL;
+    h ^= h >> 16;
+    return h & cache_hash_mask;
+}
+
+void AP_Terrain::cache_hash_insert(uint16_t idx)
+{
+    const struct grid_block &grid = cache[idx].grid;
+    uint16_t slot = cache_hash_slot(grid.lat, grid.lon, grid.spacing);
+    cache[idx].hash_next = cache_hash[slot];
+    cache_hash[slot] = idx;
+}
+
+void AP_Terrain::cache_hash_remove(uint16_t idx)
+{
+    const struct grid_block &grid = cache[idx].grid;
+    uint16_t *p = &cache_hash[cache_hash_slot(grid.lat, grid.lon, grid.spacing)];
+    while (*p != cache_none) {
+        if (*p == idx) {
+            *p = cache[idx].hash_next;
+            break;
+        }
+        p = &cache[*p].hash_next;
+    }
+    cache[idx].hash_next = cache_none;
+}
+
+/*
+  move a block to the most recently used end of the LRU list
+ */
+void AP_Terrain::lru_touch(uint16_t idx)
+{
+    if (idx == lru_head) {
+        return;
+    }
+    struct grid_cache &c = cache[idx];
+    // unlink. As idx isn't the head it has a predecessor
+    cache[c.lru_prev].lru_next = c.lru_next;
+    if (c.lru_next != cache_none) {
+        cache[c.lru_next].lru_prev = c.lru_prev;
+    } else {
+        lru_tail = c.lru_prev;
+    }
+    // and push on the head
+    c.lru_prev = cache_none;
+    c.lru_next = lru_head;
+    cache[lru_head].lru_prev = idx;
+    lru_head = idx;
+}
+#endif // TERRAIN_LARGE_CACHE
+
+/*
+  find the cache index of a grid block, or -1 if not in the cache
+ */
+int16_t AP_Terrain::find_cache_idx(int32_t lat, int32_t lon, uint16_t spacing)
+{
+#if TERRAIN_LARGE_CACHE
+    if (cache == NULL) {
+        return -1;
+    }
+    for (uint16_t i=cache_hash[cache_hash_slot(lat, lon, spacing)];
+         i != cache_none;
+         i = cache[i].hash_next) {
+        if (cache[i].grid.lat == lat &&
+            cache[i].grid.lon == lon &&
+            cache[i].grid.spacing == spacing) {
+            return i;
+        }
+    }
+#else
+    for (uint16_t i=0; i<cache_size; i++) {
+        if (cache[i].grid.lat == lat &&
+            cache[i].grid.lon == lon &&
+            cache[i].grid.spacing == spacing) {
+            return i;
+        }
+    }
+#endif
+    return -1;
+}
+
 /*
   find a grid structure given a grid_info
  */
 AP_Terrain::grid_cache &AP_Terrain::find_grid_cache(const struct grid_info &info)
 {
-    uint16_t oldest_i = 0;
+#if TERRAIN_LARGE_CACHE
+    allocate();
+#endif
 
     // see if we have that grid
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
-        if (cache[i].grid.lat == info.grid_lat && 
-            cache[i].grid.lon == info.grid_lon &&
-            cache[i].grid.spacing == grid_spacing) {
-            cache[i].last_access_ms = hal.scheduler->millis();
-            return cache[i];
-        }
-        if (cache[i].last_access_ms < cache[oldest_i].last_access_ms) {
-            oldest_i = i;
-        }
+    int16_t idx = find_cache_idx(info.grid_lat, info.grid_lon, grid_spacing);
+    if (idx != -1) {
+        cache[idx].last_access_ms = hal.scheduler->millis();
+#if TERRAIN_LARGE_CACHE
+        lru_touch(idx);
+#endif
+        return cache[idx];
     }
 
     // Not found. Use the oldest grid and make it this grid,
     // initially unpopulated
+#if TERRAIN_LARGE_CACHE
+    uint16_t oldest_i = lru_tail;
+    cache_hash_remove(oldest_i);
+#else
+    uint16_t oldest_i = 0;
+    for (uint16_t i=1; i<cache_size; i++) {
+        if (cache[i].last_access_ms < cache[oldest_i].last_access_ms) {
+            oldest_i = i;
+        }
+    }
+#endif
     struct grid_cache &grid = cache[oldest_i];
-    memset(&grid, 0, sizeof(grid));
+    memset(&grid.grid, 0, sizeof(grid.grid));
 
     grid.grid.lat = info.grid_lat;
     grid.grid.lon = info.grid_lon;
@@ -147,6 +302,17 @@ AP_Terrain::grid_cache &AP_Terrain::find_grid_cache(const struct grid_info &info
     grid.grid.version = TERRAIN_GRID_FORMAT_VERSION;
     grid.last_access_ms = hal.scheduler->millis();
 
+#if TERRAIN_LARGE_CACHE
+    cache_hash_insert(oldest_i);
+    lru_touch(oldest_i);
+
+    // blocks already on disk come straight from the page cache
+    if (read_mapped_block(grid.grid)) {
+        grid.state = GRID_CACHE_VALID;
+        return grid;
+    }
+#endif
+
     // mark as waiting for disk read
     grid.state = GRID_CACHE_DISKWAIT;
 
@@ -159,7 +325,7 @@ AP_Terrain::grid_cache &AP_Terrain::find_grid_cache(const struct grid_info &info
 int16_t AP_Terrain::find_io_idx(enum GridCacheState state)
 {
     // try first with given state
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
+    for (uint16_t i=0; i<cache_size; i++) {
         if (disk_block.block.lat == cache[i].grid.lat &&
             disk_block.block.lon == cache[i].grid.lon && 
             cache[i].state == state) {
@@ -167,7 +333,7 @@ int16_t AP_Terrain::find_io_idx(enum GridCacheState state)
         }
     }    
     // then any state
-    for (uint16_t i=0; i<TERRAIN_GRID_BLOCK_CACHE_SIZE; i++) {
+    for (uint16_t i=0; i<cache_size; i++) {
         if (disk_block.block.lat == cache[i].grid.lat &&
             disk_block.block.lon == cache[i].grid.lon) {
             return i;
@@ -188,4 +354,17 @@ uint16_t AP_Terrain::get_block_crc(struct grid_block &block)
     return ret;
 }
 
+/*
+  check a block read from disk is the one wanted, and is intact
+ */
+bool AP_Terrain::block_valid(struct grid_block &block, int32_t lat, int32_t lon)
+{
+    return block.lat == lat &&
+        block.lon == lon &&
+        block.bitmap != 0 &&
+        block.spacing == grid_spacing &&
+        block.version == TERRAIN_GRID_FORMAT_VERSION &&
+        block.crc == get_block_crc(block);
+}
+
 #endif // AP_TERRAIN_AVAILABLE
@@ -0,0 +1,316 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// Check of AP_Terrain::height_amsl_points() against height_amsl()
+//
+// Terrain data is given to the library as TERRAIN_DATA messages, as a
+// GCS would send them, for the grid blocks along a line of points. One
+// block on the line is left out and one 4x4 grid is left out of every
+// block. Every point of the line, points on the edges and corners of
+// the grid blocks and points across a degree boundary, where there is
+// no data, must get the same height and availability from both
+// functions. The time taken for the points of the line by each
+// function is then printed.
+//
+
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_PX4.h>
+
+#include <AP_Common.h>
+#include <AP_Param.h>
+#include <AP_Progmem.h>
+#include <AP_Math.h>
+#include <AP_Compass.h>
+#include <Filter.h>
+#include <AP_Declination.h>
+#include <AP_Airspeed.h>
+#include <AP_Baro.h>
+#include <AP_AHRS.h>
+#include <AP_ADC.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_InertialSensor.h>
+#include <AP_GPS.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <AP_Mission.h>
+#include <AP_Rally.h>
+#include <StorageManager.h>
+#include <AP_Terrain.h>
+#include <AP_Notify.h>
+#include <AP_Vehicle.h>
+#include <AP_NavEKF.h>
+#include <AP_Scheduler.h>
+#include <AP_BattMonitor.h>
+#include <AP_RangeFinder.h>
+#include <AP_OpticalFlow.h>
+#include <SITL.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+#if AP_TERRAIN_AVAILABLE
+
+static AP_InertialSensor ins;
+static AP_Baro baro;
+static AP_GPS gps;
+static AP_AHRS_DCM ahrs(ins, baro, gps);
+
+static bool mission_cmd(const AP_Mission::Mission_Command &cmd) { return true; }
+static void mission_complete(void) {}
+
+static AP_Mission mission(ahrs, &mission_cmd, &mission_cmd, &mission_complete);
+static AP_Rally rally(ahrs);
+static AP_Terrain terrain(ahrs, mission, rally);
+
+// the default TERRAIN_SPACING
+#define SPACING 100
+
+// points along the line, and the number of them used for timing
+#define LINE_POINTS 240
+#define TIMED_POINTS 200
+#define TIMING_RUNS 200
+
+// grid blocks given data
+#define MAX_BLOCKS 32
+
+// the 4x4 grid left out of every block
+#define MISSING_GRIDBIT 20
+
+#define MAX_POINTS (LINE_POINTS + MAX_BLOCKS*18 + 64)
+
+static Location points[MAX_POINTS];
+static uint16_t num_points;
+
+static float heights[MAX_POINTS];
+static bool available[MAX_POINTS];
+
+static int32_t block_lat[MAX_BLOCKS];
+static int32_t block_lon[MAX_BLOCKS];
+static uint8_t num_blocks;
+
+/*
+  find the south west corner of the grid block holding a location, in
+  the same way as the library does
+ */
+static void block_corner(const Location &loc, int32_t &lat, int32_t &lon)
+{
+    int32_t lat_degrees = (loc.lat<0?(loc.lat-9999999L):loc.lat) / (10*1000*1000L);
+    int32_t lon_degrees = (loc.lng<0?(loc.lng-9999999L):loc.lng) / (10*1000*1000L);
+    Location ref;
+    memset(&ref, 0, sizeof(ref));
+    ref.lat = lat_degrees*10*1000*1000L;
+    ref.lng = lon_degrees*10*1000*1000L;
+    Vector2f offset = location_diff(ref, loc);
+    uint32_t grid_idx_x = ((uint32_t)(offset.x / SPACING)) / TERRAIN_GRID_BLOCK_SPACING_X;
+    uint32_t grid_idx_y = ((uint32_t)(offset.y / SPACING)) / TERRAIN_GRID_BLOCK_SPACING_Y;
+    location_offset(ref,
+                    grid_idx_x * TERRAIN_GRID_BLOCK_SPACING_X * (float)SPACING,
+                    grid_idx_y * TERRAIN_GRID_BLOCK_SPACING_Y * (float)SPACING);
+    lat = ref.lat;
+    lon = ref.lng;
+}
+
+/*
+  send the library the heights of a grid block, leaving out one 4x4 grid
+ */
+static void fill_block(int32_t lat, int32_t lon)
+{
+    for (uint8_t gridbit=0; gridbit<TERRAIN_GRID_BLOCK_MUL_X*TERRAIN_GRID_BLOCK_MUL_Y; gridbit++) {
+        if (gridbit == MISSING_GRIDBIT) {
+            continue;
+        }
+        int16_t data[16];
+        for (uint8_t i=0; i<16; i++) {
+            uint32_t v = (uint32_t)lat/1000 + (uint32_t)lon/3000 + gridbit*137 + i*29;
+            data[i] = (v % 1500) - 100;
+        }
+        mavlink_message_t msg;
+        mavlink_msg_terrain_data_pack(255, 0, &msg, lat, lon, SPACING, gridbit, data);
+        terrain.handle_terrain_data(&msg);
+    }
+}
+
+static void add_point(const Location &loc)
+{
+    if (num_points < MAX_POINTS) {
+        points[num_points++] = loc;
+    }
+}
+
+/*
+  make the points to check, giving data for the blocks of the line
+  except one
+ */
+static void setup_points(void)
+{
+    Location loc;
+    memset(&loc, 0, sizeof(loc));
+    loc.lat = -353632610;
+    loc.lng = 1491652300;
+
+    // a line of points 40m apart, crossing several grid blocks
+    for (uint16_t i=0; i<LINE_POINTS; i++) {
+        add_point(loc);
+        location_update(loc, 30, 40);
+    }
+
+    // the block of this point is left without data
+    int32_t missing_lat, missing_lon;
+    block_corner(points[LINE_POINTS/2], missing_lat, missing_lon);
+
+    for (uint16_t i=0; i<LINE_POINTS && num_blocks < MAX_BLOCKS; i++) {
+        int32_t lat, lon;
+        block_corner(points[i], lat, lon);
+        bool known = (lat == missing_lat && lon == missing_lon);
+        for (uint8_t b=0; b<num_blocks; b++) {
+            if (block_lat[b] == lat && block_lon[b] == lon) {
+                known = true;
+            }
+        }
+        if (!known) {
+            block_lat[num_blocks] = lat;
+            block_lon[num_blocks] = lon;
+            num_blocks++;
+        }
+    }
+
+    // points on and either side of the corners and the far edges of
+    // each block, and of the missing block
+    for (uint8_t b=0; b<=num_blocks; b++) {
+        Location corner;
+        memset(&corner, 0, sizeof(corner));
+        corner.lat = (b < num_blocks) ? block_lat[b] : missing_lat;
+        corner.lng = (b < num_blocks) ? block_lon[b] : missing_lon;
+        Location north = corner;
+        location_offset(north, TERRAIN_GRID_BLOCK_SPACING_X * SPACING, SPACING);
+        Location east = corner;
+        location_offset(east, SPACING, TERRAIN_GRID_BLOCK_SPACING_Y * SPACING);
+        const Location *edges[3] = { &corner, &north, &east };
+        for (uint8_t e=0; e<3; e++) {
+            for (int8_t dlat=-1; dlat<=1; dlat++) {
+                for (int8_t dlng=-1; dlng<=1; dlng++) {
+                    if (e != 0 && dlat != 0 && dlng != 0) {
+                        continue;
+                    }
+                    Location p = *edges[e];
+                    p.lat += dlat;
+                    p.lng += dlng;
+                    add_point(p);
+                }
+            }
+        }
+    }
+
+    // points either side of a degree boundary, with no data
+    memset(&loc, 0, sizeof(loc));
+    loc.lat = -350000400;
+    loc.lng = 1490000000 - 200;
+    for (uint8_t i=0; i<40; i++) {
+        add_point(loc);
+        loc.lat += 20;
+        loc.lng += 10;
+    }
+}
+
+static bool check_points(void)
+{
+    uint16_t found = terrain.height_amsl_points(points, num_points, heights, available);
+    uint16_t errors = 0;
+    uint16_t have_data = 0;
+    for (uint16_t i=0; i<num_points; i++) {
+        float height = 0;
+        bool ok = terrain.height_amsl(points[i], height);
+        if (ok) {
+            have_data++;
+        }
+        if (ok != available[i] || (ok && height != heights[i])) {
+            if (errors++ < 10) {
+                hal.console->printf_P(PSTR("point %u %ld %ld: height_amsl %u %f batch %u %f\n"),
+                                      (unsigned)i, (long)points[i].lat, (long)points[i].lng,
+                                      (unsigned)ok, height,
+                                      (unsigned)available[i], heights[i]);
+            }
+        }
+    }
+    hal.console->printf_P(PSTR("%u points, %u with data, %u without, %u blocks\n"),
+                          (unsigned)num_points, (unsigned)have_data,
+                          (unsigned)(num_points - have_data), (unsigned)num_blocks);
+    if (found != have_data) {
+        hal.console->printf_P(PSTR("height_amsl_points() found %u\n"), (unsigned)found);
+        errors++;
+    }
+    if (have_data == 0 || have_data == num_points) {
+        hal.console->println("expected points both with and without data");
+        errors++;
+    }
+    if (errors != 0) {
+        hal.console->printf_P(PSTR("FAILED: %u mismatches\n"), (unsigned)errors);
+        return false;
+    }
+    hal.console->println("height_amsl_points() matches height_amsl()");
+    return true;
+}
+
+static void time_points(void)
+{
+    float height;
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint16_t r=0; r<TIMING_RUNS; r++) {
+        for (uint16_t i=0; i<TIMED_POINTS; i++) {
+            terrain.height_amsl(points[i], height);
+        }
+    }
+    uint32_t t1 = hal.scheduler->micros();
+    for (uint16_t r=0; r<TIMING_RUNS; r++) {
+        terrain.height_amsl_points(points, TIMED_POINTS, heights, available);
+    }
+    uint32_t t2 = hal.scheduler->micros();
+    hal.console->printf_P(PSTR("%u runs of %u points: height_amsl() %lu usec, height_amsl_points() %lu usec\n"),
+                          (unsigned)TIMING_RUNS, (unsigned)TIMED_POINTS,
+                          (unsigned long)(t1 - t0), (unsigned long)(t2 - t1));
+}
+
+static bool passed;
+
+void setup(void)
+{
+    hal.console->println("AP_Terrain batch height check");
+
+    setup_points();
+
+    // the first lookup of each block puts it in the cache, so the
+    // data can be given to it
+    terrain.height_amsl_points(points, num_points, heights, NULL);
+    for (uint8_t b=0; b<num_blocks; b++) {
+        fill_block(block_lat[b], block_lon[b]);
+    }
+
+    passed = check_points();
+}
+
+void loop(void)
+{
+    if (passed) {
+        time_points();
+    }
+    hal.scheduler->delay(1000);
+}
+
+#else
+
+void setup(void)
+{
+    hal.console->println("TerrainBatch needs a board with terrain support");
+}
+
+void loop(void)
+{
+    hal.scheduler->delay(1000);
+}
+
+#endif // AP_TERRAIN_AVAILABLE
+
+AP_HAL_MAIN();
@@ -14,6 +14,7 @@
 #include <AP_AHRS.h>
 #include "../AP_Airspeed/AP_Airspeed.h"
 #include "../AP_BattMonitor/AP_BattMonitor.h"
+#include "../AP_Scheduler/AP_Scheduler.h"
 #include <stdint.h>
 
 #if CONFIG_HAL_BOARD == HAL_BOARD_PX4
@@ -83,6 +84,9 @@ public:
 	void Log_Write_Current(const AP_BattMonitor &battery, int16_t throttle);
     void Log_Write_Compass(const Compass &compass);
     void Log_Write_Mode(uint8_t mode);
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+    void Log_Write_Scheduler(const AP_Scheduler &sched);
+#endif
 
     bool logging_started(void) const { return log_write_started; }
 
@@ -446,6 +450,26 @@ struct PACKED log_Mode {
     uint8_t mode_num;
 };
 
+/*
+  per-task scheduler statistics
+ */
+struct PACKED log_Scheduler {
+    LOG_PACKET_HEADER;
+    uint32_t time_ms;
+    uint8_t task;
+    uint16_t budget;
+    uint16_t min_time;
+    uint16_t avg_time;
+    uint16_t max_time;
+    uint32_t runs;
+    uint16_t overruns;
+    uint16_t skipped;
+    uint16_t slip0;
+    uint16_t slip1;
+    uint16_t slip2;
+    uint16_t slip4;
+};
+
 /*
   terrain log structure
  */
@@ -614,6 +638,8 @@ Format characters in the format string for binary log messages
       "AHR2","IccCfLL","TimeMS,Roll,Pitch,Yaw,Alt,Lat,Lng" }, \
     { LOG_POS_MSG, sizeof(log_POS), \
       "POS","ILLff","TimeMS,Lat,Lng,Alt,RelAlt" }, \
+    { LOG_SCHED_MSG, sizeof(log_Scheduler), \
+      "SCHD","IBHHHHIHHHHHH","TimeMS,Task,Budget,Min,Avg,Max,Runs,Ovr,Skip,Sl0,Sl1,Sl2,Sl4" }, \
     { LOG_SIMSTATE_MSG, sizeof(log_AHRS), \
       "SIM","IccCfLL","TimeMS,Roll,Pitch,Yaw,Alt,Lat,Lng" }, \
     { LOG_EKF1_MSG, sizeof(log_EKF1), \
@@ -729,6 +755,7 @@ Format characters in the format string for binary log messages
 #define LOG_GYR2_MSG      176
 #define LOG_GYR3_MSG      177
 #define LOG_POS_MSG       178
+#define LOG_SCHED_MSG     179
 
 // message types 200 to 210 reversed for GPS driver use
 // message types 211 to 220 reversed for autotune use
@@ -24,26 +24,44 @@
 #include <stdio.h>
 #include <time.h>
 #include <dirent.h>
-#include "../AP_HAL/utility/RingBuffer.h"
+#if CONFIG_HAL_BOARD == HAL_BOARD_LINUX || CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#include <sys/uio.h>
+#define DATAFLASH_FILE_HAVE_WRITEV 1
+#endif
 
 extern const AP_HAL::HAL& hal;
 
 #define MAX_LOG_FILES 500U
 #define DATAFLASH_PAGE_SIZE 1024UL
 
+// the IO thread waits for this much data before writing, unless the
+// data is 2 seconds old. Larger chunks only batch up a backlog
+#define DATAFLASH_FILE_MIN_FLUSH 4096UL
+
+// log file times before this (2015) are from a board without a clock
+#define DATAFLASH_FILE_MIN_TIME 1420070400UL
+// how far into a log to look for a GPS fix to date it by
+#define DATAFLASH_FILE_TIME_SCAN 65536UL
+// GPS epoch as unix time, less the leap seconds since then
+#define GPS_UNIX_OFFSET_SEC (315964800UL - 16)
+
 /*
   constructor
  */
-DataFlash_File::DataFlash_File(const char *log_directory) :
+DataFlash_File::DataFlash_File(const char *log_directory, uint32_t writebuf_size) :
     _write_fd(-1),
     _read_fd(-1),
     _read_offset(0),
     _write_offset(0),
+    _readbuf(NULL),
+    _readbuf_ofs(0),
+    _readbuf_len(0),
+    _read_block_ofs(0),
     _initialised(false),
     _open_error(false),
     _log_directory(log_directory),
-    _writebuf(NULL),
-    _writebuf_size(16*1024),
+    _writebuf(0),
+    _writebuf_size(writebuf_size),
 #if defined(CONFIG_ARCH_BOARD_PX4FMU_V1)
     // V1 gets IO errors with larger than 512 byte writes
     _writebuf_chunk(512),
@@ -59,12 +77,15 @@ DataFlash_File::DataFlash_File(const char *log_directory) :
     _writebuf_chunk(512),
 #elif defined(CONFIG_ARCH_BOARD_VRHERO_V10)
     _writebuf_chunk(512),
+#elif defined(DATAFLASH_FILE_HAVE_WRITEV)
+    // gather a backlog of up to 64k per syscall, split over the end of
+    // the buffer if needed
+    _writebuf_chunk(65536),
 #else
     _writebuf_chunk(4096),
 #endif
-    _writebuf_head(0),
-    _writebuf_tail(0),
-    _last_write_time(0)
+    _last_write_time(0),
+    _write_stats()
 #if CONFIG_HAL_BOARD == HAL_BOARD_PX4 || CONFIG_HAL_BOARD == HAL_BOARD_VRBRAIN
     ,_perf_write(perf_alloc(PC_ELAPSED, "DF_write")),
     _perf_fsync(perf_alloc(PC_ELAPSED, "DF_fsync")),
@@ -105,26 +126,19 @@ void DataFlash_File::Init(const struct LogStructure *structure, uint8_t num_type
         hal.console->printf("Failed to create log directory %s", _log_directory);
         return;
     }
-    if (_writebuf != NULL) {
-        free(_writebuf);
-        _writebuf = NULL;
-    }
 
     /*
       if we can't allocate the full writebuf then try reducing it
       until we can allocate it
      */
-    while (_writebuf == NULL && _writebuf_size >= _writebuf_chunk) {
-        _writebuf = (uint8_t *)malloc(_writebuf_size);
-        if (_writebuf == NULL) {
-            _writebuf_size /= 2;
-        }
+    while (!_writebuf.set_size(_writebuf_size) && _writebuf_size >= _writebuf_chunk) {
+        _writebuf_size /= 2;
     }
-    if (_writebuf == NULL) {
+    if (_writebuf.get_size() == 0) {
         hal.console->printf("Out of memory for logging\n");
         return;        
     }
-    _writebuf_head = _writebuf_tail = 0;
+    _writebuf_size = _writebuf.get_size();
     _initialised = true;
     hal.scheduler->register_io_process(AP_HAL_MEMBERPROC(&DataFlash_File::_io_timer));
 }
@@ -196,38 +210,24 @@ void DataFlash_File::WriteBlock(const void *pBuffer, uint16_t size)
     if (_write_fd == -1 || !_initialised || _open_error || !_writes_enabled) {
         return;
     }
-    uint16_t _head;
-    uint16_t space = BUF_SPACE(_writebuf);
-    if (space < size) {
+    if (_writebuf.space() < size) {
         // discard the whole write, to keep the log consistent
         perf_count(_perf_overruns);
+        _write_stats.dropped_bytes += size;
         return;
     }
 
-    if (_writebuf_tail < _head) {
-        // perform as single memcpy
-        assert(_writebuf_tail+size <= _writebuf_size);
-        memcpy(&_writebuf[_writebuf_tail], pBuffer, size);
-        BUF_ADVANCETAIL(_writebuf, size);
-    } else {
-        // perform as two memcpy calls
-        uint16_t n = _writebuf_size - _writebuf_tail;
-        if (n > size) n = size;
-        assert(_writebuf_tail+n <= _writebuf_size);
-        memcpy(&_writebuf[_writebuf_tail], pBuffer, n);
-        BUF_ADVANCETAIL(_writebuf, n);
-        pBuffer = (const void *)(((const uint8_t *)pBuffer) + n);
-        n = size - n;
-        if (n > 0) {
-            assert(_writebuf_tail+n <= _writebuf_size);
-            memcpy(&_writebuf[_writebuf_tail], pBuffer, n);
-            BUF_ADVANCETAIL(_writebuf, n);
-        }
+    _writebuf.write((const uint8_t *)pBuffer, size);
+
+    uint32_t used = _writebuf.available();
+    if (used > _write_stats.high_water) {
+        _write_stats.high_water = used;
     }
 }
 
 /*
-  read a packet. The header bytes have already been read.
+  read a packet. The header bytes have already been read by
+  _log_read_next()
 */
 void DataFlash_File::ReadBlock(void *pkt, uint16_t size)
 {
@@ -236,8 +236,10 @@ void DataFlash_File::ReadBlock(void *pkt, uint16_t size)
     }
 
     memset(pkt, 0, size);
-    ::read(_read_fd, pkt, size);
-    _read_offset += size;
+    const uint8_t *data = NULL;
+    uint32_t n = _read_peek(_read_block_ofs, size, data);
+    memcpy(pkt, data, n);
+    _read_block_ofs += size;
 }
 
 
@@ -296,6 +298,47 @@ uint32_t DataFlash_File::_get_log_time(uint16_t log_num)
     return st.st_mtime;
 }
 
+/*
+  find the time of a log for listing it. Boards without a clock give
+  their logs a time near the epoch, so for those use the time of the
+  first GPS fix near the start of the log. This reads the log, so it
+  is not used for the GCS log list
+ */
+uint32_t DataFlash_File::_get_log_list_time(uint16_t log_num)
+{
+    uint32_t ret = _get_log_time(log_num);
+    if (ret >= DATAFLASH_FILE_MIN_TIME || !_initialised) {
+        return ret;
+    }
+    if (_read_fd != -1 && _read_fd_log_num != log_num) {
+        // don't take the read buffer from a download of another log
+        return ret;
+    }
+    bool was_open = _read_fd != -1;
+    if (!_read_open(log_num)) {
+        return ret;
+    }
+    struct log_reader r;
+    _log_read_start(r, 0, DATAFLASH_FILE_TIME_SCAN);
+    const uint8_t *msg;
+    while (_log_read_next(r, msg)) {
+        if (msg[2] != LOG_GPS_MSG || r.msg_len[LOG_GPS_MSG] < sizeof(struct log_GPS)) {
+            continue;
+        }
+        const struct log_GPS *pkt = (const struct log_GPS *)msg;
+        if (pkt->status >= AP_GPS::GPS_OK_FIX_3D && pkt->gps_week != 0) {
+            ret = pkt->gps_week * 7 * 86400UL + pkt->gps_week_ms / 1000 +
+                GPS_UNIX_OFFSET_SEC;
+            break;
+        }
+    }
+    if (!was_open) {
+        ::close(_read_fd);
+        _read_fd = -1;
+    }
+    return ret;
+}
+
 /*
   find the number of pages in a log
  */
@@ -337,9 +380,26 @@ int16_t DataFlash_File::get_log_data(uint16_t log_num, uint16_t page, uint32_t o
         free(fname);
         _read_offset = 0;
         _read_fd_log_num = log_num;
+        _readbuf_len = 0;
     }
     uint32_t ofs = page * (uint32_t)DATAFLASH_PAGE_SIZE + offset;
 
+    // downloads read the log in small sequential chunks, so serve
+    // them from the read-ahead buffer
+    const uint8_t *p;
+    uint32_t n = _read_peek(ofs, len, p);
+    if (_readbuf == NULL) {
+        return (int16_t)_read_file(ofs, data, len);
+    }
+    memcpy(data, p, n);
+    return n;
+}
+
+/*
+  read from the open log at an offset
+ */
+ssize_t DataFlash_File::_read_file(uint32_t ofs, void *data, uint32_t len)
+{
     /*
       this rather strange bit of code is here to work around a bug
       in file offsets in NuttX. Every few hundred blocks of reads
@@ -360,13 +420,116 @@ int16_t DataFlash_File::get_log_data(uint16_t log_num, uint16_t page, uint32_t o
         ::lseek(_read_fd, ofs, SEEK_SET);
         _read_offset = ofs;
     }
-    int16_t ret = (int16_t)::read(_read_fd, data, len);
+    ssize_t ret = ::read(_read_fd, data, len);
     if (ret > 0) {
         _read_offset += ret;
     }
     return ret;
 }
 
+/*
+  open a log for reading, keeping it open if it already is
+ */
+bool DataFlash_File::_read_open(uint16_t log_num)
+{
+    if (_read_fd != -1 && log_num == _read_fd_log_num) {
+        return true;
+    }
+    if (_read_fd != -1) {
+        ::close(_read_fd);
+        _read_fd = -1;
+    }
+    char *fname = _log_file_name(log_num);
+    if (fname == NULL) {
+        return false;
+    }
+    _read_fd = ::open(fname, O_RDONLY);
+    free(fname);
+    if (_read_fd == -1) {
+        return false;
+    }
+    _read_fd_log_num = log_num;
+    _read_offset = 0;
+    _readbuf_len = 0;
+    return true;
+}
+
+/*
+  get up to len bytes of the open log at ofs through the read-ahead
+  buffer, refilling it from ofs if they are not all in it. Returns the
+  number of bytes available, which is less than len at the end of the
+  log. data is valid until the next read
+ */
+uint32_t DataFlash_File::_read_peek(uint32_t ofs, uint32_t len, const uint8_t *&data)
+{
+    if (_readbuf == NULL) {
+        _readbuf = (uint8_t *)malloc(DATAFLASH_FILE_READBUF_SIZE);
+        _readbuf_len = 0;
+        if (_readbuf == NULL) {
+            data = NULL;
+            return 0;
+        }
+    }
+    if (ofs < _readbuf_ofs || ofs + len > _readbuf_ofs + _readbuf_len) {
+        ssize_t ret = _read_file(ofs, _readbuf, DATAFLASH_FILE_READBUF_SIZE);
+        _readbuf_ofs = ofs;
+        _readbuf_len = ret > 0 ? ret : 0;
+    }
+    data = &_readbuf[ofs - _readbuf_ofs];
+    uint32_t avail = _readbuf_ofs + _readbuf_len - ofs;
+    return len < avail ? len : avail;
+}
+
+/*
+  start a walk over the messages of the open log between two offsets
+ */
+void DataFlash_File::_log_read_start(struct log_reader &r, uint32_t start, uint32_t end)
+{
+    r.next = start;
+    r.end = end;
+    memset(r.msg_len, 0, sizeof(r.msg_len));
+    for (uint8_t i=0; i<_num_types; i++) {
+        uint8_t type = pgm_read_byte((const prog_char *)&_structures[i].msg_type);
+        r.msg_len[type] = pgm_read_byte((const prog_char *)&_structures[i].msg_len);
+    }
+}
+
+/*
+  find the next message of the log. Bytes that don't start a message
+  are skipped. A message of unknown type is returned as just its
+  header, and the walk carries on after it. msg is the whole message,
+  valid until the next read, and ReadBlock() then reads its body
+ */
+bool DataFlash_File::_log_read_next(struct log_reader &r, const uint8_t *&msg)
+{
+    while (r.next < r.end) {
+        if (_read_peek(r.next, 3, msg) < 3) {
+            // reached end of file
+            return false;
+        }
+        if (msg[0] != HEAD_BYTE1 || msg[1] != HEAD_BYTE2) {
+            r.next++;
+            continue;
+        }
+        uint8_t len = r.msg_len[msg[2]];
+        if (len < 3) {
+            len = 3;
+        }
+        if (_read_peek(r.next, len, msg) < len) {
+            // the log ends part way through the message
+            return false;
+        }
+        if (msg[2] == LOG_FORMAT_MSG && len >= sizeof(struct log_Format)) {
+            const struct log_Format *fmt = (const struct log_Format *)msg;
+            r.msg_len[fmt->type] = fmt->length;
+        }
+        _read_block_ofs = r.next + 3;
+        r.next += len;
+        return true;
+    }
+    return false;
+}
+
 /*
   find size and date of a log
  */
@@ -424,6 +587,11 @@ uint16_t DataFlash_File::start_new_log(void)
         ::close(_read_fd);
         _read_fd = -1;
     }
+    if (_readbuf != NULL) {
+        // downloads are over, so give back the read-ahead buffer
+        free(_readbuf);
+        _readbuf = NULL;
+    }
 
     uint16_t log_num = find_last_log();
     // re-use empty logs if possible
@@ -448,8 +616,7 @@ uint16_t DataFlash_File::start_new_log(void)
     }
     free(fname);
     _write_offset = 0;
-    _writebuf_head = 0;
-    _writebuf_tail = 0;
+    _writebuf.clear();
     log_write_started = true;
 
     // now update lastlog.txt with the new log number
@@ -470,69 +637,18 @@ void DataFlash_File::LogReadProcess(uint16_t log_num,
                                     void (*print_mode)(AP_HAL::BetterStream *port, uint8_t mode),
                                     AP_HAL::BetterStream *port)
 {
-    uint8_t log_step = 0;
     if (!_initialised || _open_error) {
         return;
     }
-    if (_read_fd != -1) {
-        ::close(_read_fd);
-        _read_fd = -1;
-    }
-    char *fname = _log_file_name(log_num);
-    if (fname == NULL) {
-        return;
-    }
-    _read_fd = ::open(fname, O_RDONLY);
-    free(fname);
-    if (_read_fd == -1) {
+    if (!_read_open(log_num)) {
         return;
     }
-    _read_fd_log_num = log_num;
-    _read_offset = 0;
-    if (start_page != 0) {
-        ::lseek(_read_fd, start_page * DATAFLASH_PAGE_SIZE, SEEK_SET);
-        _read_offset = start_page * DATAFLASH_PAGE_SIZE;
-    }
-
-    uint8_t log_counter = 0;
-
-    while (true) {
-        uint8_t data;
-        if (::read(_read_fd, &data, 1) != 1) {
-            // reached end of file
-            break;
-        }
-        _read_offset++;
-
-        // This is a state machine to read the packets
-        switch(log_step) {
-            case 0:
-                if (data == HEAD_BYTE1) {
-                    log_step++;
-                }
-                break;
-
-            case 1:
-                if (data == HEAD_BYTE2) {
-                    log_step++;
-                } else {
-                    log_step = 0;
-                }
-                break;
 
-            case 2:
-                log_step = 0;
-                _print_log_entry(data, print_mode, port);
-                log_counter++;
-                if (log_counter == 10) {
-                    log_counter = 0;
-                    ::lseek(_read_fd, 0, SEEK_CUR);
-                }
-                break;
-        }
-        if (_read_offset >= (end_page+1) * DATAFLASH_PAGE_SIZE) {
-            break;
-        }
+    struct log_reader r;
+    _log_read_start(r, start_page * DATAFLASH_PAGE_SIZE, (end_page+1) * DATAFLASH_PAGE_SIZE);
+    const uint8_t *msg;
+    while (_log_read_next(r, msg)) {
+        _print_log_entry(msg[2], print_mode, port);
     }
 
     ::close(_read_fd);
@@ -554,6 +670,13 @@ void DataFlash_File::ShowDeviceInfo(AP_HAL::BetterStream *port)
 {
     port->printf_P(PSTR("DataFlash logs stored in %s\n"), 
                    _log_directory);
+    port->printf_P(PSTR("Write buffer %u bytes, high water %u, dropped %u bytes, %u flushes, max %uus, %u errors\n"),
+                   (unsigned)_writebuf.get_size(),
+                   (unsigned)_write_stats.high_water,
+                   (unsigned)_write_stats.dropped_bytes,
+                   (unsigned)_write_stats.flush_count,
+                   (unsigned)_write_stats.flush_max_us,
+                   (unsigned)_write_stats.write_errors);
 }
 
 
@@ -579,9 +702,9 @@ void DataFlash_File::ListAvailableLogs(AP_HAL::BetterStream *port)
         if (filename != NULL) {
             size = _get_log_size(log_num);
             if (size != 0) {
-                struct stat st;
-                if (stat(filename, &st) == 0) {
-                    struct tm *tm = gmtime(&st.st_mtime);
+                time_t t = _get_log_list_time(log_num);
+                if (t != 0) {
+                    struct tm *tm = gmtime(&t);
                     port->printf_P(PSTR("Log %u in %s of size %u %u/%u/%u %u:%u\n"), 
                                    (unsigned)log_num, 
                                    filename,
@@ -602,20 +725,20 @@ void DataFlash_File::ListAvailableLogs(AP_HAL::BetterStream *port)
 
 void DataFlash_File::_io_timer(void)
 {
-    uint16_t _tail;
     if (_write_fd == -1 || !_initialised || _open_error) {
         return;
     }
 
-    uint16_t nbytes = BUF_AVAILABLE(_writebuf);
+    uint32_t nbytes = _writebuf.available();
     if (nbytes == 0) {
         return;
     }
     uint32_t tnow = hal.scheduler->micros();
-    if (nbytes < _writebuf_chunk && 
+    uint32_t min_flush = _writebuf_chunk < DATAFLASH_FILE_MIN_FLUSH ? _writebuf_chunk : DATAFLASH_FILE_MIN_FLUSH;
+    if (nbytes < min_flush && 
         tnow - _last_write_time < 2000000UL) {
-        // write in 512 byte chunks, but always write at least once
-        // per 2 seconds if data is available
+        // write in chunks of at least min_flush, but always write at
+        // least once per 2 seconds if data is available
         return;
     }
 
@@ -626,10 +749,14 @@ void DataFlash_File::_io_timer(void)
         // be kind to the FAT PX4 filesystem
         nbytes = _writebuf_chunk;
     }
-    if (_writebuf_head > _tail) {
-        // only write to the end of the buffer
-        nbytes = min(nbytes, _writebuf_size - _writebuf_head);
-    }
+
+    ByteBuffer::IoVec vec[2];
+    uint8_t nvec = _writebuf.peekiovec(vec, nbytes);
+#ifndef DATAFLASH_FILE_HAVE_WRITEV
+    // only write to the end of the buffer
+    nvec = 1;
+    nbytes = vec[0].len;
+#endif
 
     // try to align writes on a 512 byte boundary to avoid filesystem
     // reads
@@ -639,11 +766,26 @@ void DataFlash_File::_io_timer(void)
             nbytes -= ofs;
         }
     }
+    if (vec[0].len >= nbytes) {
+        vec[0].len = nbytes;
+        nvec = 1;
+    } else {
+        vec[1].len = nbytes - vec[0].len;
+    }
 
-    assert(_writebuf_head+nbytes <= _writebuf_size);
-    ssize_t nwritten = ::write(_write_fd, &_writebuf[_writebuf_head], nbytes);
+#ifdef DATAFLASH_FILE_HAVE_WRITEV
+    struct iovec iov[2];
+    for (uint8_t i=0; i<nvec; i++) {
+        iov[i].iov_base = vec[i].data;
+        iov[i].iov_len = vec[i].len;
+    }
+    ssize_t nwritten = ::writev(_write_fd, iov, nvec);
+#else
+    ssize_t nwritten = ::write(_write_fd, vec[0].data, vec[0].len);
+#endif
     if (nwritten <= 0) {
         perf_count(_perf_errors);
+        _write_stats.write_errors++;
         close(_write_fd);
         _write_fd = -1;
         _initialised = false;
@@ -655,10 +797,17 @@ void DataFlash_File::_io_timer(void)
           chunk, ensuring the directory entry is updated after each
           write.
          */
-        BUF_ADVANCEHEAD(_writebuf, nwritten);
+        _writebuf.advance(nwritten);
 #if CONFIG_HAL_BOARD != HAL_BOARD_SITL && CONFIG_HAL_BOARD_SUBTYPE != HAL_BOARD_SUBTYPE_LINUX_NONE
         ::fsync(_write_fd);
 #endif
+
+        uint32_t flush_us = hal.scheduler->micros() - tnow;
+        _write_stats.flush_count++;
+        _write_stats.flush_last_us = flush_us;
+        if (flush_us > _write_stats.flush_max_us) {
+            _write_stats.flush_max_us = flush_us;
+        }
     }
     perf_end(_perf_write);
 }
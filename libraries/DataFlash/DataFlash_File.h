@@ -18,12 +18,39 @@
 #define perf_count(x)
 #endif
 
+#include "../AP_HAL/utility/RingBuffer.h"
+
+/*
+  size of the write buffer between the main thread and the IO
+  thread. Must be a power of 2. Boards may override this.
+ */
+#ifndef DATAFLASH_FILE_BUFSIZE
+#if CONFIG_HAL_BOARD == HAL_BOARD_LINUX || CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#define DATAFLASH_FILE_BUFSIZE (256*1024UL)
+#else
+#define DATAFLASH_FILE_BUFSIZE (16*1024UL)
+#endif
+#endif
+
+/*
+  size of the read-ahead buffer for log download and log reading,
+  allocated when first needed. Boards may override this, but it must
+  hold the largest message
+ */
+#ifndef DATAFLASH_FILE_READBUF_SIZE
+#if CONFIG_HAL_BOARD == HAL_BOARD_LINUX || CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#define DATAFLASH_FILE_READBUF_SIZE (64*1024UL)
+#else
+#define DATAFLASH_FILE_READBUF_SIZE 4096UL
+#endif
+#endif
+
 
 class DataFlash_File : public DataFlash_Class
 {
 public:
     // constructor
-    DataFlash_File(const char *log_directory);
+    DataFlash_File(const char *log_directory, uint32_t writebuf_size=DATAFLASH_FILE_BUFSIZE);
 
     // initialisation
     void Init(const struct LogStructure *structure, uint8_t num_types);
@@ -51,12 +78,43 @@ public:
     void ShowDeviceInfo(AP_HAL::BetterStream *port);
     void ListAvailableLogs(AP_HAL::BetterStream *port);
 
+    // write buffer statistics
+    struct WriteStats {
+        uint32_t dropped_bytes;     // bytes discarded because the buffer was full
+        uint32_t high_water;        // largest number of bytes waiting to be written
+        uint32_t flush_count;       // number of successful writes made by the IO thread
+        uint32_t write_errors;      // number of failed writes, which stop logging
+        uint32_t flush_last_us;     // duration of the last write, including fsync
+        uint32_t flush_max_us;      // longest write, including fsync
+    };
+    const WriteStats &get_write_stats(void) const { return _write_stats; }
+
 private:
     int _write_fd;
     int _read_fd;
     uint16_t _read_fd_log_num;
     uint32_t _read_offset;
     uint32_t _write_offset;
+
+    // read-ahead buffer for reading logs, holding _readbuf_len bytes
+    // of the log from _readbuf_ofs
+    uint8_t *_readbuf;
+    uint32_t _readbuf_ofs;
+    uint32_t _readbuf_len;
+
+    // where ReadBlock() reads the body of the current message
+    uint32_t _read_block_ofs;
+
+    /*
+      a walk over the messages of the open log. Messages are framed by
+      the length of their type, from the vehicle's log structures and
+      then from the FMT messages in the log itself
+     */
+    struct log_reader {
+        uint32_t next;          // offset to look for the next message at
+        uint32_t end;           // offset to stop at
+        uint8_t  msg_len[256];  // length of each message type, zero if unknown
+    };
     volatile bool _initialised;
     volatile bool _open_error;
     const char *_log_directory;
@@ -66,19 +124,28 @@ private:
     */
     void ReadBlock(void *pkt, uint16_t size);
 
-    // write buffer
-    uint8_t *_writebuf;
-    uint16_t _writebuf_size;
-    const uint16_t _writebuf_chunk;
-    volatile uint16_t _writebuf_head;
-    volatile uint16_t _writebuf_tail;
+    // read from the open log at an offset
+    ssize_t _read_file(uint32_t ofs, void *data, uint32_t len);
+    bool _read_open(uint16_t log_num);
+    uint32_t _read_peek(uint32_t ofs, uint32_t len, const uint8_t *&data);
+
+    // message iteration over the open log
+    void _log_read_start(struct log_reader &r, uint32_t start, uint32_t end);
+    bool _log_read_next(struct log_reader &r, const uint8_t *&msg);
+
+    // write buffer, filled by WriteBlock() and drained by _io_timer()
+    ByteBuffer _writebuf;
+    uint32_t _writebuf_size;
+    const uint32_t _writebuf_chunk;
     uint32_t _last_write_time;
+    WriteStats _write_stats;
 
     /* construct a file name given a log number. Caller must free. */
     char *_log_file_name(uint16_t log_num);
     char *_lastlog_file_name(void);
     uint32_t _get_log_size(uint16_t log_num);
     uint32_t _get_log_time(uint16_t log_num);
+    uint32_t _get_log_list_time(uint16_t log_num);
 
     void stop_logging(void);
 
@@ -1251,6 +1251,34 @@ void DataFlash_Class::Log_Write_Mode(uint8_t mode)
     WriteBlock(&pkt, sizeof(pkt));
 }
 
+#if AP_SCHEDULER_EXTENDED_AVAILABLE
+// Write the timing statistics of every scheduler task
+void DataFlash_Class::Log_Write_Scheduler(const AP_Scheduler &sched)
+{
+    uint32_t now = hal.scheduler->millis();
+    for (uint8_t i=0; i<sched.num_tasks(); i++) {
+        const AP_Scheduler::TaskStats &stats = sched.task_stats(i);
+        struct log_Scheduler pkt = {
+            LOG_PACKET_HEADER_INIT(LOG_SCHED_MSG),
+            time_ms  : now,
+            task     : i,
+            budget   : sched.task_budget(i),
+            min_time : stats.min_micros,
+            avg_time : (uint16_t)(stats.runs ? stats.total_micros / stats.runs : 0),
+            max_time : stats.max_micros,
+            runs     : stats.runs,
+            overruns : stats.overruns,
+            skipped  : stats.skipped,
+            slip0    : stats.slips[0],
+            slip1    : stats.slips[1],
+            slip2    : stats.slips[2],
+            slip4    : stats.slips[3]
+        };
+        WriteBlock(&pkt, sizeof(pkt));
+    }
+}
+#endif
+
 // Write ESC status messages
 void DataFlash_Class::Log_Write_ESC(void)
 {
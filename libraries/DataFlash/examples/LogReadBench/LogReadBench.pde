@@ -0,0 +1,275 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// Benchmark of reading file logs with DataFlash_File::LogReadProcess()
+//
+// A log of TEST messages is written to logreadbench/1.BIN in the
+// current directory, then parsed with LogReadProcess() to a port that
+// discards its output. For comparison the same log is printed to the
+// same port by the old LogReadProcess() loop, which made a read() call
+// for each header byte and message body.
+//
+
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_Empty_Private.h>
+#include <AP_HAL_PX4.h>
+
+#include <AP_Common.h>
+#include <AP_Param.h>
+#include <AP_Progmem.h>
+#include <AP_Math.h>
+#include <AP_Compass.h>
+#include <Filter.h>
+#include <AP_Declination.h>
+#include <AP_Airspeed.h>
+#include <AP_Baro.h>
+#include <AP_AHRS.h>
+#include <AP_ADC.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_InertialSensor.h>
+#include <AP_GPS.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <AP_Mission.h>
+#include <StorageManager.h>
+#include <AP_Terrain.h>
+#include <AP_Notify.h>
+#include <AP_Vehicle.h>
+#include <AP_NavEKF.h>
+#include <AP_Rally.h>
+#include <AP_Scheduler.h>
+#include <AP_BattMonitor.h>
+#include <AP_RangeFinder.h>
+#include <AP_OpticalFlow.h>
+#include <SITL.h>
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOG_DIRECTORY "logreadbench"
+#define LOG_FILE LOG_DIRECTORY "/1.BIN"
+
+// size of the test log
+#define NUM_MESSAGES 200000UL
+
+static DataFlash_File DataFlash(LOG_DIRECTORY);
+
+#define LOG_TEST_MSG 1
+
+struct PACKED log_Test {
+    LOG_PACKET_HEADER;
+    uint16_t v1, v2, v3, v4;
+    int32_t  l1, l2;
+};
+
+static const struct LogStructure log_structure[] PROGMEM = {
+    LOG_COMMON_STRUCTURES,
+    { LOG_TEST_MSG, sizeof(log_Test),
+      "TEST", "HHHHii",        "V1,V2,V3,V4,L1,L2" }
+};
+
+#define PGM_UINT8(addr) pgm_read_byte((const prog_char *)addr)
+#define NUM_TYPES (sizeof(log_structure)/sizeof(log_structure[0]))
+
+// a port that counts what is printed to it and throws it away
+class NullUART : public Empty::EmptyUARTDriver {
+public:
+    size_t write(uint8_t c) { count++; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) { count += size; return size; }
+    uint32_t count;
+};
+static NullUART null_uart;
+
+/*
+  the old file log reader, kept here for comparison. Messages are
+  printed by the same _print_log_entry() as LogReadProcess() uses
+ */
+class OldLogReader : public DataFlash_File {
+public:
+    OldLogReader(const char *log_directory) :
+        DataFlash_File(log_directory),
+        _fd(-1) {}
+
+    void set_structures(const struct LogStructure *structures, uint8_t num_types) {
+        _structures = structures;
+        _num_types = num_types;
+    }
+
+    void read_log(const char *fname,
+                  void (*print_mode)(AP_HAL::BetterStream *port, uint8_t mode),
+                  AP_HAL::BetterStream *port) {
+        _fd = ::open(fname, O_RDONLY);
+        if (_fd == -1) {
+            return;
+        }
+        uint8_t log_step = 0;
+        uint8_t log_counter = 0;
+        uint8_t data;
+        while (::read(_fd, &data, 1) == 1) {
+            switch (log_step) {
+            case 0:
+                if (data == HEAD_BYTE1) {
+                    log_step++;
+                }
+                break;
+            case 1:
+                if (data == HEAD_BYTE2) {
+                    log_step++;
+                } else {
+                    log_step = 0;
+                }
+                break;
+            case 2:
+                log_step = 0;
+                _print_log_entry(data, print_mode, port);
+                log_counter++;
+                if (log_counter == 10) {
+                    log_counter = 0;
+                    ::lseek(_fd, 0, SEEK_CUR);
+                }
+                break;
+            }
+        }
+        ::close(_fd);
+        _fd = -1;
+    }
+
+private:
+    int _fd;
+
+    void ReadBlock(void *pkt, uint16_t size) {
+        memset(pkt, 0, size);
+        if (::read(_fd, pkt, size) != size) {
+            // a short message at the end of the log
+        }
+    }
+};
+static OldLogReader old_reader(LOG_DIRECTORY);
+
+static uint32_t log_size;
+
+static void print_mode(AP_HAL::BetterStream *port, uint8_t mode)
+{
+    port->printf_P(PSTR("Mode(%u)"), (unsigned)mode);
+}
+
+/*
+  write the test log, starting with the formats of its messages
+ */
+static bool make_log(void)
+{
+    mkdir(LOG_DIRECTORY, 0777);
+    int fd = open(LOG_FILE, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    log_size = 0;
+    for (uint8_t i=0; i<NUM_TYPES; i++) {
+        struct log_Format pkt;
+        memset(&pkt, 0, sizeof(pkt));
+        pkt.head1 = HEAD_BYTE1;
+        pkt.head2 = HEAD_BYTE2;
+        pkt.msgid = LOG_FORMAT_MSG;
+        pkt.type = PGM_UINT8(&log_structure[i].msg_type);
+        pkt.length = PGM_UINT8(&log_structure[i].msg_len);
+        strncpy_P(pkt.name, log_structure[i].name, sizeof(pkt.name));
+        strncpy_P(pkt.format, log_structure[i].format, sizeof(pkt.format));
+        strncpy_P(pkt.labels, log_structure[i].labels, sizeof(pkt.labels));
+        if (write(fd, &pkt, sizeof(pkt)) != sizeof(pkt)) {
+            close(fd);
+            return false;
+        }
+        log_size += sizeof(pkt);
+    }
+    for (uint32_t i=0; i<NUM_MESSAGES; i++) {
+        struct log_Test pkt = {
+            LOG_PACKET_HEADER_INIT(LOG_TEST_MSG),
+            v1    : (uint16_t)i,
+            v2    : 2000,
+            v3    : 3000,
+            v4    : 4000,
+            l1    : (int32_t)i * 5000,
+            l2    : -(int32_t)i
+        };
+        if (write(fd, &pkt, sizeof(pkt)) != sizeof(pkt)) {
+            close(fd);
+            return false;
+        }
+        log_size += sizeof(pkt);
+    }
+    close(fd);
+
+    // DataFlash_File finds its logs from the number of the last one
+    fd = open(LOG_DIRECTORY "/LASTLOG.TXT", O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    bool ok = write(fd, "1\r\n", 3) == 3;
+    close(fd);
+    return ok;
+}
+
+static void show_rate(const char *name, uint32_t usec)
+{
+    hal.console->printf_P(PSTR("%s: %lu usec %.1f MB/s\n"),
+                          name, (unsigned long)usec,
+                          usec ? log_size / (float)usec : 0.0f);
+}
+
+void setup(void)
+{
+    hal.console->println("DataFlash log read benchmark");
+
+    if (!make_log()) {
+        hal.console->println("Failed to write " LOG_FILE);
+        return;
+    }
+    DataFlash.Init(log_structure, NUM_TYPES);
+    old_reader.set_structures(log_structure, NUM_TYPES);
+    hal.console->printf_P(PSTR("%lu byte log\n"), (unsigned long)log_size);
+}
+
+void loop(void)
+{
+    uint16_t start_page, end_page;
+    DataFlash.get_log_boundaries(1, start_page, end_page);
+
+    null_uart.count = 0;
+    uint32_t t0 = hal.scheduler->micros();
+    DataFlash.LogReadProcess(1, start_page, end_page, print_mode, &null_uart);
+    show_rate("LogReadProcess", hal.scheduler->micros() - t0);
+    hal.console->printf_P(PSTR("printed %lu bytes\n"), (unsigned long)null_uart.count);
+
+    null_uart.count = 0;
+    t0 = hal.scheduler->micros();
+    old_reader.read_log(LOG_FILE, print_mode, &null_uart);
+    show_rate("old LogReadProcess", hal.scheduler->micros() - t0);
+    hal.console->printf_P(PSTR("printed %lu bytes\n"), (unsigned long)null_uart.count);
+
+    hal.scheduler->delay(1000);
+}
+
+#else
+
+void setup(void)
+{
+    hal.console->println("LogReadBench needs a board with file logs");
+}
+
+void loop(void)
+{
+    hal.scheduler->delay(1000);
+}
+
+#endif
+
+AP_HAL_MAIN();
@@ -58,9 +58,62 @@ enum ap_message {
     MSG_GIMBAL_REPORT,
     MSG_EKF_STATUS_REPORT,
     MSG_LOCAL_POSITION,
+    MSG_SCHED_STATS,
+    MSG_STREAM_STATS,
     MSG_RETRY_DEFERRED // this must be last
 };
 
+// per-message achieved rates are kept on all but the smallest boards
+#if HAL_CPU_CLASS > HAL_CPU_CLASS_16
+#define GCS_STREAM_STATS_AVAILABLE 1
+#else
+#define GCS_STREAM_STATS_AVAILABLE 0
+#endif
+
+// limits on the estimated capacity of a link, in bytes per second.
+// Network links on Linux and SITL can carry log downloads much faster
+// than any radio
+#define GCS_LINK_MIN_BPS 100
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_1000
+#define GCS_LINK_MAX_BPS 1000000
+#else
+#define GCS_LINK_MAX_BPS 100000
+#endif
+
+// gaps in a log download that the GCS can ask for again while the
+// download continues
+#if HAL_CPU_CLASS > HAL_CPU_CLASS_16
+#define GCS_LOG_GAPS 8
+#else
+#define GCS_LOG_GAPS 2
+#endif
+
+// most LOG_DATA packets sent in one call, bounding the time taken
+// from the main loop
+#if HAL_CPU_CLASS >= HAL_CPU_CLASS_1000
+#define GCS_LOG_WINDOW 100
+#else
+#define GCS_LOG_WINDOW 40
+#endif
+
+// the starting estimate for links with an unknown baudrate
+#define GCS_LINK_DEFAULT_BPS 5760
+
+// DATA32 packet type used to send per-message rates, with the payload
+// laid out as below
+#define DATAMSG_TYPE_STREAM_STATS 0xFB
+
+struct PACKED stream_stats_packet {
+    uint8_t msg;            // ap_message id
+    uint8_t stream;         // stream it was last sent in, or 0xFF
+    uint16_t rate_cHz;      // achieved rate over the last second
+    uint16_t requested_cHz; // requested rate of that stream
+    uint16_t missed;        // sends of that stream dropped at their deadline
+    uint32_t link_bps;      // estimated link capacity
+    uint32_t sent_bps;      // bytes sent over the last second
+    uint8_t radio_txbuf;    // last RADIO_STATUS txbuf, or 0xFF
+};
+
 
 ///
 /// @class	GCS_MAVLINK
@@ -108,6 +161,16 @@ public:
     // see if we should send a stream now. Called at 50Hz
     bool        stream_trigger(enum streams stream_num);
 
+    // estimated capacity of this link in bytes per second
+    uint32_t    link_bandwidth(void) const { return _link_bps; }
+
+#if GCS_STREAM_STATS_AVAILABLE
+    // rate at which a message was sent over the last second, in 0.01Hz
+    uint16_t    message_rate(enum ap_message id) const {
+        return id < MSG_RETRY_DEFERRED ? _msg_rate[id] : 0;
+    }
+#endif
+
 	// this costs us 51 bytes per instance, but means that low priority
 	// messages don't block the CPU
     mavlink_statustext_t pending_status;
@@ -137,6 +200,7 @@ public:
 #endif
     void send_autopilot_version(void) const;
     void send_local_position(const AP_AHRS &ahrs) const;
+    void send_stream_stats(void);
 
     // return a bitmap of active channels. Used by libraries to loop
     // over active channels to send to all active channels    
@@ -158,6 +222,9 @@ public:
 private:
     void        handleMessage(mavlink_message_t * msg);
 
+    // route and handle a received packet
+    void        packetReceived(mavlink_message_t &msg);
+
     /// The stream we are communicating over
     AP_HAL::UARTDriver *_port;
 
@@ -212,8 +279,58 @@ private:
     // saveable rate of each stream
     AP_Int16        streamRates[NUM_STREAMS];
 
-    // number of 50Hz ticks until we next send this stream
-    uint8_t         stream_ticks[NUM_STREAMS];
+    /*
+      stream scheduler. Each stream is due at its requested rate, and
+      is dropped if not sent by the time it is next due. Due streams
+      are sent in weighted fair queuing order while the link has
+      budget, so under congestion each stream gets a share of the link
+      in proportion to its weight
+     */
+    struct stream_state {
+        uint32_t next_due_ms;   // when the stream is next due
+        uint32_t vfinish;       // virtual finish time of its last send
+        uint16_t cost;          // filtered bytes per send
+        uint16_t missed;        // sends dropped at their deadline
+        uint16_t rate_cHz;      // requested rate
+    };
+    struct stream_state _stream_state[NUM_STREAMS];
+
+    // streams asked about and streams admitted since the last
+    // scheduling pass
+    uint16_t        _stream_checked;
+    uint16_t        _stream_admitted;
+
+    // the stream being sent, and the bytes sent for it so far
+    uint8_t         _stream_active;
+    uint16_t        _stream_bytes;
+
+    // link capacity estimate and budget
+    uint32_t        _link_bps;
+    int32_t         _link_tokens;
+    uint32_t        _link_vclock;
+    uint32_t        _sched_last_ms;
+    uint32_t        _sched_bytes;
+    uint16_t        _sched_txspace;
+    uint16_t        _txspace_max;
+    uint8_t         _radio_txbuf;
+    bool            _budget_limited;
+
+#if GCS_STREAM_STATS_AVAILABLE
+    // per-message send counts for the current one second window, and
+    // the rates from the last window
+    uint8_t         _msg_count[MSG_RETRY_DEFERRED];
+    uint8_t         _msg_stream[MSG_RETRY_DEFERRED];
+    uint16_t        _msg_rate[MSG_RETRY_DEFERRED];
+    uint32_t        _stats_start_ms;
+    uint32_t        _stats_bytes;
+    uint32_t        _sent_bps;
+    uint8_t         _stats_send_index;
+#endif
+
+    void            stream_schedule(void);
+    void            stream_account(void);
+    bool            try_send_counted(enum ap_message id);
+    void            stream_update_stats(uint32_t tnow, uint32_t bytes);
 
     // number of extra ticks to add to slow things down for the radio
     uint8_t         stream_slowdown;
@@ -249,6 +366,20 @@ private:
     // start page of log data
     uint16_t _log_data_page;
 
+    // ranges the GCS asked for again, sent before the download
+    // carries on from _log_data_offset
+    struct log_gap {
+        uint32_t ofs;
+        uint32_t count;
+    };
+    struct log_gap _log_gaps[GCS_LOG_GAPS];
+    uint8_t  _log_num_gaps;
+
+    // download statistics, reported when the end of the log is sent
+    uint32_t _log_start_ms;
+    uint32_t _log_bytes_sent;
+    uint32_t _log_bytes_resent;
+
     // deferred message handling
     enum ap_message deferred_messages[MSG_RETRY_DEFERRED];
     uint8_t next_deferred_message;
@@ -277,6 +408,7 @@ private:
     void handle_log_send(DataFlash_Class &dataflash);
     void handle_log_send_listing(DataFlash_Class &dataflash);
     bool handle_log_send_data(DataFlash_Class &dataflash);
+    void handle_log_send_stats(void);
 
     void handle_mission_request_list(AP_Mission &mission, mavlink_message_t *msg);
     void handle_mission_request(AP_Mission &mission, mavlink_message_t *msg);
@@ -46,6 +46,21 @@ GCS_MAVLINK::init(AP_HAL::UARTDriver *port, mavlink_channel_t mav_chan)
     initialised = true;
     _queued_parameter = NULL;
     reset_cli_timeout();
+
+    // start the stream scheduler
+    _link_bps = GCS_LINK_DEFAULT_BPS;
+    _link_tokens = 0;
+    _stream_active = 0xFF;
+    _radio_txbuf = 0xFF;
+    _sched_last_ms = hal.scheduler->millis();
+    _sched_bytes = comm_get_bytes_sent(chan);
+    _sched_txspace = comm_get_txspace(chan);
+    _txspace_max = _sched_txspace;
+#if GCS_STREAM_STATS_AVAILABLE
+    memset(_msg_stream, 0xFF, sizeof(_msg_stream));
+    _stats_start_ms = _sched_last_ms;
+    _stats_bytes = _sched_bytes;
+#endif
 }
 
 
@@ -90,10 +105,14 @@ GCS_MAVLINK::setup_uart(const AP_SerialManager& serial_manager, AP_SerialManager
     uart->set_flow_control(old_flow_control);
 
     // now change back to desired baudrate
-    uart->begin(serial_manager.find_baudrate(protocol, instance));
+    uint32_t baudrate = serial_manager.find_baudrate(protocol, instance);
+    uart->begin(baudrate);
 
     // and init the gcs instance
     init(uart, mav_chan);
+
+    // the stream scheduler starts from the baudrate, at 10 bits a byte
+    _link_bps = constrain_int32(baudrate / 10, GCS_LINK_MIN_BPS, GCS_LINK_MAX_BPS);
 }
 
 uint16_t
@@ -123,13 +142,18 @@ GCS_MAVLINK::queued_param_send()
         return;
     }
 
-    uint16_t bytes_allowed;
+    uint32_t bytes_allowed;
     uint8_t count;
     uint32_t tnow = hal.scheduler->millis();
 
-    // use at most 30% of bandwidth on parameters. The constant 26 is
-    // 1/(1000 * 1/8 * 0.001 * 0.3)
-    bytes_allowed = 57 * (tnow - _queued_parameter_send_time_ms) * 26;
+    // other streams are slowed while parameters are sent, so
+    // parameters can have what the stream scheduler estimates the
+    // link carries
+    uint32_t dt = tnow - _queued_parameter_send_time_ms;
+    if (dt > 1000) {
+        dt = 1000;
+    }
+    bytes_allowed = _link_bps * dt / 1000;
     if (bytes_allowed > comm_get_txspace(chan)) {
         bytes_allowed = comm_get_txspace(chan);
     }
@@ -643,6 +667,18 @@ void GCS_MAVLINK::handle_radio_status(mavlink_message_t *msg, DataFlash_Class &d
         stream_slowdown--;
     }
 
+    // the radio's buffer filling means the air link carries less than
+    // the stream scheduler estimated
+    _radio_txbuf = packet.txbuf;
+    if (packet.txbuf < 20) {
+        _link_bps -= _link_bps / 4;
+    } else if (packet.txbuf < 50) {
+        _link_bps -= _link_bps / 8;
+    }
+    if (_link_bps < GCS_LINK_MIN_BPS) {
+        _link_bps = GCS_LINK_MIN_BPS;
+    }
+
     //log rssi, noise, etc if logging Performance monitoring data
     if (log_radio) {
         dataflash.Log_Write_Radio(packet);
@@ -782,7 +818,7 @@ void GCS_MAVLINK::send_message(enum ap_message id)
 
     // see if we can send the deferred messages, if any
     while (num_deferred_messages != 0) {
-        if (!try_send_message(deferred_messages[next_deferred_message])) {
+        if (!try_send_counted(deferred_messages[next_deferred_message])) {
             break;
         }
         next_deferred_message++;
@@ -809,7 +845,7 @@ void GCS_MAVLINK::send_message(enum ap_message id)
     }
 
     if (num_deferred_messages != 0 ||
-        !try_send_message(id)) {
+        !try_send_counted(id)) {
         // can't send it now, so defer it
         if (num_deferred_messages == MSG_RETRY_DEFERRED) {
             // the defer buffer is full, discard
@@ -824,6 +860,25 @@ void GCS_MAVLINK::send_message(enum ap_message id)
     }
 }
 
+/*
+  route and handle a received packet
+ */
+void GCS_MAVLINK::packetReceived(mavlink_message_t &msg)
+{
+    // we exclude radio packets to make it possible to use the
+    // CLI over the radio
+    if (msg.msgid != MAVLINK_MSG_ID_RADIO && msg.msgid != MAVLINK_MSG_ID_RADIO_STATUS) {
+        mavlink_active |= (1U<<(chan-MAVLINK_COMM_0));
+    }
+    // if a snoop handler has been setup then use it
+    if (msg_snoop != NULL) {
+        msg_snoop(&msg);
+    }
+    if (routing.check_and_forward(chan, &msg)) {
+        handleMessage(&msg);
+    }
+}
+
 void
 GCS_MAVLINK::update(void (*run_cli)(AP_HAL::UARTDriver *))
 {
@@ -834,6 +889,29 @@ GCS_MAVLINK::update(void (*run_cli)(AP_HAL::UARTDriver *))
 
     // process received bytes
     uint16_t nbytes = comm_get_available(chan);
+
+    if (run_cli == NULL || mavlink_active != 0) {
+        // we aren't watching for the CLI, so packets can be framed in
+        // place in the driver's receive buffer, if it allows it
+        while (nbytes > 0) {
+            const uint8_t *buf;
+            uint16_t n = _port->read_span(buf);
+            if (n == 0) {
+                break;
+            }
+            if (n > nbytes) {
+                n = nbytes;
+            }
+            bool got_msg;
+            n = comm_parse_block(chan, buf, n, &msg, &status, got_msg);
+            _port->read_advance(n);
+            nbytes -= n;
+            if (got_msg) {
+                packetReceived(msg);
+            }
+        }
+    }
+
     for (uint16_t i=0; i<nbytes; i++)
     {
         uint8_t c = comm_receive_ch(chan);
@@ -856,18 +934,7 @@ GCS_MAVLINK::update(void (*run_cli)(AP_HAL::UARTDriver *))
 
         // Try to get a new message
         if (mavlink_parse_char(chan, c, &msg, &status)) {
-            // we exclude radio packets to make it possible to use the
-            // CLI over the radio
-            if (msg.msgid != MAVLINK_MSG_ID_RADIO && msg.msgid != MAVLINK_MSG_ID_RADIO_STATUS) {
-                mavlink_active |= (1U<<(chan-MAVLINK_COMM_0));
-            }
-            // if a snoop handler has been setup then use it
-            if (msg_snoop != NULL) {
-                msg_snoop(&msg);
-            }
-            if (routing.check_and_forward(chan, &msg)) {
-                handleMessage(&msg);
-            }
+            packetReceived(msg);
         }
     }
 
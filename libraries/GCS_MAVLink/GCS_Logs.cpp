@@ -90,6 +90,38 @@ void GCS_MAVLINK::handle_log_request_data(mavlink_message_t *msg, DataFlash_Clas
     mavlink_msg_log_request_data_decode(msg, &packet);
 
     _log_listing = false;
+    if (_log_sending && _log_num_data == packet.id &&
+        packet.ofs < _log_data_offset && _log_num_gaps < GCS_LOG_GAPS) {
+        /*
+          the GCS missed some of what we sent. Send the gap again
+          without losing our place, and make sure the download
+          covers the rest of what was asked for
+         */
+        struct log_gap &gap = _log_gaps[_log_num_gaps++];
+        gap.ofs = packet.ofs;
+        gap.count = _log_data_offset - packet.ofs;
+        if (gap.count > packet.count) {
+            gap.count = packet.count;
+        }
+        uint32_t end = packet.ofs + packet.count;
+        if (end < packet.ofs || end > _log_data_size) {
+            end = _log_data_size;
+        }
+        if (end > _log_data_offset + _log_data_remaining) {
+            _log_data_remaining = end - _log_data_offset;
+        }
+        handle_log_send(dataflash);
+        return;
+    }
+
+    if (_log_num_data != packet.id || packet.ofs == 0) {
+        // a new download
+        _log_start_ms = hal.scheduler->millis();
+        _log_bytes_sent = 0;
+        _log_bytes_resent = 0;
+    }
+    _log_num_gaps = 0;
+
     if (!_log_sending || _log_num_data != packet.id) {
         _log_sending = false;
 
@@ -154,23 +186,32 @@ void GCS_MAVLINK::handle_log_send(DataFlash_Class &dataflash)
     if (!_log_sending) {
         return;
     }
-    uint8_t num_sends = 1;
-    if (chan == MAVLINK_COMM_0 && hal.gpio->usb_connected()) {
-        // when on USB we can send a lot more data
-        num_sends = 40;
-    } else if (have_flow_control()) {
-        num_sends = 10;        
-    }
 
+    /*
+      on USB and flow controlled ports the port holds back what the
+      link can't take, so we fill the transmit buffer. Otherwise
+      data beyond what the link carries would be lost in the radio, so
+      we send what the stream scheduler's link budget allows. Running
+      out of budget with more to send lets the scheduler probe for
+      more capacity, so fast links such as network links speed up
+     */
+    const int32_t packet_len = MAVLINK_NUM_NON_PAYLOAD_BYTES+MAVLINK_MSG_ID_LOG_DATA_LEN;
+    bool paced = !have_flow_control();
 #if CONFIG_HAL_BOARD == HAL_BOARD_SITL
     // assume USB speeds in SITL for the purposes of log download
-    num_sends = 40;
+    paced = false;
 #endif
+    int32_t budget = _link_tokens - (int32_t)(comm_get_bytes_sent(chan) - _sched_bytes);
 
-    for (uint8_t i=0; i<num_sends; i++) {
-        if (_log_sending) {
-            if (!handle_log_send_data(dataflash)) break;
+    for (uint8_t i=0; i<GCS_LOG_WINDOW && _log_sending; i++) {
+        if (paced && budget < packet_len) {
+            _budget_limited = true;
+            break;
+        }
+        if (!handle_log_send_data(dataflash)) {
+            break;
         }
+        budget -= packet_len;
     }
 }
 
@@ -219,14 +260,19 @@ bool GCS_MAVLINK::handle_log_send_data(DataFlash_Class &dataflash)
         return false;
     }
 
+    // gaps the GCS asked for again go first
+    bool gap = _log_num_gaps != 0;
+    uint32_t &ofs = gap ? _log_gaps[0].ofs : _log_data_offset;
+    uint32_t &remaining = gap ? _log_gaps[0].count : _log_data_remaining;
+
     int16_t ret = 0;
-    uint32_t len = _log_data_remaining;
+    uint32_t len = remaining;
 	mavlink_log_data_t packet;
 
     if (len > 90) {
         len = 90;
     }
-    ret = dataflash.get_log_data(_log_num_data, _log_data_page, _log_data_offset, len, packet.data);
+    ret = dataflash.get_log_data(_log_num_data, _log_data_page, ofs, len, packet.data);
     if (ret < 0) {
         // report as EOF on error
         ret = 0;
@@ -235,16 +281,45 @@ bool GCS_MAVLINK::handle_log_send_data(DataFlash_Class &dataflash)
         memset(&packet.data[ret], 0, 90-ret);
     }
 
-    packet.ofs = _log_data_offset;
+    packet.ofs = ofs;
     packet.id = _log_num_data;
     packet.count = ret;
     _mav_finalize_message_chan_send(chan, MAVLINK_MSG_ID_LOG_DATA, (const char *)&packet, 
                                     MAVLINK_MSG_ID_LOG_DATA_LEN, MAVLINK_MSG_ID_LOG_DATA_CRC);
 
-    _log_data_offset += len;
-    _log_data_remaining -= len;
-    if (ret < 90 || _log_data_remaining == 0) {
+    ofs += len;
+    remaining -= len;
+    _log_bytes_sent += ret;
+    if (gap) {
+        _log_bytes_resent += ret;
+        if (ret < 90 || remaining == 0) {
+            _log_num_gaps--;
+            memmove(&_log_gaps[0], &_log_gaps[1], _log_num_gaps * sizeof(_log_gaps[0]));
+        }
+    } else if (ret < 90 || remaining == 0) {
+        if ((uint32_t)ret < len || ofs >= _log_data_size) {
+            // sent the end of the log
+            handle_log_send_stats();
+        }
+        _log_data_remaining = 0;
+    }
+    if (_log_data_remaining == 0 && _log_num_gaps == 0) {
         _log_sending = false;
     }
     return true;
 }
+
+/**
+   report the throughput of a log download
+ */
+void GCS_MAVLINK::handle_log_send_stats(void)
+{
+    uint32_t dt = hal.scheduler->millis() - _log_start_ms;
+    char text[MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN];
+    hal.util->snprintf_P(text, sizeof(text), PSTR("Log %u: %lukB at %lukB/s, %lukB resent"),
+                         (unsigned)_log_num_data,
+                         (unsigned long)(_log_bytes_sent / 1024),
+                         (unsigned long)(dt ? _log_bytes_sent * 1000ULL / (dt * 1024ULL) : 0),
+                         (unsigned long)(_log_bytes_resent / 1024));
+    send_text(SEVERITY_LOW, text);
+}
@@ -38,6 +38,9 @@ mavlink_system_t mavlink_system = {7,1};
 // mask of serial ports disabled to allow for SERIAL_CONTROL
 static uint8_t mavlink_locked_mask;
 
+// bytes sent on each channel, for the stream scheduler
+static uint32_t mavlink_bytes_sent[MAVLINK_COMM_NUM_BUFFERS];
+
 // routing table
 MAVLink_routing GCS_MAVLINK::routing;
 
@@ -141,7 +144,18 @@ void comm_send_buffer(mavlink_channel_t chan, const uint8_t *buf, uint8_t len)
     if (chan >= MAVLINK_COMM_NUM_BUFFERS) {
         return;
     }
-    mavlink_comm_port[chan]->write(buf, len);
+    mavlink_bytes_sent[chan] += mavlink_comm_port[chan]->write(buf, len);
+}
+
+/*
+  return the number of bytes sent on a channel
+ */
+uint32_t comm_get_bytes_sent(mavlink_channel_t chan)
+{
+    if (chan >= MAVLINK_COMM_NUM_BUFFERS) {
+        return 0;
+    }
+    return mavlink_bytes_sent[chan];
 }
 
 static const uint8_t mavlink_message_crc_progmem[256] PROGMEM = MAVLINK_MESSAGE_CRCS;
@@ -163,3 +177,121 @@ bool comm_is_idle(mavlink_channel_t chan)
 	mavlink_status_t *status = mavlink_get_channel_status(chan);
 	return status == NULL || status->parse_state <= MAVLINK_PARSE_STATE_IDLE;
 }
+
+/*
+  feed bytes to the byte parser until it finds a packet or runs out
+ */
+static uint16_t parse_bytes(mavlink_channel_t chan, const uint8_t *buf, uint16_t len,
+                            mavlink_message_t *msg, mavlink_status_t *status, bool &got_msg)
+{
+    for (uint16_t i=0; i<len; i++) {
+        if (mavlink_parse_char(chan, buf[i], msg, status)) {
+            got_msg = true;
+            return i+1;
+        }
+    }
+    return len;
+}
+
+/*
+  parse a block of received bytes, framing whole packets in place.
+
+  The channel status is kept as mavlink_parse_char() would leave it
+  after the same bytes. That parser clears parse_error on each byte
+  and then counts any error found on it, so parse_error is only ever
+  the errors of the last byte, and the drop count returned with a
+  packet is always zero
+ */
+uint16_t comm_parse_block(mavlink_channel_t chan, const uint8_t *buf, uint16_t len,
+                          mavlink_message_t *msg, mavlink_status_t *status, bool &got_msg)
+{
+    got_msg = false;
+    mavlink_status_t *rxstatus = mavlink_get_channel_status(chan);
+
+    uint16_t i = 0;
+    while (i < len) {
+        if (rxstatus->parse_state > MAVLINK_PARSE_STATE_IDLE) {
+            // finish the packet started in an earlier block, or by a
+            // start byte at the end of a bad CRC
+            if (mavlink_parse_char(chan, buf[i++], msg, status)) {
+                got_msg = true;
+                return i;
+            }
+            continue;
+        }
+
+        // anything before the start byte is line noise
+        const uint8_t *pkt = (const uint8_t *)memchr(&buf[i], MAVLINK_STX, len-i);
+        if (pkt == NULL) {
+            rxstatus->parse_error = 0;
+            return len;
+        }
+        if (pkt != &buf[i]) {
+            rxstatus->parse_error = 0;
+        }
+        i = pkt - buf;
+        if (len - i < MAVLINK_NUM_NON_PAYLOAD_BYTES ||
+            len - i < pkt[1] + MAVLINK_NUM_NON_PAYLOAD_BYTES) {
+            // the packet continues in the next block
+            return i + parse_bytes(chan, pkt, len-i, msg, status, got_msg);
+        }
+
+        uint8_t plen = pkt[1];
+#if MAVLINK_MAX_PAYLOAD_LEN < 255
+        if (plen > MAVLINK_MAX_PAYLOAD_LEN) {
+            // too long for us. Skip the length, as the byte parser
+            // does. It reports the error on the length byte itself
+            rxstatus->buffer_overrun++;
+            rxstatus->parse_error = 0;
+            rxstatus->parse_state = MAVLINK_PARSE_STATE_IDLE;
+            i += 2;
+            continue;
+        }
+#endif
+        uint16_t crc;
+        crc_init(&crc);
+        crc_accumulate_buffer(&crc, (const char *)&pkt[1], MAVLINK_CORE_HEADER_LEN + plen);
+        crc_accumulate(mavlink_get_message_crc(pkt[5]), &crc);
+        if (pkt[MAVLINK_NUM_HEADER_BYTES+plen] != (crc & 0xFF) ||
+            pkt[MAVLINK_NUM_HEADER_BYTES+plen+1] != (crc >> 8)) {
+            // bad CRC. Skip the packet. If its last byte is a start
+            // byte the byte parser starts the next packet from it, so
+            // the rest of that packet goes through the byte parser
+            rxstatus->parse_error = 1;
+            rxstatus->parse_state = MAVLINK_PARSE_STATE_IDLE;
+            i += plen + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+            if (pkt[plen + MAVLINK_NUM_NON_PAYLOAD_BYTES - 1] == MAVLINK_STX) {
+                mavlink_message_t *rxmsg = mavlink_get_channel_buffer(chan);
+                rxstatus->parse_state = MAVLINK_PARSE_STATE_GOT_STX;
+                rxmsg->len = 0;
+                mavlink_start_checksum(rxmsg);
+            }
+            continue;
+        }
+
+        // the header is laid out as in mavlink_message_t, and the
+        // checksum is kept after the payload, as mavlink_parse_char()
+        // does
+        msg->checksum = crc;
+        memcpy(&msg->magic, pkt, MAVLINK_NUM_HEADER_BYTES);
+        memcpy(_MAV_PAYLOAD_NON_CONST(msg), &pkt[MAVLINK_NUM_HEADER_BYTES], plen+2);
+
+        rxstatus->current_rx_seq = msg->seq;
+        if (rxstatus->packet_rx_success_count == 0) {
+            rxstatus->packet_rx_drop_count = 0;
+        }
+        rxstatus->packet_rx_success_count++;
+        rxstatus->parse_error = 0;
+        rxstatus->parse_state = MAVLINK_PARSE_STATE_IDLE;
+
+        status->parse_state = rxstatus->parse_state;
+        status->packet_idx = plen;
+        status->current_rx_seq = rxstatus->current_rx_seq+1;
+        status->packet_rx_success_count = rxstatus->packet_rx_success_count;
+        status->packet_rx_drop_count = 0;
+
+        got_msg = true;
+        return i + plen + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+    }
+    return len;
+}
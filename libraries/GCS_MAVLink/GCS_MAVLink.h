@@ -92,6 +92,13 @@ uint16_t comm_get_available(mavlink_channel_t chan);
 /// @returns		Number of bytes available
 uint16_t comm_get_txspace(mavlink_channel_t chan);
 
+/// Count of bytes sent on the nominated MAVLink channel
+///
+/// @param chan		Channel to check
+/// @returns		Bytes sent since startup, wrapping at 2^32
+///
+uint32_t comm_get_bytes_sent(mavlink_channel_t chan);
+
 #ifdef HAVE_CRC_ACCUMULATE
 // use the AVR C library implementation. This is a bit over twice as
 // fast as the C version
@@ -116,6 +123,17 @@ uint8_t mav_var_type(enum ap_var_type t);
 // return CRC byte for a mavlink message ID
 uint8_t mavlink_get_message_crc(uint8_t msgid);
 
+/*
+  parse a block of received bytes. Packets that are wholly inside the
+  block are framed and checked in place, and copied to msg in one
+  go. Partial packets at either end go through mavlink_parse_char(),
+  so a packet may span several blocks. Returns the number of bytes
+  consumed, which stops after the first packet found, with got_msg
+  set
+ */
+uint16_t comm_parse_block(mavlink_channel_t chan, const uint8_t *buf, uint16_t len,
+                          mavlink_message_t *msg, mavlink_status_t *status, bool &got_msg);
+
 // severity levels used in STATUSTEXT messages
 enum gcs_severity {
     SEVERITY_LOW=1,
@@ -0,0 +1,348 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  MAVLink telemetry stream scheduling
+ */
+
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <AP_HAL.h>
+#include <GCS.h>
+
+extern const AP_HAL::HAL& hal;
+
+// _stream_active when no stream is being sent
+#define STREAM_NONE 0xFF
+
+/*
+  weight of each stream in the fair queuing. When the link can't carry
+  everything, each stream gets a share of it in proportion to its
+  weight, so attitude and status keep their rates while bulk streams
+  slow down
+ */
+static const uint8_t stream_weights[GCS_MAVLINK::NUM_STREAMS] PROGMEM = {
+    2,  // STREAM_RAW_SENSORS
+    8,  // STREAM_EXTENDED_STATUS
+    2,  // STREAM_RC_CHANNELS
+    2,  // STREAM_RAW_CONTROLLER
+    8,  // STREAM_POSITION
+    16, // STREAM_EXTRA1
+    4,  // STREAM_EXTRA2
+    1,  // STREAM_EXTRA3
+    8,  // STREAM_PARAMS
+};
+
+/*
+  see if we should send a stream now. Called at 50Hz from
+  data_stream_send(), once for each stream
+ */
+bool GCS_MAVLINK::stream_trigger(enum streams stream_num)
+{
+    if (stream_num >= NUM_STREAMS) {
+        return false;
+    }
+
+    // anything sent since the last trigger belongs to the stream
+    // triggered then
+    stream_account();
+
+    if (_stream_checked & (1U<<stream_num)) {
+        // a stream asked about twice means data_stream_send() has
+        // started its next round
+        stream_schedule();
+    }
+    _stream_checked |= (1U<<stream_num);
+
+    float rate = (uint8_t)streamRates[stream_num].get();
+
+    // send at a much lower rate while handling waypoints and
+    // parameter sends
+    if ((stream_num != STREAM_PARAMS) &&
+        (waypoint_receiving || _queued_parameter != NULL)) {
+        rate *= 0.25f;
+    }
+    if (rate > 50) {
+        rate = 50;
+    }
+
+    struct stream_state &st = _stream_state[stream_num];
+    uint16_t rate_cHz = rate > 0 ? rate * 100 : 0;
+    if (st.rate_cHz == 0 && rate_cHz != 0) {
+        // newly enabled, so it is due now
+        st.next_due_ms = hal.scheduler->millis();
+    }
+    st.rate_cHz = rate_cHz;
+
+    if (rate_cHz == 0 || !(_stream_admitted & (1U<<stream_num))) {
+        return false;
+    }
+    _stream_admitted &= ~(1U<<stream_num);
+
+    // the next send is due one period after this one was due
+    st.next_due_ms += 100000UL / rate_cHz;
+
+    _stream_active = stream_num;
+    _stream_bytes = 0;
+    return true;
+}
+
+/*
+  update the cost of the stream that was last sent, from the bytes
+  its messages took
+ */
+void GCS_MAVLINK::stream_account(void)
+{
+    if (_stream_active >= NUM_STREAMS) {
+        return;
+    }
+    struct stream_state &st = _stream_state[_stream_active];
+    if (_stream_bytes != 0) {
+        if (st.cost == 0) {
+            st.cost = _stream_bytes;
+        } else {
+            st.cost = (st.cost * 3U + _stream_bytes) / 4;
+        }
+    }
+    _stream_active = STREAM_NONE;
+}
+
+/*
+  try to send a message, counting its bytes towards the stream being
+  sent and the message towards its achieved rate
+ */
+bool GCS_MAVLINK::try_send_counted(enum ap_message id)
+{
+    uint32_t bytes = comm_get_bytes_sent(chan);
+    if (!try_send_message(id)) {
+        return false;
+    }
+    bytes = comm_get_bytes_sent(chan) - bytes;
+    if (bytes == 0) {
+        // nothing to send for this vehicle
+        return true;
+    }
+    if (_stream_active < NUM_STREAMS) {
+        _stream_bytes += bytes;
+    }
+#if GCS_STREAM_STATS_AVAILABLE
+    if (id < MSG_RETRY_DEFERRED) {
+        if (_msg_count[id] != 0xFF) {
+            _msg_count[id]++;
+        }
+        if (_stream_active < NUM_STREAMS) {
+            _msg_stream[id] = _stream_active;
+        }
+    }
+#endif
+    return true;
+}
+
+/*
+  scheduling pass, run at the start of each round of
+  data_stream_send(). This updates the estimate of the link capacity,
+  refills the link budget with what the link carried since the last
+  pass, then admits the due streams in weighted fair queuing order
+  until the budget is spent
+ */
+void GCS_MAVLINK::stream_schedule(void)
+{
+    uint32_t tnow = hal.scheduler->millis();
+    uint32_t bytes = comm_get_bytes_sent(chan);
+    uint16_t txspace = comm_get_txspace(chan);
+    uint32_t dt = tnow - _sched_last_ms;
+    uint32_t written = bytes - _sched_bytes;
+
+    if (txspace > _txspace_max) {
+        _txspace_max = txspace;
+    }
+
+    uint32_t refill = 0;
+    if (dt > 0 && dt < 1000) {
+        // bytes that left our transmit buffer since the last pass
+        int32_t drained = (int32_t)written + txspace - _sched_txspace;
+        if (txspace < _txspace_max && _sched_txspace < _txspace_max) {
+            // the buffer held a backlog throughout, so it drained at
+            // the rate the link can carry
+            if (drained > 0) {
+                _link_bps = (_link_bps * 7 + drained * 1000UL / dt) / 8;
+            }
+        } else if (_budget_limited && _radio_txbuf >= 50) {
+            // the link kept up with everything and we had more to
+            // send, so probe for more capacity
+            _link_bps += _link_bps / 256 + 1;
+        }
+        _link_bps = constrain_int32(_link_bps, GCS_LINK_MIN_BPS, GCS_LINK_MAX_BPS);
+        refill = _link_bps * dt / 1000;
+        _link_tokens += (int32_t)refill - (int32_t)written;
+    }
+    _sched_last_ms = tnow;
+    _sched_bytes = bytes;
+    _sched_txspace = txspace;
+
+#if GCS_STREAM_STATS_AVAILABLE
+    stream_update_stats(tnow, bytes);
+#endif
+
+    // only streams asked about in the last round are scheduled
+    uint16_t candidates = _stream_checked;
+    _stream_checked = 0;
+    _stream_admitted = 0;
+    _budget_limited = false;
+
+    // drop sends that passed their deadline, and find the due streams
+    uint16_t due = 0;
+    uint16_t due_weight = 0;
+    uint16_t max_cost = 0;
+    for (uint8_t i=0; i<NUM_STREAMS; i++) {
+        struct stream_state &st = _stream_state[i];
+        if (!(candidates & (1U<<i)) || st.rate_cHz == 0) {
+            continue;
+        }
+        if (st.cost > max_cost) {
+            max_cost = st.cost;
+        }
+        int32_t late = tnow - st.next_due_ms;
+        if (late < 0) {
+            continue;
+        }
+        uint32_t period = 100000UL / st.rate_cHz;
+        if ((uint32_t)late >= period) {
+            // missed its deadline, as the next send is due already
+            uint32_t n = late / period;
+            st.missed = (st.missed + n > 0xFFFF) ? 0xFFFF : st.missed + n;
+            st.next_due_ms += n * period;
+        }
+        due |= (1U<<i);
+        due_weight += pgm_read_byte(&stream_weights[i]);
+    }
+
+    /*
+      virtual time advances by what the link carried since the last
+      pass, shared between the streams waiting to send. A stream that
+      sends more than its share finishes ever later in virtual time,
+      and so goes after the others
+     */
+    if (due_weight != 0) {
+        _link_vclock += refill * 16 / due_weight;
+    }
+    for (uint8_t i=0; i<NUM_STREAMS; i++) {
+        struct stream_state &st = _stream_state[i];
+        if ((due & (1U<<i)) && (int32_t)(st.vfinish - _link_vclock) < 0) {
+            // it has been idle, so starts from the current virtual time
+            st.vfinish = _link_vclock;
+        }
+    }
+
+    // keep at most 100ms of link time in hand, but always enough for
+    // the largest stream
+    int32_t cap = _link_bps / 10;
+    if (cap < max_cost) {
+        cap = max_cost;
+    }
+    _link_tokens = constrain_int32(_link_tokens, -cap, cap);
+
+    int32_t budget = _link_tokens;
+    while (due != 0) {
+        // the due stream that would finish first in virtual time goes
+        // next
+        uint8_t best = STREAM_NONE;
+        uint32_t best_tag = 0;
+        for (uint8_t i=0; i<NUM_STREAMS; i++) {
+            if (!(due & (1U<<i))) {
+                continue;
+            }
+            const struct stream_state &st = _stream_state[i];
+            uint8_t weight = pgm_read_byte(&stream_weights[i]);
+            uint32_t tag = st.vfinish + ((st.cost + 1) * 16UL) / weight;
+            if (best == STREAM_NONE || (int32_t)(tag - best_tag) < 0) {
+                best = i;
+                best_tag = tag;
+            }
+        }
+        struct stream_state &st = _stream_state[best];
+        if (st.cost > budget) {
+            // the rest wait for the link to catch up
+            _budget_limited = true;
+            break;
+        }
+        budget -= st.cost;
+        due &= ~(1U<<best);
+        _stream_admitted |= (1U<<best);
+        st.vfinish = best_tag;
+    }
+}
+
+#if GCS_STREAM_STATS_AVAILABLE
+/*
+  turn the message counts into rates once a second
+ */
+void GCS_MAVLINK::stream_update_stats(uint32_t tnow, uint32_t bytes)
+{
+    uint32_t dt = tnow - _stats_start_ms;
+    if (dt < 1000) {
+        return;
+    }
+    for (uint8_t i=0; i<MSG_RETRY_DEFERRED; i++) {
+        _msg_rate[i] = _msg_count[i] * 100000UL / dt;
+        _msg_count[i] = 0;
+    }
+    _sent_bps = (bytes - _stats_bytes) * 1000UL / dt;
+    _stats_start_ms = tnow;
+    _stats_bytes = bytes;
+}
+#endif
+
+/*
+  send the achieved rate of one message, cycling through the messages
+  sent over the last second on successive calls
+ */
+void GCS_MAVLINK::send_stream_stats(void)
+{
+#if GCS_STREAM_STATS_AVAILABLE
+    uint8_t i = 0;
+    for (uint8_t n=0; n<MSG_RETRY_DEFERRED; n++) {
+        i = _stats_send_index++;
+        if (_stats_send_index >= MSG_RETRY_DEFERRED) {
+            _stats_send_index = 0;
+        }
+        if (_msg_rate[i] != 0) {
+            break;
+        }
+    }
+    if (_msg_rate[i] == 0) {
+        return;
+    }
+
+    struct stream_stats_packet pkt;
+    pkt.msg = i;
+    pkt.stream = _msg_stream[i];
+    pkt.rate_cHz = _msg_rate[i];
+    if (pkt.stream < NUM_STREAMS) {
+        pkt.requested_cHz = _stream_state[pkt.stream].rate_cHz;
+        pkt.missed = _stream_state[pkt.stream].missed;
+    } else {
+        pkt.requested_cHz = 0;
+        pkt.missed = 0;
+    }
+    pkt.link_bps = _link_bps;
+    pkt.sent_bps = _sent_bps;
+    pkt.radio_txbuf = _radio_txbuf;
+
+    uint8_t data[32];
+    memset(data, 0, sizeof(data));
+    memcpy(data, &pkt, sizeof(pkt));
+    mavlink_msg_data32_send(chan, DATAMSG_TYPE_STREAM_STATS, sizeof(pkt), data);
+#endif
+}
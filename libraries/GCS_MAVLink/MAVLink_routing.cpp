@@ -23,13 +23,27 @@
 #include <AP_Common.h>
 #include <GCS.h>
 #include <MAVLink_routing.h>
+#include "MAVLink_targets.h"
 
 extern const AP_HAL::HAL& hal;
 
 #define ROUTING_DEBUG 0
 
+// payload offsets of target_system and target_component by msgid
+static const uint8_t target_offsets[256][2] PROGMEM = MAVLINK_TARGET_OFFSETS;
+
 // constructor
-MAVLink_routing::MAVLink_routing(void) : num_routes(0) {}
+MAVLink_routing::MAVLink_routing(void) : num_routes(0)
+{
+    memset(route_hash, 0, sizeof(route_hash));
+}
+
+// hash of a sysid/compid. Components of one system get consecutive
+// slots
+static inline uint8_t route_hash_index(uint8_t sysid, uint8_t compid)
+{
+    return (sysid * 31U + compid) & (MAVLINK_ROUTE_HASH_SIZE-1);
+}
 
 /*
   forward a MAVLink message to the right port. This also
@@ -126,28 +140,16 @@ bool MAVLink_routing::check_and_forward(mavlink_channel_t in_channel, const mavl
     }
 
     // forward on any channels matching the targets
-    bool forwarded = false;
-    for (uint8_t i=0; i<num_routes; i++) {
-        if (broadcast_system || (target_system == routes[i].sysid &&
-                                 (broadcast_component || 
-                                  target_component == routes[i].compid))) {
-            if (in_channel != routes[i].channel) {
-                if (comm_get_txspace(routes[i].channel) >= 
-                    ((uint16_t)msg->len) + MAVLINK_NUM_NON_PAYLOAD_BYTES) {
-#if ROUTING_DEBUG
-                    ::printf("fwd msg %u from chan %u on chan %u sysid=%u compid=%u\n",
-                             msg->msgid,
-                             (unsigned)in_channel,
-                             (unsigned)routes[i].channel,
-                             (unsigned)target_system,
-                             (unsigned)target_component);
-#endif
-                    _mavlink_resend_uart(routes[i].channel, msg);
-                }
-                forwarded = true;
-            }
-        }
+    uint8_t mask;
+    if (broadcast_system) {
+        mask = route_mask(-1, -1);
+    } else {
+        mask = route_mask(target_system, broadcast_component ? -1 : target_component);
     }
+    mask &= ~(1U<<(in_channel-MAVLINK_COMM_0));
+    bool forwarded = (mask != 0);
+    forward(mask, in_channel, msg);
+
     if (!forwarded && match_system) {
         process_locally = true;
     }
@@ -162,23 +164,69 @@ bool MAVLink_routing::check_and_forward(mavlink_channel_t in_channel, const mavl
 */
 void MAVLink_routing::send_to_components(const mavlink_message_t* msg)
 {
-    bool sent_to_chan[MAVLINK_COMM_NUM_BUFFERS];
-    memset(sent_to_chan, 0, sizeof(sent_to_chan));
+    forward(route_mask(mavlink_system.sysid, -1), MAVLINK_COMM_0, msg);
+}
 
-    // check learned routes
+/*
+  find the route for a sysid/compid
+*/
+const struct MAVLink_routing::route *MAVLink_routing::find_route(uint8_t sysid, uint8_t compid) const
+{
+    uint8_t h = route_hash_index(sysid, compid);
+    for (uint8_t n=0; n<MAVLINK_ROUTE_HASH_SIZE; n++) {
+        uint8_t idx = route_hash[h];
+        if (idx == 0) {
+            return NULL;
+        }
+        const struct route &r = routes[idx-1];
+        if (r.sysid == sysid && r.compid == compid) {
+            return &r;
+        }
+        h = (h+1) & (MAVLINK_ROUTE_HASH_SIZE-1);
+    }
+    return NULL;
+}
+
+/*
+  return the mask of channels with routes to a target. A sysid or
+  compid of -1 matches any route
+*/
+uint8_t MAVLink_routing::route_mask(int16_t sysid, int16_t compid) const
+{
+    if (sysid != -1 && compid != -1) {
+        const struct route *r = find_route(sysid, compid);
+        return r ? r->channel_mask : 0;
+    }
+    uint8_t mask = 0;
     for (uint8_t i=0; i<num_routes; i++) {
-        if ((routes[i].sysid == mavlink_system.sysid) && !sent_to_chan[routes[i].channel]) {
-            if (comm_get_txspace(routes[i].channel) >= ((uint16_t)msg->len) + MAVLINK_NUM_NON_PAYLOAD_BYTES) {
+        if (sysid == -1 || routes[i].sysid == sysid) {
+            mask |= routes[i].channel_mask;
+        }
+    }
+    return mask;
+}
+
+/*
+  send a message once on each channel in mask that has room for it
+*/
+void MAVLink_routing::forward(uint8_t mask, mavlink_channel_t in_channel, const mavlink_message_t* msg)
+{
+    for (uint8_t i=0; mask != 0 && i<MAVLINK_COMM_NUM_BUFFERS; i++) {
+        if (!(mask & (1U<<i))) {
+            continue;
+        }
+        mask &= ~(1U<<i);
+        mavlink_channel_t channel = (mavlink_channel_t)(MAVLINK_COMM_0 + i);
+        if (comm_get_txspace(channel) >= ((uint16_t)msg->len) + MAVLINK_NUM_NON_PAYLOAD_BYTES) {
 #if ROUTING_DEBUG
-                ::printf("send msg %u on chan %u sysid=%u compid=%u\n",
-                         msg->msgid,
-                         (unsigned)routes[i].channel,
-                         (unsigned)routes[i].sysid,
-                         (unsigned)routes[i].compid);
+            ::printf("fwd msg %u from chan %u on chan %u sysid=%u compid=%u\n",
+                     msg->msgid,
+                     (unsigned)in_channel,
+                     (unsigned)channel,
+                     (unsigned)msg->sysid,
+                     (unsigned)msg->compid);
 #endif
-                _mavlink_resend_uart(routes[i].channel, msg);
-                sent_to_chan[routes[i].channel] = true;
-            }
+            _mavlink_resend_uart(channel, msg);
         }
     }
 }
@@ -188,31 +236,48 @@ void MAVLink_routing::send_to_components(const mavlink_message_t* msg)
 */
 void MAVLink_routing::learn_route(mavlink_channel_t in_channel, const mavlink_message_t* msg)
 {
-    uint8_t i;
     if (msg->sysid == 0 || 
         (msg->sysid == mavlink_system.sysid && 
          msg->compid == mavlink_system.compid)) {
         return;
     }
-    for (i=0; i<num_routes; i++) {
-        if (routes[i].sysid == msg->sysid && 
-            routes[i].compid == msg->compid &&
-            routes[i].channel == in_channel) {
+    uint8_t chan_bit = 1U<<(in_channel-MAVLINK_COMM_0);
+    uint8_t h = route_hash_index(msg->sysid, msg->compid);
+    for (uint8_t n=0; n<MAVLINK_ROUTE_HASH_SIZE; n++) {
+        uint8_t idx = route_hash[h];
+        if (idx == 0) {
             break;
         }
-    }
-    if (i == num_routes && i<MAVLINK_MAX_ROUTES) {
-        routes[i].sysid = msg->sysid;
-        routes[i].compid = msg->compid;
-        routes[i].channel = in_channel;
-        num_routes++;
+        struct route &r = routes[idx-1];
+        if (r.sysid == msg->sysid && r.compid == msg->compid) {
+            if (!(r.channel_mask & chan_bit)) {
+                r.channel_mask |= chan_bit;
 #if ROUTING_DEBUG
-        ::printf("learned route %u %u via %u\n",
-                 (unsigned)msg->sysid, 
-                 (unsigned)msg->compid,
-                 (unsigned)in_channel);
+                ::printf("learned route %u %u via %u\n",
+                         (unsigned)msg->sysid, 
+                         (unsigned)msg->compid,
+                         (unsigned)in_channel);
 #endif
+            }
+            return;
+        }
+        h = (h+1) & (MAVLINK_ROUTE_HASH_SIZE-1);
     }
+    if (num_routes == MAVLINK_MAX_ROUTES) {
+        // table is full
+        return;
+    }
+    routes[num_routes].sysid = msg->sysid;
+    routes[num_routes].compid = msg->compid;
+    routes[num_routes].channel_mask = chan_bit;
+    num_routes++;
+    route_hash[h] = num_routes;
+#if ROUTING_DEBUG
+    ::printf("learned route %u %u via %u\n",
+             (unsigned)msg->sysid, 
+             (unsigned)msg->compid,
+             (unsigned)in_channel);
+#endif
 }
 
 
@@ -230,33 +295,12 @@ void MAVLink_routing::handle_heartbeat(mavlink_channel_t in_channel, const mavli
     mask &= ~(1U<<(in_channel-MAVLINK_COMM_0));
 
     // mask out channels that are known sources for this sysid/compid
-    for (uint8_t i=0; i<num_routes; i++) {
-        if (routes[i].sysid == msg->sysid && routes[i].compid == msg->compid) {
-            mask &= ~(1U<<((unsigned)(routes[i].channel-MAVLINK_COMM_0)));
-        }
+    const struct route *r = find_route(msg->sysid, msg->compid);
+    if (r != NULL) {
+        mask &= ~r->channel_mask;
     }
 
-    if (mask == 0) {
-        // nothing to send to
-        return;
-    }
-
-    // send on the remaining channels
-    for (uint8_t i=0; i<MAVLINK_COMM_NUM_BUFFERS; i++) {
-        if (mask & (1U<<i)) {
-            mavlink_channel_t channel = (mavlink_channel_t)(MAVLINK_COMM_0 + i);
-            if (comm_get_txspace(channel) >= ((uint16_t)msg->len) + MAVLINK_NUM_NON_PAYLOAD_BYTES) {
-#if ROUTING_DEBUG
-                ::printf("fwd HB from chan %u on chan %u from sysid=%u compid=%u\n",
-                         (unsigned)in_channel,
-                         (unsigned)channel,
-                         (unsigned)msg->sysid,
-                         (unsigned)msg->compid);
-#endif
-                _mavlink_resend_uart(channel, msg);
-            }
-        }
-    }
+    forward(mask, in_channel, msg);
 }
 
 
@@ -267,202 +311,17 @@ void MAVLink_routing::handle_heartbeat(mavlink_channel_t in_channel, const mavli
 */
 void MAVLink_routing::get_targets(const mavlink_message_t* msg, int16_t &sysid, int16_t &compid)
 {
-    // unfortunately the targets are not in a consistent position in
-    // the packets, so we need a switch. Using the single element
-    // extraction functions (which are inline) makes this a bit faster
-    // than it would otherwise be.
-    // This list of messages below was extracted using:
-    //
-    // cat ardupilotmega/*h common/*h|egrep
-    // 'get_target_system|get_target_component' |grep inline | cut
-    // -d'(' -f1 | cut -d' ' -f4 > /tmp/targets.txt
-    //
-    // TODO: we should write a python script to extract this list
-    // properly
-    
-    switch (msg->msgid) {
-        // these messages only have a target system
-    case MAVLINK_MSG_ID_CAMERA_FEEDBACK:
-        sysid = mavlink_msg_camera_feedback_get_target_system(msg);
-        break;
-    case MAVLINK_MSG_ID_CAMERA_STATUS:
-        sysid = mavlink_msg_camera_status_get_target_system(msg);
-        break;
-    case MAVLINK_MSG_ID_CHANGE_OPERATOR_CONTROL:
-        sysid = mavlink_msg_change_operator_control_get_target_system(msg);
-        break;
-    case MAVLINK_MSG_ID_SET_MODE:
-        sysid = mavlink_msg_set_mode_get_target_system(msg);
-        break;
-    case MAVLINK_MSG_ID_SET_GPS_GLOBAL_ORIGIN:
-        sysid = mavlink_msg_set_gps_global_origin_get_target_system(msg);
-        break;
-
-    // these support both target system and target component
-    case MAVLINK_MSG_ID_DIGICAM_CONFIGURE:
-        sysid  = mavlink_msg_digicam_configure_get_target_system(msg);
-        compid = mavlink_msg_digicam_configure_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_DIGICAM_CONTROL:
-        sysid  = mavlink_msg_digicam_control_get_target_system(msg);
-        compid = mavlink_msg_digicam_control_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_FENCE_FETCH_POINT:
-        sysid  = mavlink_msg_fence_fetch_point_get_target_system(msg);
-        compid = mavlink_msg_fence_fetch_point_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_FENCE_POINT:
-        sysid  = mavlink_msg_fence_point_get_target_system(msg);
-        compid = mavlink_msg_fence_point_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MOUNT_CONFIGURE:
-        sysid  = mavlink_msg_mount_configure_get_target_system(msg);
-        compid = mavlink_msg_mount_configure_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MOUNT_CONTROL:
-        sysid  = mavlink_msg_mount_control_get_target_system(msg);
-        compid = mavlink_msg_mount_control_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MOUNT_STATUS:
-        sysid  = mavlink_msg_mount_status_get_target_system(msg);
-        compid = mavlink_msg_mount_status_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_RALLY_FETCH_POINT:
-        sysid  = mavlink_msg_rally_fetch_point_get_target_system(msg);
-        compid = mavlink_msg_rally_fetch_point_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_RALLY_POINT:
-        sysid  = mavlink_msg_rally_point_get_target_system(msg);
-        compid = mavlink_msg_rally_point_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_SET_MAG_OFFSETS:
-        sysid  = mavlink_msg_set_mag_offsets_get_target_system(msg);
-        compid = mavlink_msg_set_mag_offsets_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_COMMAND_INT:
-        sysid  = mavlink_msg_command_int_get_target_system(msg);
-        compid = mavlink_msg_command_int_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_COMMAND_LONG:
-        sysid  = mavlink_msg_command_long_get_target_system(msg);
-        compid = mavlink_msg_command_long_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
-        sysid  = mavlink_msg_file_transfer_protocol_get_target_system(msg);
-        compid = mavlink_msg_file_transfer_protocol_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_GPS_INJECT_DATA:
-        sysid  = mavlink_msg_gps_inject_data_get_target_system(msg);
-        compid = mavlink_msg_gps_inject_data_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_LOG_ERASE:
-        sysid  = mavlink_msg_log_erase_get_target_system(msg);
-        compid = mavlink_msg_log_erase_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_LOG_REQUEST_DATA:
-        sysid  = mavlink_msg_log_request_data_get_target_system(msg);
-        compid = mavlink_msg_log_request_data_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_LOG_REQUEST_END:
-        sysid  = mavlink_msg_log_request_end_get_target_system(msg);
-        compid = mavlink_msg_log_request_end_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_LOG_REQUEST_LIST:
-        sysid  = mavlink_msg_log_request_list_get_target_system(msg);
-        compid = mavlink_msg_log_request_list_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_ACK:
-        sysid  = mavlink_msg_mission_ack_get_target_system(msg);
-        compid = mavlink_msg_mission_ack_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_CLEAR_ALL:
-        sysid  = mavlink_msg_mission_clear_all_get_target_system(msg);
-        compid = mavlink_msg_mission_clear_all_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_COUNT:
-        sysid  = mavlink_msg_mission_count_get_target_system(msg);
-        compid = mavlink_msg_mission_count_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_ITEM:
-        sysid  = mavlink_msg_mission_item_get_target_system(msg);
-        compid = mavlink_msg_mission_item_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_ITEM_INT:
-        sysid  = mavlink_msg_mission_item_int_get_target_system(msg);
-        compid = mavlink_msg_mission_item_int_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_REQUEST:
-        sysid  = mavlink_msg_mission_request_get_target_system(msg);
-        compid = mavlink_msg_mission_request_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
-        sysid  = mavlink_msg_mission_request_list_get_target_system(msg);
-        compid = mavlink_msg_mission_request_list_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_REQUEST_PARTIAL_LIST:
-        sysid  = mavlink_msg_mission_request_partial_list_get_target_system(msg);
-        compid = mavlink_msg_mission_request_partial_list_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_SET_CURRENT:
-        sysid  = mavlink_msg_mission_set_current_get_target_system(msg);
-        compid = mavlink_msg_mission_set_current_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_MISSION_WRITE_PARTIAL_LIST:
-        sysid  = mavlink_msg_mission_write_partial_list_get_target_system(msg);
-        compid = mavlink_msg_mission_write_partial_list_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
-        sysid  = mavlink_msg_param_request_list_get_target_system(msg);
-        compid = mavlink_msg_param_request_list_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
-        sysid  = mavlink_msg_param_request_read_get_target_system(msg);
-        compid = mavlink_msg_param_request_read_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_PARAM_SET:
-        sysid  = mavlink_msg_param_set_get_target_system(msg);
-        compid = mavlink_msg_param_set_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_PING:
-        sysid  = mavlink_msg_ping_get_target_system(msg);
-        compid = mavlink_msg_ping_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_RC_CHANNELS_OVERRIDE:
-        sysid  = mavlink_msg_rc_channels_override_get_target_system(msg);
-        compid = mavlink_msg_rc_channels_override_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_REQUEST_DATA_STREAM:
-        sysid  = mavlink_msg_request_data_stream_get_target_system(msg);
-        compid = mavlink_msg_request_data_stream_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_SAFETY_SET_ALLOWED_AREA:
-        sysid  = mavlink_msg_safety_set_allowed_area_get_target_system(msg);
-        compid = mavlink_msg_safety_set_allowed_area_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_SET_ATTITUDE_TARGET:
-        sysid  = mavlink_msg_set_attitude_target_get_target_system(msg);
-        compid = mavlink_msg_set_attitude_target_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_SET_POSITION_TARGET_GLOBAL_INT:
-        sysid  = mavlink_msg_set_position_target_global_int_get_target_system(msg);
-        compid = mavlink_msg_set_position_target_global_int_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED:
-        sysid  = mavlink_msg_set_position_target_local_ned_get_target_system(msg);
-        compid = mavlink_msg_set_position_target_local_ned_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_V2_EXTENSION:
-        sysid  = mavlink_msg_v2_extension_get_target_system(msg);
-        compid = mavlink_msg_v2_extension_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_GIMBAL_REPORT:
-        sysid  = mavlink_msg_gimbal_report_get_target_system(msg);
-        compid = mavlink_msg_gimbal_report_get_target_component(msg);
-        break;
-    case MAVLINK_MSG_ID_GIMBAL_CONTROL:
-        sysid  = mavlink_msg_gimbal_control_get_target_system(msg);
-        compid = mavlink_msg_gimbal_control_get_target_component(msg);
-        break;
+    // the targets are not in a consistent position in the packets, so
+    // their offsets are looked up in a table generated from the
+    // message definitions by generate_targets.py. The length check
+    // guards against truncated packets
+    const uint8_t *payload = (const uint8_t *)_MAV_PAYLOAD(msg);
+    uint8_t sysid_ofs  = pgm_read_byte(&target_offsets[msg->msgid][0]);
+    uint8_t compid_ofs = pgm_read_byte(&target_offsets[msg->msgid][1]);
+    if (sysid_ofs != MAVLINK_TARGET_NONE && sysid_ofs < msg->len) {
+        sysid = payload[sysid_ofs];
+    }
+    if (compid_ofs != MAVLINK_TARGET_NONE && compid_ofs < msg->len) {
+        compid = payload[compid_ofs];
     }
 }
-
@@ -11,11 +11,15 @@
 #include <GCS_MAVLink.h>
 
 // 20 routes should be enough for now. This may need to increase as
-// we make more extensive use of MAVLink forwarding
+// we make more extensive use of MAVLink forwarding. The hash size
+// must be a power of 2, and is kept at least twice the number of
+// routes so probe sequences stay short
 #if HAL_CPU_CLASS > HAL_CPU_CLASS_16
 #define MAVLINK_MAX_ROUTES 20
+#define MAVLINK_ROUTE_HASH_SIZE 64
 #else
 #define MAVLINK_MAX_ROUTES 5
+#define MAVLINK_ROUTE_HASH_SIZE 16
 #endif
 
 /*
@@ -42,14 +46,28 @@ public:
     void send_to_components(const mavlink_message_t* msg);
 
 private:
-    // a simple linear routing table. We don't expect to have a lot of
-    // routes, so a scalable structure isn't worthwhile yet.
+    // one route per sysid/compid, with the mask of channels it has
+    // been seen on. Routes are looked up by an open addressed hash
+    // of sysid/compid, holding the index+1 of the route, or zero for
+    // an empty slot. Routes are never removed, so no tombstones are
+    // needed
     uint8_t num_routes;
     struct route {
         uint8_t sysid;
         uint8_t compid;
-        mavlink_channel_t channel;
+        uint8_t channel_mask;
     } routes[MAVLINK_MAX_ROUTES];
+    uint8_t route_hash[MAVLINK_ROUTE_HASH_SIZE];
+
+    // find the route for a sysid/compid, or NULL
+    const struct route *find_route(uint8_t sysid, uint8_t compid) const;
+
+    // mask of channels with routes matching a target. -1 is a
+    // wildcard
+    uint8_t route_mask(int16_t sysid, int16_t compid) const;
+
+    // forward a message on each channel in a mask
+    void forward(uint8_t mask, mavlink_channel_t in_channel, const mavlink_message_t* msg);
 
     // learn new routes
     void learn_route(mavlink_channel_t in_channel, const mavlink_message_t* msg);
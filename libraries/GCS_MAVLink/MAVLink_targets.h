@@ -0,0 +1,274 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  offsets of target_system and target_component in the payload of each
+  MAVLink message, indexed by msgid. MAVLINK_TARGET_NONE means the
+  message has no such field.
+
+  generated from ardupilotmega.xml by generate_targets.py, do not edit
+ */
+
+#ifndef __MAVLINK_TARGETS_H
+#define __MAVLINK_TARGETS_H
+
+#define MAVLINK_TARGET_NONE 0xFF
+
+#define MAVLINK_TARGET_OFFSETS { \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x0C, 0x0D }, /* PING */ \
+    { 0x00, 0xFF }, /* CHANGE_OPERATOR_CONTROL */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x04, 0xFF }, /* SET_MODE */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x02, 0x03 }, /* PARAM_REQUEST_READ */ \
+    { 0x00, 0x01 }, /* PARAM_REQUEST_LIST */ \
+    { 0xFF, 0xFF }, \
+    { 0x04, 0x05 }, /* PARAM_SET */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x04, 0x05 }, /* MISSION_REQUEST_PARTIAL_LIST */ \
+    { 0x04, 0x05 }, /* MISSION_WRITE_PARTIAL_LIST */ \
+    { 0x20, 0x21 }, /* MISSION_ITEM */ \
+    { 0x02, 0x03 }, /* MISSION_REQUEST */ \
+    { 0x02, 0x03 }, /* MISSION_SET_CURRENT */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* MISSION_REQUEST_LIST */ \
+    { 0x02, 0x03 }, /* MISSION_COUNT */ \
+    { 0x00, 0x01 }, /* MISSION_CLEAR_ALL */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* MISSION_ACK */ \
+    { 0x0C, 0xFF }, /* SET_GPS_GLOBAL_ORIGIN */ \
+    { 0xFF, 0xFF }, \
+    { 0x12, 0x13 }, /* PARAM_MAP_RC */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x18, 0x19 }, /* SAFETY_SET_ALLOWED_AREA */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x02, 0x03 }, /* REQUEST_DATA_STREAM */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x10, 0x11 }, /* RC_CHANNELS_OVERRIDE */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x20, 0x21 }, /* MISSION_ITEM_INT */ \
+    { 0xFF, 0xFF }, \
+    { 0x1E, 0x1F }, /* COMMAND_INT */ \
+    { 0x1E, 0x1F }, /* COMMAND_LONG */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x24, 0x25 }, /* SET_ATTITUDE_TARGET */ \
+    { 0xFF, 0xFF }, \
+    { 0x32, 0x33 }, /* SET_POSITION_TARGET_LOCAL_NED */ \
+    { 0xFF, 0xFF }, \
+    { 0x32, 0x33 }, /* SET_POSITION_TARGET_GLOBAL_INT */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x01, 0x02 }, /* FILE_TRANSFER_PROTOCOL */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x04, 0x05 }, /* LOG_REQUEST_LIST */ \
+    { 0xFF, 0xFF }, \
+    { 0x0A, 0x0B }, /* LOG_REQUEST_DATA */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* LOG_ERASE */ \
+    { 0x00, 0x01 }, /* LOG_REQUEST_END */ \
+    { 0x00, 0x01 }, /* GPS_INJECT_DATA */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x29, 0x2A }, /* SET_ACTUATOR_CONTROL_TARGET */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x06, 0x07 }, /* SET_MAG_OFFSETS */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x06, 0x07 }, /* DIGICAM_CONFIGURE */ \
+    { 0x04, 0x05 }, /* DIGICAM_CONTROL */ \
+    { 0x00, 0x01 }, /* MOUNT_CONFIGURE */ \
+    { 0x0C, 0x0D }, /* MOUNT_CONTROL */ \
+    { 0x0C, 0x0D }, /* MOUNT_STATUS */ \
+    { 0xFF, 0xFF }, \
+    { 0x08, 0x09 }, /* FENCE_POINT */ \
+    { 0x00, 0x01 }, /* FENCE_FETCH_POINT */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x0E, 0x0F }, /* RALLY_POINT */ \
+    { 0x00, 0x01 }, /* RALLY_FETCH_POINT */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x1A, 0xFF }, /* CAMERA_STATUS */ \
+    { 0x2A, 0xFF }, /* CAMERA_FEEDBACK */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* AUTOPILOT_VERSION_REQUEST */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* LED_CONTROL */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x28, 0x29 }, /* GIMBAL_REPORT */ \
+    { 0x0C, 0x0D }, /* GIMBAL_CONTROL */ \
+    { 0x00, 0x01 }, /* GIMBAL_RESET */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* GIMBAL_SET_HOME_OFFSETS */ \
+    { 0xFF, 0xFF }, \
+    { 0x1A, 0x1B }, /* GIMBAL_SET_FACTORY_PARAMETERS */ \
+    { 0xFF, 0xFF }, \
+    { 0x04, 0x05 }, /* GIMBAL_ERASE_FIRMWARE_AND_CONFIG */ \
+    { 0x00, 0x01 }, /* GIMBAL_PERFORM_FACTORY_TESTS */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* GIMBAL_REQUEST_AXIS_CALIBRATION_STATUS */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* GIMBAL_REQUEST_AXIS_CALIBRATION */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* GOPRO_GET_REQUEST */ \
+    { 0xFF, 0xFF }, \
+    { 0x00, 0x01 }, /* GOPRO_SET_REQUEST */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0x03, 0x04 }, /* V2_EXTENSION */ \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+    { 0xFF, 0xFF }, \
+}
+
+#endif // __MAVLINK_TARGETS_H
@@ -0,0 +1,369 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// Check and benchmark of comm_parse_block() against mavlink_parse_char()
+//
+// A stream of packets is made with noise, bad CRCs, start bytes in
+// CRCs, length bytes longer than the packet and cut off packets. It
+// is given to mavlink_parse_char() a byte at a time on one channel,
+// and to comm_parse_block() on another in spans of varying length, as
+// GCS_MAVLINK::update() does with read_span(). Both must find the same
+// packets at the same place in the stream, with the same channel
+// status, and the same channel status at the end of every span. Then
+// the rate of each parser is printed.
+//
+
+#include <stdarg.h>
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_FLYMAPLE.h>
+#include <AP_HAL_PX4.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_Empty_Private.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include <AP_ADC.h>
+#include <AP_InertialSensor.h>
+#include <AP_Notify.h>
+#include <AP_GPS.h>
+#include <AP_Baro.h>
+#include <Filter.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <GCS.h>
+#include <AP_Mission.h>
+#include <AP_Terrain.h>
+#include <AP_AHRS.h>
+#include <AP_Airspeed.h>
+#include <AP_Vehicle.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_Compass.h>
+#include <AP_Declination.h>
+#include <AP_NavEKF.h>
+#include <AP_Rally.h>
+#include <AP_Scheduler.h>
+#include <AP_BattMonitor.h>
+#include <SITL.h>
+#include <AP_RangeFinder.h>
+#include <AP_OpticalFlow.h>
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_APM1 || CONFIG_HAL_BOARD == HAL_BOARD_APM2
+#define STREAM_SIZE 1024
+#define REPEATS 4
+#else
+#define STREAM_SIZE 16384
+#define REPEATS 50
+#endif
+
+// span length used for timing, about a read-ahead of telemetry
+#define TIMING_SPAN 512
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+const AP_Param::GroupInfo GCS_MAVLINK::var_info[] PROGMEM = {
+    AP_GROUPEND
+};
+
+#define CHAN_BYTE  MAVLINK_COMM_0
+#define CHAN_BLOCK MAVLINK_COMM_1
+
+static uint8_t stream[STREAM_SIZE];
+static uint16_t stream_len;
+
+static uint32_t seed = 1;
+
+static uint16_t random16(void)
+{
+    seed = seed * 1103515245UL + 12345;
+    return (seed >> 16) & 0x7FFF;
+}
+
+/*
+  make one packet, of a type picked at random
+ */
+static uint16_t make_packet(uint8_t *buf)
+{
+    mavlink_message_t msg;
+    switch (random16() % 5) {
+    case 0:
+        mavlink_msg_heartbeat_pack(255, 0, &msg, MAV_TYPE_GCS, MAV_AUTOPILOT_INVALID,
+                                   random16(), random16(), 0);
+        break;
+    case 1:
+        mavlink_msg_attitude_pack(1, 1, &msg, random16(), random16()*0.001f, -0.2f,
+                                  1.5f, 0, random16()*0.01f, 0);
+        break;
+    case 2:
+        mavlink_msg_statustext_pack(1, 1, &msg, SEVERITY_LOW, "parse_bench check \xfe");
+        break;
+    case 3:
+        mavlink_msg_param_value_pack(1, 1, &msg, "RATE_RLL_P", random16()*0.001f,
+                                     MAV_PARAM_TYPE_REAL32, 600, random16() % 600);
+        break;
+    default:
+        mavlink_msg_gps_raw_int_pack(1, 1, &msg, random16(), 3, -353632610 + random16(),
+                                     1491652300, 584000, 121, 200, random16(), 0, 10);
+        break;
+    }
+    return mavlink_msg_to_send_buffer(buf, &msg);
+}
+
+static void add_bytes(const uint8_t *buf, uint16_t len)
+{
+    if (stream_len + len > STREAM_SIZE) {
+        len = STREAM_SIZE - stream_len;
+    }
+    memcpy(&stream[stream_len], buf, len);
+    stream_len += len;
+}
+
+/*
+  fill the stream with packets, mostly good, with damage of each kind
+ */
+static void make_stream(void)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    uint8_t buf2[MAVLINK_MAX_PACKET_LEN];
+    while (stream_len < STREAM_SIZE) {
+        uint16_t len = make_packet(buf);
+        switch (random16() % 12) {
+        case 0: {
+            // line noise, with start bytes in it
+            uint8_t n = 1 + random16() % 20;
+            for (uint8_t i=0; i<n; i++) {
+                buf2[i] = (random16() % 4 == 0) ? MAVLINK_STX : random16();
+            }
+            add_bytes(buf2, n);
+            break;
+        }
+        case 1:
+            // bad CRC from a damaged payload
+            buf[MAVLINK_NUM_HEADER_BYTES] ^= 0x10;
+            add_bytes(buf, len);
+            break;
+        case 2: {
+            // a bad CRC ending in a start byte, followed by the rest
+            // of a good packet, which the byte parser finds from the
+            // start byte in the CRC
+            buf[len-1] = (buf[len-1] == MAVLINK_STX) ? 0 : MAVLINK_STX;
+            add_bytes(buf, len);
+            uint16_t len2 = make_packet(buf2);
+            add_bytes(&buf2[1], len2-1);
+            break;
+        }
+        case 3:
+            // a start byte in the first CRC byte
+            buf[len-2] = (buf[len-2] == MAVLINK_STX) ? 0 : MAVLINK_STX;
+            add_bytes(buf, len);
+            break;
+        case 4:
+            // a length byte longer than the packet, which swallows
+            // the packets after it
+            buf[1] = 200 + random16() % 56;
+            add_bytes(buf, len);
+            break;
+        case 5:
+            // a packet cut off part way
+            add_bytes(buf, 1 + random16() % (len-1));
+            break;
+        default:
+            add_bytes(buf, len);
+            break;
+        }
+    }
+}
+
+static void reset_channel(mavlink_channel_t chan)
+{
+    memset(mavlink_get_channel_status(chan), 0, sizeof(mavlink_status_t));
+}
+
+static bool same_message(const mavlink_message_t &m1, const mavlink_message_t &m2)
+{
+    return (m1.checksum == m2.checksum &&
+            m1.magic == m2.magic &&
+            m1.len == m2.len &&
+            m1.seq == m2.seq &&
+            m1.sysid == m2.sysid &&
+            m1.compid == m2.compid &&
+            m1.msgid == m2.msgid &&
+            memcmp(_MAV_PAYLOAD(&m1), _MAV_PAYLOAD(&m2), m1.len+2) == 0);
+}
+
+/*
+  compare the parts of the channel status kept by both parsers
+ */
+static bool same_status(void)
+{
+    const mavlink_status_t *s1 = mavlink_get_channel_status(CHAN_BYTE);
+    const mavlink_status_t *s2 = mavlink_get_channel_status(CHAN_BLOCK);
+    return (s1->parse_state == s2->parse_state &&
+            s1->parse_error == s2->parse_error &&
+            s1->packet_rx_drop_count == s2->packet_rx_drop_count &&
+            s1->packet_rx_success_count == s2->packet_rx_success_count &&
+            s1->buffer_overrun == s2->buffer_overrun &&
+            s1->current_rx_seq == s2->current_rx_seq);
+}
+
+static uint16_t errors;
+static uint16_t packets_found;
+static uint16_t spans;
+
+static void report(const char *what, uint16_t ofs)
+{
+    if (errors++ < 10) {
+        const mavlink_status_t *s1 = mavlink_get_channel_status(CHAN_BYTE);
+        const mavlink_status_t *s2 = mavlink_get_channel_status(CHAN_BLOCK);
+        hal.console->printf_P(PSTR("%s at %u: state %u/%u parse_error %u/%u drop %u/%u success %u/%u\n"),
+                              what, (unsigned)ofs,
+                              (unsigned)s1->parse_state, (unsigned)s2->parse_state,
+                              (unsigned)s1->parse_error, (unsigned)s2->parse_error,
+                              (unsigned)s1->packet_rx_drop_count, (unsigned)s2->packet_rx_drop_count,
+                              (unsigned)s1->packet_rx_success_count, (unsigned)s2->packet_rx_success_count);
+    }
+}
+
+/*
+  give the byte parser the stream up to end. Returns true if it found
+  a packet on the last byte, and reports any it found before that
+ */
+static bool byte_parse_to(uint16_t &ofs, uint16_t end, mavlink_message_t &msg, mavlink_status_t &status)
+{
+    bool got_msg = false;
+    while (ofs < end) {
+        got_msg = mavlink_parse_char(CHAN_BYTE, stream[ofs++], &msg, &status);
+        if (got_msg && ofs != end) {
+            report("packet missed by comm_parse_block()", ofs);
+        }
+    }
+    return got_msg;
+}
+
+/*
+  parse the stream with both parsers, giving comm_parse_block() spans
+  of 1 to max_span bytes
+ */
+static void check_spans(uint16_t max_span)
+{
+    reset_channel(CHAN_BYTE);
+    reset_channel(CHAN_BLOCK);
+
+    mavlink_message_t byte_msg, block_msg;
+    mavlink_status_t byte_status, block_status;
+    uint16_t byte_ofs = 0;
+    uint16_t ofs = 0;
+    while (ofs < stream_len) {
+        uint16_t end = ofs + 1 + random16() % max_span;
+        if (end > stream_len) {
+            end = stream_len;
+        }
+        spans++;
+        while (ofs < end) {
+            bool got_msg;
+            ofs += comm_parse_block(CHAN_BLOCK, &stream[ofs], end - ofs,
+                                    &block_msg, &block_status, got_msg);
+            if (!got_msg) {
+                continue;
+            }
+            packets_found++;
+            if (!byte_parse_to(byte_ofs, ofs, byte_msg, byte_status)) {
+                report("packet not found by mavlink_parse_char()", ofs);
+                continue;
+            }
+            if (!same_message(byte_msg, block_msg)) {
+                report("different packets", ofs);
+            }
+            if (byte_status.packet_rx_drop_count != block_status.packet_rx_drop_count ||
+                byte_status.packet_rx_success_count != block_status.packet_rx_success_count ||
+                byte_status.current_rx_seq != block_status.current_rx_seq) {
+                report("different returned status", ofs);
+            }
+            if (!same_status()) {
+                report("different status after packet", ofs);
+            }
+        }
+        if (byte_parse_to(byte_ofs, end, byte_msg, byte_status)) {
+            report("packet missed by comm_parse_block()", end);
+        }
+        if (!same_status()) {
+            report("different status at end of span", end);
+        }
+    }
+}
+
+static float byte_rate(void)
+{
+    mavlink_message_t msg;
+    mavlink_status_t status;
+    reset_channel(CHAN_BYTE);
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint8_t r=0; r<REPEATS; r++) {
+        for (uint16_t i=0; i<stream_len; i++) {
+            mavlink_parse_char(CHAN_BYTE, stream[i], &msg, &status);
+        }
+    }
+    uint32_t dt = hal.scheduler->micros() - t0;
+    return dt ? stream_len * (float)REPEATS / dt : 0;
+}
+
+static float block_rate(void)
+{
+    mavlink_message_t msg;
+    mavlink_status_t status;
+    reset_channel(CHAN_BLOCK);
+    uint32_t t0 = hal.scheduler->micros();
+    for (uint8_t r=0; r<REPEATS; r++) {
+        uint16_t ofs = 0;
+        while (ofs < stream_len) {
+            uint16_t end = min(ofs + TIMING_SPAN, stream_len);
+            while (ofs < end) {
+                bool got_msg;
+                ofs += comm_parse_block(CHAN_BLOCK, &stream[ofs], end - ofs,
+                                        &msg, &status, got_msg);
+            }
+        }
+    }
+    uint32_t dt = hal.scheduler->micros() - t0;
+    return dt ? stream_len * (float)REPEATS / dt : 0;
+}
+
+static bool passed;
+
+void setup(void)
+{
+    hal.console->println("MAVLink block parser check");
+
+    make_stream();
+
+    check_spans(1);
+    check_spans(16);
+    check_spans(300);
+    check_spans(STREAM_SIZE);
+
+    hal.console->printf_P(PSTR("%u byte stream, %u spans, %u packets found\n"),
+                          (unsigned)stream_len, (unsigned)spans, (unsigned)packets_found);
+    if (errors != 0) {
+        hal.console->printf_P(PSTR("FAILED: %u mismatches\n"), (unsigned)errors);
+        return;
+    }
+    hal.console->println("comm_parse_block() matches mavlink_parse_char()");
+    passed = true;
+}
+
+void loop(void)
+{
+    if (passed) {
+        float byte_bpus = byte_rate();
+        float block_bpus = block_rate();
+        hal.console->printf_P(PSTR("mavlink_parse_char() %.1f bytes/usec, comm_parse_block() %.1f bytes/usec\n"),
+                              byte_bpus, block_bpus);
+    }
+    hal.scheduler->delay(1000);
+}
+
+AP_HAL_MAIN();
@@ -0,0 +1,514 @@
+// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+
+//
+// Check and benchmark of MAVLink routing, replaying a packet stream
+// through MAVLink_routing::check_and_forward()
+//
+// The routing decisions are first checked against expected results and
+// against a copy of the old linear route table, for targeted messages,
+// broadcasts, heartbeats and more routes than the table holds. No GCS
+// links are active in this example, so heartbeats are only checked not
+// to go back where they came from.
+//
+// On SITL and Linux the stream is read from routing_bench.tlog in the
+// current directory if it exists, for example a telemetry log captured
+// by MAVProxy. Packets from ground stations (sysid >= 200) are replayed
+// on channel 0 and all others on channel 1, as if from a companion
+// computer. Otherwise a synthetic stream is used, from a GCS, a
+// companion computer and a gimbal.
+//
+
+#include <stdarg.h>
+#include <AP_Common.h>
+#include <AP_Progmem.h>
+#include <AP_HAL.h>
+#include <AP_HAL_AVR.h>
+#include <AP_HAL_SITL.h>
+#include <AP_HAL_Linux.h>
+#include <AP_HAL_FLYMAPLE.h>
+#include <AP_HAL_PX4.h>
+#include <AP_HAL_Empty.h>
+#include <AP_HAL_Empty_Private.h>
+#include <AP_Math.h>
+#include <AP_Param.h>
+#include <StorageManager.h>
+#include <AP_ADC.h>
+#include <AP_InertialSensor.h>
+#include <AP_Notify.h>
+#include <AP_GPS.h>
+#include <AP_Baro.h>
+#include <Filter.h>
+#include <DataFlash.h>
+#include <GCS_MAVLink.h>
+#include <GCS.h>
+#include <AP_Mission.h>
+#include <StorageManager.h>
+#include <AP_Terrain.h>
+#include <AP_AHRS.h>
+#include <AP_Airspeed.h>
+#include <AP_Vehicle.h>
+#include <AP_ADC_AnalogSource.h>
+#include <AP_Compass.h>
+#include <AP_Declination.h>
+#include <AP_NavEKF.h>
+#include <AP_HAL_Linux.h>
+#include <AP_Rally.h>
+#include <AP_Scheduler.h>
+#include <AP_BattMonitor.h>
+#include <SITL.h>
+#include <AP_RangeFinder.h>
+#include <AP_OpticalFlow.h>
+
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL || CONFIG_HAL_BOARD == HAL_BOARD_LINUX
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define ROUTING_BENCH_TLOG 1
+#define MAX_PACKETS 2000
+#else
+#define ROUTING_BENCH_TLOG 0
+#define MAX_PACKETS 32
+#endif
+
+#define REPEATS 10
+
+const AP_HAL::HAL& hal = AP_HAL_BOARD_DRIVER;
+
+const AP_Param::GroupInfo GCS_MAVLINK::var_info[] PROGMEM = {
+    AP_GROUPEND
+};
+
+static MAVLink_routing routing;
+
+// a port with no room, so packets are routed but never sent
+class NullUART : public Empty::EmptyUARTDriver {
+public:
+    int16_t txspace() { return 0; }
+};
+static NullUART null_uart;
+
+// a port that records how many bytes are written to it
+class RecordUART : public Empty::EmptyUARTDriver {
+public:
+    RecordUART() : bytes_written(0) {}
+    int16_t txspace() { return 1024; }
+    size_t write(uint8_t c) { bytes_written++; return 1; }
+    size_t write(const uint8_t *buffer, size_t size) { bytes_written += size; return size; }
+    uint32_t bytes_written;
+};
+static RecordUART record_uart[MAVLINK_COMM_NUM_BUFFERS];
+
+static mavlink_message_t packets[MAX_PACKETS];
+static mavlink_channel_t channels[MAX_PACKETS];
+static uint16_t num_packets;
+
+static void add_packet(mavlink_channel_t chan)
+{
+    channels[num_packets++] = chan;
+}
+
+#if ROUTING_BENCH_TLOG
+/*
+  load packets from a tlog, which is a 64 bit timestamp before each
+  packet
+ */
+static bool load_tlog(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    mavlink_status_t status;
+    memset(&status, 0, sizeof(status));
+    uint8_t buf[512];
+    ssize_t n;
+    while (num_packets < MAX_PACKETS && (n = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i=0; i<n && num_packets < MAX_PACKETS; i++) {
+            // the timestamps are skipped by the parser as noise
+            if (mavlink_parse_char(MAVLINK_COMM_NUM_BUFFERS-1, buf[i],
+                                   &packets[num_packets], &status)) {
+                add_packet(packets[num_packets].sysid >= 200 ? MAVLINK_COMM_0 : MAVLINK_COMM_1);
+            }
+        }
+    }
+    close(fd);
+    return num_packets != 0;
+}
+#endif
+
+/*
+  a GCS on channel 0 sending commands and parameter traffic, and a
+  companion computer and gimbal on channel 1 sending high rate
+  telemetry and position targets
+ */
+static void make_packets(void)
+{
+    const uint8_t gcs_sysid = 255;
+    const uint8_t cc_compid = MAV_COMP_ID_SYSTEM_CONTROL;
+    const uint8_t gimbal_compid = MAV_COMP_ID_GIMBAL;
+    uint8_t sysid = mavlink_system.sysid;
+
+    while (num_packets + 8 <= MAX_PACKETS) {
+        mavlink_msg_heartbeat_pack(gcs_sysid, 0, &packets[num_packets],
+                                   MAV_TYPE_GCS, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+        add_packet(MAVLINK_COMM_0);
+
+        mavlink_msg_param_request_read_pack(gcs_sysid, 0, &packets[num_packets],
+                                            sysid, mavlink_system.compid, "SYSID_THISMAV", -1);
+        add_packet(MAVLINK_COMM_0);
+
+        mavlink_msg_command_long_pack(gcs_sysid, 0, &packets[num_packets],
+                                      sysid, gimbal_compid, MAV_CMD_DO_MOUNT_CONTROL,
+                                      0, 0, 0, 0, 0, 0, 0, 0);
+        add_packet(MAVLINK_COMM_0);
+
+        mavlink_msg_heartbeat_pack(sysid, cc_compid, &packets[num_packets],
+                                   MAV_TYPE_ONBOARD_CONTROLLER, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+        add_packet(MAVLINK_COMM_1);
+
+        mavlink_msg_attitude_pack(sysid, cc_compid, &packets[num_packets],
+                                  0, 0, 0, 0, 0, 0, 0);
+        add_packet(MAVLINK_COMM_1);
+
+        mavlink_msg_set_position_target_local_ned_pack(sysid, cc_compid, &packets[num_packets],
+                                                       0, sysid, mavlink_system.compid,
+                                                       MAV_FRAME_LOCAL_NED, 0,
+                                                       0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        add_packet(MAVLINK_COMM_1);
+
+        mavlink_msg_gimbal_report_pack(sysid, gimbal_compid, &packets[num_packets],
+                                       sysid, mavlink_system.compid,
+                                       0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        add_packet(MAVLINK_COMM_1);
+
+        mavlink_msg_named_value_float_pack(sysid, cc_compid, &packets[num_packets],
+                                           0, "CC_LOAD", 0);
+        add_packet(MAVLINK_COMM_1);
+    }
+}
+
+/*
+  the old linear route table, with one route per sysid/compid/channel,
+  giving the channels a message would be forwarded on instead of
+  sending it
+ */
+class LinearRouting {
+public:
+    LinearRouting(void) : num_routes(0) {}
+
+    bool check_and_forward(mavlink_channel_t in_channel, const mavlink_message_t* msg, uint8_t &mask);
+
+private:
+    uint8_t num_routes;
+    struct route {
+        uint8_t sysid;
+        uint8_t compid;
+        mavlink_channel_t channel;
+    } routes[MAVLINK_MAX_ROUTES];
+
+    void learn_route(mavlink_channel_t in_channel, const mavlink_message_t* msg);
+};
+
+/*
+  targets of the messages used by the checks
+ */
+static void get_targets(const mavlink_message_t* msg, int16_t &sysid, int16_t &compid)
+{
+    switch (msg->msgid) {
+    case MAVLINK_MSG_ID_COMMAND_LONG:
+        sysid  = mavlink_msg_command_long_get_target_system(msg);
+        compid = mavlink_msg_command_long_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+        sysid  = mavlink_msg_param_request_read_get_target_system(msg);
+        compid = mavlink_msg_param_request_read_get_target_component(msg);
+        break;
+    case MAVLINK_MSG_ID_SET_MODE:
+        sysid  = mavlink_msg_set_mode_get_target_system(msg);
+        break;
+    }
+}
+
+bool LinearRouting::check_and_forward(mavlink_channel_t in_channel, const mavlink_message_t* msg, uint8_t &mask)
+{
+    mask = 0;
+    if (msg->sysid == mavlink_system.sysid && 
+        msg->compid == mavlink_system.compid) {
+        return true;
+    }
+
+    learn_route(in_channel, msg);
+
+    if (msg->msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+        mask = GCS_MAVLINK::active_channel_mask();
+        mask &= ~(1U<<(in_channel-MAVLINK_COMM_0));
+        for (uint8_t i=0; i<num_routes; i++) {
+            if (routes[i].sysid == msg->sysid && routes[i].compid == msg->compid) {
+                mask &= ~(1U<<((unsigned)(routes[i].channel-MAVLINK_COMM_0)));
+            }
+        }
+        return true;
+    }
+
+    int16_t target_system = -1;
+    int16_t target_component = -1;
+    get_targets(msg, target_system, target_component);
+
+    bool broadcast_system = (target_system == 0 || target_system == -1);
+    bool broadcast_component = (target_component == 0 || target_component == -1);
+    bool match_system = broadcast_system || (target_system == mavlink_system.sysid);
+    bool match_component = match_system && (broadcast_component || 
+                                            (target_component == mavlink_system.compid));
+    bool process_locally = match_system && match_component;
+
+    if (process_locally && !broadcast_system && !broadcast_component) {
+        return true;
+    }
+
+    bool forwarded = false;
+    for (uint8_t i=0; i<num_routes; i++) {
+        if (broadcast_system || (target_system == routes[i].sysid &&
+                                 (broadcast_component || 
+                                  target_component == routes[i].compid))) {
+            if (in_channel != routes[i].channel) {
+                mask |= 1U<<(routes[i].channel-MAVLINK_COMM_0);
+                forwarded = true;
+            }
+        }
+    }
+    if (!forwarded && match_system) {
+        process_locally = true;
+    }
+
+    return process_locally;
+}
+
+void LinearRouting::learn_route(mavlink_channel_t in_channel, const mavlink_message_t* msg)
+{
+    uint8_t i;
+    if (msg->sysid == 0 || 
+        (msg->sysid == mavlink_system.sysid && 
+         msg->compid == mavlink_system.compid)) {
+        return;
+    }
+    for (i=0; i<num_routes; i++) {
+        if (routes[i].sysid == msg->sysid && 
+            routes[i].compid == msg->compid &&
+            routes[i].channel == in_channel) {
+            break;
+        }
+    }
+    if (i == num_routes && i<MAVLINK_MAX_ROUTES) {
+        routes[i].sysid = msg->sysid;
+        routes[i].compid = msg->compid;
+        routes[i].channel = in_channel;
+        num_routes++;
+    }
+}
+
+static MAVLink_routing check_routing;
+static LinearRouting linear_routing;
+static uint16_t check_errors;
+
+// expected result not given
+#define ANY_MASK 0xFFFF
+
+/*
+  route a message with both tables, checking they agree with each other
+  and with the expected result
+ */
+static bool check_route(const char *name, uint8_t in_channel, const mavlink_message_t &msg,
+                        bool expect_local, uint16_t expect_mask)
+{
+    uint32_t before[MAVLINK_COMM_NUM_BUFFERS];
+    for (uint8_t i=0; i<MAVLINK_COMM_NUM_BUFFERS; i++) {
+        before[i] = record_uart[i].bytes_written;
+    }
+    bool local = check_routing.check_and_forward((mavlink_channel_t)in_channel, &msg);
+    uint8_t mask = 0;
+    for (uint8_t i=0; i<MAVLINK_COMM_NUM_BUFFERS; i++) {
+        if (record_uart[i].bytes_written != before[i]) {
+            mask |= 1U<<i;
+        }
+    }
+
+    uint8_t linear_mask;
+    bool linear_local = linear_routing.check_and_forward((mavlink_channel_t)in_channel, &msg, linear_mask);
+
+    if (local == linear_local && mask == linear_mask &&
+        (expect_mask == ANY_MASK || (local == expect_local && mask == expect_mask))) {
+        return local;
+    }
+    if (check_errors++ < 10) {
+        hal.console->printf_P(PSTR("%s: msg %u from %u/%u on chan %u: local %u/%u mask 0x%x/0x%x"),
+                              name, (unsigned)msg.msgid, (unsigned)msg.sysid, (unsigned)msg.compid,
+                              (unsigned)in_channel, (unsigned)local, (unsigned)linear_local,
+                              (unsigned)mask, (unsigned)linear_mask);
+        if (expect_mask != ANY_MASK) {
+            hal.console->printf_P(PSTR(" expected %u/0x%x"), (unsigned)expect_local, (unsigned)expect_mask);
+        }
+        hal.console->println();
+    }
+    return local;
+}
+
+/*
+  check the routing decisions. A GCS is on channel 0, a companion
+  computer on channel 1 and a gimbal on the last channel
+ */
+static bool check_routes(void)
+{
+    const uint8_t gcs_sysid = 255;
+    const uint8_t cc_compid = MAV_COMP_ID_SYSTEM_CONTROL;
+    const uint8_t gimbal_compid = MAV_COMP_ID_GIMBAL;
+    const uint8_t sysid = mavlink_system.sysid;
+    const uint8_t gcs_chan = 0;
+    const uint8_t cc_chan = 1;
+    const uint8_t gimbal_chan = MAVLINK_COMM_NUM_BUFFERS-1;
+    const uint8_t all_chans = (1U<<MAVLINK_COMM_NUM_BUFFERS)-1;
+    mavlink_message_t msg;
+
+    for (uint8_t i=0; i<MAVLINK_COMM_NUM_BUFFERS; i++) {
+        mavlink_comm_port[i] = &record_uart[i];
+    }
+
+    // heartbeats learn routes, and are never sent back where they
+    // came from
+    mavlink_msg_heartbeat_pack(gcs_sysid, 0, &msg, MAV_TYPE_GCS, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+    check_route("GCS heartbeat", gcs_chan, msg, true,
+                GCS_MAVLINK::active_channel_mask() & ~(1U<<gcs_chan));
+    mavlink_msg_heartbeat_pack(sysid, cc_compid, &msg, MAV_TYPE_ONBOARD_CONTROLLER, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+    check_route("companion heartbeat", cc_chan, msg, true,
+                GCS_MAVLINK::active_channel_mask() & ~(1U<<cc_chan));
+    mavlink_msg_heartbeat_pack(sysid, gimbal_compid, &msg, MAV_TYPE_GIMBAL, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+    check_route("gimbal heartbeat", gimbal_chan, msg, true,
+                GCS_MAVLINK::active_channel_mask() & ~(1U<<gimbal_chan));
+    uint8_t cc_chans = 1U<<cc_chan;
+#if MAVLINK_COMM_NUM_BUFFERS > 3
+    // the companion computer on a second link. Its heartbeat is not
+    // sent back on either of its links
+    mavlink_msg_heartbeat_pack(sysid, cc_compid, &msg, MAV_TYPE_ONBOARD_CONTROLLER, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+    check_route("companion heartbeat on second link", 2, msg, true,
+                GCS_MAVLINK::active_channel_mask() & ~((1U<<cc_chan) | (1U<<2)));
+    cc_chans |= 1U<<2;
+#endif
+
+    // targeted messages go only to the learned channels
+    mavlink_msg_command_long_pack(gcs_sysid, 0, &msg, sysid, gimbal_compid, MAV_CMD_DO_MOUNT_CONTROL, 0, 0, 0, 0, 0, 0, 0, 0);
+    check_route("targeted at gimbal", gcs_chan, msg, false, 1U<<gimbal_chan);
+    mavlink_msg_command_long_pack(gcs_sysid, 0, &msg, sysid, cc_compid, MAV_CMD_DO_SET_MODE, 0, 0, 0, 0, 0, 0, 0, 0);
+    check_route("targeted at companion", gcs_chan, msg, false, cc_chans);
+    mavlink_msg_param_request_read_pack(sysid, cc_compid, &msg, gcs_sysid, 0, "CC_PARAM", -1);
+    check_route("targeted at GCS", cc_chan, msg, false, 1U<<gcs_chan);
+    mavlink_msg_command_long_pack(gcs_sysid, 0, &msg, sysid, mavlink_system.compid, MAV_CMD_DO_SET_MODE, 0, 0, 0, 0, 0, 0, 0, 0);
+    check_route("targeted at us", gcs_chan, msg, true, 0);
+
+    // a targeted message for an unknown component of this system is
+    // handled locally, and one for an unknown system is dropped
+    mavlink_msg_command_long_pack(gcs_sysid, 0, &msg, sysid, 99, MAV_CMD_DO_SET_MODE, 0, 0, 0, 0, 0, 0, 0, 0);
+    check_route("unknown component", gcs_chan, msg, true, 0);
+    mavlink_msg_command_long_pack(gcs_sysid, 0, &msg, 42, 1, MAV_CMD_DO_SET_MODE, 0, 0, 0, 0, 0, 0, 0, 0);
+    check_route("unknown system", gcs_chan, msg, false, 0);
+
+    // broadcasts go to every channel with a route except the one they
+    // came in on
+    mavlink_msg_attitude_pack(sysid, cc_compid, &msg, 0, 0, 0, 0, 0, 0, 0);
+    check_route("broadcast", cc_chan, msg, true, all_chans & ~(1U<<cc_chan));
+    mavlink_msg_command_long_pack(gcs_sysid, 0, &msg, 0, 0, MAV_CMD_DO_SET_MODE, 0, 0, 0, 0, 0, 0, 0, 0);
+    check_route("broadcast to system 0", gcs_chan, msg, true, all_chans & ~(1U<<gcs_chan));
+    mavlink_msg_set_mode_pack(gcs_sysid, 0, &msg, sysid, 0, 0);
+    check_route("broadcast to our components", gcs_chan, msg, true,
+                cc_chans | (1U<<gimbal_chan));
+
+    // more routes than there are hash slots, with several sysid/compid
+    // pairs in each slot, filling the table. Targeted messages reach
+    // the routes that were learned and no others. The old table took
+    // a route for each link a sysid/compid was seen on, so it fills
+    // sooner when components are on more than one link. Both tables
+    // start empty here to hold the same number of routes
+    check_routing = MAVLink_routing();
+    linear_routing = LinearRouting();
+    for (uint16_t k=0; k<MAVLINK_ROUTE_HASH_SIZE+8; k++) {
+        uint8_t route_sysid = 2 + (k % 4) * 64;
+        uint8_t route_compid = k / 4;
+        uint8_t chan = k % MAVLINK_COMM_NUM_BUFFERS;
+        mavlink_msg_heartbeat_pack(route_sysid, route_compid, &msg, MAV_TYPE_GENERIC, MAV_AUTOPILOT_INVALID, 0, 0, 0);
+        check_route("many routes heartbeat", chan, msg, true, ANY_MASK);
+    }
+    uint16_t forwarded = 0;
+    for (uint16_t k=0; k<MAVLINK_ROUTE_HASH_SIZE+8; k++) {
+        uint8_t route_sysid = 2 + (k % 4) * 64;
+        uint8_t route_compid = k / 4;
+        uint8_t chan = k % MAVLINK_COMM_NUM_BUFFERS;
+        uint8_t in_chan = (chan + 1) % MAVLINK_COMM_NUM_BUFFERS;
+        mavlink_msg_command_long_pack(sysid, cc_compid, &msg, route_sysid, route_compid, MAV_CMD_DO_SET_MODE, 0, 0, 0, 0, 0, 0, 0, 0);
+        uint32_t before = record_uart[chan].bytes_written;
+        check_route("many routes targeted", in_chan, msg, false, ANY_MASK);
+        if (record_uart[chan].bytes_written != before) {
+            forwarded++;
+        }
+    }
+    mavlink_msg_attitude_pack(sysid, cc_compid, &msg, 0, 0, 0, 0, 0, 0, 0);
+    check_route("many routes broadcast", cc_chan, msg, true, ANY_MASK);
+    if (forwarded == 0 || forwarded >= MAVLINK_ROUTE_HASH_SIZE+8) {
+        hal.console->printf_P(PSTR("many routes: %u of %u forwarded\n"),
+                              (unsigned)forwarded, (unsigned)(MAVLINK_ROUTE_HASH_SIZE+8));
+        check_errors++;
+    }
+
+    for (uint8_t i=0; i<MAVLINK_COMM_NUM_BUFFERS; i++) {
+        mavlink_comm_port[i] = &null_uart;
+    }
+
+    if (check_errors != 0) {
+        hal.console->printf_P(PSTR("FAILED: %u routing mismatches\n"), (unsigned)check_errors);
+        return false;
+    }
+    hal.console->println("routing matches the linear route table");
+    return true;
+}
+
+void setup(void)
+{
+    hal.console->println("MAVLink routing benchmark");
+
+    check_routes();
+
+#if ROUTING_BENCH_TLOG
+    if (load_tlog("routing_bench.tlog")) {
+        hal.console->printf_P(PSTR("loaded %u packets from routing_bench.tlog\n"),
+                              (unsigned)num_packets);
+    }
+#endif
+    if (num_packets == 0) {
+        make_packets();
+        hal.console->printf_P(PSTR("made %u packets\n"), (unsigned)num_packets);
+    }
+}
+
+void loop(void)
+{
+    uint32_t best = 0;
+    uint16_t local = 0;
+    for (uint8_t r=0; r<REPEATS; r++) {
+        local = 0;
+        uint32_t t0 = hal.scheduler->micros();
+        for (uint16_t i=0; i<num_packets; i++) {
+            if (routing.check_and_forward(channels[i], &packets[i])) {
+                local++;
+            }
+        }
+        uint32_t dt = hal.scheduler->micros() - t0;
+        if (r == 0 || dt < best) {
+            best = dt;
+        }
+    }
+
+    hal.console->printf_P(PSTR("%u packets %u local: %.3f usec/packet %lu packets/sec\n"),
+                          (unsigned)num_packets, (unsigned)local,
+                          best / (float)num_packets,
+                          (unsigned long)(best ? num_packets * 1.0e6f / best : 0));
+    hal.scheduler->delay(1000);
+}
+
+AP_HAL_MAIN();
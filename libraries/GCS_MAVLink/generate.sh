@@ -18,3 +18,6 @@ rm -rf "$mavdir/include/*"
 
 echo "Generating C code"
 mavgen.py --lang=C --wire-protocol=1.0 --output=$mavdir/include/mavlink/v1.0 $mavdir/message_definitions/ardupilotmega.xml
+
+echo "Generating routing target table"
+python $mavdir/generate_targets.py $mavdir/message_definitions/ardupilotmega.xml $mavdir/MAVLink_targets.h
@@ -0,0 +1,109 @@
+#!/usr/bin/env python
+'''
+generate MAVLink_targets.h, the table of target_system and
+target_component offsets used by MAVLink_routing, from the message
+definitions
+
+usage: generate_targets.py message_definitions/ardupilotmega.xml MAVLink_targets.h
+'''
+
+import os, sys
+import xml.etree.ElementTree as ET
+
+type_lengths = {
+    'char'     : 1,
+    'int8_t'   : 1,
+    'uint8_t'  : 1,
+    'uint8_t_mavlink_version' : 1,
+    'int16_t'  : 2,
+    'uint16_t' : 2,
+    'int32_t'  : 4,
+    'uint32_t' : 4,
+    'float'    : 4,
+    'int64_t'  : 8,
+    'uint64_t' : 8,
+    'double'   : 8,
+}
+
+NONE = 0xFF
+
+def load_messages(filename, messages, done):
+    '''load the messages from a definitions file and its includes'''
+    filename = os.path.abspath(filename)
+    if filename in done:
+        return
+    done.add(filename)
+    root = ET.parse(filename).getroot()
+    for inc in root.findall('include'):
+        load_messages(os.path.join(os.path.dirname(filename), inc.text.strip()), messages, done)
+    for m in root.iter('message'):
+        fields = []
+        for f in m:
+            if f.tag == 'extensions':
+                # not sent on the 1.0 wire protocol
+                break
+            if f.tag != 'field':
+                continue
+            ftype = f.get('type')
+            count = 1
+            if '[' in ftype:
+                ftype, count = ftype[:-1].split('[')
+                count = int(count)
+            fields.append((f.get('name'), type_lengths[ftype], count))
+        messages[int(m.get('id'))] = (m.get('name'), fields)
+
+def wire_offsets(fields):
+    '''return the payload offset of each field. Fields are sent largest
+    type first, keeping the definition order for types of the same
+    size, as done by mavgen'''
+    ordered = sorted(fields, key=lambda f: f[1], reverse=True)
+    offsets = {}
+    ofs = 0
+    for (name, length, count) in ordered:
+        offsets[name] = ofs
+        ofs += length * count
+    return offsets
+
+def generate(xml, output):
+    messages = {}
+    load_messages(xml, messages, set())
+
+    f = open(output, 'w')
+    f.write('''// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+  offsets of target_system and target_component in the payload of each
+  MAVLink message, indexed by msgid. MAVLINK_TARGET_NONE means the
+  message has no such field.
+
+  generated from %s by generate_targets.py, do not edit
+ */
+
+#ifndef __MAVLINK_TARGETS_H
+#define __MAVLINK_TARGETS_H
+
+#define MAVLINK_TARGET_NONE 0x%02X
+
+#define MAVLINK_TARGET_OFFSETS { \\
+''' % (os.path.basename(xml), NONE))
+    for msgid in range(256):
+        sysid = compid = NONE
+        comment = ''
+        if msgid in messages:
+            (name, fields) = messages[msgid]
+            offsets = wire_offsets(fields)
+            sysid = offsets.get('target_system', NONE)
+            compid = offsets.get('target_component', NONE)
+            if sysid != NONE or compid != NONE:
+                comment = ' /* %s */' % name
+        f.write('    { 0x%02X, 0x%02X },%s \\\n' % (sysid, compid, comment))
+    f.write('''}
+
+#endif // __MAVLINK_TARGETS_H
+''')
+    f.close()
+
+if len(sys.argv) != 3:
+    print("usage: generate_targets.py DEFINITIONS.xml OUTPUT.h")
+    sys.exit(1)
+
+generate(sys.argv[1], sys.argv[2])
@@ -44,6 +44,8 @@ Aircraft::Aircraft(const char *home_str, const char *frame_str) :
     gyro_noise(radians(0.1f)),
     accel_noise(0.3),
     rate_hz(400),
+    instance(0),
+    lockstep(false),
     last_time_us(0)
 {
     char *saveptr=NULL;
@@ -138,6 +140,10 @@ void Aircraft::adjust_frame_time(float new_rate)
    into account desired speedup */
 void Aircraft::sync_frame_time(void)
 {
+    if (lockstep) {
+        // simulation time is all that matters
+        return;
+    }
     uint64_t now = get_wall_time_us();
     uint64_t dt_us = now - last_wall_time_us;
     if (dt_us < scaled_frame_time_us) {
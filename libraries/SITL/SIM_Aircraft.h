@@ -45,6 +45,14 @@ public:
      */
     void set_speedup(float speedup);
 
+    /*
+      run in lockstep with the autopilot, as fast as the CPU allows,
+      instead of keeping in step with the wall clock
+     */
+    void set_lockstep(bool _lockstep) {
+        lockstep = _lockstep;
+    }
+
     /*
       set instance number
      */
@@ -84,6 +92,7 @@ protected:
     float scaled_frame_time_us;
     uint64_t last_wall_time_us;
     uint8_t instance;
+    bool lockstep;
 
     bool on_ground(const Vector3f &pos) const;
 
@@ -0,0 +1,226 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  multi-vehicle swarm simulation, see SIM_Swarm.h
+*/
+
+#include <AP_HAL.h>
+#if CONFIG_HAL_BOARD == HAL_BOARD_SITL
+#include "SIM_Swarm.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+SwarmLink::SwarmLink(void) :
+    _shared(NULL),
+    _instance(0)
+{
+    memset(_inputs, 0, sizeof(_inputs));
+}
+
+uint64_t SwarmLink::wall_time_ms(void)
+{
+    struct timeval tp;
+    gettimeofday(&tp, NULL);
+    return tp.tv_sec*1000ULL + tp.tv_usec/1000;
+}
+
+/*
+  map the shared swarm file
+ */
+bool SwarmLink::map(const char *path, bool create)
+{
+    int fd = open(path, create ? (O_RDWR|O_CREAT|O_TRUNC) : O_RDWR, 0644);
+    if (fd == -1) {
+        return false;
+    }
+    if (create && ftruncate(fd, sizeof(struct swarm_shared)) != 0) {
+        close(fd);
+        return false;
+    }
+    void *p = mmap(NULL, sizeof(struct swarm_shared), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    _shared = (struct swarm_shared *)p;
+    return true;
+}
+
+/*
+  create the shared state. The magic is written last, so autopilots
+  never see a half initialised swarm
+ */
+bool SwarmLink::create(const char *path, uint16_t num_vehicles, uint16_t idle_pwm)
+{
+    if (num_vehicles == 0 || num_vehicles > SWARM_MAX_VEHICLES || !map(path, true)) {
+        return false;
+    }
+    for (uint16_t i=0; i<num_vehicles; i++) {
+        for (uint8_t s=0; s<16; s++) {
+            _inputs[i].servos[s] = idle_pwm;
+        }
+    }
+    memset((void *)_shared, 0, sizeof(*_shared));
+    _shared->num_vehicles = num_vehicles;
+    _shared->running = 1;
+    __sync_synchronize();
+    _shared->magic = SWARM_MAGIC;
+    return true;
+}
+
+/*
+  attach to a swarm as one vehicle, waiting for the physics process
+  to create it if needed
+ */
+bool SwarmLink::attach(const char *path, uint8_t instance)
+{
+    uint64_t start = wall_time_ms();
+    while (_shared == NULL || _shared->magic != SWARM_MAGIC) {
+        if (_shared == NULL) {
+            map(path, false);
+        }
+        if (wall_time_ms() - start > SWARM_TIMEOUT_MS) {
+            return false;
+        }
+        if (_shared == NULL || _shared->magic != SWARM_MAGIC) {
+            usleep(10000);
+        }
+    }
+    if (instance >= _shared->num_vehicles) {
+        return false;
+    }
+    _instance = instance;
+    return true;
+}
+
+/*
+  send servos for the next step and wait for the resulting state
+ */
+bool SwarmLink::exchange(const Aircraft::sitl_input &input, struct sitl_fdm &fdm)
+{
+    struct swarm_input &in = _shared->inputs[_instance];
+    struct swarm_output &out = _shared->outputs[_instance];
+
+    uint32_t seq = out.seq + 1;
+    memcpy(in.servos, input.servos, sizeof(in.servos));
+    __sync_synchronize();
+    in.seq = seq;
+    in.attached = 1;
+
+    uint64_t start = 0;
+    for (uint16_t spins=0; out.seq != seq; spins++) {
+        if (!_shared->running) {
+            return false;
+        }
+        if (spins < 200) {
+            sched_yield();
+            continue;
+        }
+        // the physics is waiting for slower vehicles
+        if (start == 0) {
+            start = wall_time_ms();
+        } else if (wall_time_ms() - start > SWARM_TIMEOUT_MS) {
+            return false;
+        }
+        usleep(50);
+    }
+    __sync_synchronize();
+    memcpy(&fdm, (const void *)&out.fdm, sizeof(fdm));
+    return true;
+}
+
+/*
+  step every model once. Each attached vehicle's input for the step is
+  waited for first, so all vehicles advance together
+ */
+uint16_t SwarmLink::step(Aircraft **models)
+{
+    uint16_t n = _shared->num_vehicles;
+    uint16_t attached = 0;
+
+    // the timeout is for the whole step, so several vehicles going
+    // at once are all dropped in one timeout
+    uint64_t start = 0;
+    for (uint16_t i=0; i<n; i++) {
+        struct swarm_input &in = _shared->inputs[i];
+        const struct swarm_output &out = _shared->outputs[i];
+        if (!in.attached) {
+            continue;
+        }
+        for (uint16_t spins=0; in.seq == out.seq; spins++) {
+            if (spins < 200) {
+                sched_yield();
+                continue;
+            }
+            if (start == 0) {
+                start = wall_time_ms();
+            } else if (wall_time_ms() - start > SWARM_TIMEOUT_MS) {
+                // the autopilot has gone, leave its vehicle where it is
+                fprintf(stderr, "Swarm vehicle %u detached\n", (unsigned)i);
+                in.attached = 0;
+                break;
+            }
+            usleep(50);
+        }
+        if (in.attached) {
+            __sync_synchronize();
+            memcpy(_inputs[i].servos, (const void *)in.servos, sizeof(_inputs[i].servos));
+            attached++;
+        }
+    }
+
+    for (uint16_t i=0; i<n; i++) {
+        models[i]->update(_inputs[i]);
+    }
+
+    for (uint16_t i=0; i<n; i++) {
+        struct swarm_output &out = _shared->outputs[i];
+        models[i]->fill_fdm(out.fdm);
+        __sync_synchronize();
+        if (_shared->inputs[i].attached) {
+            out.seq = _shared->inputs[i].seq;
+        }
+    }
+    return attached;
+}
+
+/*
+  smallest horizontal distance between any two vehicles
+ */
+float SwarmLink::min_separation(void) const
+{
+    float ret = -1;
+    uint16_t n = _shared->num_vehicles;
+    for (uint16_t i=0; i<n; i++) {
+        const struct sitl_fdm &a = _shared->outputs[i].fdm;
+        float scale = cosf(radians(a.latitude));
+        for (uint16_t j=i+1; j<n; j++) {
+            const struct sitl_fdm &b = _shared->outputs[j].fdm;
+            float dn = (b.latitude - a.latitude) * 111319.5f;
+            float de = (b.longitude - a.longitude) * 111319.5f * scale;
+            float d = pythagorous2(dn, de);
+            if (ret < 0 || d < ret) {
+                ret = d;
+            }
+        }
+    }
+    return ret;
+}
+#endif // CONFIG_HAL_BOARD
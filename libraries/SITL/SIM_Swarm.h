@@ -0,0 +1,113 @@
+/// -*- tab-width: 4; Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil -*-
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/*
+  multi-vehicle swarm simulation
+
+  One physics process steps the models of every vehicle in the swarm
+  together. Each autopilot is a normal SITL process that exchanges
+  servo outputs and FDM state with the physics process through a
+  memory mapped file instead of UDP. The file holds one array of
+  servo inputs and one array of FDM outputs, one cache line aligned
+  slot per vehicle, so the physics loop walks each array in order and
+  no two writers share a cache line.
+
+  Each exchange is a lockstep handshake on a sequence number: the
+  autopilot writes its servos and bumps its input sequence, the
+  physics process steps all vehicles once it has every attached
+  vehicle's input for the step, then publishes the FDM state with the
+  matching output sequence.
+*/
+
+#ifndef _SIM_SWARM_H
+#define _SIM_SWARM_H
+
+#include "SIM_Aircraft.h"
+
+#define SWARM_MAX_VEHICLES 64
+#define SWARM_MAGIC 0x5357524D
+
+// how long either side waits for the other before giving up
+#define SWARM_TIMEOUT_MS 5000
+
+class SwarmLink
+{
+public:
+    SwarmLink(void);
+
+    /*
+      physics side: create the shared state for num_vehicles
+      vehicles. Models are driven with idle_pwm on all servos until
+      their autopilot attaches
+     */
+    bool create(const char *path, uint16_t num_vehicles, uint16_t idle_pwm);
+
+    /*
+      autopilot side: attach to an existing swarm as vehicle instance
+     */
+    bool attach(const char *path, uint8_t instance);
+
+    /*
+      autopilot side: send servo outputs and wait for the FDM state
+      of the next step. Returns false if the physics process has gone
+     */
+    bool exchange(const Aircraft::sitl_input &input, struct sitl_fdm &fdm);
+
+    /*
+      physics side: step all models, then publish their state. Vehicles
+      without an autopilot attached are stepped with their last
+      inputs. Returns the number of vehicles attached
+     */
+    uint16_t step(Aircraft **models);
+
+    /*
+      physics side: return the smallest horizontal distance in meters
+      between any two vehicles, for checking collision avoidance
+     */
+    float min_separation(void) const;
+
+    uint16_t num_vehicles(void) const { return _shared ? _shared->num_vehicles : 0; }
+
+private:
+    struct swarm_input {
+        volatile uint32_t seq;
+        volatile uint8_t attached;
+        uint16_t servos[16];
+    } __attribute__((aligned(64)));
+
+    struct swarm_output {
+        volatile uint32_t seq;
+        struct sitl_fdm fdm;
+    } __attribute__((aligned(64)));
+
+    struct swarm_shared {
+        uint32_t magic;
+        uint16_t num_vehicles;
+        volatile uint8_t running;
+        struct swarm_input inputs[SWARM_MAX_VEHICLES];
+        struct swarm_output outputs[SWARM_MAX_VEHICLES];
+    };
+
+    bool map(const char *path, bool create);
+    static uint64_t wall_time_ms(void);
+
+    struct swarm_shared *_shared;
+    uint8_t _instance;
+
+    // physics side copy of the last inputs of each vehicle
+    Aircraft::sitl_input _inputs[SWARM_MAX_VEHICLES];
+};
+
+#endif // _SIM_SWARM_H